@@ -0,0 +1,120 @@
+#include "bytecode.h"
+
+#include <cstring>
+
+#include "vm.h"
+
+
+Chunk::~Chunk() {
+    for (auto it = constants.begin(); it != constants.end(); it++) {
+        if (it->isHeapValue()) {
+            it->payloadObject->pinCount--;
+        }
+    }
+}
+
+void Chunk::emit(OpCode op) {
+    code.push_back(static_cast<uint8_t>(op));
+}
+
+void Chunk::emit(OpCode op, uint32_t operand) {
+    emit(op);
+
+    size_t offset = code.size();
+    code.resize(offset + sizeof(uint32_t));
+    std::memcpy(&code[offset], &operand, sizeof(uint32_t));
+}
+
+void Chunk::emit(OpCode op, uint32_t first, uint32_t second) {
+    emit(op, first);
+
+    size_t offset = code.size();
+    code.resize(offset + sizeof(uint32_t));
+    std::memcpy(&code[offset], &second, sizeof(uint32_t));
+}
+
+void Chunk::emit(OpCode op, uint32_t first, uint32_t second,
+        uint32_t third) {
+    emit(op, first, second);
+
+    size_t offset = code.size();
+    code.resize(offset + sizeof(uint32_t));
+    std::memcpy(&code[offset], &third, sizeof(uint32_t));
+}
+
+void Chunk::patch(size_t offset, uint32_t operand) {
+    std::memcpy(&code[offset + 1], &operand, sizeof(uint32_t));
+}
+
+void Chunk::rewrite(size_t offset, OpCode op) const {
+    code[offset] = static_cast<uint8_t>(op);
+}
+
+uint32_t Chunk::addConstant(ExpressionValue value) {
+    value = value.promote();
+
+    if (value.isHeapValue()) {
+        value.payloadObject->pinCount++;
+    }
+
+    constants.push_back(value);
+
+    return static_cast<uint32_t>(constants.size() - 1);
+}
+
+uint32_t Chunk::addScope(const Scope& scope) {
+    scopes.push_back(scope);
+
+    return static_cast<uint32_t>(scopes.size() - 1);
+}
+
+uint32_t Chunk::addCache() {
+    caches.emplace_back();
+
+    return static_cast<uint32_t>(caches.size() - 1);
+}
+
+
+uint32_t operandCount(OpCode op) {
+    switch (op) {
+        case OpCode::CONSTANT:
+        case OpCode::CLOSURE:
+        case OpCode::LOAD_NAME:
+        case OpCode::STORE_NAME:
+        case OpCode::LOAD_GLOBAL:
+        case OpCode::JUMP:
+        case OpCode::LOOP:
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_FALSE_OR_POP:
+        case OpCode::JUMP_IF_TRUE_OR_POP:
+        case OpCode::PUSH_SCOPE:
+        case OpCode::CALL:
+        case OpCode::CALL_SELF:
+        case OpCode::TAIL_CALL:
+            return 1;
+        case OpCode::LOAD_LOCAL:
+        case OpCode::STORE_LOCAL:
+        case OpCode::LOAD_CALLEE:
+        case OpCode::COMPARE_JUMP_IF_FALSE:
+            return 2;
+        case OpCode::LOAD_CAPTURED:
+        case OpCode::STORE_CAPTURED:
+        case OpCode::ADD_LOCAL_CONSTANT:
+        case OpCode::SUBTRACT_LOCAL_CONSTANT:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+
+CompiledFunction::CompiledFunction(const Scope& parameterScope) {
+    this->parameterScope = parameterScope;
+}
+
+ExpressionValue CompiledFunction::evaluate(
+        Environment* env) {
+    VirtualMachine vm;
+
+    return vm.run(*this, env);
+}
@@ -0,0 +1,442 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "expressions.h"
+
+
+/**
+ * @brief The instructions understood by the VirtualMachine.
+ *
+ * Every instruction is encoded as a single byte. Instructions that take an
+ * operands are followed by one 32 bit unsigned integer per operand in
+ * native byte order.
+ *
+ */
+enum class OpCode : uint8_t {
+    /**
+     * @brief Push the constant at index <operand> onto the stack.
+     *
+     */
+    CONSTANT,
+
+    /**
+     * @brief Push a closure of the function held by the constant at index
+     * <operand>, capturing its variables from the current environment.
+     *
+     */
+    CLOSURE,
+
+    /**
+     * @brief Push an empty value (the result of an empty block or print).
+     *
+     */
+    NONE,
+
+    /**
+     * @brief Discard the value on top of the stack.
+     *
+     */
+    POP,
+
+    /**
+     * @brief Push the variable whose name is the symbol <operand>.
+     *
+     */
+    LOAD_NAME,
+
+    /**
+     * @brief Assign the value on top of the stack to the variable whose
+     * name is the symbol <operand>. The value stays on the stack.
+     *
+     */
+    STORE_NAME,
+
+    /**
+     * @brief Push the variable in slot <operand 1> of the environment
+     * <operand 0> levels up.
+     *
+     */
+    LOAD_LOCAL,
+
+    /**
+     * @brief Assign the value on top of the stack to the variable in slot
+     * <operand 1> of the environment <operand 0> levels up. The value stays
+     * on the stack.
+     *
+     */
+    STORE_LOCAL,
+
+    /**
+     * @brief Push the global variable whose name is the symbol <operand>.
+     *
+     */
+    LOAD_GLOBAL,
+
+    /**
+     * @brief Push the captured variable <operand 1> of the closure of the
+     * call whose environment is <operand 0> levels up. Its name is the
+     * symbol <operand 2>.
+     *
+     */
+    LOAD_CAPTURED,
+
+    /**
+     * @brief Assign the value on top of the stack to the captured variable
+     * <operand 1> of the closure of the call whose environment is
+     * <operand 0> levels up. Its name is the symbol <operand 2>. The value
+     * stays on the stack.
+     *
+     */
+    STORE_CAPTURED,
+
+    /**
+     * @brief Push the function to call whose name is the symbol
+     * <operand 0>, like LOAD_NAME, remembering where it was found in the
+     * call site cache <operand 1>.
+     *
+     */
+    LOAD_CALLEE,
+
+    ADD,
+    SUBTRACT,
+    MULTIPLY,
+    DIVIDE,
+    EQUALS,
+    NOT_EQUALS,
+    GREATER,
+    GREATER_OR_EQUALS,
+    LESS,
+    LESS_OR_EQUALS,
+
+    /**
+     * @brief Quickened forms of the operations above for two INT or two
+     * FLOAT operands, which skip the type dispatch. Never emitted by the
+     * Compiler: the VirtualMachine rewrites an operation to one of them once
+     * it saw operands of that type, and back to the generic operation when
+     * the operands do not match.
+     *
+     */
+    ADD_INT,
+    SUBTRACT_INT,
+    MULTIPLY_INT,
+    DIVIDE_INT,
+    EQUALS_INT,
+    NOT_EQUALS_INT,
+    GREATER_INT,
+    GREATER_OR_EQUALS_INT,
+    LESS_INT,
+    LESS_OR_EQUALS_INT,
+    ADD_FLOAT,
+    SUBTRACT_FLOAT,
+    MULTIPLY_FLOAT,
+    DIVIDE_FLOAT,
+    EQUALS_FLOAT,
+    NOT_EQUALS_FLOAT,
+    GREATER_FLOAT,
+    GREATER_OR_EQUALS_FLOAT,
+    LESS_FLOAT,
+    LESS_OR_EQUALS_FLOAT,
+
+    /**
+     * @brief Superinstructions pushing the variable in slot <operand 1> of
+     * the environment <operand 0> levels up plus or minus the constant at
+     * index <operand 2>, as LOAD_LOCAL, CONSTANT and ADD or SUBTRACT would.
+     * Emitted for operations like x - 1.
+     *
+     */
+    ADD_LOCAL_CONSTANT,
+    SUBTRACT_LOCAL_CONSTANT,
+
+    /**
+     * @brief Continue execution at the absolute offset <operand>.
+     *
+     */
+    JUMP,
+
+    /**
+     * @brief Continue execution at the earlier offset <operand>, the start
+     * of a loop. Runs a collection first if one has been requested.
+     *
+     */
+    LOOP,
+
+    /**
+     * @brief Pop the condition and jump to <operand> unless it is an INT
+     * with a nonzero value.
+     *
+     */
+    JUMP_IF_FALSE,
+
+    /**
+     * @brief Superinstruction popping two operands, comparing them with the
+     * comparison <operand 1> (like LESS) and jumping to <operand 0> unless
+     * the comparison holds. Emitted for conditions of if statements that
+     * are comparisons.
+     *
+     */
+    COMPARE_JUMP_IF_FALSE,
+
+    /**
+     * @brief Jump to <operand> if the INT on top of the stack is 0, keeping
+     * it as the result. Otherwise pop it. Used for and connectives.
+     *
+     */
+    JUMP_IF_FALSE_OR_POP,
+
+    /**
+     * @brief Jump to <operand> if the INT on top of the stack is 1, keeping
+     * it as the result. Otherwise pop it. Used for or connectives.
+     *
+     */
+    JUMP_IF_TRUE_OR_POP,
+
+    /**
+     * @brief Open a new variable scope for the scope at index <operand> as
+     * a child of the current one.
+     *
+     */
+    PUSH_SCOPE,
+
+    /**
+     * @brief Close the innermost variable scope.
+     *
+     */
+    POP_SCOPE,
+
+    /**
+     * @brief Call the function below the <operand> arguments on the stack.
+     * Throws if it is not a function.
+     *
+     */
+    CALL,
+
+    /**
+     * @brief Quickened form of CALL for calls of the function that is
+     * currently executing, like most recursive calls. Never emitted by the
+     * Compiler: the VirtualMachine rewrites a CALL to it after such a call,
+     * and back to CALL when the function on the stack is a different one.
+     *
+     */
+    CALL_SELF,
+
+    /**
+     * @brief Call the function below the <operand> arguments on the stack in
+     * place of the current call frame, as if followed by RETURN. Functions
+     * that are not compiled are called like with CALL.
+     *
+     */
+    TAIL_CALL,
+
+    /**
+     * @brief Return the value on top of the stack to the caller.
+     *
+     */
+    RETURN
+};
+
+
+/**
+ * @brief A sequence of instructions together with the constants and scopes
+ * they refer to. Names are referenced by their SymbolId. Constants are
+ * pinned on the heap for as long as the chunk exists.
+ *
+ */
+class Chunk {
+public:
+    /**
+     * @brief Construct a new empty Chunk object.
+     *
+     */
+    Chunk() = default;
+
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+
+    /**
+     * @brief Destroy the Chunk object, unpinning its constants.
+     *
+     */
+    ~Chunk();
+
+    /**
+     * @brief Append an instruction without operand.
+     *
+     * @param op the instruction to append.
+     */
+    void emit(OpCode op);
+
+    /**
+     * @brief Append an instruction with an operand.
+     *
+     * @param op the instruction to append.
+     * @param operand the operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t operand);
+
+    /**
+     * @brief Append an instruction with two operands.
+     *
+     * @param op the instruction to append.
+     * @param first the first operand of the instruction.
+     * @param second the second operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t first, uint32_t second);
+
+    /**
+     * @brief Append an instruction with three operands.
+     *
+     * @param op the instruction to append.
+     * @param first the first operand of the instruction.
+     * @param second the second operand of the instruction.
+     * @param third the third operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t first, uint32_t second, uint32_t third);
+
+    /**
+     * @brief Overwrite the operand of the instruction at <offset>.
+     *
+     * @param offset the offset of the instruction (not of the operand).
+     * @param operand the new operand.
+     */
+    void patch(size_t offset, uint32_t operand);
+
+    /**
+     * @brief Add a constant, which can be referenced by CONSTANT. Pins the
+     * heap object of the constant.
+     *
+     * @param value the constant to add.
+     * @return uint32_t the index of the constant.
+     */
+    uint32_t addConstant(ExpressionValue value);
+
+    /**
+     * @brief Add the scope of a block, which can be referenced by
+     * PUSH_SCOPE.
+     *
+     * @param scope the scope to add.
+     * @return uint32_t the index of the scope.
+     */
+    uint32_t addScope(const Scope& scope);
+
+    /**
+     * @brief Add an empty call site cache, which can be referenced by
+     * LOAD_CALLEE.
+     *
+     * @return uint32_t the index of the cache.
+     */
+    uint32_t addCache();
+
+    /**
+     * @brief Read an operand of the instruction at <offset>.
+     *
+     * @param offset the offset of the instruction (not of the operand).
+     * @param index which operand to read.
+     * @return uint32_t the operand.
+     */
+    uint32_t readOperand(size_t offset, uint32_t index = 0) const {
+        uint32_t operand;
+        std::memcpy(&operand, &code[offset + 1 + index * sizeof(uint32_t)],
+            sizeof(uint32_t));
+
+        return operand;
+    }
+
+    /**
+     * @brief Replace the instruction at <offset> by another one with the
+     * same operands, used to quicken instructions while the chunk runs.
+     *
+     * @param offset the offset of the instruction.
+     * @param op the new instruction.
+     */
+    void rewrite(size_t offset, OpCode op) const;
+
+    /**
+     * @brief The encoded instructions. Quickening rewrites them even in
+     * chunks that are otherwise constant.
+     *
+     */
+    mutable std::vector<uint8_t> code;
+
+    /**
+     * @brief The constants referenced by CONSTANT instructions.
+     *
+     */
+    std::vector<ExpressionValue> constants;
+
+    /**
+     * @brief The scopes referenced by PUSH_SCOPE instructions. Environments
+     * point into this list, so it must not change while the chunk runs.
+     *
+     */
+    std::vector<Scope> scopes;
+
+    /**
+     * @brief The call site caches referenced by LOAD_CALLEE instructions.
+     * Filled while the chunk runs, like quickened instructions.
+     *
+     */
+    mutable std::vector<BindingCache> caches;
+};
+
+
+/**
+ * @brief Get the number of operands following an instruction.
+ *
+ * @param op the instruction to check.
+ * @return uint32_t the number of operands <op> takes.
+ */
+uint32_t operandCount(OpCode op);
+
+
+/**
+ * @brief A function whose body has been compiled to bytecode.
+ *
+ * Evaluating it directly runs a VirtualMachine on its chunk. When called from
+ * inside a VirtualMachine, a new call frame is pushed instead.
+ *
+ */
+class CompiledFunction: public Function {
+public:
+    /**
+     * @brief Construct a new Compiled Function object.
+     *
+     * @param parameterScope the scope declaring the parameters of the
+     * function.
+     */
+    CompiledFunction(const Scope& parameterScope);
+
+    /**
+     * @brief Run the compiled body in a new VirtualMachine.
+     *
+     * @param env The environment which provides the context for the variables.
+     * It must have been created for the parameter scope, with the arguments
+     * stored in its slots.
+     * @return ExpressionValue the value of the function body.
+     */
+    ExpressionValue evaluate(
+        Environment* env);
+
+    /**
+     * @brief The bytecode of the function body.
+     *
+     */
+    Chunk chunk;
+
+    /**
+     * @brief The JIT state of the CustomFunction this function was compiled
+     * from, nullptr for the code of a whole program.
+     *
+     */
+    std::shared_ptr<JitFunction> jit;
+
+};
+
+
+#endif
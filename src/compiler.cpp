@@ -0,0 +1,383 @@
+#include "compiler.h"
+
+#include "program.h"
+
+
+std::shared_ptr<CompiledFunction> Compiler::compileProgram(
+        const Program& program) {
+    auto compiled = std::make_shared<CompiledFunction>(Scope());
+
+    CompiledFunction* enclosing = current;
+    current = compiled.get();
+    lastInstruction = SIZE_MAX;
+    lastJumpTarget = SIZE_MAX;
+
+    this->program = &program;
+    compile(program.getRoot());
+    emit(OpCode::RETURN);
+
+    current = enclosing;
+
+    return compiled;
+}
+
+std::shared_ptr<CompiledFunction> Compiler::compileFunction(
+        const CustomFunction& function) {
+    auto compiled = std::make_shared<CompiledFunction>(
+        function.getParameterScope());
+    compiled->setPure(function.isPure());
+    compiled->jit = function.getJit();
+
+    auto& captures = function.getCaptures();
+    for (auto it = captures.begin(); it != captures.end(); it++) {
+        compiled->capture(*it);
+    }
+
+    CompiledFunction* enclosing = current;
+    size_t enclosingInstruction = lastInstruction;
+    size_t enclosingJumpTarget = lastJumpTarget;
+    current = compiled.get();
+    lastInstruction = SIZE_MAX;
+    lastJumpTarget = SIZE_MAX;
+
+    compile(function.getBody());
+    emit(OpCode::RETURN);
+
+    current = enclosing;
+    lastInstruction = enclosingInstruction;
+    lastJumpTarget = enclosingJumpTarget;
+
+    return compiled;
+}
+
+void Compiler::compile(NodeId id) {
+    program->get(id).compile(*this);
+}
+
+void Compiler::emit(OpCode op) {
+    lastInstruction = current->chunk.code.size();
+    current->chunk.emit(op);
+}
+
+void Compiler::emit(OpCode op, uint32_t operand) {
+    lastInstruction = current->chunk.code.size();
+    current->chunk.emit(op, operand);
+}
+
+void Compiler::emit(OpCode op, uint32_t first, uint32_t second) {
+    lastInstruction = current->chunk.code.size();
+    current->chunk.emit(op, first, second);
+}
+
+void Compiler::emit(OpCode op, uint32_t first, uint32_t second,
+        uint32_t third) {
+    lastInstruction = current->chunk.code.size();
+    current->chunk.emit(op, first, second, third);
+}
+
+void Compiler::emitLoad(const VariableLocation& location,
+        SymbolId name) {
+    switch (location.kind) {
+        case VariableKind::LOCAL:
+            emit(OpCode::LOAD_LOCAL, location.depth, location.slot);
+            break;
+        case VariableKind::GLOBAL:
+            emit(OpCode::LOAD_GLOBAL, name);
+            break;
+        case VariableKind::CAPTURED:
+            emit(OpCode::LOAD_CAPTURED, location.depth, location.slot, name);
+            break;
+        default:
+            emit(OpCode::LOAD_NAME, name);
+            break;
+    }
+}
+
+size_t Compiler::emitJump(OpCode op) {
+    auto& code = current->chunk.code;
+
+    if (op == OpCode::JUMP_IF_FALSE && lastInstruction != SIZE_MAX
+            && lastJumpTarget != code.size()) {
+        auto comparison = static_cast<OpCode>(code[lastInstruction]);
+
+        switch (comparison) {
+            case OpCode::EQUALS:
+            case OpCode::NOT_EQUALS:
+            case OpCode::GREATER:
+            case OpCode::GREATER_OR_EQUALS:
+            case OpCode::LESS:
+            case OpCode::LESS_OR_EQUALS: {
+                code.resize(lastInstruction);
+
+                size_t offset = code.size();
+                emit(OpCode::COMPARE_JUMP_IF_FALSE, 0,
+                    static_cast<uint32_t>(comparison));
+
+                return offset;
+            }
+            default:
+                break;
+        }
+    }
+
+    size_t offset = code.size();
+    emit(op, 0);
+
+    return offset;
+}
+
+void Compiler::patchJump(size_t offset) {
+    lastJumpTarget = current->chunk.code.size();
+    current->chunk.patch(offset, static_cast<uint32_t>(lastJumpTarget));
+}
+
+size_t Compiler::markLoopStart() {
+    lastJumpTarget = current->chunk.code.size();
+
+    return lastJumpTarget;
+}
+
+void Compiler::emitLoop(size_t start) {
+    emit(OpCode::LOOP, static_cast<uint32_t>(start));
+}
+
+uint32_t Compiler::addConstant(ExpressionValue value) {
+    return current->chunk.addConstant(std::move(value));
+}
+
+uint32_t Compiler::addScope(const Scope& scope) {
+    return current->chunk.addScope(scope);
+}
+
+uint32_t Compiler::addCache() {
+    return current->chunk.addCache();
+}
+
+const ExpressionValue* Compiler::getLiteral(NodeId id) const {
+    auto literal = dynamic_cast<const Literal*>(&program->get(id));
+
+    return literal ? &literal->getValue() : nullptr;
+}
+
+const VariableLocation* Compiler::getLocal(NodeId id) const {
+    auto name = dynamic_cast<const Name*>(&program->get(id));
+
+    if (!name || name->location.kind != VariableKind::LOCAL) {
+        return nullptr;
+    }
+
+    return &name->location;
+}
+
+
+void Literal::compile(Compiler& compiler) const {
+    compiler.emit(OpCode::CONSTANT, compiler.addConstant(value));
+}
+
+
+void Name::compile(Compiler& compiler) const {
+    compiler.emitLoad(location, name);
+}
+
+
+void BinaryOperation::compileOperation(Compiler& compiler, OpCode op) const {
+    compiler.compile(left);
+    compiler.compile(right);
+    compiler.emit(op);
+}
+
+bool BinaryOperation::compileLocalAndConstant(Compiler& compiler,
+        OpCode op) const {
+    auto location = compiler.getLocal(left);
+    auto constant = compiler.getLiteral(right);
+
+    if (!location || !constant) {
+        return false;
+    }
+
+    compiler.emit(op, location->depth, location->slot,
+        compiler.addConstant(*constant));
+
+    return true;
+}
+
+void Addition::compile(Compiler& compiler) const {
+    if (!compileLocalAndConstant(compiler, OpCode::ADD_LOCAL_CONSTANT)) {
+        compileOperation(compiler, OpCode::ADD);
+    }
+}
+
+void Subtraction::compile(Compiler& compiler) const {
+    if (!compileLocalAndConstant(compiler, OpCode::SUBTRACT_LOCAL_CONSTANT)) {
+        compileOperation(compiler, OpCode::SUBTRACT);
+    }
+}
+
+void Multiplication::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::MULTIPLY);
+}
+
+void Division::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::DIVIDE);
+}
+
+void EqualComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::EQUALS);
+}
+
+void GreaterThanComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::GREATER);
+}
+
+void GreaterThanOrEqualComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::GREATER_OR_EQUALS);
+}
+
+void LessThanComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::LESS);
+}
+
+void LessThanOrEqualComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::LESS_OR_EQUALS);
+}
+
+void NotEqualComparison::compile(Compiler& compiler) const {
+    compileOperation(compiler, OpCode::NOT_EQUALS);
+}
+
+
+void AndConnective::compile(Compiler& compiler) const {
+    compiler.compile(left);
+    size_t shortCircuit = compiler.emitJump(OpCode::JUMP_IF_FALSE_OR_POP);
+    compiler.compile(right);
+    compiler.patchJump(shortCircuit);
+}
+
+
+void OrConnective::compile(Compiler& compiler) const {
+    compiler.compile(left);
+    size_t shortCircuit = compiler.emitJump(OpCode::JUMP_IF_TRUE_OR_POP);
+    compiler.compile(right);
+    compiler.patchJump(shortCircuit);
+}
+
+
+void Assignment::compile(Compiler& compiler) const {
+    compiler.compile(right);
+
+    switch (left.location.kind) {
+        case VariableKind::LOCAL:
+            compiler.emit(OpCode::STORE_LOCAL,
+                left.location.depth, left.location.slot);
+            break;
+        case VariableKind::CAPTURED:
+            compiler.emit(OpCode::STORE_CAPTURED, left.location.depth,
+                left.location.slot, left.name);
+            break;
+        default:
+            compiler.emit(OpCode::STORE_NAME, left.name);
+            break;
+    }
+}
+
+
+void Block::compile(Compiler& compiler) const {
+    if (needsEnvironment) {
+        compiler.emit(OpCode::PUSH_SCOPE, compiler.addScope(scope));
+    }
+
+    if (exprList.empty()) {
+        compiler.emit(OpCode::NONE);
+    }
+
+    for (auto it = exprList.begin(); it != exprList.end(); it++) {
+        if (it != exprList.begin()) {
+            compiler.emit(OpCode::POP);
+        }
+
+        compiler.compile(*it);
+    }
+
+    if (needsEnvironment) {
+        compiler.emit(OpCode::POP_SCOPE);
+    }
+}
+
+
+void IfStatement::compile(Compiler& compiler) const {
+    compiler.compile(condition);
+    size_t toElse = compiler.emitJump(OpCode::JUMP_IF_FALSE);
+
+    compiler.compile(ifBlock);
+    size_t toEnd = compiler.emitJump(OpCode::JUMP);
+
+    compiler.patchJump(toElse);
+    if (elseBlock != NO_NODE) {
+        compiler.compile(elseBlock);
+    } else {
+        compiler.emit(OpCode::NONE);
+    }
+
+    compiler.patchJump(toEnd);
+}
+
+
+void WhileLoop::compile(Compiler& compiler) const {
+    if (needsEnvironment) {
+        compiler.emit(OpCode::PUSH_SCOPE, compiler.addScope(scope));
+    }
+
+    size_t start = compiler.markLoopStart();
+    compiler.compile(condition);
+    size_t exit = compiler.emitJump(OpCode::JUMP_IF_FALSE);
+
+    for (auto it = body.begin(); it != body.end(); it++) {
+        compiler.compile(*it);
+        compiler.emit(OpCode::POP);
+    }
+
+    if (step != NO_NODE) {
+        compiler.compile(step);
+        compiler.emit(OpCode::POP);
+    }
+
+    compiler.emitLoop(start);
+    compiler.patchJump(exit);
+
+    if (needsEnvironment) {
+        compiler.emit(OpCode::POP_SCOPE);
+    }
+
+    compiler.emit(OpCode::NONE);
+}
+
+
+void ForLoop::compile(Compiler& compiler) const {
+    compiler.compile(init);
+    compiler.emit(OpCode::POP);
+
+    WhileLoop::compile(compiler);
+}
+
+void FunctionWrapper::compile(Compiler& compiler) const {
+    ExpressionValue functionVar(std::static_pointer_cast<Function>(
+        compiler.compileFunction(*function)));
+
+    compiler.emit(OpCode::CLOSURE, compiler.addConstant(functionVar));
+}
+
+
+void Invocation::compile(Compiler& compiler) const {
+    if (functionLocation.kind == VariableKind::DYNAMIC) {
+        compiler.emit(OpCode::LOAD_CALLEE, functionName, compiler.addCache());
+    } else {
+        compiler.emitLoad(functionLocation, functionName);
+    }
+
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        compiler.compile(*it);
+    }
+
+    compiler.emit(tailCall ? OpCode::TAIL_CALL : OpCode::CALL,
+        static_cast<uint32_t>(arguments.size()));
+}
@@ -0,0 +1,197 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+
+#include <cstdint>
+#include <memory>
+
+#include "bytecode.h"
+
+
+/**
+ * @brief Compiler to lower an expression tree into bytecode for the
+ * VirtualMachine.
+ *
+ * Every expression emits its own instructions through compile. The compiler
+ * keeps track of the chunk that is currently being written, so that function
+ * bodies end up in their own CompiledFunction.
+ *
+ */
+class Compiler {
+public:
+    /**
+     * @brief Compile a whole program, usually the one returned by
+     * Parser::parseAll.
+     *
+     * @param program the program to compile, starting at its root.
+     * @return std::shared_ptr<CompiledFunction> a function without parameters
+     * which evaluates <program> when run.
+     */
+    std::shared_ptr<CompiledFunction> compileProgram(const Program& program);
+
+    /**
+     * @brief Compile the body of a function into its own chunk.
+     *
+     * @param function the function to compile.
+     * @return std::shared_ptr<CompiledFunction> the compiled function.
+     */
+    std::shared_ptr<CompiledFunction> compileFunction(
+        const CustomFunction& function);
+
+    /**
+     * @brief Emit the bytecode for an expression of the program being
+     * compiled.
+     *
+     * @param id the id of the expression.
+     */
+    void compile(NodeId id);
+
+    /**
+     * @brief Append an instruction without operand to the current chunk.
+     *
+     * @param op the instruction to append.
+     */
+    void emit(OpCode op);
+
+    /**
+     * @brief Append an instruction with an operand to the current chunk.
+     *
+     * @param op the instruction to append.
+     * @param operand the operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t operand);
+
+    /**
+     * @brief Append an instruction with two operands to the current chunk.
+     *
+     * @param op the instruction to append.
+     * @param first the first operand of the instruction.
+     * @param second the second operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t first, uint32_t second);
+
+    /**
+     * @brief Append an instruction with three operands to the current chunk.
+     *
+     * @param op the instruction to append.
+     * @param first the first operand of the instruction.
+     * @param second the second operand of the instruction.
+     * @param third the third operand of the instruction.
+     */
+    void emit(OpCode op, uint32_t first, uint32_t second, uint32_t third);
+
+    /**
+     * @brief Append the instruction loading a variable from its location.
+     *
+     * @param location the location found by the Resolver.
+     * @param name the name of the variable.
+     */
+    void emitLoad(const VariableLocation& location, SymbolId name);
+
+    /**
+     * @brief Append a jump instruction whose target is not known yet.
+     *
+     * A JUMP_IF_FALSE directly following a comparison that no jump targets
+     * is merged with it into a COMPARE_JUMP_IF_FALSE.
+     *
+     * @param op the jump instruction to append.
+     * @return size_t the offset of the jump, to be passed to patchJump.
+     */
+    size_t emitJump(OpCode op);
+
+    /**
+     * @brief Let the jump at <offset> continue at the end of the current
+     * chunk.
+     *
+     * @param offset the offset returned by emitJump.
+     */
+    void patchJump(size_t offset);
+
+    /**
+     * @brief Mark the end of the current chunk as the start of a loop.
+     * Instructions are not merged across it.
+     *
+     * @return size_t the offset of the loop start, to be passed to emitLoop.
+     */
+    size_t markLoopStart();
+
+    /**
+     * @brief Append a LOOP instruction jumping back to <start>.
+     *
+     * @param start the offset returned by markLoopStart.
+     */
+    void emitLoop(size_t start);
+
+    /**
+     * @brief Add the scope of a block to the current chunk.
+     *
+     * @param scope the scope to add.
+     * @return uint32_t the index of the scope.
+     */
+    uint32_t addScope(const Scope& scope);
+
+    /**
+     * @brief Add a constant to the current chunk.
+     *
+     * @param value the constant to add.
+     * @return uint32_t the index of the constant.
+     */
+    uint32_t addConstant(ExpressionValue value);
+
+    /**
+     * @brief Add an empty call site cache to the current chunk.
+     *
+     * @return uint32_t the index of the cache.
+     */
+    uint32_t addCache();
+
+    /**
+     * @brief Get the value of an expression if it is a literal.
+     *
+     * @param id the id of the expression.
+     * @return const ExpressionValue* the value, nullptr if the expression
+     * is no literal.
+     */
+    const ExpressionValue* getLiteral(NodeId id) const;
+
+    /**
+     * @brief Get the location of an expression if it is a name of a local
+     * variable.
+     *
+     * @param id the id of the expression.
+     * @return const VariableLocation* the location, nullptr if the
+     * expression is no name or the variable is not LOCAL.
+     */
+    const VariableLocation* getLocal(NodeId id) const;
+
+private:
+    /**
+     * @brief The function whose chunk is currently being written.
+     *
+     */
+    CompiledFunction* current = nullptr;
+
+    /**
+     * @brief The program being compiled.
+     *
+     */
+    const Program* program = nullptr;
+
+    /**
+     * @brief The offset of the last instruction in the current chunk,
+     * SIZE_MAX if there is none.
+     *
+     */
+    size_t lastInstruction = SIZE_MAX;
+
+    /**
+     * @brief The offset in the current chunk the last patched jump or the
+     * last loop start continues at, SIZE_MAX if there is none. Instructions
+     * are not merged across it.
+     *
+     */
+    size_t lastJumpTarget = SIZE_MAX;
+};
+
+
+#endif
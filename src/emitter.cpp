@@ -0,0 +1,680 @@
+#include "emitter.h"
+
+#include <cmath>
+#include <sstream>
+
+#include "program.h"
+
+
+std::string CppEmitter::emitProgram(const Program& program,
+        const std::string& source) {
+    this->program = &program;
+    definitions.clear();
+    initializers.clear();
+    symbols.clear();
+    scopes = 0;
+    strings = 0;
+    functions = 0;
+    caches = 0;
+
+    emitBody("run", program.getRoot());
+
+    std::string code = "// Emitted by no-pain --emit-cpp from " + source
+        + "\n\n#include <limits>\n\n#include \"native.h\"\n\n\n";
+
+    if (!symbols.empty()) {
+        code += "static SymbolId symbols["
+            + std::to_string(symbols.size()) + "];\n";
+    }
+    if (scopes > 0) {
+        code += "static Scope scopes[" + std::to_string(scopes) + "];\n";
+    }
+    if (strings > 0) {
+        code += "static ExpressionValue strings["
+            + std::to_string(strings) + "];\n";
+    }
+    if (functions > 0) {
+        code += "static std::shared_ptr<NativeFunction> functions["
+            + std::to_string(functions) + "];\n";
+    }
+    if (caches > 0) {
+        code += "static BindingCache caches[" + std::to_string(caches)
+            + "];\n";
+    }
+
+    for (auto it = definitions.begin(); it != definitions.end(); it++) {
+        code += "\n\n" + *it;
+    }
+
+    code += "\n\nint main() {\n";
+    for (auto it = initializers.begin(); it != initializers.end(); it++) {
+        code += "    " + *it + "\n";
+    }
+    code += "\n    return NativeRuntime::run(run);\n}\n";
+
+    return code;
+}
+
+CppValue CppEmitter::emit(NodeId id) {
+    return program->get(id).emitCpp(*this);
+}
+
+std::string CppEmitter::emitFunction(const CustomFunction& function) {
+    auto index = std::to_string(functions++);
+    auto name = "function" + index;
+
+    emitBody(name, function.getBody());
+
+    std::string parameters;
+    auto& names = function.getParameterNames();
+    for (auto it = names.begin(); it != names.end(); it++) {
+        parameters += (it == names.begin() ? "" : ", ") + symbol(*it);
+    }
+
+    initializers.push_back("functions[" + index
+        + "] = std::make_shared<NativeFunction>(" + name
+        + ", std::vector<SymbolId>{ " + parameters + " }, "
+        + (function.isPure() ? "true" : "false") + ");");
+
+    if (function.getParameterScope().isCaptured()) {
+        initializers.push_back("functions[" + index
+            + "]->getParameterScope().setCaptured();");
+    }
+
+    auto& captures = function.getCaptures();
+    for (auto it = captures.begin(); it != captures.end(); it++) {
+        initializers.push_back("functions[" + index
+            + "]->capture(VariableLocation{ VariableKind::"
+            + (it->kind == VariableKind::CAPTURED ? "CAPTURED" : "LOCAL")
+            + ", " + std::to_string(it->depth) + ", "
+            + std::to_string(it->slot) + " });");
+    }
+
+    return "functions[" + index + "]";
+}
+
+void CppEmitter::emitBody(const std::string& name, NodeId body) {
+    CppFunction function;
+    CppFunction* enclosing = current;
+    current = &function;
+
+    auto value = emit(body);
+    line("return " + box(value) + ";");
+
+    current = enclosing;
+
+    std::string code = "static ExpressionValue " + name
+        + "(Environment* env) {\n";
+    for (auto it = function.lines.begin(); it != function.lines.end(); it++) {
+        code += *it + "\n";
+    }
+    code += "}\n";
+
+    definitions.push_back(code);
+}
+
+void CppEmitter::line(const std::string& code) {
+    current->lines.push_back(std::string(current->depth * 4, ' ') + code);
+}
+
+size_t CppEmitter::reserveLine() {
+    current->lines.push_back(std::string(current->depth * 4, ' '));
+
+    return current->lines.size() - 1;
+}
+
+void CppEmitter::setLine(size_t index, const std::string& code) {
+    current->lines[index] += code;
+}
+
+void CppEmitter::open(const std::string& head) {
+    line(head.empty() ? "{" : head + " {");
+    current->depth++;
+}
+
+void CppEmitter::close() {
+    current->depth--;
+    line("}");
+}
+
+CppValue CppEmitter::declare(CppType type, const std::string& init) {
+    auto name = newName("t");
+    line(std::string(typeName(type)) + " " + name + " = " + init + ";");
+
+    return CppValue{ name, type };
+}
+
+std::string CppEmitter::newName(const char* prefix) {
+    return prefix + std::to_string(current->names++);
+}
+
+std::string CppEmitter::box(const CppValue& value) {
+    switch (value.type) {
+        case CppType::INT:
+        case CppType::FLOAT:
+            return "ExpressionValue(" + value.code + ")";
+        default:
+            return value.code;
+    }
+}
+
+std::string CppEmitter::convert(const CppValue& value, CppType type) {
+    return type == CppType::VALUE ? box(value) : value.code;
+}
+
+const char* CppEmitter::typeName(CppType type) {
+    switch (type) {
+        case CppType::INT:
+            return "int";
+        case CppType::FLOAT:
+            return "float";
+        default:
+            return "ExpressionValue";
+    }
+}
+
+std::string CppEmitter::truth(const CppValue& value) {
+    switch (value.type) {
+        case CppType::INT:
+            return value.code + " != 0";
+        case CppType::FLOAT:
+            // Only INTs count as true
+            return "false";
+        default:
+            return "NativeRuntime::isTrue(" + value.code + ")";
+    }
+}
+
+std::string CppEmitter::symbol(SymbolId symbol) {
+    auto it = symbols.find(symbol);
+
+    if (it == symbols.end()) {
+        uint32_t index = static_cast<uint32_t>(symbols.size());
+        it = symbols.emplace(symbol, index).first;
+
+        initializers.push_back("symbols[" + std::to_string(index)
+            + "] = intern(" + quote(getSymbolName(symbol)) + ");");
+    }
+
+    return "symbols[" + std::to_string(it->second) + "]";
+}
+
+std::string CppEmitter::scope(const Scope& scope) {
+    auto name = "scopes[" + std::to_string(scopes++) + "]";
+
+    auto& names = scope.getNames();
+    for (auto it = names.begin(); it != names.end(); it++) {
+        auto declared = symbol(*it);
+        initializers.push_back(name + ".declare(" + declared + ");");
+    }
+
+    if (scope.isCaptured()) {
+        initializers.push_back(name + ".setCaptured();");
+    }
+
+    return name;
+}
+
+CppValue CppEmitter::constant(const ExpressionValue& value) {
+    switch (value.type) {
+        case ExpressionValueType::INT:
+            if (value.payloadInt == INT32_MIN) {
+                return CppValue{ "(-2147483647 - 1)", CppType::INT };
+            } else if (value.payloadInt < 0) {
+                return CppValue{ "(" + std::to_string(value.payloadInt) + ")",
+                    CppType::INT };
+            }
+
+            return CppValue{ std::to_string(value.payloadInt), CppType::INT };
+        case ExpressionValueType::FLOAT: {
+            float number = value.payloadFloat;
+            std::ostringstream code;
+
+            if (std::isnan(number)) {
+                code << "std::numeric_limits<float>::quiet_NaN()";
+            } else if (std::isinf(number)) {
+                code << (number < 0 ? "(-" : "(")
+                    << "std::numeric_limits<float>::infinity())";
+            } else {
+                // Hexadecimal, so the constant keeps every bit
+                code << "(" << std::hexfloat << number << "f)";
+            }
+
+            return CppValue{ code.str(), CppType::FLOAT };
+        }
+        case ExpressionValueType::STRING: {
+            auto name = "strings[" + std::to_string(strings++) + "]";
+            auto& text = value.getString();
+
+            initializers.push_back(name + " = NativeRuntime::string("
+                + quote(text) + ", " + std::to_string(text.size()) + ");");
+
+            return CppValue{ name, CppType::VALUE };
+        }
+        default:
+            return CppValue{ "ExpressionValue()", CppType::VALUE };
+    }
+}
+
+std::string CppEmitter::cache() {
+    return "caches[" + std::to_string(caches++) + "]";
+}
+
+std::string CppEmitter::load(const VariableLocation& location,
+        SymbolId name) {
+    auto& env = getEnvironment();
+
+    switch (location.kind) {
+        case VariableKind::LOCAL:
+            return env + "->getLocalVariable(" + std::to_string(location.depth)
+                + ", " + std::to_string(location.slot) + ")";
+        case VariableKind::GLOBAL:
+            return env + "->getGlobalVariable(" + symbol(name) + ")";
+        case VariableKind::CAPTURED:
+            return env + "->getCapturedVariable("
+                + std::to_string(location.depth) + ", "
+                + std::to_string(location.slot) + ", " + symbol(name) + ")";
+        default:
+            return env + "->getVariable(" + symbol(name) + ")";
+    }
+}
+
+const std::string& CppEmitter::getEnvironment() const {
+    return current->environment;
+}
+
+void CppEmitter::setEnvironment(const std::string& environment) {
+    current->environment = environment;
+}
+
+std::string CppEmitter::quote(const std::string& text) {
+    static const char* digits = "01234567";
+    std::string literal = "\"";
+
+    for (auto it = text.begin(); it != text.end(); it++) {
+        unsigned char c = static_cast<unsigned char>(*it);
+
+        if (c == '"' || c == '\\' || c == '?') {
+            literal += '\\';
+            literal += c;
+        } else if (c >= 0x20 && c < 0x7f) {
+            literal += c;
+        } else {
+            // Always three digits, so a following digit is not part of it
+            literal += '\\';
+            literal += digits[c >> 6];
+            literal += digits[(c >> 3) & 7];
+            literal += digits[c & 7];
+        }
+    }
+
+    return literal + "\"";
+}
+
+
+CppValue Literal::emitCpp(CppEmitter& emitter) const {
+    return emitter.constant(value);
+}
+
+
+CppValue Name::emitCpp(CppEmitter& emitter) const {
+    return emitter.declare(CppType::VALUE, emitter.load(location, name));
+}
+
+
+void BinaryOperation::emitOperands(CppEmitter& emitter, CppValue& leftValue,
+        CppValue& rightValue) const {
+    leftValue = emitter.emit(left);
+
+    if (leftValue.type == CppType::VALUE) {
+        emitter.line("Pin " + emitter.newName("pin") + "("
+            + leftValue.code + ".getHeapObject());");
+    }
+
+    rightValue = emitter.emit(right);
+}
+
+CppValue BinaryOperation::emitOperation(CppEmitter& emitter,
+        const char* nativeOperator, const char* functor,
+        const char* operation, bool comparison) const {
+    CppValue leftValue, rightValue;
+    emitOperands(emitter, leftValue, rightValue);
+
+    if (leftValue.type == rightValue.type
+            && leftValue.type != CppType::VALUE) {
+        return emitter.declare(comparison ? CppType::INT : leftValue.type,
+            leftValue.code + " " + nativeOperator + " " + rightValue.code);
+    }
+
+    // Checks the types at runtime, mixed INTs and FLOATs are left to apply
+    // to report
+    auto applied = std::string(comparison ? "compare<" : "operate<")
+        + operation + ">(" + CppEmitter::box(leftValue) + ", "
+        + CppEmitter::box(rightValue) + ", " + functor + "())";
+
+    return emitter.declare(comparison ? CppType::INT : CppType::VALUE,
+        "NativeRuntime::" + applied);
+}
+
+CppValue BinaryOperation::emitConnective(CppEmitter& emitter,
+        int shortCircuit, const char* error) const {
+    auto leftValue = emitter.emit(left);
+    auto leftInt = leftValue.type == CppType::INT
+        ? leftValue.code
+        : "NativeRuntime::connective(" + CppEmitter::box(leftValue) + ", \""
+            + error + "\")";
+
+    auto result = emitter.newName("t");
+    size_t declaration = emitter.reserveLine();
+
+    emitter.open("if (" + leftInt + " == " + std::to_string(shortCircuit)
+        + ")");
+    size_t leftResult = emitter.reserveLine();
+    emitter.close();
+
+    emitter.open("else");
+    auto rightValue = emitter.emit(right);
+    size_t rightResult = emitter.reserveLine();
+    emitter.close();
+
+    auto type = leftValue.type == rightValue.type
+        ? leftValue.type
+        : CppType::VALUE;
+
+    emitter.setLine(declaration,
+        std::string(CppEmitter::typeName(type)) + " " + result + ";");
+    emitter.setLine(leftResult,
+        result + " = " + CppEmitter::convert(leftValue, type) + ";");
+    emitter.setLine(rightResult,
+        result + " = " + CppEmitter::convert(rightValue, type) + ";");
+
+    return CppValue{ result, type };
+}
+
+CppValue Addition::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "+", "std::plus<>",
+        "Addition", false);
+}
+
+CppValue Subtraction::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "-", "std::minus<>",
+        "Subtraction", false);
+}
+
+CppValue Multiplication::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "*", "std::multiplies<>",
+        "Multiplication", false);
+}
+
+CppValue Division::emitCpp(CppEmitter& emitter) const {
+    CppValue leftValue, rightValue;
+    emitOperands(emitter, leftValue, rightValue);
+
+    if (leftValue.type == CppType::INT && rightValue.type == CppType::INT) {
+        return emitter.declare(CppType::INT, "NativeRuntime::divide("
+            + leftValue.code + ", " + rightValue.code + ")");
+    } else if (leftValue.type == CppType::FLOAT
+            && rightValue.type == CppType::FLOAT) {
+        return emitter.declare(CppType::FLOAT,
+            leftValue.code + " / " + rightValue.code);
+    }
+
+    return emitter.declare(CppType::VALUE, "Division::apply("
+        + CppEmitter::box(leftValue) + ", " + CppEmitter::box(rightValue)
+        + ")");
+}
+
+CppValue EqualComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "==", "std::equal_to<>",
+        "EqualComparison", true);
+}
+
+CppValue GreaterThanComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, ">", "std::greater<>",
+        "GreaterThanComparison", true);
+}
+
+CppValue GreaterThanOrEqualComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, ">=", "std::greater_equal<>",
+        "GreaterThanOrEqualComparison", true);
+}
+
+CppValue LessThanComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "<", "std::less<>",
+        "LessThanComparison", true);
+}
+
+CppValue LessThanOrEqualComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "<=", "std::less_equal<>",
+        "LessThanOrEqualComparison", true);
+}
+
+CppValue NotEqualComparison::emitCpp(CppEmitter& emitter) const {
+    return emitOperation(emitter, "!=", "std::not_equal_to<>",
+        "NotEqualComparison", true);
+}
+
+
+CppValue AndConnective::emitCpp(CppEmitter& emitter) const {
+    return emitConnective(emitter, 0, "And: Wrong types");
+}
+
+
+CppValue OrConnective::emitCpp(CppEmitter& emitter) const {
+    return emitConnective(emitter, 1, "Or: Wrong types");
+}
+
+
+CppValue Assignment::emitCpp(CppEmitter& emitter) const {
+    auto value = emitter.emit(right);
+    auto env = emitter.getEnvironment();
+
+    switch (left.location.kind) {
+        case VariableKind::LOCAL:
+            emitter.line(env + "->setLocalVariable("
+                + std::to_string(left.location.depth) + ", "
+                + std::to_string(left.location.slot) + ", "
+                + CppEmitter::box(value) + ");");
+            break;
+        case VariableKind::CAPTURED:
+            emitter.line(env + "->setCapturedVariable("
+                + std::to_string(left.location.depth) + ", "
+                + std::to_string(left.location.slot) + ", "
+                + emitter.symbol(left.name) + ", "
+                + CppEmitter::box(value) + ");");
+            break;
+        default:
+            emitter.line(env + "->setVariable(" + emitter.symbol(left.name)
+                + ", " + CppEmitter::box(value) + ");");
+            break;
+    }
+
+    return value;
+}
+
+
+CppValue Block::emitCpp(CppEmitter& emitter) const {
+    if (exprList.empty()) {
+        return CppValue{ "ExpressionValue()", CppType::VALUE };
+    }
+
+    auto parent = emitter.getEnvironment();
+    std::string result, region;
+    size_t declaration = 0;
+
+    if (needsEnvironment) {
+        result = emitter.newName("t");
+        declaration = emitter.reserveLine();
+        emitter.open("");
+
+        region = emitter.newName("region");
+        auto env = emitter.newName("env");
+        emitter.line("NurseryRegion " + region + "(Heap::global());");
+        emitter.line("Environment* " + env
+            + " = Environment::create(" + parent + ", "
+            + emitter.scope(scope) + ");");
+        emitter.line("Pin " + emitter.newName("pin") + "(" + env + ");");
+        emitter.setEnvironment(env);
+    }
+
+    for (auto it = exprList.begin(); it != exprList.end() - 1; it++) {
+        // The value is dropped, so are all temporaries of the expression
+        emitter.open("");
+        emitter.line("NurseryRegion " + emitter.newName("region")
+            + "(Heap::global());");
+        emitter.emit(*it);
+        emitter.close();
+    }
+
+    auto value = emitter.emit(exprList.back());
+
+    if (!needsEnvironment) {
+        return value;
+    }
+
+    emitter.setLine(declaration,
+        std::string(CppEmitter::typeName(value.type)) + " " + result + ";");
+    emitter.line(result + " = " + (value.type == CppType::VALUE
+        ? value.code + ".escape(" + region + ".getMark())"
+        : value.code) + ";");
+    emitter.close();
+    emitter.setEnvironment(parent);
+
+    return CppValue{ result, value.type };
+}
+
+
+CppValue IfStatement::emitCpp(CppEmitter& emitter) const {
+    auto conditionValue = emitter.emit(condition);
+
+    auto result = emitter.newName("t");
+    size_t declaration = emitter.reserveLine();
+
+    emitter.open("if (" + CppEmitter::truth(conditionValue) + ")");
+    auto ifValue = emitter.emit(ifBlock);
+    size_t ifResult = emitter.reserveLine();
+    emitter.close();
+
+    emitter.open("else");
+    auto elseValue = elseBlock != NO_NODE
+        ? emitter.emit(elseBlock)
+        : CppValue{ "ExpressionValue()", CppType::VALUE };
+    size_t elseResult = emitter.reserveLine();
+    emitter.close();
+
+    auto type = ifValue.type == elseValue.type
+        ? ifValue.type
+        : CppType::VALUE;
+
+    emitter.setLine(declaration,
+        std::string(CppEmitter::typeName(type)) + " " + result + ";");
+    emitter.setLine(ifResult,
+        result + " = " + CppEmitter::convert(ifValue, type) + ";");
+    emitter.setLine(elseResult,
+        result + " = " + CppEmitter::convert(elseValue, type) + ";");
+
+    return CppValue{ result, type };
+}
+
+
+CppValue WhileLoop::emitCpp(CppEmitter& emitter) const {
+    auto parent = emitter.getEnvironment();
+
+    // Created once, every iteration reuses the environment
+    emitter.open("");
+    emitter.line("NurseryRegion " + emitter.newName("region")
+        + "(Heap::global());");
+
+    if (needsEnvironment) {
+        auto env = emitter.newName("env");
+        emitter.line("Environment* " + env
+            + " = Environment::create(" + parent + ", "
+            + emitter.scope(scope) + ");");
+        emitter.line("Pin " + emitter.newName("pin") + "(" + env + ");");
+        emitter.setEnvironment(env);
+    }
+
+    emitter.open("while (true)");
+    emitter.line("Heap::global().safepoint();");
+    emitter.line("NurseryRegion " + emitter.newName("iteration")
+        + "(Heap::global());");
+
+    auto conditionValue = emitter.emit(condition);
+    emitter.line("if (!(" + CppEmitter::truth(conditionValue) + ")) break;");
+
+    for (auto it = body.begin(); it != body.end(); it++) {
+        emitter.emit(*it);
+    }
+
+    if (step != NO_NODE) {
+        emitter.emit(step);
+    }
+
+    emitter.close();
+    emitter.close();
+    emitter.setEnvironment(parent);
+
+    return CppValue{ "ExpressionValue()", CppType::VALUE };
+}
+
+
+CppValue ForLoop::emitCpp(CppEmitter& emitter) const {
+    emitter.open("");
+    emitter.line("NurseryRegion " + emitter.newName("region")
+        + "(Heap::global());");
+    emitter.emit(init);
+    emitter.close();
+
+    return WhileLoop::emitCpp(emitter);
+}
+
+
+CppValue FunctionWrapper::emitCpp(CppEmitter& emitter) const {
+    return emitter.declare(CppType::VALUE, "Function::createClosure("
+        + emitter.emitFunction(*function) + ", " + emitter.getEnvironment()
+        + ")");
+}
+
+
+CppValue Invocation::emitCpp(CppEmitter& emitter) const {
+    auto env = emitter.getEnvironment();
+
+    // Every value the callers still need is rooted here
+    emitter.line("Heap::global().safepoint();");
+
+    auto functionVar = emitter.declare(CppType::VALUE,
+        functionLocation.kind == VariableKind::DYNAMIC
+            ? env + "->getVariable(" + emitter.symbol(functionName) + ", "
+                + emitter.cache() + ")"
+            : emitter.load(functionLocation, functionName));
+
+    auto result = emitter.newName("t");
+    emitter.line("ExpressionValue " + result + ";");
+    emitter.open("");
+
+    auto region = emitter.newName("region");
+    auto functionEnv = emitter.newName("args");
+    emitter.line("NurseryRegion " + region + "(Heap::global());");
+    emitter.line("Environment* " + functionEnv
+        + " = NativeRuntime::prepareCall(" + functionVar.code + ", "
+        + std::to_string(arguments.size()) + ", " + env + ");");
+    emitter.line("Pin " + emitter.newName("pin") + "(" + functionVar.code
+        + ".payloadObject);");
+    emitter.line("Pin " + emitter.newName("pin") + "(" + functionEnv + ");");
+
+    for (uint32_t slot = 0; slot < arguments.size(); slot++) {
+        auto argument = emitter.emit(arguments[slot]);
+        emitter.line(functionEnv + "->bindSlot(" + std::to_string(slot) + ", "
+            + CppEmitter::box(argument) + ");");
+    }
+
+    auto call = tailCall
+        ? "NativeFunction::tailCall(" + functionVar.code + ", " + functionEnv
+            + ")"
+        : functionVar.code + ".getFunction()->evaluate(" + functionEnv + ")";
+    emitter.line(result + " = " + call + ".escape(" + region
+        + ".getMark());");
+    emitter.close();
+
+    return CppValue{ result, CppType::VALUE };
+}
@@ -0,0 +1,345 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "expressions.h"
+
+
+/**
+ * @brief The C++ type an emitted value is held in.
+ *
+ */
+enum class CppType : uint8_t {
+    /**
+     * @brief An ExpressionValue of any type.
+     *
+     */
+    VALUE,
+
+    /**
+     * @brief An int, the value is known to be an INT.
+     *
+     */
+    INT,
+
+    /**
+     * @brief A float, the value is known to be a FLOAT.
+     *
+     */
+    FLOAT
+};
+
+
+/**
+ * @brief The value of an emitted expression.
+ *
+ */
+struct CppValue {
+    /**
+     * @brief A C++ expression without side effects evaluating to the value,
+     * a temporary or a constant.
+     *
+     */
+    std::string code;
+
+    /**
+     * @brief The C++ type of <code>.
+     *
+     */
+    CppType type;
+};
+
+
+/**
+ * @brief Backend translating an expression tree into a standalone C++
+ * translation unit, which links against the runtime in native.h.
+ *
+ * Every expression emits the statements computing its value through
+ * emitCpp and returns the temporary holding it. Values are kept in ints or
+ * floats where their type is known when emitting, like the results of
+ * comparisons or of arithmetic on such values, and in ExpressionValues
+ * otherwise. Operations on ExpressionValues fall back to the apply
+ * functions of the tree evaluator. Environments, calls, tail calls and
+ * memoization work exactly as in the tree evaluator, so the emitted program
+ * behaves the same.
+ *
+ */
+class CppEmitter {
+public:
+    /**
+     * @brief Emit a whole program, usually the one returned by
+     * Parser::parseAll.
+     *
+     * @param program the program to emit, starting at its root.
+     * @param source the name of the script, mentioned in the output.
+     * @return std::string the translation unit.
+     */
+    std::string emitProgram(const Program& program, const std::string& source);
+
+    /**
+     * @brief Emit an expression of the program being emitted.
+     *
+     * @param id the id of the expression.
+     * @return CppValue the value of the expression.
+     */
+    CppValue emit(NodeId id);
+
+    /**
+     * @brief Emit the body of a function as its own C++ function.
+     *
+     * @param function the function to emit.
+     * @return std::string an expression evaluating to the NativeFunction.
+     */
+    std::string emitFunction(const CustomFunction& function);
+
+    /**
+     * @brief Append a line of code to the current function.
+     *
+     * @param code the code without indentation.
+     */
+    void line(const std::string& code);
+
+    /**
+     * @brief Append an empty line to be filled in later with setLine, e.g.
+     * the declaration of a value whose type is not known yet.
+     *
+     * @return size_t the index of the line.
+     */
+    size_t reserveLine();
+
+    /**
+     * @brief Fill in a line appended with reserveLine.
+     *
+     * @param index the index of the line.
+     * @param code the code without indentation.
+     */
+    void setLine(size_t index, const std::string& code);
+
+    /**
+     * @brief Open a C++ block, indenting the lines up to the matching
+     * close.
+     *
+     * @param head the code in front of the brace, e.g. an if. May be empty.
+     */
+    void open(const std::string& head);
+
+    /**
+     * @brief Close the innermost C++ block.
+     *
+     */
+    void close();
+
+    /**
+     * @brief Declare a new temporary initialized to <init>.
+     *
+     * @param type the type of the temporary.
+     * @param init the C++ expression to initialize it with.
+     * @return CppValue the temporary.
+     */
+    CppValue declare(CppType type, const std::string& init);
+
+    /**
+     * @brief Get a new name unique in the current function.
+     *
+     * @param prefix the start of the name.
+     * @return std::string the name.
+     */
+    std::string newName(const char* prefix);
+
+    /**
+     * @brief Convert a value to an ExpressionValue.
+     *
+     * @param value the value.
+     * @return std::string the C++ expression.
+     */
+    static std::string box(const CppValue& value);
+
+    /**
+     * @brief Convert a value to a value of type <type>. Only converts to
+     * VALUE or to the type the value has.
+     *
+     * @param value the value.
+     * @param type the type to convert to.
+     * @return std::string the C++ expression.
+     */
+    static std::string convert(const CppValue& value, CppType type);
+
+    /**
+     * @brief Get the C++ declaration of a temporary of <type>.
+     *
+     * @param type the type.
+     * @return const char* the C++ type.
+     */
+    static const char* typeName(CppType type);
+
+    /**
+     * @brief Get a C++ condition holding if <value> is a nonzero INT.
+     *
+     * @param value the value.
+     * @return std::string the C++ expression.
+     */
+    static std::string truth(const CppValue& value);
+
+    /**
+     * @brief Get the constant holding a symbol at runtime.
+     *
+     * @param symbol the symbol.
+     * @return std::string the C++ expression.
+     */
+    std::string symbol(SymbolId symbol);
+
+    /**
+     * @brief Get a constant holding a copy of <scope> at runtime.
+     *
+     * @param scope the scope.
+     * @return std::string the C++ expression.
+     */
+    std::string scope(const Scope& scope);
+
+    /**
+     * @brief Get a constant holding a value at runtime.
+     *
+     * @param value the value of a Literal.
+     * @return CppValue the constant.
+     */
+    CppValue constant(const ExpressionValue& value);
+
+    /**
+     * @brief Get a new BindingCache for a call site.
+     *
+     * @return std::string the C++ expression.
+     */
+    std::string cache();
+
+    /**
+     * @brief Get the C++ expression evaluating to a variable.
+     *
+     * @param location the resolved location of the variable.
+     * @param name the name of the variable.
+     * @return std::string the C++ expression.
+     */
+    std::string load(const VariableLocation& location, SymbolId name);
+
+    /**
+     * @brief Get the environment expressions are currently evaluated in.
+     *
+     * @return const std::string& the name of the Environment*.
+     */
+    const std::string& getEnvironment() const;
+
+    /**
+     * @brief Set the environment expressions are evaluated in.
+     *
+     * @param environment the name of the Environment*.
+     */
+    void setEnvironment(const std::string& environment);
+
+private:
+    /**
+     * @brief A C++ function being emitted.
+     *
+     */
+    struct CppFunction {
+        /**
+         * @brief The lines of the body, including their indentation.
+         *
+         */
+        std::vector<std::string> lines;
+
+        /**
+         * @brief The number of C++ blocks open.
+         *
+         */
+        uint32_t depth = 1;
+
+        /**
+         * @brief The number of names handed out.
+         *
+         */
+        uint32_t names = 0;
+
+        /**
+         * @brief The environment expressions are evaluated in.
+         *
+         */
+        std::string environment = "env";
+    };
+
+    /**
+     * @brief Emit <body> as a C++ function.
+     *
+     * @param name the name of the C++ function.
+     * @param body the expression evaluated by the function.
+     */
+    void emitBody(const std::string& name, NodeId body);
+
+    /**
+     * @brief Escape <text> as a C++ string literal.
+     *
+     * @param text the text.
+     * @return std::string the literal, including the quotes.
+     */
+    static std::string quote(const std::string& text);
+
+    /**
+     * @brief The program being emitted.
+     *
+     */
+    const Program* program = nullptr;
+
+    /**
+     * @brief The function currently being emitted.
+     *
+     */
+    CppFunction* current = nullptr;
+
+    /**
+     * @brief The definitions of the C++ functions emitted so far.
+     *
+     */
+    std::vector<std::string> definitions;
+
+    /**
+     * @brief The statements initializing the constants at startup.
+     *
+     */
+    std::vector<std::string> initializers;
+
+    /**
+     * @brief The index of each symbol in the table of symbols.
+     *
+     */
+    std::unordered_map<SymbolId, uint32_t> symbols;
+
+    /**
+     * @brief The number of scopes in the table of scopes.
+     *
+     */
+    uint32_t scopes = 0;
+
+    /**
+     * @brief The number of strings in the table of string constants.
+     *
+     */
+    uint32_t strings = 0;
+
+    /**
+     * @brief The number of functions in the table of functions.
+     *
+     */
+    uint32_t functions = 0;
+
+    /**
+     * @brief The number of binding caches of call sites.
+     *
+     */
+    uint32_t caches = 0;
+};
+
+
+#endif
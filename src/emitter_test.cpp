@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "emitter.h"
+
+
+std::string emitProgram(const char* program) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+
+    auto parsed = parser->parseAll();
+
+    CppEmitter emitter;
+    return emitter.emitProgram(*parsed, "test.npn");
+}
+
+bool contains(const std::string& code, const char* part) {
+    return code.find(part) != std::string::npos;
+}
+
+
+TEST(CppEmitter, EmitsStandaloneProgram) {
+    auto code = emitProgram("x = 2 x * 3");
+
+    ASSERT_TRUE(contains(code, "#include \"native.h\""));
+    ASSERT_TRUE(contains(code, "static ExpressionValue run(Environment* env)"));
+    ASSERT_TRUE(contains(code, "symbols[0] = intern(\"x\");"));
+    ASSERT_TRUE(contains(code, "return NativeRuntime::run(run);"));
+}
+
+TEST(CppEmitter, KeepsComparisonsInInts) {
+    auto code = emitProgram("x = 3 IF x < 4 { 1 } ELSE { 2 }");
+
+    // The comparison and both branches are INTs, no value is boxed
+    ASSERT_TRUE(contains(code,
+        " = NativeRuntime::compare<LessThanComparison>("));
+    ASSERT_TRUE(contains(code, "int t0;"));
+    ASSERT_TRUE(contains(code, "return ExpressionValue(t0);"));
+    ASSERT_TRUE(contains(code, " != 0) {"));
+    ASSERT_FALSE(contains(code, "NativeRuntime::isTrue"));
+}
+
+TEST(CppEmitter, FallsBackToApplyForValues) {
+    auto code = emitProgram("f = FUN a, b { a + b } f(1, 2)");
+
+    ASSERT_TRUE(contains(code, "NativeRuntime::operate<Addition>("));
+    ASSERT_TRUE(contains(code, "static ExpressionValue function0"));
+    ASSERT_TRUE(contains(code, "std::make_shared<NativeFunction>(function0"));
+}
+
+TEST(CppEmitter, EmitsTailCalls) {
+    auto code = emitProgram(
+        "f = FUN a { IF a > 0 { f(a - 1) } ELSE { 0 } } f(3)");
+
+    ASSERT_TRUE(contains(code, "NativeFunction::tailCall("));
+    ASSERT_TRUE(contains(code, ".getFunction()->evaluate("));
+}
+
+TEST(CppEmitter, EmitsClosures) {
+    auto code = emitProgram(
+        "makeAdder = FUN n { FUN x { x + n } } add = makeAdder(2) add(1)");
+
+    ASSERT_TRUE(contains(code, "Function::createClosure(functions[1], env)"));
+    ASSERT_TRUE(contains(code,
+        "functions[0]->getParameterScope().setCaptured();"));
+    ASSERT_TRUE(contains(code,
+        "functions[1]->capture(VariableLocation{ VariableKind::LOCAL, 0, 0 });"));
+    ASSERT_TRUE(contains(code, "env->getCapturedVariable(0, 0, symbols["));
+}
+
+TEST(CppEmitter, EscapesStrings) {
+    auto code = emitProgram("print(\"say \\\"hi\\\"?\\n\")");
+
+    ASSERT_TRUE(contains(code,
+        "NativeRuntime::string(\"say \\\"hi\\\"\\?\\012\", 10);"));
+}
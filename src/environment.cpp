@@ -1,58 +1,363 @@
 #include "environment.h"
 
 
-ExpressionValue::ExpressionValue() {}
-ExpressionValue::~ExpressionValue() {}
+uint32_t Scope::declare(SymbolId name) {
+    uint32_t slot;
 
+    if (find(name, slot)) {
+        return slot;
+    }
+
+    names.push_back(name);
+
+    return static_cast<uint32_t>(names.size() - 1);
+}
+
+bool Scope::find(SymbolId name, uint32_t& slot) const {
+    for (size_t i = 0; i < names.size(); i++) {
+        if (names[i] == name) {
+            slot = static_cast<uint32_t>(i);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint32_t Scope::size() const {
+    return static_cast<uint32_t>(names.size());
+}
+
+const std::vector<SymbolId>& Scope::getNames() const {
+    return names;
+}
+
+void Scope::setCaptured() {
+    captured = true;
+}
+
+
+std::vector<uint64_t> Environment::bindingVersions;
+
+BindingCacheStatistics Environment::cacheStatistics;
 
 Environment::Environment():
-    parent(nullptr) {}
+    parent(nullptr), scope(nullptr),
+    env(std::make_unique<std::unordered_map<SymbolId, ExpressionValue>>()) {}
+
+Environment::Environment(Environment* parent):
+    parent(parent), scope(nullptr) {}
 
-Environment::Environment(std::shared_ptr<Environment>& parent):
-    parent(parent) {}
+Environment::Environment(Environment* parent, const Scope& scope):
+    parent(parent), scope(&scope),
+    slots(scope.size(), ExpressionValue::undefined()) {}
 
-void Environment::setParent(std::shared_ptr<Environment>& parent) {
+void Environment::setParent(Environment* parent) {
     this->parent = parent;
 }
 
-std::shared_ptr<ExpressionValue> Environment::getVariable(std::string& name) {
-    auto var = env.find(name);
+Environment* Environment::getParent() {
+    return parent;
+}
+
+Environment* Environment::getRoot() {
+    Environment* root = this;
+
+    while (root->parent) {
+        root = root->parent;
+    }
+
+    return root;
+}
+
+void Environment::setClosure(FunctionObject* closure) {
+    this->closure = closure;
+}
+
+void Environment::trace(Heap& heap) {
+    heap.mark(parent);
+    heap.mark(closure);
+
+    for (auto it = slots.begin(); it != slots.end(); it++) {
+        it->trace(heap);
+    }
 
-    if (var == env.end()) {
-        if (parent) {
-            return parent->getVariable(name);
-        } else {
-            throw std::exception((std::string("Variable ")
-                + name
-                + std::string(" undefined"))
-                .c_str());
+    if (env) {
+        for (auto it = env->begin(); it != env->end(); it++) {
+            it->second.trace(heap);
         }
-    } else {
+    }
+}
+
+size_t Environment::getSize() const {
+    return sizeof(Environment) + slots.capacity() * sizeof(ExpressionValue);
+}
+
+Environment* Environment::getAncestor(uint32_t depth) {
+    Environment* ancestor = this;
+
+    while (depth > 0) {
+        ancestor = ancestor->parent;
+        depth--;
+    }
+
+    return ancestor;
+}
+
+ExpressionValue Environment::getVariable(const VariableLocation& location,
+        SymbolId name) {
+    switch (location.kind) {
+        case VariableKind::LOCAL:
+            return getLocalVariable(location.depth, location.slot);
+        case VariableKind::GLOBAL:
+            return getGlobalVariable(name);
+        case VariableKind::CAPTURED:
+            return getCapturedVariable(location.depth, location.slot, name);
+        default:
+            return getVariable(name);
+    }
+}
+
+ExpressionValue Environment::getLocalVariable(uint32_t depth, uint32_t slot) {
+    Environment* owner = getAncestor(depth);
+    auto& var = owner->slots[slot];
+
+    if (var.type != ExpressionValueType::UNDEFINED) {
+        return var;
+    }
+
+    return getVariable(owner->scope->getNames()[slot]);
+}
+
+ExpressionValue Environment::getCapturedVariable(uint32_t depth,
+        uint32_t slot, SymbolId name) {
+    auto& var = *getAncestor(depth)->closure->captures[slot];
+
+    if (var.type != ExpressionValueType::UNDEFINED) {
+        return var;
+    }
+
+    return getVariable(name);
+}
+
+ExpressionValue* Environment::getStorage(const VariableLocation& location) {
+    Environment* owner = getAncestor(location.depth);
+
+    if (location.kind == VariableKind::CAPTURED) {
+        return owner->closure->captures[location.slot];
+    }
+
+    return &owner->slots[location.slot];
+}
+
+void Environment::setLocalVariable(uint32_t depth, uint32_t slot,
+        const ExpressionValue& value) {
+    Environment* owner = getAncestor(depth);
+    auto& var = owner->slots[slot];
+
+    if (var.type == ExpressionValueType::UNDEFINED) {
+        bindingCreated(owner->scope->getNames()[slot]);
+    }
+
+    var = value.promote();
+}
+
+void Environment::setCapturedVariable(uint32_t depth, uint32_t slot,
+        SymbolId name, const ExpressionValue& value) {
+    auto& var = *getAncestor(depth)->closure->captures[slot];
+
+    if (var.type == ExpressionValueType::UNDEFINED) {
+        bindingCreated(name);
+    }
+
+    var = value.promote();
+}
+
+ExpressionValue Environment::getGlobalVariable(SymbolId name) {
+    Environment* root = getRoot();
+
+    auto var = root->env->find(name);
+    if (var != root->env->end()) {
         return var->second;
     }
+
+    return getVariable(name);
+}
+
+void Environment::setVariable(const VariableLocation& location,
+        SymbolId name, const ExpressionValue& value) {
+    switch (location.kind) {
+        case VariableKind::LOCAL:
+            setLocalVariable(location.depth, location.slot, value);
+            break;
+        case VariableKind::CAPTURED:
+            setCapturedVariable(location.depth, location.slot, name, value);
+            break;
+        default:
+            setVariable(name, value);
+            break;
+    }
+}
+
+ExpressionValue* Environment::findLocalVariable(SymbolId name) {
+    uint32_t slot;
+
+    return findLocalVariable(name, slot);
+}
+
+ExpressionValue* Environment::findLocalVariable(SymbolId name,
+        uint32_t& slot) {
+    if (scope && scope->find(name, slot)
+            && slots[slot].type != ExpressionValueType::UNDEFINED) {
+        return &slots[slot];
+    }
+
+    slot = BindingCache::NO_SLOT;
+
+    if (env) {
+        auto var = env->find(name);
+
+        if (var != env->end()) {
+            return &var->second;
+        }
+    }
+
+    return nullptr;
+}
+
+ExpressionValue* Environment::findCachedVariable(SymbolId name,
+        const BindingCache& cache) {
+    // The address may have been reused by a different environment
+    if (scope != cache.scope) {
+        return nullptr;
+    }
+
+    if (cache.slot != BindingCache::NO_SLOT) {
+        auto& var = slots[cache.slot];
+
+        return var.type != ExpressionValueType::UNDEFINED ? &var : nullptr;
+    }
+
+    if (env) {
+        auto var = env->find(name);
+
+        if (var != env->end()) {
+            return &var->second;
+        }
+    }
+
+    return nullptr;
+}
+
+ExpressionValue Environment::getVariable(SymbolId name) {
+    // The chain grows with the depth of recursion, so it is walked in a
+    // loop rather than recursively
+    for (Environment* current = this; current; current = current->parent) {
+        auto var = current->findLocalVariable(name);
+
+        if (var) {
+            return *var;
+        }
+    }
+
+    throw std::exception((std::string("Variable ")
+        + getSymbolName(name)
+        + std::string(" undefined"))
+        .c_str());
+}
+
+ExpressionValue Environment::getVariable(SymbolId name,
+        BindingCache& cache) {
+    // Every variable bound after the cache was filled bumps the version, so
+    // nothing between this environment and the owner can shadow it. Older
+    // environments in the chain were searched when the cache was filled.
+    if (cache.owner && cache.version == bindingVersion(name)) {
+        for (Environment* current = this; current; current = current->parent) {
+            if (current != cache.owner) {
+                continue;
+            }
+
+            auto var = current->findCachedVariable(name, cache);
+            if (var) {
+                cacheStatistics.hits++;
+                return *var;
+            }
+
+            break;
+        }
+    }
+
+    cacheStatistics.misses++;
+
+    for (Environment* current = this; current; current = current->parent) {
+        uint32_t slot;
+        auto var = current->findLocalVariable(name, slot);
+
+        if (var) {
+            cache.owner = current;
+            cache.scope = current->scope;
+            cache.slot = slot;
+            cache.version = bindingVersion(name);
+
+            return *var;
+        }
+    }
+
+    throw std::exception((std::string("Variable ")
+        + getSymbolName(name)
+        + std::string(" undefined"))
+        .c_str());
+}
+
+const BindingCacheStatistics& Environment::getCacheStatistics() {
+    return cacheStatistics;
+}
+
+void Environment::resetCacheStatistics() {
+    cacheStatistics = BindingCacheStatistics();
 }
 
 bool Environment::setVariableIfDefined(
-        std::string& name, std::shared_ptr<ExpressionValue>& value) {
-    if (env.find(name) == env.end()) {
-        if (parent) {
-            return parent->setVariableIfDefined(name, value);
-        } else {
-            return false;
-        }
-    } else {
-        setLocalVariable(name, value);
-        return true;
+        SymbolId name, const ExpressionValue& value) {
+    for (Environment* current = this; current; current = current->parent) {
+        auto var = current->findLocalVariable(name);
+
+        if (var) {
+            *var = value.promote();
+            return true;
+        }
     }
+
+    return false;
 }
 
 void Environment::setVariable(
-        std::string& name, std::shared_ptr<ExpressionValue>& value) {
+        SymbolId name, const ExpressionValue& value) {
     if (!parent || !parent->setVariableIfDefined(name, value))
         setLocalVariable(name, value);
 }
 
 void Environment::setLocalVariable(
-        std::string& name, std::shared_ptr<ExpressionValue>& value) {
-    env[name] = value;
+        SymbolId name, const ExpressionValue& value) {
+    uint32_t slot;
+
+    if (scope && scope->find(name, slot)) {
+        if (slots[slot].type == ExpressionValueType::UNDEFINED) {
+            bindingCreated(name);
+        }
+
+        slots[slot] = value.promote();
+        return;
+    }
+
+    if (!env) {
+        env = std::make_unique<std::unordered_map<SymbolId, ExpressionValue>>();
+    }
+
+    auto inserted = env->emplace(name, ExpressionValue());
+    if (inserted.second) {
+        bindingCreated(name);
+    }
+
+    inserted.first->second = value.promote();
 }
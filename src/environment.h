@@ -1,189 +1,644 @@
 #ifndef ENVIRONMENT_H
 #define ENVIRONMENT_H
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "gc.h"
+#include "symbols.h"
+#include "value.h"
 
-class Function;
+
+/**
+ * @brief The static description of the variables a scope (a block or the
+ * parameters of a function) declares.
+ *
+ * Every declared name gets a slot index. Environments created for the scope
+ * store the value of each variable at its slot index.
+ *
+ */
+class Scope {
+public:
+    /**
+     * @brief Declare a variable in this scope.
+     *
+     * @param name the name of the variable.
+     * @return uint32_t the slot of the variable. Declaring a name twice
+     * returns the same slot.
+     */
+    uint32_t declare(SymbolId name);
+
+    /**
+     * @brief Find the slot of a variable declared in this scope.
+     *
+     * @param name the name of the variable.
+     * @param slot set to the slot of the variable if it was found.
+     * @return true if <name> is declared in this scope.
+     * @return false otherwise.
+     */
+    bool find(SymbolId name, uint32_t& slot) const;
+
+    /**
+     * @brief Get the number of variables declared in this scope.
+     *
+     * @return uint32_t the number of slots environments for this scope need.
+     */
+    uint32_t size() const;
+
+    /**
+     * @brief Get the names of all variables, indexed by their slot.
+     *
+     * @return const std::vector<SymbolId>& the declared names.
+     */
+    const std::vector<SymbolId>& getNames() const;
+
+    /**
+     * @brief Mark this scope as declaring variables captured by a closure.
+     * Environments for it are allocated on the heap then, as the closure may
+     * outlive them.
+     *
+     */
+    void setCaptured();
+
+    /**
+     * @brief Check whether closures capture variables of this scope.
+     *
+     * @return true if setCaptured was called.
+     * @return false otherwise.
+     */
+    bool isCaptured() const {
+        return captured;
+    }
+
+private:
+    /**
+     * @brief The declared names, indexed by their slot.
+     *
+     */
+    std::vector<SymbolId> names;
+
+    /**
+     * @brief Whether closures capture variables of this scope.
+     *
+     */
+    bool captured = false;
+};
 
 
 /**
- * @brief The type an expression evaluates to.
- * 
- * This can be STRING, INT, FLOAT or FUNCTION;
- * 
+ * @brief How a variable reference is looked up at runtime.
+ *
  */
-enum class ExpressionValueType {
-    STRING,
-    INT,
-    FLOAT,
-    FUNCTION
+enum class VariableKind : uint8_t {
+    /**
+     * @brief Search the environment chain by name. Used for references the
+     * resolver has not seen.
+     *
+     */
+    DYNAMIC,
+
+    /**
+     * @brief Access the slot <slot> of the environment <depth> levels up.
+     *
+     */
+    LOCAL,
+
+    /**
+     * @brief Access a global variable like print, defined in the root
+     * environment.
+     *
+     */
+    GLOBAL,
+
+    /**
+     * @brief Access the captured variable <slot> of the closure of the call
+     * whose environment is <depth> levels up. Used for free variables of
+     * functions.
+     *
+     */
+    CAPTURED
 };
 
 
 /**
- * @brief The value an expression evaluates to.
- * 
- * There are different types of expression values, defined under
- * ExpressionValueType. Always set the <type> according to
- * the value type assigned to this Expression Value.
- * 
+ * @brief The location of a variable as determined by the Resolver.
+ *
  */
-class ExpressionValue {
-public:
+struct VariableLocation {
     /**
-     * @brief Construct a new Expression Value object.
-     * 
+     * @brief How the variable is looked up.
+     *
      */
-    ExpressionValue();
+    VariableKind kind = VariableKind::DYNAMIC;
 
     /**
-     * @brief Destroy the Expression Value object.
-     * 
+     * @brief The number of environments between the reference and the
+     * environment holding the variable, if <kind> is LOCAL, or the
+     * environment of the call capturing it, if <kind> is CAPTURED.
+     *
      */
-    ~ExpressionValue();
+    uint32_t depth = 0;
 
-    union {
-        /**
-         * @brief Contains an integer value as an Expression Value,
-         * if <type> is ExpressionValueType::INT.
-         * 
-         */
-        int payloadInt;
+    /**
+     * @brief The slot of the variable in its environment, if <kind> is LOCAL,
+     * or its index among the captured variables, if <kind> is CAPTURED.
+     *
+     */
+    uint32_t slot = 0;
+};
+
+
+class Environment;
+
+
+/**
+ * @brief Where a call site found its function the last time, so the next
+ * lookup of the same name can skip searching the environment chain.
+ *
+ * An entry stays valid as long as no new variable of the same name has been
+ * bound anywhere since it was filled. Reassigning the variable keeps it
+ * valid, because the value is always read from the remembered variable.
+ *
+ */
+struct BindingCache {
+    /**
+     * @brief The slot marking variables kept in the map of <owner>.
+     *
+     */
+    static const uint32_t NO_SLOT = UINT32_MAX;
+
+    /**
+     * @brief The environment the variable was found in, nullptr while the
+     * cache is empty. Only compared, never dereferenced before it is found
+     * in the environment chain of the lookup again.
+     *
+     */
+    Environment* owner = nullptr;
+
+    /**
+     * @brief The scope of <owner> when the variable was found.
+     *
+     */
+    const Scope* scope = nullptr;
+
+    /**
+     * @brief The slot of the variable in <owner>, NO_SLOT if it is kept in
+     * the map of <owner>.
+     *
+     */
+    uint32_t slot = NO_SLOT;
 
-         /**
-         * @brief Contains a float value as an Expression Value,
-         * if <type> is ExpressionValueType::FLOAT.
-         * 
-         */
-        float payloadFloat;
-    };
     /**
-     * @brief Contains a string value as an Expression Value,
-     * if <type> is ExpressionValueType::STRING.
-     * 
+     * @brief The binding version of the name when the variable was found.
+     *
      */
-    std::string payloadStr;
+    uint64_t version = 0;
+};
+
 
+/**
+ * @brief Counters describing how often call sites found their function in
+ * their BindingCache.
+ *
+ */
+struct BindingCacheStatistics {
     /**
-     * @brief Contains a ifunction value as an Expression Value,
-     * if <type> is ExpressionValueType::FUNCTION.
-     * 
+     * @brief The number of lookups answered from a cache.
+     *
      */
-    std::shared_ptr<Function> payloadFunc;
+    uint64_t hits = 0;
 
     /**
-     * @brief The type of this Expression Value. Must be set in
-     * accordance with the actual type stored in this object.
-     * 
+     * @brief The number of lookups that searched the environment chain.
+     *
      */
-    ExpressionValueType type;
+    uint64_t misses = 0;
 };
 
 
 /**
  * @brief The environment under which variables are defined.
- * 
+ *
  * An Environment can have access to a parent which will be
- * used to resolve variable names not found in itself. Usually,
- * variables should be set using setVariable. For initializing
- * function parameters for example, you would use setLocalVariable,
- * so that variables with the same name from an outer scope are reliably
- * shadowed. For assignments to bubble up to potential parent environments,
- * setVariableIfDefined is used internally.
+ * used to resolve variable names not found in itself. Variables declared
+ * by the Scope of an environment are stored in a flat array of slots and
+ * accessed through their VariableLocation. The root environment (the one
+ * without parent) additionally keeps global variables like print in a map
+ * from interned names to values.
+ *
+ * Variables can also be accessed by name. Usually, they should be set using
+ * setVariable. For initializing function parameters for example, you would
+ * use setLocalVariable, so that variables with the same name from an outer
+ * scope are reliably shadowed. For assignments to bubble up to potential
+ * parent environments, setVariableIfDefined is used internally.
+ *
+ * Environments are heap objects. They are created with Heap::allocate and
+ * live as long as the collector can reach them, for example from a call
+ * frame or through the parent of another environment. The environments of
+ * calls and blocks are allocated in the nursery instead, so values stored
+ * in any environment are promoted out of the nursery first. Only scopes
+ * whose variables are captured by closures get heap environments, see
+ * create.
+ *
+ * The environment of a call has the environment the function was defined
+ * in as parent and remembers the closure of the function, which holds the
+ * variables the function captured.
  *
  */
-class Environment {
+class Environment: public HeapObject {
 public:
     /**
-     * @brief Construct a new Environment object with no parent.
-     * 
+     * @brief Construct a new root Environment object with no parent.
+     *
      */
     Environment();
 
     /**
-     * @brief Construct a new Environment object with a parent.
-     * 
+     * @brief Construct a new Environment object with a parent and no slots.
+     *
+     * @param parent the parent this environment should have.
+     *
+     */
+    Environment(Environment* parent);
+
+    /**
+     * @brief Construct a new Environment object with a parent and one slot
+     * for every variable declared in <scope>.
+     *
      * @param parent the parent this environment should have.
-     * 
+     * @param scope the scope this environment is created for. Must outlive
+     * the environment.
      */
-    Environment(std::shared_ptr<Environment>& parent);
-    
+    Environment(Environment* parent, const Scope& scope);
+
+    /**
+     * @brief Allocate an environment for <scope>, in the nursery unless
+     * closures capture variables of the scope.
+     *
+     * @param parent the parent the environment should have.
+     * @param scope the scope the environment is created for.
+     * @return Environment* the new environment.
+     */
+    static Environment* create(Environment* parent, const Scope& scope) {
+        if (scope.isCaptured()) {
+            return Heap::global().allocate<Environment>(parent, scope);
+        }
+
+        return Heap::global().allocateYoung<Environment>(parent, scope);
+    }
+
 
     /**
      * @brief Set the Parent object.
-     * 
+     *
      * @param parent the parent this environment should have.
      */
-    void setParent(std::shared_ptr<Environment>& parent);
+    void setParent(Environment* parent);
+
+    /**
+     * @brief Get the Parent object.
+     *
+     * @return Environment* the parent of this environment, nullptr if it
+     * has none.
+     */
+    Environment* getParent();
+
+    /**
+     * @brief Get the root environment at the top of the chain.
+     *
+     * @return Environment* the environment without parent.
+     */
+    Environment* getRoot();
+
+    /**
+     * @brief Remember the closure of the call this environment is created
+     * for.
+     *
+     * @param closure the heap object of the function called.
+     */
+    void setClosure(FunctionObject* closure);
+
+    /**
+     * @brief Get the slot <slot> of this environment.
+     *
+     * @param slot the slot index.
+     * @return ExpressionValue& the value stored in the slot.
+     */
+    ExpressionValue& getSlot(uint32_t slot) {
+        return slots[slot];
+    }
+
+    /**
+     * @brief Bind a parameter, storing its value in slot <slot> of this
+     * environment.
+     *
+     * @param slot the slot of the parameter.
+     * @param value the argument. It is stored as is, like with getSlot,
+     * unless closures may capture it.
+     */
+    void bindSlot(uint32_t slot, const ExpressionValue& value) {
+        if (slots[slot].type == ExpressionValueType::UNDEFINED) {
+            bindingCreated(scope->getNames()[slot]);
+        }
+
+        slots[slot] = scope->isCaptured() ? value.promote() : value;
+    }
+
+    /**
+     * @brief Mark the parent, the closure and the values of all variables.
+     *
+     * @param heap the heap running the collection.
+     */
+    void trace(Heap& heap) override;
+
+    size_t getSize() const override;
+
+    /**
+     * @brief Get the variable stored at a location found by the Resolver.
+     *
+     * Falls back to a lookup by name if the slot has not been assigned yet.
+     *
+     * @param location the location of the variable.
+     * @param name the name of the variable.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
+     */
+    ExpressionValue getVariable(const VariableLocation& location,
+        SymbolId name);
+
+    /**
+     * @brief Get the variable in slot <slot> of the environment <depth>
+     * levels up.
+     *
+     * Falls back to a lookup by name if the slot has not been assigned yet.
+     *
+     * @param depth the number of parents to go up.
+     * @param slot the slot of the variable.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
+     */
+    ExpressionValue getLocalVariable(uint32_t depth, uint32_t slot);
+
+    /**
+     * @brief Get the captured variable <slot> of the closure of the call
+     * whose environment is <depth> levels up.
+     *
+     * Falls back to a lookup by name if the variable has not been assigned
+     * yet.
+     *
+     * @param depth the number of parents to go up.
+     * @param slot the index of the variable among the captured ones.
+     * @param name the name of the variable.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
+     */
+    ExpressionValue getCapturedVariable(uint32_t depth, uint32_t slot,
+        SymbolId name);
+
+    /**
+     * @brief Get the storage of a variable, to be captured by a closure.
+     *
+     * @param location the location of the variable, LOCAL or CAPTURED.
+     * @return ExpressionValue* the variable, which lives as long as this
+     * environment.
+     */
+    ExpressionValue* getStorage(const VariableLocation& location);
+
+    /**
+     * @brief Set the variable in slot <slot> of the environment <depth>
+     * levels up.
+     *
+     * @param depth the number of parents to go up.
+     * @param slot the slot of the variable.
+     * @param value the value that should be stored in that variable.
+     */
+    void setLocalVariable(uint32_t depth, uint32_t slot,
+        const ExpressionValue& value);
+
+    /**
+     * @brief Set the captured variable <slot> of the closure of the call
+     * whose environment is <depth> levels up, which is the variable of the
+     * environment the function is defined in.
+     *
+     * @param depth the number of parents to go up.
+     * @param slot the index of the variable among the captured ones.
+     * @param name the name of the variable.
+     * @param value the value that should be stored in that variable.
+     */
+    void setCapturedVariable(uint32_t depth, uint32_t slot, SymbolId name,
+        const ExpressionValue& value);
+
+    /**
+     * @brief Get a global variable from the root environment.
+     *
+     * @param name the name of the variable.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
+     */
+    ExpressionValue getGlobalVariable(SymbolId name);
+
+    /**
+     * @brief Set a variable at a location found by the Resolver.
+     *
+     * @param location the location of the variable.
+     * @param name the name of the variable.
+     * @param value the value that should be stored in that variable.
+     */
+    void setVariable(const VariableLocation& location,
+        SymbolId name, const ExpressionValue& value);
 
     /**
      * @brief Get the Variable object associated with name <name>.
-     * 
+     *
      * If no variable is found under this name in this environment,
      * the search bubbles up to the <parent>.
-     * 
+     *
      * @param name the name of the variable that should be searched for.
-     * @return std::shared_ptr<ExpressionValue> to the variable
-     * if it exists, otherwise nullptr.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
      */
-    std::shared_ptr<ExpressionValue> getVariable(std::string& name);
-    
+    ExpressionValue getVariable(SymbolId name);
+
+    /**
+     * @brief Get the Variable object associated with name <name>, like
+     * getVariable, using and updating the cache of a call site.
+     *
+     * A cached variable is used if its environment is still part of the
+     * chain of this environment. The chain is walked up to it, but no
+     * environment on the way is searched.
+     *
+     * @param name the name of the variable that should be searched for.
+     * @param cache the cache of the call site.
+     * @return ExpressionValue the value of the variable. Throws if the
+     * variable is not defined.
+     */
+    ExpressionValue getVariable(SymbolId name, BindingCache& cache);
+
+    /**
+     * @brief Get the counters of all binding caches.
+     *
+     * @return const BindingCacheStatistics& the statistics.
+     */
+    static const BindingCacheStatistics& getCacheStatistics();
+
+    /**
+     * @brief Reset the counters of all binding caches to 0.
+     *
+     */
+    static void resetCacheStatistics();
+
 
     /**
      * @brief Set a variable if it is defined in this environment.
-     * 
+     *
      * If no variable is found under this name in this environment,
-     * the search bubbles up to the <parent> (also using setVariableIfDefined).
-     * 
+     * the search bubbles up to the <parent>.
+     *
      * @param name the name the variable.
      * @param value the value that should be stored in that variable.
      * @return true if a variable was found in this environment or a parent
      * environment and could be reassigned, false otherwise.
      */
-    bool setVariableIfDefined(std::string& name,
-        std::shared_ptr<ExpressionValue>& value);
+    bool setVariableIfDefined(SymbolId name,
+        const ExpressionValue& value);
 
     /**
      * @brief Set a variable in this environment or a parent environment.
-     * 
+     *
      * If no variable is found under this name in this environment,
      * the search bubbles up to the <parent> (using setVariableIfDefined).
-     * 
+     *
      * @param name the name the variable.
      * @param value the value that should be stored in that variable.
      */
-    void setVariable(std::string& name,
-        std::shared_ptr<ExpressionValue>& value);
+    void setVariable(SymbolId name,
+        const ExpressionValue& value);
 
     /**
      * @brief Set a variable in this environment.
-     * 
+     *
      * The search DOES NOT bubble to the parent.
-     * 
+     *
      * @param name the name the variable.
      * @param value the value that should be stored in that variable.
      */
-    void setLocalVariable(std::string& name,
-        std::shared_ptr<ExpressionValue>& value);
+    void setLocalVariable(SymbolId name,
+        const ExpressionValue& value);
 
 private:
+    /**
+     * @brief Find a defined variable in this environment only.
+     *
+     * @param name the name of the variable.
+     * @return ExpressionValue* the variable, nullptr if it is not defined
+     * here.
+     */
+    ExpressionValue* findLocalVariable(SymbolId name);
+
+    /**
+     * @brief Find a defined variable in this environment only.
+     *
+     * @param name the name of the variable.
+     * @param slot set to the slot of the variable, or BindingCache::NO_SLOT
+     * if it is kept in the map.
+     * @return ExpressionValue* the variable, nullptr if it is not defined
+     * here.
+     */
+    ExpressionValue* findLocalVariable(SymbolId name, uint32_t& slot);
+
+    /**
+     * @brief Find the variable a cache remembers in this environment.
+     *
+     * @param name the name of the variable.
+     * @param cache the cache whose owner is this environment.
+     * @return ExpressionValue* the variable, nullptr if it is no longer
+     * defined here.
+     */
+    ExpressionValue* findCachedVariable(SymbolId name,
+        const BindingCache& cache);
+
+    /**
+     * @brief Note that a new variable named <name> has been bound, which
+     * may shadow variables remembered by binding caches.
+     *
+     * @param name the name of the variable.
+     */
+    static void bindingCreated(SymbolId name) {
+        if (name >= bindingVersions.size()) {
+            bindingVersions.resize(name + 1);
+        }
+
+        bindingVersions[name]++;
+    }
+
+    /**
+     * @brief Get the binding version of a name.
+     *
+     * @param name the name.
+     * @return uint64_t the number of variables named <name> bound so far.
+     */
+    static uint64_t bindingVersion(SymbolId name) {
+        return name < bindingVersions.size() ? bindingVersions[name] : 0;
+    }
+
+    /**
+     * @brief The binding version of every name, indexed by its SymbolId.
+     *
+     */
+    static std::vector<uint64_t> bindingVersions;
+
+    /**
+     * @brief The counters of all binding caches.
+     *
+     */
+    static BindingCacheStatistics cacheStatistics;
+
+    /**
+     * @brief Get the environment <depth> levels up.
+     *
+     * @param depth the number of parents to go up.
+     * @return Environment* the environment.
+     */
+    Environment* getAncestor(uint32_t depth);
+
     /**
      * @brief The parent of this environment.
-     * 
+     *
      * It will be consulted for variables under certain conditions
      * when variables are not found in this environment.
-     * 
+     *
+     */
+    Environment* parent;
+
+    /**
+     * @brief The scope describing the slots, nullptr if there are none.
+     *
+     */
+    const Scope* scope;
+
+    /**
+     * @brief The function whose call this environment was created for,
+     * nullptr for other environments.
+     *
+     */
+    FunctionObject* closure = nullptr;
+
+    /**
+     * @brief The values of the variables declared by <scope>.
+     *
      */
-    std::shared_ptr<Environment> parent;
+    std::vector<ExpressionValue> slots;
 
     /**
-     * @brief The map of variable names to their value.
-     * 
+     * @brief The map of variable names to their value for variables not
+     * declared by <scope>. Always present in the root environment, created
+     * on demand elsewhere.
+     *
      */
-    std::unordered_map<std::string, std::shared_ptr<ExpressionValue>> env;
+    std::unique_ptr<std::unordered_map<SymbolId, ExpressionValue>> env;
 };
 
 
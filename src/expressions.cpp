@@ -1,29 +1,52 @@
 #include "expressions.h"
 
+#include "jit.h"
+#include "program.h"
+
+
+Expression::~Expression() {}
+
 
 Literal::Literal(const Token& token) {
     switch (token.getType()) {
         case TokenType::STRING:
-            value = std::make_shared<ExpressionValue>();
-            value->payloadStr = token.payloadStr;
-            value->type = ExpressionValueType::STRING;
+            value = ExpressionValue(token.getString());
             break;
         case TokenType::INT:
-            value = std::make_shared<ExpressionValue>();
-            value->payloadInt = token.payloadInt;
-            value->type = ExpressionValueType::INT;
+            value = ExpressionValue(token.payloadInt);
             break;
         case TokenType::FLOAT:
-            value = std::make_shared<ExpressionValue>();
-            value->payloadFloat = token.payloadFloat;
-            value->type = ExpressionValueType::FLOAT;
+            value = ExpressionValue(token.payloadFloat);
             break;
         default:
             throw std::exception("Token not convertible to Literal");
     }
+
+    if (value.isHeapValue()) {
+        value.payloadObject->pinCount++;
+    }
+}
+
+Literal::Literal(const ExpressionValue& value) {
+    this->value = value.promote();
+
+    if (this->value.isHeapValue()) {
+        this->value.payloadObject->pinCount++;
+    }
+}
+
+Literal::~Literal() {
+    if (value.isHeapValue()) {
+        value.payloadObject->pinCount--;
+    }
+}
+
+ExpressionValue Literal::evaluate(Program& program,
+        Environment* env) {
+    return value;
 }
 
-std::shared_ptr<ExpressionValue> Literal::evaluate(std::shared_ptr<Environment>& env) {
+const ExpressionValue& Literal::getValue() const {
     return value;
 }
 
@@ -33,283 +56,295 @@ Name::Name(const Token& token) {
         throw std::exception("Token not convertible to Name");
     }
 
-    name = token.payloadStr;
+    name = token.payloadSymbol;
 }
 
-std::shared_ptr<ExpressionValue> Name::evaluate(std::shared_ptr<Environment>& env) {
-    return env->getVariable(name);
+ExpressionValue Name::evaluate(Program& program,
+        Environment* env) {
+    return env->getVariable(location, name);
 }
 
 
-BinaryOperation::BinaryOperation(std::unique_ptr<Expression> left,
-        std::unique_ptr<Expression> right):
-            left(std::move(left)), right(std::move(right)) {}
+BinaryOperation::BinaryOperation(NodeId left, NodeId right):
+    left(left), right(right) {}
 
 
-std::shared_ptr<ExpressionValue> Addition::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue Addition::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
+
+    return apply(leftValue, rightValue);
+}
 
-    if (leftValue->type != rightValue->type) {
+ExpressionValue Addition::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Addition: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt + rightValue->payloadInt;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt + rightValue.payloadInt);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat + rightValue->payloadFloat;
-            ret->type = ExpressionValueType::FLOAT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat + rightValue.payloadFloat);
         case ExpressionValueType::STRING:
-            ret->payloadStr = leftValue->payloadStr + rightValue->payloadStr;
-            ret->type = ExpressionValueType::STRING;
-            break;
+            return ExpressionValue::youngString(
+                leftValue.getString() + rightValue.getString());
         default:
             throw std::exception("Addition: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> Subtraction::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue Subtraction::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
+
+    return apply(leftValue, rightValue);
+}
 
-    if (leftValue->type != rightValue->type) {
+ExpressionValue Subtraction::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Subtraction: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt - rightValue->payloadInt;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt - rightValue.payloadInt);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat - rightValue->payloadFloat;
-            ret->type = ExpressionValueType::FLOAT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat - rightValue.payloadFloat);
+        default:
+            throw std::exception("Subtraction: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> Multiplication::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue Multiplication::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
 
-    if (leftValue->type != rightValue->type) {
+    return apply(leftValue, rightValue);
+}
+
+ExpressionValue Multiplication::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Multiplication: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt * rightValue->payloadInt;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt * rightValue.payloadInt);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat * rightValue->payloadFloat;
-            ret->type = ExpressionValueType::FLOAT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat * rightValue.payloadFloat);
+        default:
+            throw std::exception("Multiplication: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> Division::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue Division::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
 
-    if (leftValue->type != rightValue->type) {
+    return apply(leftValue, rightValue);
+}
+
+ExpressionValue Division::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Division: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt / rightValue->payloadInt;
-            ret->type = ExpressionValueType::INT;
-            break;
+            if (rightValue.payloadInt == 0) {
+                throw std::exception("Division: Division by zero");
+            }
+
+            return ExpressionValue(leftValue.payloadInt / rightValue.payloadInt);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat / rightValue->payloadFloat;
-            ret->type = ExpressionValueType::FLOAT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat / rightValue.payloadFloat);
+        default:
+            throw std::exception("Division: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> EqualComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue EqualComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
+
+    return apply(leftValue, rightValue);
+}
 
-    if (leftValue->type != rightValue->type) {
+ExpressionValue EqualComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Equal: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt == rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt == rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat == rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat == rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Equal: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> GreaterThanComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue GreaterThanComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
 
-    if (leftValue->type != rightValue->type) {
+    return apply(leftValue, rightValue);
+}
+
+ExpressionValue GreaterThanComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Greater than: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt > rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt > rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat > rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat > rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Greater than: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> GreaterThanOrEqualComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue GreaterThanOrEqualComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
 
-    if (leftValue->type != rightValue->type) {
+    return apply(leftValue, rightValue);
+}
+
+ExpressionValue GreaterThanOrEqualComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Greater than or equal: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt >= rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt >= rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat >= rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat >= rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Greater than or equal: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> LessThanComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue LessThanComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
+
+    return apply(leftValue, rightValue);
+}
 
-    if (leftValue->type != rightValue->type) {
+ExpressionValue LessThanComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Less than: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt < rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt < rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat < rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat < rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Less than: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> LessThanOrEqualComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue LessThanOrEqualComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
+
+    return apply(leftValue, rightValue);
+}
 
-    if (leftValue->type != rightValue->type) {
+ExpressionValue LessThanOrEqualComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Less than or equal: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt <= rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt <= rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat <= rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat <= rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Less than or equal: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> NotEqualComparison::evaluate(std::shared_ptr<Environment>& env) {
-    std::shared_ptr<ExpressionValue> leftValue = left->evaluate(env);
-    std::shared_ptr<ExpressionValue> rightValue = right->evaluate(env);
+ExpressionValue NotEqualComparison::evaluate(Program& program,
+        Environment* env) {
+    ExpressionValue leftValue = program.evaluate(left, env);
+    Pin pinLeft(leftValue.getHeapObject());
+    ExpressionValue rightValue = program.evaluate(right, env);
 
-    if (leftValue->type != rightValue->type) {
+    return apply(leftValue, rightValue);
+}
+
+ExpressionValue NotEqualComparison::apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    if (leftValue.type != rightValue.type) {
         throw std::exception("Not equal: Types do not match up");
     }
 
-    auto ret = std::make_shared<ExpressionValue>();
-
-    switch (leftValue->type) {
+    switch (leftValue.type) {
         case ExpressionValueType::INT:
-            ret->payloadInt = leftValue->payloadInt != rightValue->payloadInt ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadInt != rightValue.payloadInt ? 1 : 0);
         case ExpressionValueType::FLOAT:
-            ret->payloadFloat = leftValue->payloadFloat != rightValue->payloadFloat ? 1 : 0;
-            ret->type = ExpressionValueType::INT;
-            break;
+            return ExpressionValue(leftValue.payloadFloat != rightValue.payloadFloat ? 1 : 0);
+        default:
+            throw std::exception("Not equal: Invalid type");
     }
-
-    return ret;
 }
 
 
-std::shared_ptr<ExpressionValue> AndConnective::evaluate(std::shared_ptr<Environment>& env) {
-    auto leftValue = left->evaluate(env);
+ExpressionValue AndConnective::evaluate(Program& program,
+        Environment* env) {
+    auto leftValue = program.evaluate(left, env);
     
-    if (leftValue->type == ExpressionValueType::INT) {
-        if (leftValue->payloadInt == 0) {
+    if (leftValue.type == ExpressionValueType::INT) {
+        if (leftValue.payloadInt == 0) {
             return leftValue;
         } else {
-            return right->evaluate(env);
+            return program.evaluate(right, env);
         }
     } else {
         throw std::exception("And: Wrong types");
@@ -317,14 +352,15 @@ std::shared_ptr<ExpressionValue> AndConnective::evaluate(std::shared_ptr<Environ
 }
 
 
-std::shared_ptr<ExpressionValue> OrConnective::evaluate(std::shared_ptr<Environment>& env) {
-    auto leftValue = left->evaluate(env);
+ExpressionValue OrConnective::evaluate(Program& program,
+        Environment* env) {
+    auto leftValue = program.evaluate(left, env);
     
-    if (leftValue->type == ExpressionValueType::INT) {
-        if (leftValue->payloadInt == 1) {
+    if (leftValue.type == ExpressionValueType::INT) {
+        if (leftValue.payloadInt == 1) {
             return leftValue;
         } else {
-            return right->evaluate(env);
+            return program.evaluate(right, env);
         }
     } else {
         throw std::exception("Or: Wrong types");
@@ -332,150 +368,424 @@ std::shared_ptr<ExpressionValue> OrConnective::evaluate(std::shared_ptr<Environm
 }
 
 
-Assignment::Assignment(std::unique_ptr<Name> left,
-        std::unique_ptr<Expression> right):
-    left(std::move(left)), right(std::move(right)) {}
+Assignment::Assignment(const Name& left, NodeId right):
+    left(left), right(right) {}
 
-std::shared_ptr<ExpressionValue> Assignment::evaluate(std::shared_ptr<Environment>& env) {
-    auto value = right->evaluate(env);
-    env->setVariable(left->name, std::move(value));
+ExpressionValue Assignment::evaluate(Program& program,
+        Environment* env) {
+    auto value = program.evaluate(right, env);
+    env->setVariable(left.location, left.name, value);
 
     return value;
 }
 
 
-std::shared_ptr<ExpressionValue> Block::evaluate(std::shared_ptr<Environment>& parent) {
-    auto env = std::make_shared<Environment>(parent);
-    std::shared_ptr<ExpressionValue> ret;
+uint64_t Block::elidedEnvironments = 0;
 
-    for (auto it = exprList.begin(); it != exprList.end(); it++) {
-        ret = (*it)->evaluate(std::move(env));
+ExpressionValue Block::evaluate(Program& program,
+        Environment* parent) {
+    if (!needsEnvironment) {
+        elidedEnvironments++;
+
+        return evaluateExpressions(program, parent);
     }
 
-    return ret;
+    // The environment is released with the block, it may point to a parent
+    // that does not outlive the block
+    NurseryRegion region(Heap::global());
+    auto env = Environment::create(parent, scope);
+    Pin pinEnv(env);
+
+    return evaluateExpressions(program, env).escape(region.getMark());
 }
 
-void Block::addExpression(std::unique_ptr<Expression>& expr) {
-    exprList.push_back(std::move(expr));
+ExpressionValue Block::evaluateExpressions(Program& program,
+        Environment* env) {
+    if (exprList.empty()) {
+        return ExpressionValue();
+    }
+
+    for (auto it = exprList.begin(); it != exprList.end() - 1; it++) {
+        // The value is dropped, so are all temporaries of the expression
+        NurseryRegion region(Heap::global());
+        program.evaluate(*it, env);
+    }
+
+    return program.evaluate(exprList.back(), env);
+}
+
+uint64_t Block::getElidedEnvironments() {
+    return elidedEnvironments;
+}
+
+void Block::resetElidedEnvironments() {
+    elidedEnvironments = 0;
+}
+
+void Block::addExpression(NodeId expr) {
+    exprList.push_back(expr);
 }
 
 
-IfStatement::IfStatement(std::unique_ptr<Expression>& condition,
-        std::unique_ptr<Block>& ifBlock, std::unique_ptr<Block>& elseBlock):
-    condition(std::move(condition)), ifBlock(std::move(ifBlock)),
-        elseBlock(std::move(elseBlock)) {}
+IfStatement::IfStatement(NodeId condition, NodeId ifBlock,
+        NodeId elseBlock):
+    condition(condition), ifBlock(ifBlock), elseBlock(elseBlock) {}
 
-std::shared_ptr<ExpressionValue> IfStatement::evaluate(
-        std::shared_ptr<Environment>& env) {
-    auto conditionResult = condition->evaluate(env);
+ExpressionValue IfStatement::evaluate(Program& program,
+        Environment* env) {
+    auto conditionResult = program.evaluate(condition, env);
     
-    if (conditionResult->type == ExpressionValueType::INT
-            && conditionResult->payloadInt != 0) {
-        return ifBlock->evaluate(env);
+    if (conditionResult.type == ExpressionValueType::INT
+            && conditionResult.payloadInt != 0) {
+        return program.evaluate(ifBlock, env);
+    } else if (elseBlock != NO_NODE) {
+        return program.evaluate(elseBlock, env);
     } else {
-        return elseBlock->evaluate(env);
+        return ExpressionValue();
     }
 }
 
 
-std::shared_ptr<ExpressionValue> CustomFunction::evaluate(
-        std::shared_ptr<Environment>& env) {
-    return body->evaluate(env);
+WhileLoop::WhileLoop(NodeId condition):
+    condition(condition) {}
+
+ExpressionValue WhileLoop::evaluate(Program& program,
+        Environment* parent) {
+    // Created once, every iteration reuses the environment
+    NurseryRegion region(Heap::global());
+    auto env = needsEnvironment
+        ? Environment::create(parent, scope)
+        : parent;
+    Pin pinEnv(env);
+
+    while (true) {
+        // Iterations without calls would never collect otherwise
+        Heap::global().safepoint();
+
+        // The values of an iteration are dropped, so are its temporaries
+        NurseryRegion iteration(Heap::global());
+        auto conditionResult = program.evaluate(condition, env);
+
+        if (conditionResult.type != ExpressionValueType::INT
+                || conditionResult.payloadInt == 0) {
+            break;
+        }
+
+        for (auto it = body.begin(); it != body.end(); it++) {
+            program.evaluate(*it, env);
+        }
+
+        if (step != NO_NODE) {
+            program.evaluate(step, env);
+        }
+    }
+
+    return ExpressionValue();
+}
+
+void WhileLoop::addExpression(NodeId expr) {
+    body.push_back(expr);
+}
+
+
+ForLoop::ForLoop(NodeId init, NodeId condition, NodeId step):
+        WhileLoop(condition), init(init) {
+    this->step = step;
+}
+
+ExpressionValue ForLoop::evaluate(Program& program,
+        Environment* parent) {
+    {
+        NurseryRegion region(Heap::global());
+        program.evaluate(init, parent);
+    }
+
+    return WhileLoop::evaluate(program, parent);
+}
+
+
+Function::~Function() {}
+
+const std::vector<SymbolId>& Function::getParameterNames() const {
+    return parameterScope.getNames();
+}
+
+const Scope& Function::getParameterScope() const {
+    return parameterScope;
+}
+
+Scope& Function::getParameterScope() {
+    return parameterScope;
+}
+
+uint32_t Function::capture(const VariableLocation& location) {
+    for (size_t i = 0; i < captures.size(); i++) {
+        if (captures[i].kind == location.kind
+                && captures[i].depth == location.depth
+                && captures[i].slot == location.slot) {
+            return static_cast<uint32_t>(i);
+        }
+    }
+
+    captures.push_back(location);
+
+    return static_cast<uint32_t>(captures.size() - 1);
+}
+
+const std::vector<VariableLocation>& Function::getCaptures() const {
+    return captures;
+}
+
+void Function::clearCaptures() {
+    captures.clear();
+}
+
+ExpressionValue Function::createClosure(
+        const std::shared_ptr<Function>& function, Environment* env) {
+    if (function->captures.empty()) {
+        // Nothing is read from the environment of the definition, which may
+        // be released long before the function is called
+        return ExpressionValue::youngFunction(function, env->getRoot());
+    }
+
+    std::vector<ExpressionValue*> variables;
+    variables.reserve(function->captures.size());
+
+    for (auto it = function->captures.begin(); it != function->captures.end();
+            it++) {
+        variables.push_back(env->getStorage(*it));
+    }
+
+    return ExpressionValue::youngFunction(function, env, std::move(variables));
+}
+
+Environment* Function::createEnvironment(const ExpressionValue& function,
+        Environment* caller) {
+    auto closure = function.getFunctionObject();
+    auto& scope = closure->function->getParameterScope();
+
+    auto env = Environment::create(
+        closure->environment ? closure->environment : caller, scope);
+
+    // A heap environment must not point into the nursery
+    env->setClosure(scope.isCaptured()
+        ? static_cast<FunctionObject*>(Heap::global().promote(closure))
+        : closure);
+
+    return env;
+}
+
+void Function::setPure(bool pure) {
+    this->pure = pure;
 }
 
-void CustomFunction::addParameter(std::unique_ptr<Name>& name) {
-    parameters.push_back(name->name);
+bool Function::isPure() const {
+    return pure;
 }
 
-const std::vector<std::string>& CustomFunction::getParameterNames() const {
-    return parameters;
+bool Function::isMemoized() const {
+    return pure && MemoTable::isEnabled();
 }
 
-void CustomFunction::setBody(std::unique_ptr<Expression>& body) {
-    this->body = std::move(body);
+MemoTable& Function::getMemoTable() const {
+    return memoTable;
+}
+
+
+TailCall CustomFunction::tailCall;
+
+CustomFunction::CustomFunction(Program& program): program(program),
+    jit(std::make_shared<JitFunction>(program, *this)) {}
+
+ExpressionValue CustomFunction::evaluate(
+        Environment* env) {
+    MemoKey key;
+    uint32_t argCount = parameterScope.size();
+    bool memoized = isMemoized() && MemoTable::makeKey(
+        argCount > 0 ? &env->getSlot(0) : nullptr, argCount, key);
+
+    ExpressionValue result;
+    if (memoized && memoTable.lookup(key, result)) {
+        return result;
+    }
+
+    Environment* caller = env->getParent();
+    if (jit->run(this, argCount > 0 ? &env->getSlot(0) : nullptr, caller,
+            SIZE_MAX, result)) {
+        if (memoized) {
+            memoTable.store(key, result);
+        }
+
+        return result;
+    }
+
+    NurseryRegion region(Heap::global());
+    result = program.evaluate(body, env);
+
+    while (tailCall.pending) {
+        // The function making the tail call has returned, so have its
+        // environments and temporaries
+        Heap::global().releaseNursery(region.getMark());
+        result = evaluateTailCall(caller);
+    }
+
+    if (memoized) {
+        memoTable.store(key, result);
+    }
+
+    return result.escape(region.getMark());
+}
+
+void CustomFunction::requestTailCall(const ExpressionValue& function,
+        Environment* arguments) {
+    uint32_t argCount = function.getFunction()->getParameterScope().size();
+
+    tailCall.arguments.resize(argCount);
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        tailCall.arguments[slot] = arguments->getSlot(slot).promote();
+    }
+
+    tailCall.function = function.promote();
+    tailCall.pending = true;
+}
+
+ExpressionValue CustomFunction::evaluateTailCall(Environment* caller) {
+    tailCall.pending = false;
+
+    auto functionVar = tailCall.function;
+    auto function = static_cast<CustomFunction*>(
+        functionVar.getFunction().get());
+
+    auto functionEnv = Function::createEnvironment(functionVar, caller);
+    Pin pinFunction(functionVar.payloadObject);
+    Pin pinEnv(functionEnv);
+
+    for (uint32_t slot = 0; slot < tailCall.arguments.size(); slot++) {
+        functionEnv->bindSlot(slot, tailCall.arguments[slot]);
+    }
+
+    return function->program.evaluate(function->body, functionEnv);
+}
+
+void CustomFunction::addParameter(const Name& name) {
+    uint32_t slot;
+
+    if (parameterScope.find(name.name, slot)) {
+        throw std::exception("Duplicate parameter name");
+    }
+
+    parameterScope.declare(name.name);
+}
+
+void CustomFunction::setBody(NodeId body) {
+    this->body = body;
+}
+
+NodeId CustomFunction::getBody() const {
+    return body;
+}
+
+const std::shared_ptr<JitFunction>& CustomFunction::getJit() const {
+    return jit;
 }
 
 
 FunctionWrapper::FunctionWrapper(std::shared_ptr<CustomFunction>& function):
         function(std::move(function)) {}
 
-std::shared_ptr<ExpressionValue> FunctionWrapper::evaluate(
-        std::shared_ptr<Environment>& env) {
-    auto exprVal = std::make_shared<ExpressionValue>();
-    exprVal->type = ExpressionValueType::FUNCTION;
-    exprVal->payloadFunc = function;
+ExpressionValue FunctionWrapper::evaluate(Program& program,
+        Environment* env) {
+    return Function::createClosure(
+        std::static_pointer_cast<Function>(function), env);
+}
 
-    return exprVal;
+CustomFunction& FunctionWrapper::getFunction() const {
+    return *function;
 }
 
 
 PrintFunction::PrintFunction() {
-    parameterNames.push_back(std::string("str"));
+    parameterScope.declare(intern("str"));
 }
 
-std::shared_ptr<ExpressionValue> PrintFunction::evaluate(
-        std::shared_ptr<Environment>& env) {
-    auto str = env->getVariable(*parameterNames.begin());
+ExpressionValue PrintFunction::evaluate(
+        Environment* env) {
+    auto& str = env->getSlot(0);
 
-    if (str->type != ExpressionValueType::STRING) {
+    if (str.type != ExpressionValueType::STRING) {
         throw std::exception("Only print strings");
     }
 
-    std::cout << str->payloadStr;
+    std::cout << str.getString();
 
-    return nullptr;
+    return ExpressionValue();
 }
 
-const std::vector<std::string>& PrintFunction::getParameterNames() const {
-    return parameterNames;
-}
 
+Invocation::Invocation(const Name& functionName):
+        functionName(functionName.name) {}
 
-Invocation::Invocation(std::unique_ptr<Name>& functionName):
-        functionName(functionName->name) {}
+ExpressionValue Invocation::evaluate(Program& program,
+        Environment* env) {
+    // Every value the callers still need is rooted here
+    Heap::global().safepoint();
 
-std::shared_ptr<ExpressionValue> Invocation::evaluate(
-        std::shared_ptr<Environment>& env) {
-    auto functionVar = env->getVariable(functionName);
+    auto functionVar = functionLocation.kind == VariableKind::DYNAMIC
+        ? env->getVariable(functionName, functionCache)
+        : env->getVariable(functionLocation, functionName);
 
-    if (functionVar->type != ExpressionValueType::FUNCTION) {
+    if (functionVar.type != ExpressionValueType::FUNCTION) {
         throw std::exception("Only invoke functions");
     }
 
-    auto function = functionVar->payloadFunc;
-    auto paramNames = function->getParameterNames();
+    auto& function = functionVar.getFunction();
+    auto& parameterScope = function->getParameterScope();
 
-    if (paramNames.size() != arguments.size()) {
+    if (parameterScope.size() != arguments.size()) {
         throw std::exception("Function arguments do not map to parameters");
     }
 
-    auto functionEnv = std::make_shared<Environment>(env);
+    NurseryRegion region(Heap::global());
+    auto functionEnv = Function::createEnvironment(functionVar, env);
+    Pin pinFunction(functionVar.payloadObject);
+    Pin pinEnv(functionEnv);
+
+    for (uint32_t slot = 0; slot < arguments.size(); slot++) {
+        functionEnv->bindSlot(slot, program.evaluate(arguments[slot], env));
+    }
 
-    auto paramName = paramNames.begin();
-    auto argValue = arguments.begin();
-    while (paramName != paramNames.end()) {
-        // TODO decide on what to do with variable shadowing
-        functionEnv->setLocalVariable(*paramName, (*argValue)->evaluate(env));
+    if (tailCall && dynamic_cast<CustomFunction*>(function.get())) {
+        CustomFunction::requestTailCall(functionVar, functionEnv);
 
-        paramName++;
-        argValue++;
+        return ExpressionValue();
     }
 
-    return function->evaluate(functionEnv);
+    return function->evaluate(functionEnv).escape(region.getMark());
 }
 
-void Invocation::addArgument(std::unique_ptr<Expression>& arg) {
-    arguments.push_back(std::move(arg));
+void Invocation::addArgument(NodeId arg) {
+    arguments.push_back(arg);
+}
+
+void Invocation::setTailCall(bool tailCall) {
+    this->tailCall = tailCall;
+}
+
+bool Invocation::isTailCall() const {
+    return tailCall;
 }
 
 
 GlobalEnvironment::GlobalEnvironment() {
     std::shared_ptr<Function> printFunction = std::make_shared<PrintFunction>();
-    auto printFunctionVar = std::make_shared<ExpressionValue>();
+    ExpressionValue printFunctionVar(printFunction);
+
+    setVariable(intern("print"), printFunctionVar);
 
-    printFunctionVar->type = ExpressionValueType::FUNCTION;
-    printFunctionVar->payloadFunc = printFunction;
+    Heap::global().addRoot(this);
+}
 
-    setVariable(std::string("print"), printFunctionVar);
+GlobalEnvironment::~GlobalEnvironment() {
+    Heap::global().removeRoot(this);
 }
 
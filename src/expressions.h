@@ -2,29 +2,140 @@
 #define EXPRESSIONS_H
 
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 #include <iostream>
 
 #include "environment.h"
+#include "memo.h"
 #include "tokenizer.h"
 
 
+class Compiler;
+class CppEmitter;
+class JitCompiler;
+class JitFunction;
+class Optimizer;
+class Program;
+class Resolver;
+enum class OpCode : uint8_t;
+struct CppValue;
+
+
+/**
+ * @brief Reference to an Expression stored in a Program, the index of the
+ * expression in the node table of the program.
+ * 
+ */
+typedef uint32_t NodeId;
+
+/**
+ * @brief The NodeId referring to no expression at all.
+ * 
+ */
+const NodeId NO_NODE = UINT32_MAX;
+
+
 /**
  * @brief Abstract base class for all Expressions.
  * 
+ * Expressions are allocated in the arena of a Program and refer to their
+ * children by NodeId.
+ * 
  */
 class Expression {
 public:
+    /**
+     * @brief Destroy the Expression object.
+     * 
+     */
+    virtual ~Expression();
+
     /**
      * @brief Evaluate this expression and return its value.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for everything
      * relating to variables.
-     * @return std::shared_ptr<ExpressionValue> the value of this expression.
+     * @return ExpressionValue the value of this expression.
+     */
+    virtual ExpressionValue evaluate(Program& program,
+        Environment* env) = 0;
+
+    /**
+     * @brief Emit the bytecode for this expression into the chunk
+     * <compiler> is currently writing.
+     * 
+     * The emitted code leaves exactly one value on the stack, the same value
+     * evaluate would return.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    virtual void compile(Compiler& compiler) const = 0;
+
+    /**
+     * @brief Emit the C++ statements computing this expression into the
+     * function <emitter> is currently writing.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the temporary or constant holding the value evaluate
+     * would return.
+     */
+    virtual CppValue emitCpp(CppEmitter& emitter) const = 0;
+
+    /**
+     * @brief Emit the machine code computing this expression into the
+     * function <jit> is currently compiling, leaving its value in the result
+     * register.
+     * 
+     * Only expressions the JIT supports override this, all others keep the
+     * function around them interpreted.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if it is not supported.
+     */
+    virtual bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Resolve the variables referenced by this expression and its
+     * children to slots in their scopes.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    virtual void resolve(Resolver& resolver) = 0;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it,
+     * e.g. by folding it into a Literal.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    virtual NodeId optimize(Optimizer& optimizer) = 0;
+
+    /**
+     * @brief Copy this expression and its children for a call the optimizer
+     * inlines. The copies of names are made by the optimizer, which replaces
+     * the parameters of the inlined function.
+     * 
+     * Only expressions without side effects override this, all others keep
+     * the call around them.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if the expression cannot be copied.
+     */
+    virtual NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of the value this expression evaluates to, as far
+     * as the optimizer can tell without running it.
+     * 
+     * @param optimizer the optimizer looking up the children.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
      */
-    virtual std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env) = 0;
+    virtual ExpressionValueType getType(const Optimizer& optimizer) const;
 };
 
 
@@ -42,21 +153,99 @@ public:
      */
     Literal(const Token& token);
 
+    /**
+     * @brief Construct a new Literal object holding a precomputed value,
+     * e.g. one folded by the Optimizer.
+     * 
+     * @param value the value, promoted to the heap if it is young.
+     */
+    Literal(const ExpressionValue& value);
+
+    /**
+     * @brief Destroy the Literal object, unpinning its value.
+     * 
+     */
+    ~Literal();
+
     /**
      * @brief Return the ExpressionValue contructed from the passed in Token.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the value of this expression.
+     * @return ExpressionValue the value of this expression.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of this literal.
+     * 
+     * @param optimizer the optimizer looking up the children.
+     * @return ExpressionValueType the type of the value.
+     */
+    ExpressionValueType getType(const Optimizer& optimizer) const;
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief Get the value of this literal.
+     * 
+     * @return const ExpressionValue& the value.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    const ExpressionValue& getValue() const;
 
 private:
     /**
-     * @brief The value constructed from the passed in Token.
+     * @brief The value constructed from the passed in Token. Its heap object
+     * is pinned for the lifetime of the literal.
      * 
      */
-    std::shared_ptr<ExpressionValue> value;
+    ExpressionValue value;
 };
 
 
@@ -76,17 +265,72 @@ public:
     /**
      * @brief Return the ExpressionValue of the variable associated to <name>.
      * 
+     * @param program the program holding the child expressions.
      * @param env the 
-     * @return std::shared_ptr<ExpressionValue> 
+     * @return ExpressionValue 
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief The name extracted from the passed in token, interned by the
+     * tokenizer.
+     * 
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    SymbolId name;
 
     /**
-     * @brief The name extracted from the passed in token.
+     * @brief Where the variable is found at runtime. Set by the Resolver.
      * 
      */
-    std::string name;
+    VariableLocation location;
 };
 
 
@@ -103,21 +347,126 @@ public:
      * @param left the left operand,
      * @param right the right operand.
      */
-    BinaryOperation(std::unique_ptr<Expression> left,
-        std::unique_ptr<Expression> right);
+    BinaryOperation(NodeId left, NodeId right);
+
+    /**
+     * @brief Resolve the variables referenced by both operands.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
         
 protected:
+    /**
+     * @brief Emit the bytecode for both operands followed by <op>.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     * @param op the instruction combining the two operand values.
+     */
+    void compileOperation(Compiler& compiler, OpCode op) const;
+
+    /**
+     * @brief Emit the superinstruction <op> if the left operand is a local
+     * variable and the right one a literal, like in x - 1.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     * @param op the superinstruction, like SUBTRACT_LOCAL_CONSTANT.
+     * @return true if the superinstruction was emitted.
+     * @return false if the operands do not fit it, nothing was emitted.
+     */
+    bool compileLocalAndConstant(Compiler& compiler, OpCode op) const;
+
+    /**
+     * @brief Emit the C++ code for both operands, pinning the left value
+     * while the right one is computed.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @param leftValue set to the value of the left operand.
+     * @param rightValue set to the value of the right operand.
+     */
+    void emitOperands(CppEmitter& emitter, CppValue& leftValue,
+        CppValue& rightValue) const;
+
+    /**
+     * @brief Emit the C++ code for both operands and the operation on them,
+     * as <nativeOperator> if both have the same known type, otherwise
+     * through NativeRuntime, which checks the types at runtime.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @param nativeOperator the C++ operator, like +.
+     * @param functor the C++ function object applying it, like std::plus<>.
+     * @param operation the name of this class.
+     * @param comparison whether the result is always an INT.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitOperation(CppEmitter& emitter, const char* nativeOperator,
+        const char* functor, const char* operation, bool comparison) const;
+
+    /**
+     * @brief Emit the C++ code for an and or or, which evaluates to the left
+     * operand if it is <shortCircuit> and to the right operand otherwise.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @param shortCircuit the left value skipping the right operand.
+     * @param error the message thrown if the left value is no INT.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitConnective(CppEmitter& emitter, int shortCircuit,
+        const char* error) const;
+
+    /**
+     * @brief Emit the machine code for both operands followed by <op>.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @param op the instruction combining the two operands, like ADD.
+     * @return true if both operands were compiled.
+     * @return false if the JIT does not support one of them.
+     */
+    bool compileNativeOperation(JitCompiler& jit, OpCode op) const;
+
+    /**
+     * @brief Optimize both operands and fold them if both are literals.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @param operation the apply function of this operation.
+     * @return NodeId the folded literal, NO_NODE if the operands are not
+     * both literals or <operation> throws for them.
+     */
+    NodeId optimizeOperation(Optimizer& optimizer, ExpressionValue (*operation)(
+        const ExpressionValue&, const ExpressionValue&));
+
+    /**
+     * @brief Copy both operands and create an operation of type <T> on the
+     * copies.
+     * 
+     * @tparam T the type of this operation.
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if an operand cannot be copied.
+     */
+    template <typename T>
+    NodeId copyOperation(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of an arithmetic operation, which is the type of
+     * both operands as it throws for operands of different types.
+     * 
+     * @param optimizer the optimizer looking up the operands.
+     * @return ExpressionValueType the type of an operand whose type is known,
+     * UNDEFINED if neither is known.
+     */
+    ExpressionValueType getOperandType(const Optimizer& optimizer) const;
+
     /**
      * @brief The left operand.
      * 
      */
-    std::unique_ptr<Expression> left;
+    NodeId left;
 
     /**
      * @brief The right operand.
      * 
      */
-    std::unique_ptr<Expression> right;
+    NodeId right;
 };
 
 
@@ -132,11 +481,71 @@ public:
     /**
      * @brief Add the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the sum of the operands.
+     * @return ExpressionValue the sum of the operands.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of the result, the type of the operands.
+     * 
+     * @param optimizer the optimizer looking up the operands.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValueType getType(const Optimizer& optimizer) const;
 };
 
 
@@ -151,11 +560,71 @@ public:
     /**
      * @brief Subtract the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the difference of the operands.
+     * @return ExpressionValue the difference of the operands.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of the result, the type of the operands.
+     * 
+     * @param optimizer the optimizer looking up the operands.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValueType getType(const Optimizer& optimizer) const;
 };
 
 
@@ -170,11 +639,71 @@ public:
     /**
      * @brief Multiply the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the product of the operands.
+     * @return ExpressionValue the product of the operands.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of the result, the type of the operands.
+     * 
+     * @param optimizer the optimizer looking up the operands.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValueType getType(const Optimizer& optimizer) const;
 };
 
 
@@ -189,33 +718,145 @@ public:
     /**
      * @brief Divide the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the quotient of the operands.
+     * @return ExpressionValue the quotient of the operands.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
-};
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
 
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
 
-/**
- * @brief An Expression which compares the values of two other expressions
- * for equality. Only works if the two operand have the exact same type.
- * 
- */
-class EqualComparison: public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
-    
     /**
-     * @brief Compare the two operands for equality and return the result.
+     * @brief Emit the bytecode for this expression.
      * 
-     * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
-     * and value 1 if the operands are equal, 0 if not.
+     * @param compiler the compiler to emit the bytecode with.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
-};
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Get the type of the result, the type of the operands.
+     * 
+     * @param optimizer the optimizer looking up the operands.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
+     */
+    ExpressionValueType getType(const Optimizer& optimizer) const;
+};
+
+
+/**
+ * @brief An Expression which compares the values of two other expressions
+ * for equality. Only works if the two operand have the exact same type.
+ * 
+ */
+class EqualComparison: public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+    
+    /**
+     * @brief Compare the two operands for equality and return the result.
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue ExpressionValue with type INT
+     * and value 1 if the operands are equal, 0 if not.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+};
 
 
 /**
@@ -231,13 +872,65 @@ public:
     /**
      * @brief Compare the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
+     * @return ExpressionValue ExpressionValue with type INT
      * and value 1 if the left operand is greater than the right operand,
      * 0 if not.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
 };
 
 
@@ -254,13 +947,65 @@ public:
     /**
      * @brief Compare the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
+     * @return ExpressionValue ExpressionValue with type INT
      * and value 1 if the left operand is greater than or equal to the right
      * operand, 0 if not.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
 };
 
 
@@ -277,13 +1022,65 @@ public:
     /**
      * @brief Compare the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
+     * @return ExpressionValue ExpressionValue with type INT
      * and value 1 if the left operand is less than the right operand,
      * 0 if not.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
 };
 
 
@@ -300,13 +1097,65 @@ public:
     /**
      * @brief Compare the two operands and return the result.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
+     * @return ExpressionValue ExpressionValue with type INT
      * and value 1 if the left operand is less than or equal to the right
      * operand, 0 if not.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
 };
 
 
@@ -321,259 +1170,986 @@ public:
     using BinaryOperation::BinaryOperation;
     
     /**
-     * @brief Compare the two operands for inequality and return the result.
+     * @brief Compare the two operands for inequality and return the result.
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue ExpressionValue with type INT
+     * and value 1 if the operands are not equal, 0 if not.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Apply this operation to two already evaluated operands.
+     * 
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return ExpressionValue the result, as described for
+     * evaluate.
+     */
+    static ExpressionValue apply(
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+};
+
+
+/**
+ * @brief An Expression that connects two operands with an and.
+ * 
+ */
+class AndConnective: public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+    
+    /**
+     * @brief Evaluate the and operation.
+     * 
+     * Evaluate the left operand first. If it is an ExpressionValue with type
+     * INT and value 0, stop and return it. Otherwise, return the evaluation
+     * of the right operand.
+     * 
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue ExpressionValue with the value
+     * described above.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+};
+
+
+/**
+ * @brief An Expression which connets two operands with an or.
+ * 
+ */
+class OrConnective: public BinaryOperation {
+public:
+    using BinaryOperation::BinaryOperation;
+
+    /**
+     * @brief Evaluate the or operation.
+     * 
+     * Evaluate the left operand first. If it is an ExpressionValue with type
+     * INT and value 1, stop and return it. Otherwise, return the evaluation
+     * of the right operand.
+     * 
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue ExpressionValue with the value
+     * described above.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+};
+
+
+/**
+ * @brief An Expression which assigns a value to a name (variable).
+ * 
+ */
+class Assignment: public Expression {
+public:
+    /**
+     * @brief Construct a new Assignment object.
+     * 
+     * @param left the name to which the value should be assigned.
+     * @param right the expression evaluating to what should be assigned.
+     */
+    Assignment(const Name& left, NodeId right);
+
+    /**
+     * @brief Evaluate the assignment statement.
+     * 
+     * Set the value to which <right> evaluates to as a variable
+     * with name <name>.
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue the evaluation of <right>.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+private:
+    /**
+     * @brief The name to which the value is assigned.
+     * 
+     */
+    Name left;
+
+    /**
+     * @brief The expression evaluating to what is assigned.
+     * 
+     */
+    NodeId right;
+};
+
+
+/**
+ * @brief An expression which provides a scope for variables.
+ * 
+ */
+class Block: public Expression {
+public:
+    /**
+     * @brief Evaluate all the expressions associated to this block.
+     * 
+     * Create a new environment for those expressions which has the passed
+     * in evironment as its parent. Blocks which the Resolver found to declare
+     * no variables are evaluated in <parent> directly.
+     * 
+     * 
+     * @param program the program holding the child expressions.
+     * @param parent The environment around this block statement.
+     * @return ExpressionValue the value of the last
+     * expression in this block.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* parent);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief Add an expression to this block.
+     * 
+     * @param expr the expression that should be added.
+     */
+    void addExpression(NodeId expr);
+
+    /**
+     * @brief Get the number of environment allocations avoided by
+     * evaluating blocks without variables in their parent environment.
+     * 
+     * @return uint64_t the number of avoided allocations since the last
+     * reset.
+     */
+    static uint64_t getElidedEnvironments();
+
+    /**
+     * @brief Reset the number of avoided environment allocations to 0.
+     * 
+     */
+    static void resetElidedEnvironments();
+
+private:
+    /**
+     * @brief Evaluate all expressions in <env>.
+     * 
+     * @param program the program holding the child expressions.
+     * @param env the environment to evaluate the expressions in.
+     * @return ExpressionValue the value of the last expression.
+     */
+    ExpressionValue evaluateExpressions(Program& program,
+        Environment* env);
+
+    /**
+     * @brief the list of all expression in this block.
+     *
+     */
+    std::vector<NodeId> exprList;
+
+    /**
+     * @brief The variables declared directly in this block. Set by the
+     * Resolver.
+     * 
+     */
+    Scope scope;
+
+    /**
+     * @brief Whether this block needs its own environment. Cleared by the
+     * Resolver if <scope> stays empty.
+     * 
+     */
+    bool needsEnvironment = true;
+
+    /**
+     * @brief The number of environment allocations avoided so far.
+     * 
+     */
+    static uint64_t elidedEnvironments;
+};
+
+
+/**
+ * @brief An expression which executes blocks based on conditions.
+ * 
+ */
+class IfStatement: public Expression {
+public:
+    /**
+     * @brief Construct a new If Statement object.
+     * 
+     * @param condition if this evaluates to a nonzero value, <ifBlock> will be
+     * evaluated, otherwise <elseBlock> will be evaluated.
+     * @param ifBlock the block directly following the if statement.
+     * @param elseBlock the block following a potential else statement.
+     * Can be NO_NODE.
+     */
+    IfStatement(NodeId condition, NodeId ifBlock, NodeId elseBlock);
+
+    /**
+     * @brief Evaluate the condition and act upon its value.
+     * 
+     * @param program the program holding the child expressions.
+     * @param env The environment which provides the context for the variables.
+     * This will be passed on to either <ifBlock> or <elseBlock>.
+     * @return ExpressionValue the value of the <ifBlock> or
+     * <elseBlock>.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Copy this expression for an inlined call.
+     * 
+     * @param optimizer the optimizer creating the copy.
+     * @return NodeId the copy, NO_NODE if it cannot be copied.
+     */
+    NodeId copy(Optimizer& optimizer) const;
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+private:
+    /**
+     * @brief The condition which determines whether <ifBlock> or <elseBlock>
+     * is evaluated. If this evaluates to a nonzero value, <ifBlock> will be
+     * evaluated, otherwise <elseBlock> will be evaluated.
+     * 
+     */
+    NodeId condition;
+
+    /**
+     * @brief The block that will be executed if <condition> evaluates to a
+     * nonzero value.
+     * 
+     */
+    NodeId ifBlock;
+
+    /**
+     * @brief The block that will be executed if it is not NO_NODE and
+     * <condition> evaluates to 0.
+     * 
+     */
+    NodeId elseBlock;
+};
+
+
+/**
+ * @brief An expression which evaluates its body as long as its condition
+ * evaluates to a nonzero value.
+ * 
+ * The condition and the body are evaluated in one environment for the
+ * variables declared in the loop, created once when the loop starts and
+ * reused by every iteration. Variables assigned in an iteration therefore
+ * keep their value in the next one. Loops evaluate to an empty value.
+ * 
+ */
+class WhileLoop: public Expression {
+public:
+    /**
+     * @brief Construct a new While Loop object with an empty body.
+     * 
+     * @param condition the loop ends once this evaluates to anything but a
+     * nonzero INT.
+     */
+    WhileLoop(NodeId condition);
+
+    /**
+     * @brief Evaluate the body until the condition no longer holds.
+     * 
+     * @param program the program holding the child expressions.
+     * @param parent the environment around this loop.
+     * @return ExpressionValue an empty value.
+     */
+    ExpressionValue evaluate(Program& program,
+        Environment* parent);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Optimize the children of this expression.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId always NO_NODE, loops are kept.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief Add an expression to the body of this loop.
+     * 
+     * @param expr the expression that should be added.
+     */
+    void addExpression(NodeId expr);
+
+protected:
+    /**
+     * @brief The expression evaluated after the body of every iteration,
+     * NO_NODE if there is none. Evaluated in the loop environment.
+     * 
+     */
+    NodeId step = NO_NODE;
+
+private:
+    /**
+     * @brief The condition checked before every iteration.
+     * 
+     */
+    NodeId condition;
+
+    /**
+     * @brief The expressions of the body.
+     * 
+     */
+    std::vector<NodeId> body;
+
+    /**
+     * @brief The variables declared in the condition, the body or the step.
+     * Set by the Resolver.
+     * 
+     */
+    Scope scope;
+
+    /**
+     * @brief Whether this loop needs its own environment. Cleared by the
+     * Resolver if <scope> stays empty.
      * 
-     * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with type INT
-     * and value 1 if the operands are not equal, 0 if not.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    bool needsEnvironment = true;
 };
 
 
 /**
- * @brief An Expression that connects two operands with an and.
+ * @brief A while loop with an expression evaluated once before it starts and
+ * one evaluated after every iteration, like FOR i = 0, i < 10, i = i + 1.
+ * 
+ * The first expression is evaluated in the environment around the loop, so
+ * the variables it assigns are visible after the loop.
  * 
  */
-class AndConnective: public BinaryOperation {
+class ForLoop: public WhileLoop {
 public:
-    using BinaryOperation::BinaryOperation;
-    
     /**
-     * @brief Evaluate the and operation.
-     * 
-     * Evaluate the left operand first. If it is an ExpressionValue with type
-     * INT and value 0, stop and return it. Otherwise, return the evaluation
-     * of the right operand.
+     * @brief Construct a new For Loop object with an empty body.
      * 
+     * @param init the expression evaluated before the loop starts.
+     * @param condition the loop ends once this evaluates to anything but a
+     * nonzero INT.
+     * @param step the expression evaluated after every iteration.
+     */
+    ForLoop(NodeId init, NodeId condition, NodeId step);
+
+    /**
+     * @brief Evaluate the first expression and then the loop.
      * 
-     * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with the value
-     * described above.
+     * @param program the program holding the child expressions.
+     * @param parent the environment around this loop.
+     * @return ExpressionValue an empty value.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
-};
+    ExpressionValue evaluate(Program& program,
+        Environment* parent);
 
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
 
-/**
- * @brief An Expression which connets two operands with an or.
- * 
- */
-class OrConnective: public BinaryOperation {
-public:
-    using BinaryOperation::BinaryOperation;
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
 
     /**
-     * @brief Evaluate the or operation.
+     * @brief Optimize the children of this expression.
      * 
-     * Evaluate the left operand first. If it is an ExpressionValue with type
-     * INT and value 1, stop and return it. Otherwise, return the evaluation
-     * of the right operand.
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId always NO_NODE, loops are kept.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
      * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+private:
+    /**
+     * @brief The expression evaluated before the loop starts.
      * 
-     * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> ExpressionValue with the value
-     * described above.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    NodeId init;
 };
 
 
 /**
- * @brief An Expression which assigns a value to a name (variable).
+ * @brief Abstract base class of all functions, the values that can be
+ * invoked. Holds the names of the parameters and the variables the function
+ * captures from where it is defined.
  * 
  */
-class Assignment: public Expression {
+class Function {
 public:
     /**
-     * @brief Construct a new Assignment object.
+     * @brief Destroy the Function object.
      * 
-     * @param left the name to which the value should be assigned.
-     * @param right the expression evaluating to what should be assigned.
      */
-    Assignment(std::unique_ptr<Name> left,
-        std::unique_ptr<Expression> right);
+    virtual ~Function();
 
     /**
-     * @brief Evaluate the assignment statement.
-     * 
-     * Set the value to which <right> evaluates to as a variable
-     * with name <name>.
+     * @brief Evaluate the function body.
      * 
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the evaluation of <right>.
+     * It has been created for the parameter scope, with the arguments stored
+     * in its slots.
+     * @return ExpressionValue the value returned by the function.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    virtual ExpressionValue evaluate(
+        Environment* env) = 0;
 
-private:
-    std::shared_ptr<Name> left;
-    std::shared_ptr<Expression> right;
-};
+    /**
+     * @brief Get the Parameter Names list.
+     * 
+     * @return const std::vector<SymbolId>& The list of parameter names
+     * that are defined for this function.
+     */
+    const std::vector<SymbolId>& getParameterNames() const;
 
+    /**
+     * @brief Get the scope of the parameters. The environment a function
+     * is evaluated in is created for this scope, parameter i is stored in
+     * slot i.
+     * 
+     * @return const Scope& the scope declaring all parameters.
+     */
+    const Scope& getParameterScope() const;
 
-/**
- * @brief An expression which provides a scope for variables.
- * 
- */
-class Block: public Expression {
-public:
     /**
-     * @brief Evaluate all the expressions associated to this block.
+     * @brief Get the scope of the parameters, e.g. to mark it captured.
      * 
-     * Create a new environment for those expressions which has the passed
-     * in evironment as its parent.
+     * @return Scope& the scope declaring all parameters.
+     */
+    Scope& getParameterScope();
+
+    /**
+     * @brief Add a variable to the ones captured by closures of this
+     * function. Called by the Resolver for free variables of the body.
      * 
+     * @param location the location of the variable relative to the
+     * environment the function is defined in, LOCAL or CAPTURED.
+     * @return uint32_t the index of the variable among the captured ones.
+     * Capturing a location twice returns the same index.
+     */
+    uint32_t capture(const VariableLocation& location);
+
+    /**
+     * @brief Get the variables captured by closures of this function.
      * 
-     * @param parent The environment around this block statement.
-     * @return std::shared_ptr<ExpressionValue> the value of the last
-     * expression in this block.
+     * @return const std::vector<VariableLocation>& the locations, indexed
+     * like FunctionObject::captures.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& parent);
+    const std::vector<VariableLocation>& getCaptures() const;
 
     /**
-     * @brief Add an expression to this block.
+     * @brief Forget all captured variables, before the body is resolved
+     * again.
      * 
-     * @param expr the expression that should be added.
      */
-    void addExpression(std::unique_ptr<Expression>& expr);
+    void clearCaptures();
 
-private:
     /**
-     * @brief the list of all expression in this block.
-     *
+     * @brief Create the value of a function definition, a closure holding
+     * the variables captured by the function.
+     * 
+     * @param function the function defined.
+     * @param env the environment the definition is evaluated in.
+     * @return ExpressionValue the young FUNCTION value.
      */
-    std::vector<std::unique_ptr<Expression>> exprList;
-};
+    static ExpressionValue createClosure(
+        const std::shared_ptr<Function>& function, Environment* env);
+
+    /**
+     * @brief Allocate the environment of a call for its parameter scope. Its
+     * parent is the environment the function was defined in.
+     * 
+     * @param function the FUNCTION value called.
+     * @param caller the environment the call is made in, used as parent for
+     * functions without closure like print.
+     * @return Environment* the environment, in the nursery unless closures
+     * capture the parameters.
+     */
+    static Environment* createEnvironment(const ExpressionValue& function,
+        Environment* caller);
 
+    /**
+     * @brief Mark this function as pure, its results only depend on its
+     * arguments. Set by the Resolver.
+     * 
+     * @param pure whether the results of calls may be memoized.
+     */
+    void setPure(bool pure);
 
-/**
- * @brief An expression which executes blocks based on conditions.
- * 
- */
-class IfStatement: public Expression {
-public:
     /**
-     * @brief Construct a new If Statement object.
+     * @brief Check whether this function is pure.
      * 
-     * @param condition if this evaluates to a nonzero value, <ifBlock> will be
-     * evaluated, otherwise <elseBlock> will be evaluated.
-     * @param ifBlock the block directly following the if statement.
-     * @param elseBlock the block following a potential else statement.
-     * Can be nullptr.
+     * @return true if its results only depend on its arguments.
+     * @return false otherwise.
      */
-    IfStatement(std::unique_ptr<Expression>& condition,
-        std::unique_ptr<Block>& ifBlock, std::unique_ptr<Block>& elseBlock);
+    bool isPure() const;
 
     /**
-     * @brief Evaluate the condition and act upon its value.
+     * @brief Check whether calls of this function are memoized.
      * 
-     * @param env The environment which provides the context for the variables.
-     * This will be passed on to either <ifBlock> or <elseBlock>.
-     * @return std::shared_ptr<ExpressionValue> the value of the <ifBlock> or
-     * <elseBlock>.
+     * @return true if the function is pure and memoization is enabled.
+     * @return false otherwise.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    bool isMemoized() const;
 
-private:
     /**
-     * @brief The condition which determines whether <ifBlock> or <elseBlock>
-     * is evaluated. If this evaluates to a nonzero value, <ifBlock> will be
-     * evaluated, otherwise <elseBlock> will be evaluated.
+     * @brief Get the results of earlier calls of this function.
      * 
+     * @return MemoTable& the memo table.
      */
-    std::unique_ptr<Expression> condition;
+    MemoTable& getMemoTable() const;
 
+protected:
     /**
-     * @brief The block that will be executed if <condition> evaluates to a
-     * nonzero value.
+     * @brief The scope declaring all parameters of this function.
      * 
      */
-    std::unique_ptr<Expression> ifBlock;
+    Scope parameterScope;
 
     /**
-     * @brief The block that will be executed if it is not a nullptr and
-     * <condition> evaluates to 0.
+     * @brief The variables captured by closures of this function.
+     * 
+     */
+    std::vector<VariableLocation> captures;
+
+    /**
+     * @brief Whether this function is pure.
      * 
      */
-    std::unique_ptr<Expression> elseBlock;
+    bool pure = false;
+
+    /**
+     * @brief The results of earlier calls, used if the function is pure.
+     * Filled by calls even of functions that are otherwise constant.
+     * 
+     */
+    mutable MemoTable memoTable;
 };
 
 
 /**
- * @brief An Abstract Expression that holds a function with its parameter names
- * and its body.
+ * @brief A call made by an Invocation in tail position. It is not evaluated
+ * by the Invocation, but by the CustomFunction making it, once its body
+ * returned.
  * 
  */
-class Function: public Expression {
-public:
+struct TailCall {
     /**
-     * @brief Get the Parameter Names list.
+     * @brief Whether a tail call waits to be evaluated.
+     * 
+     */
+    bool pending = false;
+
+    /**
+     * @brief The CustomFunction to call.
+     * 
+     */
+    ExpressionValue function;
+
+    /**
+     * @brief The arguments of the call, promoted out of the nursery.
      * 
-     * @return const std::vector<std::string>& The list of parameter names
-     * that are defined for this function.
      */
-    virtual const std::vector<std::string>& getParameterNames() const = 0;
+    std::vector<ExpressionValue> arguments;
 };
 
 
 /**
- * @brief An Expression which holds a function defined dynamically while
- * parsing.
+ * @brief A function defined dynamically while parsing. Its body is an
+ * expression of the Program it was parsed from.
+ * 
+ * Calls of pure functions with INT and FLOAT arguments are memoized. The
+ * result is looked up before the body is evaluated and stored once the
+ * body and the tail calls it makes returned.
+ * 
+ * Tail calls made by the body are evaluated in a loop instead of recursing,
+ * so tail recursive functions run in constant stack and nursery space. The
+ * environment of a tail call has the environment of the original call as
+ * its parent, which leaves out the environments of the function making it.
+ * 
+ * Once a function is hot, calls with INT arguments run as machine code if
+ * the JitFunction could compile its body.
  * 
  */
 class CustomFunction: public Function {
 public:
     /**
-     * @brief Evaluate the function body.
+     * @brief Construct a new Custom Function object.
+     * 
+     * @param program the program holding the body. Must outlive the function.
+     */
+    CustomFunction(Program& program);
+
+    /**
+     * @brief Evaluate the function body, followed by the tail calls it makes.
      * 
      * @param env The environment which provides the context for the variables.
-     * Parameters must already be assigned to the names in <parameters>.
-     * @return std::shared_ptr<ExpressionValue> The value of the function body
-     * block <body>.
+     * Parameters must already be assigned to the slots of the parameter scope.
+     * @return ExpressionValue The value of the function body
+     * block <body>, or of the last tail call.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(
+        Environment* env);
 
     /**
-     * @brief Get the Parameter Names list.
+     * @brief Let the CustomFunction whose body is being evaluated call
+     * <function> once the body returned.
      * 
-     * @return const std::vector<std::string>& The list of parameter names
-     * that are defined for this function.
+     * @param function the CustomFunction to call.
+     * @param arguments an environment holding the arguments in its slots.
+     */
+    static void requestTailCall(const ExpressionValue& function,
+        Environment* arguments);
+
+    /**
+     * @brief Resolve the variables referenced by the body.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief Optimize the body.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
      */
-    const std::vector<std::string>& getParameterNames() const;
+    void optimize(Optimizer& optimizer);
 
     /**
      * @brief Add a parameter to the parameters list.
      * 
      * @param name the name of that parameter.
      */
-    void addParameter(std::unique_ptr<Name>& name);
+    void addParameter(const Name& name);
 
     /**
      * @brief Set the <body> of the function, which is usually a Block.
      * 
      * @param body 
      */
-    void setBody(std::unique_ptr<Expression>& body);
+    void setBody(NodeId body);
+
+    /**
+     * @brief Get the body of the function.
+     * 
+     * @return NodeId the body of the function.
+     */
+    NodeId getBody() const;
+
+    /**
+     * @brief Get the machine code state of this function, shared with the
+     * CompiledFunction compiled from it.
+     * 
+     * @return const std::shared_ptr<JitFunction>& the state.
+     */
+    const std::shared_ptr<JitFunction>& getJit() const;
 
 private:
     /**
-     * @brief The list of parameters of this function.
+     * @brief The program holding the body.
+     * 
+     */
+    Program& program;
+
+    /**
+     * @brief Evaluate the pending tail call.
      * 
+     * @param caller the parent of the environment of the function making
+     * the call, used as parent for functions without closure.
+     * @return ExpressionValue the value of the body of the function called.
      */
-    std::vector<std::string> parameters;
+    static ExpressionValue evaluateTailCall(Environment* caller);
 
     /**
      * @brief The body of this function.
      * 
      */
-    std::unique_ptr<Expression> body;
+    NodeId body = NO_NODE;
+
+    /**
+     * @brief Counts the calls of this function and holds its machine code
+     * once it is hot.
+     * 
+     */
+    std::shared_ptr<JitFunction> jit;
+
+    /**
+     * @brief The tail call requested by the body being evaluated.
+     * 
+     */
+    static TailCall tailCall;
 };
 
 
@@ -595,12 +2171,50 @@ public:
      * @brief Evaluate this FunctionWrapper by returning the function which
      * was wrapped.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> the function which has been
+     * @return ExpressionValue the function which has been
      * wrapped by this.
      */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
+
+    /**
+     * @brief Get the function that is wrapped.
+     * 
+     * @return CustomFunction& the function.
+     */
+    CustomFunction& getFunction() const;
 
 private:
     /**
@@ -612,7 +2226,7 @@ private:
 
 
 /**
- * @brief An Expression which is a function that prints a string to stdout.
+ * @brief A builtin function that prints a string to stdout.
  * 
  */
 class PrintFunction: public Function {
@@ -627,25 +2241,10 @@ public:
      * @brief Evaluate the print function by printing its parameter to stdout.
      * 
      * @param env The environment which provides the context for the variables.
-     * @return std::shared_ptr<ExpressionValue> a nullptr;
-     */
-    std::shared_ptr<ExpressionValue> evaluate(
-        std::shared_ptr<Environment>& env);
-    
-    /**
-     * @brief Get the Parameter Names list.
-     * 
-     * @return const std::vector<std::string>& The list of parameter names
-     * that are defined for this function.
-     */
-    const std::vector<std::string>& getParameterNames() const;
-
-private:
-    /**
-     * @brief The list of parameters of this function.
-     * 
+     * @return ExpressionValue a value of type NONE.
      */
-    std::vector<std::string> parameterNames;
+    ExpressionValue evaluate(
+        Environment* env);
 };
 
 
@@ -661,40 +2260,119 @@ public:
      * 
      * @param functionName the name of the function which is called.
      */
-    Invocation(std::unique_ptr<Name>& functionName);
+    Invocation(const Name& functionName);
 
     /**
      * @brief Evaluate this Invocation.
      * 
-     * Create a new environment which has all the parameters assigned.
+     * Create a new environment which has all the parameters assigned. Tail
+     * calls of CustomFunctions only request the call from the function
+     * around them and return nothing.
      * 
+     * @param program the program holding the child expressions.
      * @param env The environment which provides the context for the variables.
      * Contains only the parameters to the function. All the other variables
      * are accessible through its parent.
-     * @return std::shared_ptr<ExpressionValue> the value returned by the
+     * @return ExpressionValue the value returned by the
      * function.
      */
-    std::shared_ptr<ExpressionValue> evaluate(std::shared_ptr<Environment>& env);
+    ExpressionValue evaluate(Program& program,
+        Environment* env);
+
+    /**
+     * @brief Emit the bytecode for this expression.
+     * 
+     * @param compiler the compiler to emit the bytecode with.
+     */
+    void compile(Compiler& compiler) const;
+
+    /**
+     * @brief Emit the C++ code for this expression.
+     * 
+     * @param emitter the emitter to write the C++ code with.
+     * @return CppValue the value of this expression.
+     */
+    CppValue emitCpp(CppEmitter& emitter) const;
+
+    /**
+     * @brief Emit the machine code for this expression.
+     * 
+     * @param jit the JIT compiler to emit the machine code with.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compileNative(JitCompiler& jit) const;
+
+    /**
+     * @brief Optimize the children of this expression and simplify it.
+     * 
+     * @param optimizer the optimizer keeping track of the removed expressions.
+     * @return NodeId the expression replacing this one, NO_NODE to keep it.
+     */
+    NodeId optimize(Optimizer& optimizer);
+
+    /**
+     * @brief Resolve the variables referenced by this expression.
+     * 
+     * @param resolver the resolver keeping track of the enclosing scopes.
+     */
+    void resolve(Resolver& resolver);
 
     /**
      * @brief Add an argument to this invocation.
      * 
      * @param arg the argument to add.
      */
-    void addArgument(std::unique_ptr<Expression>& arg);
+    void addArgument(NodeId arg);
+
+    /**
+     * @brief Make this invocation a tail call of the function around it.
+     * Set by the Resolver.
+     * 
+     * @param tailCall whether calls to CustomFunctions are left to the
+     * function around this invocation.
+     */
+    void setTailCall(bool tailCall);
+
+    /**
+     * @brief Check whether this invocation is a tail call.
+     * 
+     * @return true if it is evaluated as a tail call.
+     * @return false otherwise.
+     */
+    bool isTailCall() const;
 
 private:
     /**
      * @brief The name of the function to call.
      * 
      */
-    std::string functionName;
+    SymbolId functionName;
+
+    /**
+     * @brief Where the function is found at runtime. Set by the Resolver.
+     * 
+     */
+    VariableLocation functionLocation;
+
+    /**
+     * @brief Where the function was found by the last call, if it is looked
+     * up by name.
+     * 
+     */
+    BindingCache functionCache;
 
     /**
      * @brief The list of arguments to the function call.
      * 
      */
-    std::vector<std::unique_ptr<Expression>> arguments;
+    std::vector<NodeId> arguments;
+
+    /**
+     * @brief Whether this invocation is a tail call.
+     * 
+     */
+    bool tailCall = false;
 };
 
 
@@ -706,10 +2384,18 @@ private:
 class GlobalEnvironment: public Environment {
 public:
     /**
-     * @brief Construct a new Global Environment object.
+     * @brief Construct a new Global Environment object and add it to the
+     * roots of the global heap.
+     * 
+     */
+    GlobalEnvironment();
+
+    /**
+     * @brief Destroy the Global Environment object, removing it from the
+     * roots of the global heap.
      * 
      */
-    GlobalEnvironment();  
+    ~GlobalEnvironment();
 };
 
 
@@ -1,23 +1,27 @@
 #include <gtest/gtest.h>
-#include "expressions.h"
+#include "program.h"
 
 
 TEST(Expression, LiteralInit) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token token(TokenType::INT);
     token.payloadInt = 10;
 
     Literal literal(token);
-    auto value = literal.evaluate(env);
+    auto value = literal.evaluate(program, env);
 
-    ASSERT_EQ(value->type, ExpressionValueType::INT);
-    ASSERT_EQ(value->payloadInt, 10);
+    ASSERT_EQ(value.type, ExpressionValueType::INT);
+    ASSERT_EQ(value.payloadInt, 10);
 }
 
 
 TEST(Expression, AdditionEvaluationSimple) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -25,19 +29,21 @@ TEST(Expression, AdditionEvaluationSimple) {
     Token rightToken(TokenType::INT);
     rightToken.payloadInt = 10;
 
-    std::unique_ptr<Expression> leftLiteral = std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> rightLiteral = std::make_unique<Literal>(rightToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto rightLiteral = program.create<Literal>(rightToken);
 
-    Addition addition(std::move(leftLiteral), std::move(rightLiteral));
-    auto value = addition.evaluate(env);
+    auto addition = program.create<Addition>(leftLiteral, rightLiteral);
+    auto value = program.evaluate(addition, env);
 
-    ASSERT_EQ(value->type, ExpressionValueType::INT);
-    ASSERT_EQ(value->payloadInt, 20);
+    ASSERT_EQ(value.type, ExpressionValueType::INT);
+    ASSERT_EQ(value.payloadInt, 20);
 }
 
 
 TEST(Expression, MultiplicationEvaluationSimple) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -45,19 +51,21 @@ TEST(Expression, MultiplicationEvaluationSimple) {
     Token rightToken(TokenType::INT);
     rightToken.payloadInt = 10;
 
-    std::unique_ptr<Expression> leftLiteral = std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> rightLiteral = std::make_unique<Literal>(rightToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto rightLiteral = program.create<Literal>(rightToken);
 
-    Multiplication multiplication(std::move(leftLiteral), std::move(rightLiteral));
-    auto value = multiplication.evaluate(env);
+    auto multiplication = program.create<Multiplication>(leftLiteral, rightLiteral);
+    auto value = program.evaluate(multiplication, env);
 
-    ASSERT_EQ(value->type, ExpressionValueType::INT);
-    ASSERT_EQ(value->payloadInt, 100);
+    ASSERT_EQ(value.type, ExpressionValueType::INT);
+    ASSERT_EQ(value.payloadInt, 100);
 }
 
 
 TEST(Expression, MultiplicationAdditionCombined) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -68,22 +76,23 @@ TEST(Expression, MultiplicationAdditionCombined) {
     Token rightToken(TokenType::INT);
     rightToken.payloadInt = 10;
 
-    std::unique_ptr<Expression> leftLiteral = std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> middleLiteral = std::make_unique<Literal>(middleToken);
-    std::unique_ptr<Expression> rightLiteral = std::make_unique<Literal>(rightToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto middleLiteral = program.create<Literal>(middleToken);
+    auto rightLiteral = program.create<Literal>(rightToken);
 
-    std::unique_ptr<Expression> multiplication =
-        std::make_unique<Multiplication>(std::move(leftLiteral), std::move(middleLiteral));
-    Addition addition(std::move(multiplication), std::move(rightLiteral));
-    auto value = addition.evaluate(env);
+    auto multiplication = program.create<Multiplication>(leftLiteral, middleLiteral);
+    auto addition = program.create<Addition>(multiplication, rightLiteral);
+    auto value = program.evaluate(addition, env);
 
-    ASSERT_EQ(value->type, ExpressionValueType::INT);
-    ASSERT_EQ(value->payloadInt, 110);
+    ASSERT_EQ(value.type, ExpressionValueType::INT);
+    ASSERT_EQ(value.payloadInt, 110);
 }
 
 
 TEST(Expression, Equalvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -94,33 +103,32 @@ TEST(Expression, Equalvaluation) {
     Token notEqualToken(TokenType::INT);
     notEqualToken.payloadInt = 11;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> equalLiteral =
-        std::make_unique<Literal>(equalToken);
-    std::unique_ptr<Expression> notEqualLiteral =
-        std::make_unique<Literal>(notEqualToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto equalLiteral = program.create<Literal>(equalToken);
+    auto notEqualLiteral = program.create<Literal>(notEqualToken);
 
-    EqualComparison equalComparison(std::move(leftLiteral),
-        std::move(equalLiteral));
-    auto result = equalComparison.evaluate(env);
+    auto equalComparison = program.create<EqualComparison>(leftLiteral,
+        equalLiteral);
+    auto result = program.evaluate(equalComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    EqualComparison notEqualComparison(std::move(leftLiteral),
-        std::move(notEqualLiteral));
-    result = notEqualComparison.evaluate(env);
+    auto notEqualComparison = program.create<EqualComparison>(leftLiteral,
+        notEqualLiteral);
+    result = program.evaluate(notEqualComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Expression, GreaterThanEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -131,33 +139,32 @@ TEST(Expression, GreaterThanEvaluation) {
     Token notGreatherThanToken(TokenType::INT);
     notGreatherThanToken.payloadInt = 10;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> greatherThanLiteral =
-        std::make_unique<Literal>(greatherThanToken);
-    std::unique_ptr<Expression> notGreaterThanLiteral =
-        std::make_unique<Literal>(notGreatherThanToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto greatherThanLiteral = program.create<Literal>(greatherThanToken);
+    auto notGreaterThanLiteral = program.create<Literal>(notGreatherThanToken);
 
-    GreaterThanComparison greaterThanComparison(std::move(leftLiteral),
-        std::move(greatherThanLiteral));
-    auto result = greaterThanComparison.evaluate(env);
+    auto greaterThanComparison = program.create<GreaterThanComparison>(leftLiteral,
+        greatherThanLiteral);
+    auto result = program.evaluate(greaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    GreaterThanComparison notGreaterThanComparison(std::move(leftLiteral),
-        std::move(notGreaterThanLiteral));
-    result = notGreaterThanComparison.evaluate(env);
+    auto notGreaterThanComparison = program.create<GreaterThanComparison>(leftLiteral,
+        notGreaterThanLiteral);
+    result = program.evaluate(notGreaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Expression, GreaterThanOrEqualEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -168,33 +175,32 @@ TEST(Expression, GreaterThanOrEqualEvaluation) {
     Token notGreatherThanToken(TokenType::INT);
     notGreatherThanToken.payloadInt = 11;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> greatherThanLiteral =
-        std::make_unique<Literal>(greatherThanToken);
-    std::unique_ptr<Expression> notGreaterThanLiteral =
-        std::make_unique<Literal>(notGreatherThanToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto greatherThanLiteral = program.create<Literal>(greatherThanToken);
+    auto notGreaterThanLiteral = program.create<Literal>(notGreatherThanToken);
 
-    GreaterThanOrEqualComparison greaterThanComparison(std::move(leftLiteral),
-        std::move(greatherThanLiteral));
-    auto result = greaterThanComparison.evaluate(env);
+    auto greaterThanComparison = program.create<GreaterThanOrEqualComparison>(leftLiteral,
+        greatherThanLiteral);
+    auto result = program.evaluate(greaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    GreaterThanOrEqualComparison notGreaterThanComparison(std::move(leftLiteral),
-        std::move(notGreaterThanLiteral));
-    result = notGreaterThanComparison.evaluate(env);
+    auto notGreaterThanComparison = program.create<GreaterThanOrEqualComparison>(leftLiteral,
+        notGreaterThanLiteral);
+    result = program.evaluate(notGreaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Expression, LessThanEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -205,33 +211,32 @@ TEST(Expression, LessThanEvaluation) {
     Token notGreatherThanToken(TokenType::INT);
     notGreatherThanToken.payloadInt = 10;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> greatherThanLiteral =
-        std::make_unique<Literal>(greatherThanToken);
-    std::unique_ptr<Expression> notGreaterThanLiteral =
-        std::make_unique<Literal>(notGreatherThanToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto greatherThanLiteral = program.create<Literal>(greatherThanToken);
+    auto notGreaterThanLiteral = program.create<Literal>(notGreatherThanToken);
 
-    LessThanComparison greaterThanComparison(std::move(leftLiteral),
-        std::move(greatherThanLiteral));
-    auto result = greaterThanComparison.evaluate(env);
+    auto greaterThanComparison = program.create<LessThanComparison>(leftLiteral,
+        greatherThanLiteral);
+    auto result = program.evaluate(greaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    LessThanComparison notGreaterThanComparison(std::move(leftLiteral),
-        std::move(notGreaterThanLiteral));
-    result = notGreaterThanComparison.evaluate(env);
+    auto notGreaterThanComparison = program.create<LessThanComparison>(leftLiteral,
+        notGreaterThanLiteral);
+    result = program.evaluate(notGreaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Expression, LessThanOrEqualEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -242,33 +247,32 @@ TEST(Expression, LessThanOrEqualEvaluation) {
     Token notGreatherThanToken(TokenType::INT);
     notGreatherThanToken.payloadInt = 9;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> greatherThanLiteral =
-        std::make_unique<Literal>(greatherThanToken);
-    std::unique_ptr<Expression> notGreaterThanLiteral =
-        std::make_unique<Literal>(notGreatherThanToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto greatherThanLiteral = program.create<Literal>(greatherThanToken);
+    auto notGreaterThanLiteral = program.create<Literal>(notGreatherThanToken);
 
-    LessThanOrEqualComparison greaterThanComparison(std::move(leftLiteral),
-        std::move(greatherThanLiteral));
-    auto result = greaterThanComparison.evaluate(env);
+    auto greaterThanComparison = program.create<LessThanOrEqualComparison>(leftLiteral,
+        greatherThanLiteral);
+    auto result = program.evaluate(greaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    LessThanOrEqualComparison notGreaterThanComparison(std::move(leftLiteral),
-        std::move(notGreaterThanLiteral));
-    result = notGreaterThanComparison.evaluate(env);
+    auto notGreaterThanComparison = program.create<LessThanOrEqualComparison>(leftLiteral,
+        notGreaterThanLiteral);
+    result = program.evaluate(notGreaterThanComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Expression, NotEqualvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token leftToken(TokenType::INT);
     leftToken.payloadInt = 10;
@@ -279,195 +283,185 @@ TEST(Expression, NotEqualvaluation) {
     Token notEqualToken(TokenType::INT);
     notEqualToken.payloadInt = 11;
 
-    std::unique_ptr<Expression> leftLiteral =
-        std::make_unique<Literal>(leftToken);
-    std::unique_ptr<Expression> equalLiteral =
-        std::make_unique<Literal>(equalToken);
-    std::unique_ptr<Expression> notEqualLiteral =
-        std::make_unique<Literal>(notEqualToken);
+    auto leftLiteral = program.create<Literal>(leftToken);
+    auto equalLiteral = program.create<Literal>(equalToken);
+    auto notEqualLiteral = program.create<Literal>(notEqualToken);
 
-    NotEqualComparison equalComparison(std::move(leftLiteral),
-        std::move(equalLiteral));
-    auto result = equalComparison.evaluate(env);
+    auto equalComparison = program.create<NotEqualComparison>(leftLiteral,
+        equalLiteral);
+    auto result = program.evaluate(equalComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 
-    leftLiteral = std::make_unique<Literal>(leftToken);
+    leftLiteral = program.create<Literal>(leftToken);
 
-    NotEqualComparison notEqualComparison(std::move(leftLiteral),
-        std::move(notEqualLiteral));
-    result = notEqualComparison.evaluate(env);
+    auto notEqualComparison = program.create<NotEqualComparison>(leftLiteral,
+        notEqualLiteral);
+    result = program.evaluate(notEqualComparison, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 
 TEST(Expression, NameEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token valToken(TokenType::INT);
     valToken.payloadInt = 10;
 
-    Token nameToken(TokenType::NAME);
-    nameToken.payloadStr = "x";
+    Token nameToken(TokenType::NAME, "x", 1);
 
-    std::unique_ptr<Expression> valLiteral = std::make_unique<Literal>(valToken);
-    auto value = valLiteral->evaluate(env);
+    auto valLiteral = program.create<Literal>(valToken);
+    auto value = program.evaluate(valLiteral, env);
 
-    env->setVariable(std::string("x"), value);
+    env->setVariable(intern("x"), value);
 
     Name name(nameToken);
-    auto eval = name.evaluate(env);
+    auto eval = name.evaluate(program, env);
 
-    ASSERT_EQ(eval->type, ExpressionValueType::INT);
-    ASSERT_EQ(eval->payloadInt, 10);
+    ASSERT_EQ(eval.type, ExpressionValueType::INT);
+    ASSERT_EQ(eval.payloadInt, 10);
 }
 
 TEST(Expression, AndConnectiveTrueEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token trueToken(TokenType::INT);
     trueToken.payloadInt = 1;
 
-    std::unique_ptr<Expression> leftTrueLiteral =
-        std::make_unique<Literal>(trueToken);
-    std::unique_ptr<Expression> rightTrueLiteral =
-        std::make_unique<Literal>(trueToken);
+    auto leftTrueLiteral = program.create<Literal>(trueToken);
+    auto rightTrueLiteral = program.create<Literal>(trueToken);
 
-    std::unique_ptr<Expression> andTrue =
-        std::make_unique<AndConnective>(std::move(leftTrueLiteral), std::move(rightTrueLiteral));
+    auto andTrue = program.create<AndConnective>(leftTrueLiteral, rightTrueLiteral);
 
-    auto result = andTrue->evaluate(env);
+    auto result = program.evaluate(andTrue, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 TEST(Expression, AndConnectiveFalseEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token trueToken(TokenType::INT);
     trueToken.payloadInt = 1;
     Token falseToken(TokenType::INT);
     falseToken.payloadInt = 0;
 
-    std::unique_ptr<Expression> leftTrueLiteral =
-        std::make_unique<Literal>(trueToken);
-    std::unique_ptr<Expression> rightFalseLiteral =
-        std::make_unique<Literal>(falseToken);
+    auto leftTrueLiteral = program.create<Literal>(trueToken);
+    auto rightFalseLiteral = program.create<Literal>(falseToken);
 
-    std::unique_ptr<Expression> andTrue =
-        std::make_unique<AndConnective>(std::move(leftTrueLiteral), std::move(rightFalseLiteral));
+    auto andTrue = program.create<AndConnective>(leftTrueLiteral, rightFalseLiteral);
 
-    auto result = andTrue->evaluate(env);
+    auto result = program.evaluate(andTrue, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 TEST(Expression, OrConnectiveTrueEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token trueToken(TokenType::INT);
     trueToken.payloadInt = 1;
     Token falseToken(TokenType::INT);
     falseToken.payloadInt = 0;
 
-    std::unique_ptr<Expression> leftTrueLiteral =
-        std::make_unique<Literal>(trueToken);
-    std::unique_ptr<Expression> rightFalseLiteral =
-        std::make_unique<Literal>(falseToken);
+    auto leftTrueLiteral = program.create<Literal>(trueToken);
+    auto rightFalseLiteral = program.create<Literal>(falseToken);
 
-    std::unique_ptr<Expression> orTrue =
-        std::make_unique<OrConnective>(std::move(leftTrueLiteral), std::move(rightFalseLiteral));
+    auto orTrue = program.create<OrConnective>(leftTrueLiteral, rightFalseLiteral);
 
-    auto result = orTrue->evaluate(env);
+    auto result = program.evaluate(orTrue, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 TEST(Expression, OrConnectiveFalseEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token falseToken(TokenType::INT);
     falseToken.payloadInt = 0;
 
-    std::unique_ptr<Expression> leftFalseLiteral =
-        std::make_unique<Literal>(falseToken);
-    std::unique_ptr<Expression> rightFalseLiteral =
-        std::make_unique<Literal>(falseToken);
+    auto leftFalseLiteral = program.create<Literal>(falseToken);
+    auto rightFalseLiteral = program.create<Literal>(falseToken);
 
-    std::unique_ptr<Expression> andTrue =
-        std::make_unique<AndConnective>(std::move(leftFalseLiteral), std::move(rightFalseLiteral));
+    auto andTrue = program.create<AndConnective>(leftFalseLiteral, rightFalseLiteral);
 
-    auto result = andTrue->evaluate(env);
+    auto result = program.evaluate(andTrue, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 TEST(Expression, AssignmentEvaluation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token valToken(TokenType::INT);
     valToken.payloadInt = 10;
 
-    Token nameToken(TokenType::NAME);
-    nameToken.payloadStr = "x";
+    Token nameToken(TokenType::NAME, "x", 1);
 
-    std::unique_ptr<Expression> valLiteral =
-        std::make_unique<Literal>(valToken);
-    auto name = std::make_unique<Name>(nameToken);
+    auto valLiteral = program.create<Literal>(valToken);
+    Name name(nameToken);
     
-    std::unique_ptr<Expression> assignment =
-        std::make_unique<Assignment>(std::move(name), std::move(valLiteral));
+    auto assignment = program.create<Assignment>(name, valLiteral);
 
-    assignment->evaluate(env);
+    program.evaluate(assignment, env);
 
-    auto result = env->getVariable(std::string("x"));
+    auto result = env->getVariable(intern("x"));
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 10);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 10);
 }
 
 TEST(Expression, BlockEvaluation) {
     // (outer is int 50)
     // { inner = outer }
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
-    auto value = std::make_shared<ExpressionValue>();
-    value->payloadInt = 50;
-    value->type = ExpressionValueType::INT;
-    env->setVariable(std::string("outer"), value);
+    ExpressionValue value(50);
+    env->setVariable(intern("outer"), value);
 
-    Token rightToken(TokenType::NAME);
-    rightToken.payloadStr = std::string("outer");
+    Token rightToken(TokenType::NAME, "outer", 5);
 
-    Token nameToken(TokenType::NAME);
-    nameToken.payloadStr = "inner";
+    Token nameToken(TokenType::NAME, "inner", 5);
 
-    std::unique_ptr<Expression> rightName =
-        std::make_unique<Name>(rightToken);
-    auto name = std::make_unique<Name>(nameToken);
+    auto rightName = program.create<Name>(rightToken);
+    Name name(nameToken);
     
-    std::unique_ptr<Expression> assignment =
-        std::make_unique<Assignment>(std::move(name), std::move(rightName));
+    auto assignment = program.create<Assignment>(name, rightName);
 
-    std::unique_ptr<Block> block =
-        std::make_unique<Block>();
+    auto block = program.create<Block>();
     
-    block->addExpression(std::move(assignment));
+    program.get<Block>(block).addExpression(assignment);
 
-    auto result = block->evaluate(env);
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 50);
+    auto result = program.evaluate(block, env);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 50);
 }
 
 TEST(Expression, IfStatement) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
     Token conditionalToken(TokenType::INT);
     conditionalToken.payloadInt = 1;
@@ -478,46 +472,41 @@ TEST(Expression, IfStatement) {
     Token onFalseToken(TokenType::INT);
     onFalseToken.payloadInt = 20;
 
-    std::unique_ptr<Expression> conditionalLiteral =
-        std::make_unique<Literal>(conditionalToken);
+    auto conditionalLiteral = program.create<Literal>(conditionalToken);
 
-    std::unique_ptr<Expression> onTrueLiteral =
-        std::make_unique<Literal>(onTrueToken);
+    auto onTrueLiteral = program.create<Literal>(onTrueToken);
     
-    std::unique_ptr<Expression> onFalseLiteral =
-        std::make_unique<Literal>(onFalseToken);
+    auto onFalseLiteral = program.create<Literal>(onFalseToken);
 
-    auto trueBlock =
-        std::make_unique<Block>();
+    auto trueBlock = program.create<Block>();
     
-    auto falseBlock =
-        std::make_unique<Block>();
+    auto falseBlock = program.create<Block>();
 
-    trueBlock->addExpression(onTrueLiteral);
-    falseBlock->addExpression(onFalseLiteral);
+    program.get<Block>(trueBlock).addExpression(onTrueLiteral);
+    program.get<Block>(falseBlock).addExpression(onFalseLiteral);
 
-    IfStatement ifStmt(conditionalLiteral, trueBlock, falseBlock);
+    auto ifStmt = program.create<IfStatement>(conditionalLiteral, trueBlock, falseBlock);
 
-    auto result = ifStmt.evaluate(env);
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 10);
+    auto result = program.evaluate(ifStmt, env);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 10);
 }
 
 TEST(Expression, PrintFunction) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
 
-    Token printToken(TokenType::NAME);
-    printToken.payloadStr = std::string("print");
+    Token printToken(TokenType::NAME, "print", 5);
 
-    Token stringToken(TokenType::STRING);
-    stringToken.payloadStr = std::string("Hello, world!");
+    Token stringToken(TokenType::STRING, "Hello, world!", 13);
 
-    auto printFuncName = std::make_unique<Name>(printToken);
+    Name printFuncName(printToken);
 
-    std::unique_ptr<Expression> arg = std::make_unique<Literal>(stringToken);
-    auto printExpr = std::make_unique<Invocation>(printFuncName);
+    auto arg = program.create<Literal>(stringToken);
+    auto printExpr = program.create<Invocation>(printFuncName);
 
-    printExpr->addArgument(arg);
+    program.get<Invocation>(printExpr).addArgument(arg);
 
-    printExpr->evaluate(env);
+    program.evaluate(printExpr, env);
 }
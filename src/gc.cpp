@@ -0,0 +1,170 @@
+#include "gc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+
+
+HeapObject::~HeapObject() {}
+
+void HeapObject::trace(Heap& heap) {}
+
+size_t HeapObject::getSize() const {
+    return sizeof(HeapObject);
+}
+
+HeapObject* HeapObject::promote(Heap& heap) const {
+    throw std::exception("Object cannot be promoted");
+}
+
+
+RootSet::~RootSet() {}
+
+
+Heap::Heap() {
+    setNurserySize(DEFAULT_NURSERY_SIZE);
+}
+
+Heap::~Heap() {
+    releaseNursery(NurseryMark{ nursery.get(), 0 });
+
+    while (objects) {
+        HeapObject* next = objects->next;
+        delete objects;
+        objects = next;
+    }
+}
+
+void Heap::track(HeapObject* object) {
+    size_t size = object->getSize();
+
+    object->next = objects;
+    objects = object;
+
+    allocatedBytes += size;
+    statistics.objectsAllocated++;
+    statistics.bytesAllocated += size;
+
+    if (allocatedBytes >= nextCollection) {
+        collectionRequested = true;
+    }
+}
+
+void Heap::collect() {
+    auto start = std::chrono::steady_clock::now();
+
+    // Epoch 0 is never current, objects created before a collection are
+    // unmarked in the first one.
+    epoch++;
+    if (epoch == 0) {
+        epoch = 1;
+    }
+
+    for (auto it = youngObjects.begin(); it != youngObjects.end(); it++) {
+        mark(*it);
+    }
+
+    for (HeapObject* object = objects; object; object = object->next) {
+        if (object->pinCount > 0) {
+            mark(object);
+        }
+    }
+
+    for (auto it = roots.begin(); it != roots.end(); it++) {
+        mark(*it);
+    }
+
+    for (auto it = rootSets.begin(); it != rootSets.end(); it++) {
+        (*it)->traceRoots(*this);
+    }
+
+    while (!grayObjects.empty()) {
+        HeapObject* object = grayObjects.back();
+        grayObjects.pop_back();
+
+        object->trace(*this);
+    }
+
+    HeapObject** link = &objects;
+
+    while (*link) {
+        HeapObject* object = *link;
+
+        if (object->markEpoch == epoch) {
+            link = &object->next;
+            continue;
+        }
+
+        size_t size = object->getSize();
+
+        *link = object->next;
+        delete object;
+
+        allocatedBytes -= size;
+        statistics.objectsFreed++;
+        statistics.bytesFreed += size;
+    }
+
+    nextCollection = std::max(heapLimit, 2 * allocatedBytes);
+    collectionRequested = false;
+
+    statistics.collections++;
+    statistics.peakLiveBytes = std::max<uint64_t>(
+        statistics.peakLiveBytes, allocatedBytes);
+    statistics.pauseSeconds += std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+void Heap::addRoot(HeapObject* object) {
+    roots.push_back(object);
+}
+
+void Heap::removeRoot(HeapObject* object) {
+    auto it = std::find(roots.begin(), roots.end(), object);
+
+    if (it != roots.end()) {
+        roots.erase(it);
+    }
+}
+
+void Heap::addRootSet(RootSet* roots) {
+    rootSets.push_back(roots);
+}
+
+void Heap::removeRootSet(RootSet* roots) {
+    auto it = std::find(rootSets.begin(), rootSets.end(), roots);
+
+    if (it != rootSets.end()) {
+        rootSets.erase(it);
+    }
+}
+
+void Heap::setNurserySize(size_t bytes) {
+    if (!youngObjects.empty()) {
+        throw std::exception("Nursery in use");
+    }
+
+    nursery = std::make_unique<char[]>(bytes);
+    nurseryTop = nursery.get();
+    nurseryEnd = nursery.get() + bytes;
+}
+
+void Heap::setHeapLimit(size_t bytes) {
+    heapLimit = bytes;
+    nextCollection = bytes;
+    collectionRequested = allocatedBytes >= nextCollection;
+}
+
+size_t Heap::getAllocatedBytes() const {
+    return allocatedBytes;
+}
+
+const GcStatistics& Heap::getStatistics() const {
+    return statistics;
+}
+
+Heap& Heap::global() {
+    static Heap heap;
+
+    return heap;
+}
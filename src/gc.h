@@ -0,0 +1,617 @@
+#ifndef GC_H
+#define GC_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+class Heap;
+
+
+/**
+ * @brief Base class of all runtime objects managed by the garbage collector:
+ * strings, function values and environments.
+ *
+ * Objects are created with Heap::allocate and freed by the collector once
+ * they can no longer be reached from a root. They never move.
+ *
+ */
+class HeapObject {
+public:
+    /**
+     * @brief Destroy the Heap Object object.
+     *
+     */
+    virtual ~HeapObject();
+
+    /**
+     * @brief Mark all objects this object references with Heap::mark.
+     *
+     * @param heap the heap running the collection.
+     */
+    virtual void trace(Heap& heap);
+
+    /**
+     * @brief Get the number of bytes this object occupies, including memory
+     * it owns. Used to decide when to collect, so it must not change over
+     * the lifetime of the object.
+     *
+     * @return size_t the size in bytes.
+     */
+    virtual size_t getSize() const;
+
+    /**
+     * @brief Copy this object out of the nursery, see Heap::promote. Only
+     * objects that can be held by values support this, the default throws.
+     *
+     * @param heap the heap to allocate the copy on.
+     * @return HeapObject* the copy.
+     */
+    virtual HeapObject* promote(Heap& heap) const;
+
+    /**
+     * @brief The number of Pins keeping this object alive. Pinned objects
+     * are roots.
+     *
+     */
+    uint32_t pinCount = 0;
+
+private:
+    friend class Heap;
+
+    /**
+     * @brief The next object allocated on the same heap.
+     *
+     */
+    HeapObject* next = nullptr;
+
+    /**
+     * @brief The collection this object was last marked in. Objects are
+     * alive during a collection if it equals the epoch of the heap, so marks
+     * never have to be cleared.
+     *
+     */
+    uint32_t markEpoch = 0;
+};
+
+
+/**
+ * @brief Interface for owners of many references into the heap, like the
+ * value stack of the VirtualMachine, which are cheaper to enumerate during
+ * a collection than to pin one by one.
+ *
+ */
+class RootSet {
+public:
+    /**
+     * @brief Destroy the Root Set object.
+     *
+     */
+    virtual ~RootSet();
+
+    /**
+     * @brief Mark all objects referenced by this root set with Heap::mark.
+     *
+     * @param heap the heap running the collection.
+     */
+    virtual void traceRoots(Heap& heap) = 0;
+};
+
+
+/**
+ * @brief Counters describing the work of the garbage collector.
+ *
+ */
+struct GcStatistics {
+    /**
+     * @brief The number of collections run.
+     *
+     */
+    uint64_t collections = 0;
+
+    /**
+     * @brief The number of objects and bytes allocated in total.
+     *
+     */
+    uint64_t objectsAllocated = 0;
+    uint64_t bytesAllocated = 0;
+
+    /**
+     * @brief The number of objects and bytes freed by collections.
+     *
+     */
+    uint64_t objectsFreed = 0;
+    uint64_t bytesFreed = 0;
+
+    /**
+     * @brief The largest number of live bytes seen after a collection.
+     *
+     */
+    uint64_t peakLiveBytes = 0;
+
+    /**
+     * @brief The time spent collecting in seconds.
+     *
+     */
+    double pauseSeconds = 0;
+
+    /**
+     * @brief The number of objects allocated in the nursery, which are not
+     * part of <objectsAllocated>.
+     *
+     */
+    uint64_t youngObjectsAllocated = 0;
+
+    /**
+     * @brief The number of nursery objects copied to the heap because they
+     * escaped.
+     *
+     */
+    uint64_t objectsPromoted = 0;
+};
+
+
+/**
+ * @brief A position in the nursery, everything allocated after it can be
+ * released at once.
+ *
+ */
+struct NurseryMark {
+    /**
+     * @brief The first free byte of the nursery.
+     *
+     */
+    char* top;
+
+    /**
+     * @brief The number of objects in the nursery.
+     *
+     */
+    size_t objects;
+};
+
+
+/**
+ * @brief A mark and sweep garbage collector.
+ *
+ * All runtime objects are kept in a list. A collection marks everything
+ * reachable from the roots and deletes the rest. Roots are precise: pinned
+ * objects, registered RootSets and objects added with addRoot.
+ *
+ * Allocating never collects, it only requests a collection once the bytes
+ * allocated since the last one exceed the heap limit. The evaluators run
+ * the collection at safepoints, where every live object is known to be
+ * reachable from a root. After a collection the limit grows to twice the
+ * live bytes if that is larger than the configured limit.
+ *
+ * Short lived objects, like the environment of a call and the temporaries
+ * computed in it, are bump allocated in a nursery instead. The nursery is
+ * released like a stack: the evaluators take a NurseryMark when a call or
+ * statement starts and destroy everything allocated after it when it ends.
+ * This is only safe because nothing older points into the nursery:
+ * environments only point to their parents, which are older, and values
+ * stored in an environment or returned past a mark are promoted, that is
+ * copied to the heap first. Every nursery object is a root of collections.
+ * Once the nursery is full, allocateYoung falls back to the heap.
+ *
+ */
+class Heap {
+public:
+    /**
+     * @brief The default heap limit in bytes.
+     *
+     */
+    static const size_t DEFAULT_HEAP_LIMIT = 1024 * 1024;
+
+    /**
+     * @brief The default size of the nursery in bytes.
+     *
+     */
+    static const size_t DEFAULT_NURSERY_SIZE = 256 * 1024;
+
+    /**
+     * @brief Construct a new empty Heap object.
+     *
+     */
+    Heap();
+
+    Heap(const Heap&) = delete;
+    Heap& operator=(const Heap&) = delete;
+
+    /**
+     * @brief Destroy the Heap object together with all objects on it.
+     *
+     */
+    ~Heap();
+
+    /**
+     * @brief Create a new object on this heap.
+     *
+     * @tparam T the type of the object, derived from HeapObject.
+     * @param args the arguments passed to the constructor of <T>.
+     * @return T* the new object. It is not rooted yet.
+     */
+    template <typename T, typename... Args>
+    T* allocate(Args&&... args) {
+        T* object = new T(std::forward<Args>(args)...);
+        track(object);
+
+        return object;
+    }
+
+    /**
+     * @brief Create a new short lived object in the nursery, or on the heap
+     * if the nursery is full.
+     *
+     * @tparam T the type of the object, derived from HeapObject.
+     * @param args the arguments passed to the constructor of <T>.
+     * @return T* the new object.
+     */
+    template <typename T, typename... Args>
+    T* allocateYoung(Args&&... args) {
+        size_t space = nurseryEnd - nurseryTop;
+        void* start = nurseryTop;
+
+        if (!std::align(alignof(T), sizeof(T), start, space)) {
+            return allocate<T>(std::forward<Args>(args)...);
+        }
+
+        T* object = new (start) T(std::forward<Args>(args)...);
+        nurseryTop = static_cast<char*>(start) + sizeof(T);
+        youngObjects.push_back(object);
+        statistics.youngObjectsAllocated++;
+
+        return object;
+    }
+
+    /**
+     * @brief Check whether an object lives in the nursery.
+     *
+     * @param object the object.
+     * @return true if <object> was allocated in the nursery.
+     * @return false otherwise.
+     */
+    bool isYoung(const HeapObject* object) const {
+        auto address = reinterpret_cast<const char*>(object);
+
+        return address >= nursery.get() && address < nurseryEnd;
+    }
+
+    /**
+     * @brief Check whether an object was allocated in the nursery after
+     * <mark>.
+     *
+     * @param object the object.
+     * @param mark the mark.
+     * @return true if <object> is released by releaseNursery(<mark>).
+     * @return false otherwise.
+     */
+    bool isYoungerThan(const HeapObject* object,
+            const NurseryMark& mark) const {
+        return isYoung(object)
+            && reinterpret_cast<const char*>(object) >= mark.top;
+    }
+
+    /**
+     * @brief Get an object that may be stored in older objects.
+     *
+     * @param object the object.
+     * @return HeapObject* a copy on the heap if <object> is in the nursery,
+     * <object> itself otherwise.
+     */
+    HeapObject* promote(HeapObject* object) {
+        if (!isYoung(object)) {
+            return object;
+        }
+
+        statistics.objectsPromoted++;
+
+        return object->promote(*this);
+    }
+
+    /**
+     * @brief Get the current position in the nursery.
+     *
+     * @return NurseryMark the mark to pass to releaseNursery.
+     */
+    NurseryMark getNurseryMark() const {
+        return NurseryMark{ nurseryTop, youngObjects.size() };
+    }
+
+    /**
+     * @brief Destroy all objects allocated in the nursery after <mark>.
+     *
+     * @param mark the mark taken before the objects were allocated.
+     */
+    void releaseNursery(const NurseryMark& mark) {
+        while (youngObjects.size() > mark.objects) {
+            youngObjects.back()->~HeapObject();
+            youngObjects.pop_back();
+        }
+
+        nurseryTop = mark.top;
+    }
+
+    /**
+     * @brief Set the size of the nursery. Throws if it is not empty.
+     *
+     * @param bytes the nursery size, 0 allocates everything on the heap.
+     */
+    void setNurserySize(size_t bytes);
+
+    /**
+     * @brief Run a collection if one has been requested.
+     *
+     * Only call this where every live object is reachable from a root.
+     *
+     */
+    void safepoint() {
+        if (collectionRequested) {
+            collect();
+        }
+    }
+
+    /**
+     * @brief Mark all objects reachable from the roots and free the rest.
+     *
+     */
+    void collect();
+
+    /**
+     * @brief Mark an object as reachable during a collection.
+     *
+     * @param object the object, may be nullptr.
+     */
+    void mark(HeapObject* object) {
+        if (object && object->markEpoch != epoch) {
+            object->markEpoch = epoch;
+            grayObjects.push_back(object);
+        }
+    }
+
+    /**
+     * @brief Keep an object alive until it is removed again. The object
+     * does not need to be allocated on this heap.
+     *
+     * @param object the object.
+     */
+    void addRoot(HeapObject* object);
+
+    /**
+     * @brief Remove an object added with addRoot.
+     *
+     * @param object the object.
+     */
+    void removeRoot(HeapObject* object);
+
+    /**
+     * @brief Register a root set, which is traced by every collection until
+     * it is removed again.
+     *
+     * @param roots the root set.
+     */
+    void addRootSet(RootSet* roots);
+
+    /**
+     * @brief Remove a root set registered with addRootSet.
+     *
+     * @param roots the root set.
+     */
+    void removeRootSet(RootSet* roots);
+
+    /**
+     * @brief Set the number of bytes allocated after which a collection is
+     * requested.
+     *
+     * @param bytes the heap limit.
+     */
+    void setHeapLimit(size_t bytes);
+
+    /**
+     * @brief Get the number of bytes currently allocated on this heap.
+     *
+     * @return size_t the bytes of all objects, live or not yet collected.
+     */
+    size_t getAllocatedBytes() const;
+
+    /**
+     * @brief Get the counters of this heap.
+     *
+     * @return const GcStatistics& the statistics.
+     */
+    const GcStatistics& getStatistics() const;
+
+    /**
+     * @brief Get the heap all runtime objects are allocated on.
+     *
+     * @return Heap& the global heap.
+     */
+    static Heap& global();
+
+private:
+    /**
+     * @brief Add a newly created object to the list of objects.
+     *
+     * @param object the object.
+     */
+    void track(HeapObject* object);
+
+    /**
+     * @brief The most recently allocated object, the head of the list of
+     * all objects.
+     *
+     */
+    HeapObject* objects = nullptr;
+
+    /**
+     * @brief The memory of the nursery.
+     *
+     */
+    std::unique_ptr<char[]> nursery;
+
+    /**
+     * @brief The first free byte of the nursery.
+     *
+     */
+    char* nurseryTop = nullptr;
+
+    /**
+     * @brief The end of the nursery.
+     *
+     */
+    char* nurseryEnd = nullptr;
+
+    /**
+     * @brief The objects in the nursery, in the order of allocation.
+     *
+     */
+    std::vector<HeapObject*> youngObjects;
+
+    /**
+     * @brief Marked objects whose references have not been traced yet.
+     *
+     */
+    std::vector<HeapObject*> grayObjects;
+
+    /**
+     * @brief Objects added with addRoot.
+     *
+     */
+    std::vector<HeapObject*> roots;
+
+    /**
+     * @brief Root sets added with addRootSet.
+     *
+     */
+    std::vector<RootSet*> rootSets;
+
+    /**
+     * @brief The current mark epoch, incremented by every collection.
+     *
+     */
+    uint32_t epoch = 0;
+
+    /**
+     * @brief The bytes of all objects on this heap.
+     *
+     */
+    size_t allocatedBytes = 0;
+
+    /**
+     * @brief The configured heap limit.
+     *
+     */
+    size_t heapLimit = DEFAULT_HEAP_LIMIT;
+
+    /**
+     * @brief The allocated bytes at which the next collection is requested.
+     *
+     */
+    size_t nextCollection = DEFAULT_HEAP_LIMIT;
+
+    /**
+     * @brief Whether the next safepoint collects.
+     *
+     */
+    bool collectionRequested = false;
+
+    /**
+     * @brief The counters of this heap.
+     *
+     */
+    GcStatistics statistics;
+};
+
+
+/**
+ * @brief Keeps a heap object alive while it is in scope, for values held in
+ * local variables across a safepoint.
+ *
+ */
+class Pin {
+public:
+    /**
+     * @brief Pin <object>.
+     *
+     * @param object the object to keep alive, may be nullptr.
+     */
+    explicit Pin(HeapObject* object): object(object) {
+        if (object) object->pinCount++;
+    }
+
+    Pin(const Pin&) = delete;
+    Pin& operator=(const Pin&) = delete;
+
+    /**
+     * @brief Unpin the object.
+     *
+     */
+    ~Pin() {
+        if (object) object->pinCount--;
+    }
+
+private:
+    /**
+     * @brief The pinned object.
+     *
+     */
+    HeapObject* object;
+};
+
+
+/**
+ * @brief Releases everything allocated in the nursery while it is in
+ * scope, used around calls and statements.
+ *
+ */
+class NurseryRegion {
+public:
+    /**
+     * @brief Mark the current position of the nursery of <heap>.
+     *
+     * @param heap the heap.
+     */
+    explicit NurseryRegion(Heap& heap):
+        heap(heap), mark(heap.getNurseryMark()) {}
+
+    NurseryRegion(const NurseryRegion&) = delete;
+    NurseryRegion& operator=(const NurseryRegion&) = delete;
+
+    /**
+     * @brief Destroy all objects allocated in the region.
+     *
+     */
+    ~NurseryRegion() {
+        heap.releaseNursery(mark);
+    }
+
+    /**
+     * @brief Get the mark the region started at.
+     *
+     * @return const NurseryMark& the mark.
+     */
+    const NurseryMark& getMark() const {
+        return mark;
+    }
+
+private:
+    /**
+     * @brief The heap owning the nursery.
+     *
+     */
+    Heap& heap;
+
+    /**
+     * @brief The position of the nursery when the region started.
+     *
+     */
+    NurseryMark mark;
+};
+
+
+#endif
@@ -0,0 +1,263 @@
+#include <gtest/gtest.h>
+
+#include "gc.h"
+#include "parser.h"
+#include "compiler.h"
+#include "vm.h"
+
+
+ExpressionValue makeString(Heap& heap, const char* text) {
+    ExpressionValue value;
+    value.type = ExpressionValueType::STRING;
+    value.payloadObject = heap.allocate<StringObject>(text);
+
+    return value;
+}
+
+
+class TestRoots: public RootSet {
+public:
+    void traceRoots(Heap& heap) override {
+        for (auto it = values.begin(); it != values.end(); it++) {
+            it->trace(heap);
+        }
+    }
+
+    std::vector<ExpressionValue> values;
+};
+
+
+TEST(Heap, FreesUnreachableObjects) {
+    Heap heap;
+
+    makeString(heap, "a");
+    makeString(heap, "b");
+    ASSERT_GT(heap.getAllocatedBytes(), 0);
+
+    heap.collect();
+
+    auto& stats = heap.getStatistics();
+    ASSERT_EQ(stats.collections, 1);
+    ASSERT_EQ(stats.objectsAllocated, 2);
+    ASSERT_EQ(stats.objectsFreed, 2);
+    ASSERT_EQ(stats.bytesFreed, stats.bytesAllocated);
+    ASSERT_EQ(heap.getAllocatedBytes(), 0);
+}
+
+
+TEST(Heap, KeepsRoots) {
+    Heap heap;
+    TestRoots roots;
+
+    auto pinned = makeString(heap, "pinned");
+    auto rooted = makeString(heap, "rooted");
+    roots.values.push_back(makeString(heap, "in root set"));
+    makeString(heap, "garbage");
+
+    heap.addRoot(rooted.payloadObject);
+    heap.addRootSet(&roots);
+
+    {
+        Pin pin(pinned.payloadObject);
+        heap.collect();
+    }
+
+    ASSERT_EQ(heap.getStatistics().objectsFreed, 1);
+    ASSERT_STREQ(pinned.getString().c_str(), "pinned");
+    ASSERT_STREQ(rooted.getString().c_str(), "rooted");
+    ASSERT_STREQ(roots.values[0].getString().c_str(), "in root set");
+
+    heap.removeRoot(rooted.payloadObject);
+    heap.removeRootSet(&roots);
+    heap.collect();
+
+    ASSERT_EQ(heap.getStatistics().objectsFreed, 4);
+}
+
+
+TEST(Heap, TracesEnvironments) {
+    Heap heap;
+    Scope scope;
+    scope.declare(intern("x"));
+
+    auto outer = heap.allocate<Environment>(nullptr, scope);
+    auto inner = heap.allocate<Environment>(outer, scope);
+    outer->getSlot(0) = makeString(heap, "outer");
+    inner->setLocalVariable(intern("y"), makeString(heap, "inner"));
+    heap.allocate<Environment>(outer, scope);
+
+    heap.addRoot(inner);
+    heap.collect();
+
+    ASSERT_EQ(heap.getStatistics().objectsFreed, 1);
+    ASSERT_STREQ(inner->getVariable(intern("x")).getString().c_str(), "outer");
+    ASSERT_STREQ(inner->getVariable(intern("y")).getString().c_str(), "inner");
+
+    heap.removeRoot(inner);
+}
+
+
+TEST(Heap, CollectsAtSafepointOverLimit) {
+    Heap heap;
+    heap.setHeapLimit(256);
+
+    makeString(heap, "a");
+    heap.safepoint();
+    ASSERT_EQ(heap.getStatistics().collections, 0);
+
+    for (int i = 0; i < 4; i++) {
+        makeString(heap, "a string larger than the heap limit on its own");
+    }
+    heap.safepoint();
+
+    ASSERT_EQ(heap.getStatistics().collections, 1);
+    ASSERT_EQ(heap.getAllocatedBytes(), 0);
+}
+
+
+class GlobalHeapLimit {
+public:
+    GlobalHeapLimit(size_t bytes) {
+        Heap::global().setHeapLimit(bytes);
+    }
+
+    ~GlobalHeapLimit() {
+        Heap::global().setHeapLimit(Heap::DEFAULT_HEAP_LIMIT);
+    }
+};
+
+
+const char* garbageProgram =
+    "   f = FUN n, s {                                        "
+    "       IF n > 0 { t = s + \"x\"; (s + \"\") + f(n - 1, t) }"
+    "       ELSE { \"!\" }                                    "
+    "   }                                                     "
+    "   f(40, \"\")                                           ";
+
+std::string expectedGarbageResult() {
+    std::string result;
+
+    for (int i = 0; i < 40; i++) {
+        result += std::string(i, 'x');
+    }
+
+    return result + "!";
+}
+
+
+TEST(Heap, TreeEvaluatorKeepsLiveValues) {
+    GlobalHeapLimit limit(256);
+    auto collections = Heap::global().getStatistics().collections;
+
+    GlobalEnvironment globalEnv;
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(garbageProgram);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto program = parser->parseAll();
+
+    auto result = program->evaluate(&globalEnv);
+
+    ASSERT_GT(Heap::global().getStatistics().collections, collections);
+    ASSERT_EQ(result.type, ExpressionValueType::STRING);
+    ASSERT_EQ(result.getString(), expectedGarbageResult());
+}
+
+
+TEST(Heap, VirtualMachineKeepsLiveValues) {
+    GlobalHeapLimit limit(256);
+    auto collections = Heap::global().getStatistics().collections;
+
+    GlobalEnvironment globalEnv;
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(garbageProgram);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto program = parser->parseAll();
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*program);
+
+    VirtualMachine vm;
+    auto result = vm.run(*compiled, &globalEnv);
+
+    ASSERT_GT(Heap::global().getStatistics().collections, collections);
+    ASSERT_EQ(result.type, ExpressionValueType::STRING);
+    ASSERT_EQ(result.getString(), expectedGarbageResult());
+}
+
+
+TEST(Heap, NurseryIsReleasedToMark) {
+    Heap heap;
+
+    auto kept = heap.allocateYoung<StringObject>("kept");
+    auto mark = heap.getNurseryMark();
+
+    auto released = heap.allocateYoung<StringObject>("released");
+    ASSERT_TRUE(heap.isYoung(kept));
+    ASSERT_TRUE(heap.isYoungerThan(released, mark));
+    ASSERT_FALSE(heap.isYoungerThan(kept, mark));
+
+    heap.releaseNursery(mark);
+
+    ASSERT_EQ(heap.getNurseryMark().objects, 1);
+    ASSERT_EQ(heap.getNurseryMark().top, mark.top);
+    ASSERT_EQ(heap.getStatistics().youngObjectsAllocated, 2);
+    ASSERT_EQ(heap.getStatistics().objectsAllocated, 0);
+    ASSERT_STREQ(kept->value.c_str(), "kept");
+}
+
+
+TEST(Heap, FullNurseryFallsBackToHeap) {
+    Heap heap;
+    heap.setNurserySize(0);
+
+    auto object = heap.allocateYoung<StringObject>("old");
+
+    ASSERT_FALSE(heap.isYoung(object));
+    ASSERT_EQ(heap.getStatistics().objectsAllocated, 1);
+}
+
+
+TEST(Heap, StoredValuesArePromoted) {
+    GlobalEnvironment globalEnv;
+    NurseryRegion region(Heap::global());
+    auto promoted = Heap::global().getStatistics().objectsPromoted;
+
+    auto value = ExpressionValue::youngString("escapes");
+    ASSERT_TRUE(Heap::global().isYoung(value.payloadObject));
+
+    globalEnv.setVariable(intern("escaped"), value);
+    auto stored = globalEnv.getVariable(intern("escaped"));
+
+    ASSERT_FALSE(Heap::global().isYoung(stored.payloadObject));
+    ASSERT_EQ(stored.getString(), "escapes");
+    ASSERT_EQ(Heap::global().getStatistics().objectsPromoted, promoted + 1);
+}
+
+
+TEST(Heap, CallsReleaseTheirNursery) {
+    const char* program =
+        "   f = FUN n { IF n > 0 { s = \"a\" + \"b\"; f(n - 1) } ELSE { n } }"
+        "   f(20)                                                         ";
+
+    auto before = Heap::global().getNurseryMark();
+    auto young = Heap::global().getStatistics().youngObjectsAllocated;
+
+    GlobalEnvironment globalEnv;
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto parsed = parser->parseAll();
+
+    auto result = parsed->evaluate(&globalEnv);
+    ASSERT_EQ(result.payloadInt, 0);
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*parsed);
+
+    VirtualMachine vm;
+    result = vm.run(*compiled, &globalEnv);
+    ASSERT_EQ(result.payloadInt, 0);
+
+    ASSERT_GT(Heap::global().getStatistics().youngObjectsAllocated, young + 80);
+    ASSERT_EQ(Heap::global().getNurseryMark().objects, before.objects);
+}
@@ -1,113 +1,178 @@
 #include "input.h"
 
-
-FileInput::FileInput(std::string& filename) {
-    filestream.open(filename);
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+BufferInput::BufferInput():
+    begin(nullptr), position(nullptr), end(nullptr), currentLineNumber(1) {}
+
+void BufferInput::setBuffer(const char* begin, const char* end) {
+    this->begin = begin;
+    this->position = begin;
+    this->end = end;
     currentLineNumber = 1;
-    nextCharAdvLineNumber = false;
-    peeked = false;
-    pointer = -1;
-
-    advanceToNonEmptyLine();
 }
 
-FileInput::~FileInput() {
-    filestream.close();
+bool BufferInput::hasNext() const {
+    return position < end;
 }
 
-void FileInput::advanceToNonEmptyLine() {
-    hasNextChar = false;
-    while (std::getline(filestream, currentLine)) {
-        if (currentLine.length() > 0) {
-            hasNextChar = true;
-            break;
-        }
+char BufferInput::getNextChar() {
+    if (position >= end) {
+        return '\0';
     }
-}
 
-char FileInput::getNextChar() {
-    if (peeked) {
-        peeked = false;
-    } else {
-        if (nextCharAdvLineNumber) {
-            currentLineNumber++;
-            nextCharAdvLineNumber = false;
-        }
+    if (position > begin && position[-1] == '\n') {
+        currentLineNumber++;
+    }
 
-        pointer++;
-        nextChar = currentLine[pointer];
+    return *position++;
+}
 
-        if (pointer + 1 >= currentLine.length()) {
-            advanceToNonEmptyLine();
+char BufferInput::peekNextChar() {
+    return position < end ? *position : '\0';
+}
 
-            pointer = -1;
-            nextCharAdvLineNumber = true;
-        }
-    }
+int BufferInput::getCurrentLineNumber() const {
+    return currentLineNumber;
+}
 
-    return nextChar;
+const char* BufferInput::getCurrentPosition() const {
+    return position;
 }
 
-bool FileInput::hasNext() const {
-    return peeked || hasNextChar;
+const char* BufferInput::getEnd() const {
+    return end;
 }
 
-char FileInput::peekNextChar() {
-    if (!peeked) {
-        nextChar = getNextChar();
-        peeked = true;
+void BufferInput::skipTo(const char* position) {
+    if (position <= this->position) {
+        return;
     }
 
-    return nextChar;
-}
+    // Count the line breaks before every skipped character, like
+    // getNextChar would have
+    const char* from = this->position > begin ? this->position - 1 : begin;
+    currentLineNumber += static_cast<int>(std::count(from, position - 1, '\n'));
 
-int FileInput::getCurrentLineNumber() const {
-    return currentLineNumber;
+    this->position = position;
 }
 
 
-StringInput::StringInput(const char* input) {
-    this->input = std::string(input);
-    peeked = false;
-    pointer = -1;
+StringInput::StringInput() {}
+
+StringInput::StringInput(const char* input): input(input) {
+    setBuffer(this->input.data(), this->input.data() + this->input.size());
 }
 
-StringInput::StringInput(std::string& input) {
-    this->input = input;
-    peeked = false;
-    pointer = -1;
+StringInput::StringInput(std::string& input): input(input) {
+    setBuffer(this->input.data(), this->input.data() + this->input.size());
 }
 
-bool StringInput::hasNext() const {
-    return peeked || pointer + 1 < input.length();
+
+FileInput::FileInput(std::string& filename) {
+    std::ifstream filestream(filename, std::ios::binary);
+    std::ostringstream contents;
+
+    contents << filestream.rdbuf();
+    input = contents.str();
+
+    setBuffer(input.data(), input.data() + input.size());
 }
 
-char StringInput::getNextChar() {
-    if (peeked) {
-        peeked = false;
-        return nextChar;
+
+#ifdef _WIN32
+
+MappedFileInput::MappedFileInput(const std::string& filename):
+    data(nullptr), size(0), file(INVALID_HANDLE_VALUE), mapping(nullptr) {
+    file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::exception("Could not open script file");
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::exception("Could not read the size of the script file");
     }
-    
-    if (hasNext()) {
-        if (input[pointer] == '\n') {
-            currentLineNumber++;
+
+    size = static_cast<size_t>(fileSize.QuadPart);
+
+    // Mapping an empty file fails, there is nothing to serve anyway
+    if (size > 0) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            data = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
         }
 
-        pointer++;
+        if (!data) {
+            if (mapping) CloseHandle(mapping);
+            CloseHandle(file);
+            throw std::exception("Could not map script file");
+        }
     }
 
-    return input[pointer];
+    setBuffer(data, data + size);
 }
 
-char StringInput::peekNextChar() {
-    if (!peeked) {
-        nextChar = getNextChar();
-        peeked = true;
+MappedFileInput::~MappedFileInput() {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+#else
+
+MappedFileInput::MappedFileInput(const std::string& filename):
+    data(nullptr), size(0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        throw std::exception("Could not open script file");
     }
 
-    return nextChar;
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        throw std::exception("Could not read the size of the script file");
+    }
+
+    size = static_cast<size_t>(fileStat.st_size);
+
+    // Mapping an empty file fails, there is nothing to serve anyway
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped == MAP_FAILED) {
+            close(fd);
+            throw std::exception("Could not map script file");
+        }
+
+        data = static_cast<char*>(mapped);
+        madvise(mapped, size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+
+    setBuffer(data, data + size);
 }
 
-int StringInput::getCurrentLineNumber() const {
-    return currentLineNumber;
+MappedFileInput::~MappedFileInput() {
+    if (data) munmap(data, size);
 }
+
+#endif
@@ -2,8 +2,10 @@
 #define INPUT_H
 
 
+#include <cstddef>
 #include <string>
 #include <fstream>
+#include <sstream>
 
 
 /**
@@ -12,6 +14,13 @@
  */
 class Input {
 public:
+    /**
+     * @brief Destroy the Input object. Inputs are owned and deleted through
+     * pointers to this class.
+     * 
+     */
+    virtual ~Input() = default;
+
     /**
      * @brief Get the line number of the currently peeked/retrieved character.
      * 
@@ -43,45 +52,76 @@ public:
      * @return char the peeked character.
      */
     virtual char peekNextChar() = 0;
-};
 
+    /**
+     * @brief Get a pointer to the character which is retrieved by the next
+     * call to getNextChar. The characters of the input are contiguous and
+     * stay in place as long as the input exists, so tokens can refer to them.
+     * 
+     * @return const char* the position of the next character.
+     */
+    virtual const char* getCurrentPosition() const = 0;
 
-class FileInput : public Input {
-public:
     /**
-     * @brief Construct a new File Input from a file with name <filename>.
+     * @brief Get a pointer past the last character of the input.
      * 
-     * @param filename the filename of the file to open.
+     * @return const char* the end of the input.
      */
-    FileInput(std::string& filename);
+    virtual const char* getEnd() const = 0;
 
     /**
-     * @brief Destroy the File Input object.
+     * @brief Advance the input to <position> without retrieving the
+     * characters in between one by one.
      * 
+     * @param position a position between getCurrentPosition and getEnd.
      */
-    ~FileInput();
-    
-    
+    virtual void skipTo(const char* position) = 0;
+};
+
+
+/**
+ * @brief An input serving characters from a contiguous range in memory.
+ * 
+ * Besides retrieving single characters, the tokenizer can scan the range
+ * between getCurrentPosition and getEnd directly and then skip over the
+ * scanned characters with skipTo.
+ * 
+ */
+class BufferInput : public Input {
+public:
     int getCurrentLineNumber() const;
     bool hasNext() const;
     char getNextChar();
     char peekNextChar();
+    const char* getCurrentPosition() const;
+    const char* getEnd() const;
+    void skipTo(const char* position);
+
+protected:
+    /**
+     * @brief Construct a new BufferInput without characters. Derived
+     * classes call setBuffer once their characters are in place.
+     * 
+     */
+    BufferInput();
+
+    /**
+     * @brief Set the characters to serve, starting at the first one.
+     * 
+     * @param begin the first character.
+     * @param end the position after the last character.
+     */
+    void setBuffer(const char* begin, const char* end);
 
 private:
-    void advanceToNonEmptyLine();
-
-    std::ifstream filestream;
-    std::string currentLine;
-    char nextChar;
-    bool peeked;
-    bool hasNextChar;
-    bool nextCharAdvLineNumber;
-    int pointer;
+    const char* begin;
+    const char* position;
+    const char* end;
     int currentLineNumber;
 };
 
 
-class StringInput : public Input {
+class StringInput : public BufferInput {
 public:
     /**
      * @brief Construct a new StringInput from a C style string.
@@ -96,18 +136,80 @@ public:
      * @param input the input as C++ style string.
      */
     StringInput(std::string& input);
-    
-    int getCurrentLineNumber() const;
-    bool hasNext() const;
-    char getNextChar();
-    char peekNextChar();
 
-private:
+protected:
+    /**
+     * @brief Construct a new empty StringInput.
+     * 
+     */
+    StringInput();
+
     std::string input;
-    bool peeked;
-    char nextChar;
-    int pointer;
-    int currentLineNumber;
+};
+
+
+/**
+ * @brief An input reading a whole file into memory up front.
+ * 
+ */
+class FileInput : public StringInput {
+public:
+    /**
+     * @brief Construct a new File Input from a file with name <filename>.
+     * 
+     * @param filename the filename of the file to open.
+     */
+    FileInput(std::string& filename);
+};
+
+
+/**
+ * @brief An input mapping a whole file into memory.
+ * 
+ * The file is not copied, its pages are read by the operating system when
+ * the tokenizer first touches them. This is the fastest way to load large
+ * scripts.
+ * 
+ */
+class MappedFileInput : public BufferInput {
+public:
+    /**
+     * @brief Map the file with name <filename>.
+     * 
+     * @param filename the filename of the file to map.
+     */
+    MappedFileInput(const std::string& filename);
+
+    MappedFileInput(const MappedFileInput&) = delete;
+    MappedFileInput& operator=(const MappedFileInput&) = delete;
+
+    /**
+     * @brief Unmap the file.
+     * 
+     */
+    ~MappedFileInput();
+
+private:
+    /**
+     * @brief The first character of the mapping, nullptr for an empty file.
+     * 
+     */
+    char* data;
+
+    /**
+     * @brief The size of the file in bytes.
+     * 
+     */
+    size_t size;
+
+#ifdef _WIN32
+    /**
+     * @brief The handles of the file and the mapping object.
+     * 
+     */
+    void* file;
+    void* mapping;
+#endif
 };
 
 
@@ -1,5 +1,9 @@
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+
 #include "input.h"
 
 
@@ -15,3 +19,73 @@ TEST(StringInput, CheckInit) {
     ASSERT_TRUE(input.hasNext());
     ASSERT_EQ(input.getNextChar(), 'p');
 }
+
+
+TEST(StringInput, SkipToCountsLines) {
+    StringInput input(std::string("ab\ncd\n\nef"));
+    const char* position = input.getCurrentPosition();
+
+    ASSERT_EQ(input.getEnd() - position, 9);
+
+    input.skipTo(position + 7);
+    ASSERT_EQ(input.getNextChar(), 'e');
+    ASSERT_EQ(input.getCurrentLineNumber(), 4);
+    ASSERT_EQ(input.getNextChar(), 'f');
+    ASSERT_FALSE(input.hasNext());
+    ASSERT_EQ(input.peekNextChar(), '\0');
+}
+
+
+/**
+ * @brief Write <contents> to a file in the test directory.
+ * 
+ * @param name the name of the file.
+ * @param contents the characters to write.
+ * @return std::string the path of the file.
+ */
+std::string writeTestFile(const char* name, const char* contents) {
+    const char* directory = std::getenv("TEST_TMPDIR");
+    std::string path = std::string(directory ? directory : ".") + "/" + name;
+
+    std::ofstream file(path, std::ios::binary);
+    file << contents;
+
+    return path;
+}
+
+
+TEST(MappedFileInput, ReadsWholeFile) {
+    auto path = writeTestFile("mapped.npn", "print(1)\nx");
+
+    {
+        MappedFileInput input(path);
+
+        ASSERT_EQ(input.getEnd() - input.getCurrentPosition(), 10);
+        ASSERT_EQ(input.getNextChar(), 'p');
+        ASSERT_EQ(input.peekNextChar(), 'r');
+
+        input.skipTo(input.getEnd() - 1);
+        ASSERT_EQ(input.getNextChar(), 'x');
+        ASSERT_EQ(input.getCurrentLineNumber(), 2);
+        ASSERT_FALSE(input.hasNext());
+    }
+
+    std::remove(path.c_str());
+}
+
+
+TEST(MappedFileInput, EmptyFile) {
+    auto path = writeTestFile("empty.npn", "");
+
+    {
+        MappedFileInput input(path);
+        ASSERT_FALSE(input.hasNext());
+    }
+
+    std::remove(path.c_str());
+}
+
+
+TEST(MappedFileInput, MissingFile) {
+    ASSERT_ANY_THROW(MappedFileInput input(std::string("does-not-exist.npn")));
+}
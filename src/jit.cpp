@@ -0,0 +1,637 @@
+#include "jit.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "bytecode.h"
+#include "program.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+std::unique_ptr<MachineCode> MachineCode::load(
+        const std::vector<uint8_t>& code) {
+#ifdef _WIN32
+    void* pages = VirtualAlloc(nullptr, code.size(), MEM_COMMIT | MEM_RESERVE,
+        PAGE_READWRITE);
+    if (!pages) {
+        return nullptr;
+    }
+
+    std::memcpy(pages, code.data(), code.size());
+
+    DWORD oldProtection;
+    if (!VirtualProtect(pages, code.size(), PAGE_EXECUTE_READ,
+            &oldProtection)) {
+        VirtualFree(pages, 0, MEM_RELEASE);
+        return nullptr;
+    }
+
+    FlushInstructionCache(GetCurrentProcess(), pages, code.size());
+#else
+    void* pages = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (pages == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::memcpy(pages, code.data(), code.size());
+
+    // The pages are never writable and executable at the same time
+    if (mprotect(pages, code.size(), PROT_READ | PROT_EXEC) != 0) {
+        munmap(pages, code.size());
+        return nullptr;
+    }
+#endif
+
+    return std::unique_ptr<MachineCode>(new MachineCode(pages, code.size()));
+}
+
+MachineCode::MachineCode(void* pages, size_t size):
+    pages(pages), size(size) {}
+
+MachineCode::~MachineCode() {
+#ifdef _WIN32
+    VirtualFree(pages, 0, MEM_RELEASE);
+#else
+    munmap(pages, size);
+#endif
+}
+
+MachineCode::Entry MachineCode::getEntry() const {
+    return reinterpret_cast<Entry>(pages);
+}
+
+
+JitCompiler::JitCompiler(const Program& program,
+        const CustomFunction& function):
+    program(program), function(function) {}
+
+bool JitCompiler::compileFunction(size_t stackBudget) {
+    uint32_t argCount = function.getParameterScope().size();
+
+    // Entry point: push rbp; mov r10, rsp
+    emit({ 0x55, 0x49, 0x89, 0xE2 });
+#ifdef _WIN32
+    // mov r9, rcx; mov r11d, edx
+    emit({ 0x49, 0x89, 0xC9, 0x41, 0x89, 0xD3 });
+#else
+    // mov r9, rdi; mov r11d, esi
+    emit({ 0x49, 0x89, 0xF9, 0x41, 0x89, 0xF3 });
+#endif
+
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        // mov eax, [r9 + 4 * slot]; push rax
+        emit({ 0x41, 0x8B, 0x81 });
+        emit32(slot * sizeof(int32_t));
+        emit({ 0x50 });
+    }
+
+    // call body; add rsp, 8 * argCount; pop rbp; mov eax, eax; ret
+    emit({ 0xE8 });
+    size_t callBody = code.size();
+    emit32(0);
+    emit({ 0x48, 0x81, 0xC4 });
+    emit32(argCount * 8);
+    emit({ 0x5D, 0x89, 0xC0, 0xC3 });
+
+    // Bailout: mov rsp, r10; pop rbp; mov rax, -1; ret
+    bailout = code.size();
+    emit({ 0x4C, 0x89, 0xD4, 0x5D, 0x48, 0xC7, 0xC0, 0xFF, 0xFF, 0xFF, 0xFF,
+        0xC3 });
+
+    // Too deep: mov rsp, r10; pop rbp; mov rax, -2; ret
+    tooDeep = code.size();
+    emit({ 0x4C, 0x89, 0xD4, 0x5D, 0x48, 0xC7, 0xC0, 0xFE, 0xFF, 0xFF, 0xFF,
+        0xC3 });
+
+    // Body: push rbp; mov rbp, rsp; inc r11d; cmp r11d, maxDepth; ja tooDeep
+    body = code.size();
+    emit({ 0x55, 0x48, 0x89, 0xE5, 0x41, 0xFF, 0xC3, 0x41, 0x81, 0xFB });
+    size_t depthLimit = code.size();
+    emit32(0);
+    emit({ 0x0F, 0x87 });
+    emitRelative(tooDeep);
+
+    start = code.size();
+    if (!compile(function.getBody())) {
+        return false;
+    }
+
+    // A nested call pushes its arguments, the return address and rbp, the
+    // arguments are counted with the operands of the caller
+    size_t frameSize = 16 + 8 * static_cast<size_t>(maxPushed);
+    maxDepth = static_cast<uint32_t>(std::min<size_t>(
+        std::max<size_t>(stackBudget / frameSize, 1), INT32_MAX));
+    std::memcpy(&code[depthLimit], &maxDepth, sizeof(maxDepth));
+
+    // dec r11d; mov rsp, rbp; pop rbp; ret
+    emit({ 0x41, 0xFF, 0xCB, 0x48, 0x89, 0xEC, 0x5D, 0xC3 });
+
+    uint32_t offset = static_cast<uint32_t>(body - (callBody + 4));
+    std::memcpy(&code[callBody], &offset, sizeof(offset));
+
+    return true;
+}
+
+bool JitCompiler::compile(NodeId id) {
+    return program.get(id).compileNative(*this);
+}
+
+void JitCompiler::loadConstant(int value) {
+    // mov eax, value
+    emit({ 0xB8 });
+    emit32(static_cast<uint32_t>(value));
+}
+
+bool JitCompiler::loadParameter(SymbolId name) {
+    uint32_t slot;
+
+    if (!function.getParameterScope().find(name, slot)) {
+        return false;
+    }
+
+    // mov eax, [rbp + offset]
+    emit({ 0x8B, 0x85 });
+    emit32(parameterOffset(slot));
+
+    return true;
+}
+
+void JitCompiler::pushOperand() {
+    // push rax
+    emit({ 0x50 });
+
+    pushed++;
+    maxPushed = std::max(maxPushed, pushed);
+}
+
+void JitCompiler::operate(OpCode op) {
+    // mov ecx, eax; pop rax
+    emit({ 0x89, 0xC1, 0x58 });
+    pushed--;
+
+    uint8_t condition;
+    switch (op) {
+        case OpCode::ADD:
+            emit({ 0x01, 0xC8 });
+            return;
+        case OpCode::SUBTRACT:
+            emit({ 0x29, 0xC8 });
+            return;
+        case OpCode::MULTIPLY:
+            emit({ 0x0F, 0xAF, 0xC1 });
+            return;
+        case OpCode::DIVIDE:
+            // test ecx, ecx; jz bailout
+            emit({ 0x85, 0xC9, 0x0F, 0x84 });
+            emitRelative(bailout);
+            // Dividing by -1 negates, idiv would trap for INT_MIN:
+            // cmp ecx, -1; jne +4; neg eax; jmp +3; cdq; idiv ecx
+            emit({ 0x83, 0xF9, 0xFF, 0x75, 0x04, 0xF7, 0xD8, 0xEB, 0x03,
+                0x99, 0xF7, 0xF9 });
+            return;
+        case OpCode::EQUALS:
+            condition = 0x94;
+            break;
+        case OpCode::NOT_EQUALS:
+            condition = 0x95;
+            break;
+        case OpCode::GREATER:
+            condition = 0x9F;
+            break;
+        case OpCode::GREATER_OR_EQUALS:
+            condition = 0x9D;
+            break;
+        case OpCode::LESS:
+            condition = 0x9C;
+            break;
+        case OpCode::LESS_OR_EQUALS:
+            condition = 0x9E;
+            break;
+        default:
+            throw std::exception("Unknown instruction");
+    }
+
+    // cmp eax, ecx; setcc al; movzx eax, al
+    emit({ 0x39, 0xC8, 0x0F, condition, 0xC0, 0x0F, 0xB6, 0xC0 });
+}
+
+size_t JitCompiler::jumpIfEquals(int value) {
+    // cmp eax, value; je
+    emit({ 0x3D });
+    emit32(static_cast<uint32_t>(value));
+    emit({ 0x0F, 0x84 });
+
+    size_t jump = code.size();
+    emit32(0);
+
+    return jump;
+}
+
+size_t JitCompiler::jump() {
+    emit({ 0xE9 });
+
+    size_t jump = code.size();
+    emit32(0);
+
+    return jump;
+}
+
+void JitCompiler::bind(size_t jump) {
+    uint32_t offset = static_cast<uint32_t>(code.size() - (jump + 4));
+    std::memcpy(&code[jump], &offset, sizeof(offset));
+}
+
+bool JitCompiler::call(SymbolId name, const std::vector<NodeId>& arguments,
+        bool tailCall) {
+    auto& parameterScope = function.getParameterScope();
+    uint32_t slot;
+
+    if (parameterScope.find(name, slot)
+            || parameterScope.size() != arguments.size()) {
+        return false;
+    }
+
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        if (!compile(*it)) {
+            return false;
+        }
+
+        pushOperand();
+    }
+
+    if (std::find(callees.begin(), callees.end(), name) == callees.end()) {
+        callees.push_back(name);
+    }
+
+    if (tailCall) {
+        // The arguments replace the parameters, pop rax; mov [rbp + offset],
+        // eax for each, then jmp start
+        for (size_t argument = arguments.size(); argument-- > 0;) {
+            emit({ 0x58, 0x89, 0x85 });
+            emit32(parameterOffset(static_cast<uint32_t>(argument)));
+            pushed--;
+        }
+
+        emit({ 0xE9 });
+        emitRelative(start);
+
+        return true;
+    }
+
+    nestedCalls++;
+
+    // call body; add rsp, 8 * argCount
+    emit({ 0xE8 });
+    emitRelative(body);
+    emit({ 0x48, 0x81, 0xC4 });
+    emit32(static_cast<uint32_t>(arguments.size() * 8));
+    pushed -= static_cast<uint32_t>(arguments.size());
+
+    return true;
+}
+
+const std::vector<uint8_t>& JitCompiler::getCode() const {
+    return code;
+}
+
+const std::vector<SymbolId>& JitCompiler::getCallees() const {
+    return callees;
+}
+
+uint32_t JitCompiler::getNestedCalls() const {
+    return nestedCalls;
+}
+
+uint32_t JitCompiler::getMaxDepth() const {
+    return maxDepth;
+}
+
+void JitCompiler::emit(std::initializer_list<uint8_t> bytes) {
+    code.insert(code.end(), bytes);
+}
+
+void JitCompiler::emit32(uint32_t value) {
+    for (int byte = 0; byte < 4; byte++) {
+        code.push_back(static_cast<uint8_t>(value >> (8 * byte)));
+    }
+}
+
+void JitCompiler::emitRelative(size_t target) {
+    emit32(static_cast<uint32_t>(target - (code.size() + 4)));
+}
+
+uint32_t JitCompiler::parameterOffset(uint32_t slot) const {
+    // Above the saved rbp and the return address, pushed in order
+    uint32_t argCount = function.getParameterScope().size();
+
+    return 16 + 8 * (argCount - 1 - slot);
+}
+
+
+uint32_t JitFunction::threshold = JitFunction::DEFAULT_THRESHOLD;
+size_t JitFunction::stackBudget = JitFunction::DEFAULT_STACK_BUDGET;
+JitStatistics JitFunction::statistics;
+
+JitFunction::JitFunction(const Program& program,
+        const CustomFunction& function):
+    program(program), function(function) {}
+
+bool JitFunction::run(const Function* self, const ExpressionValue* arguments,
+        Environment* caller, size_t maxDepth, ExpressionValue& result) {
+    if (interpreted || threshold == 0) {
+        return false;
+    }
+
+    if (!code) {
+        if (++calls < threshold) {
+            return false;
+        }
+
+        if (!compile()) {
+            interpreted = true;
+            statistics.rejected++;
+
+            return false;
+        }
+    }
+
+    if (interpretedCalls > 0) {
+        interpretedCalls--;
+
+        return false;
+    }
+
+    for (size_t slot = 0; slot < intArguments.size(); slot++) {
+        if (arguments[slot].type != ExpressionValueType::INT) {
+            return false;
+        }
+
+        intArguments[slot] = arguments[slot].payloadInt;
+    }
+
+    if (!checkCallees(self, caller)) {
+        return false;
+    }
+
+    uint32_t depth = maxDepth < nativeDepth
+        ? static_cast<uint32_t>(maxDepth) : nativeDepth;
+    uint64_t value = code->getEntry()(intArguments.data(),
+        nativeDepth - depth);
+
+    if (value == TOO_DEEP) {
+        // The interpreter recurses in frames of its own, the calls nested in
+        // this one get back to the code once it has its whole budget again
+        interpretedCalls = nativeDepth;
+        statistics.tooDeep++;
+
+        return false;
+    }
+
+    if (value == BAILOUT) {
+        // Nothing the code did is visible, the interpreter starts over
+        code.reset();
+        interpreted = true;
+        statistics.deoptimized++;
+
+        return false;
+    }
+
+    statistics.calls++;
+    result = ExpressionValue(static_cast<int>(static_cast<uint32_t>(value)));
+
+    return true;
+}
+
+bool JitFunction::isEnabled() {
+    return threshold > 0;
+}
+
+void JitFunction::setThreshold(uint32_t threshold) {
+    JitFunction::threshold = threshold;
+}
+
+void JitFunction::setStackBudget(size_t stackBudget) {
+    JitFunction::stackBudget = stackBudget;
+}
+
+const JitStatistics& JitFunction::getStatistics() {
+    return statistics;
+}
+
+void JitFunction::resetStatistics() {
+    statistics = JitStatistics();
+}
+
+bool JitFunction::compile() {
+#ifdef JIT_X86_64
+    JitCompiler compiler(program, function);
+
+    if (!compiler.compileFunction(stackBudget)) {
+        return false;
+    }
+
+    if (function.isMemoized() && compiler.getNestedCalls() > 1) {
+        return false;
+    }
+
+    code = MachineCode::load(compiler.getCode());
+    if (!code) {
+        return false;
+    }
+
+    nativeDepth = compiler.getMaxDepth();
+    callees = compiler.getCallees();
+    calleeCaches.resize(callees.size());
+    intArguments.resize(function.getParameterScope().size());
+    statistics.compiled++;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool JitFunction::checkCallees(const Function* self, Environment* caller) {
+    for (size_t i = 0; i < callees.size(); i++) {
+        ExpressionValue callee;
+
+        try {
+            callee = caller->getVariable(callees[i], calleeCaches[i]);
+        } catch (const std::exception&) {
+            // Left for the interpreter to report if the call is made
+            return false;
+        }
+
+        if (callee.type != ExpressionValueType::FUNCTION
+                || callee.getFunction().get() != self) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool Expression::compileNative(JitCompiler& jit) const {
+    return false;
+}
+
+
+bool Literal::compileNative(JitCompiler& jit) const {
+    if (value.type != ExpressionValueType::INT) {
+        return false;
+    }
+
+    jit.loadConstant(value.payloadInt);
+
+    return true;
+}
+
+
+bool Name::compileNative(JitCompiler& jit) const {
+    return jit.loadParameter(name);
+}
+
+
+bool BinaryOperation::compileNativeOperation(JitCompiler& jit,
+        OpCode op) const {
+    if (!jit.compile(left)) {
+        return false;
+    }
+
+    jit.pushOperand();
+
+    if (!jit.compile(right)) {
+        return false;
+    }
+
+    jit.operate(op);
+
+    return true;
+}
+
+bool Addition::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::ADD);
+}
+
+bool Subtraction::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::SUBTRACT);
+}
+
+bool Multiplication::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::MULTIPLY);
+}
+
+bool Division::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::DIVIDE);
+}
+
+bool EqualComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::EQUALS);
+}
+
+bool GreaterThanComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::GREATER);
+}
+
+bool GreaterThanOrEqualComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::GREATER_OR_EQUALS);
+}
+
+bool LessThanComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::LESS);
+}
+
+bool LessThanOrEqualComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::LESS_OR_EQUALS);
+}
+
+bool NotEqualComparison::compileNative(JitCompiler& jit) const {
+    return compileNativeOperation(jit, OpCode::NOT_EQUALS);
+}
+
+
+bool AndConnective::compileNative(JitCompiler& jit) const {
+    if (!jit.compile(left)) {
+        return false;
+    }
+
+    size_t shortCircuit = jit.jumpIfEquals(0);
+
+    if (!jit.compile(right)) {
+        return false;
+    }
+
+    jit.bind(shortCircuit);
+
+    return true;
+}
+
+
+bool OrConnective::compileNative(JitCompiler& jit) const {
+    if (!jit.compile(left)) {
+        return false;
+    }
+
+    size_t shortCircuit = jit.jumpIfEquals(1);
+
+    if (!jit.compile(right)) {
+        return false;
+    }
+
+    jit.bind(shortCircuit);
+
+    return true;
+}
+
+
+bool Block::compileNative(JitCompiler& jit) const {
+    if (needsEnvironment || exprList.empty()) {
+        return false;
+    }
+
+    // Every expression overwrites the value of the one before
+    for (auto it = exprList.begin(); it != exprList.end(); it++) {
+        if (!jit.compile(*it)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+bool IfStatement::compileNative(JitCompiler& jit) const {
+    // Without an ELSE the value may be no INT
+    if (elseBlock == NO_NODE || !jit.compile(condition)) {
+        return false;
+    }
+
+    size_t toElse = jit.jumpIfEquals(0);
+
+    if (!jit.compile(ifBlock)) {
+        return false;
+    }
+
+    size_t toEnd = jit.jump();
+    jit.bind(toElse);
+
+    if (!jit.compile(elseBlock)) {
+        return false;
+    }
+
+    jit.bind(toEnd);
+
+    return true;
+}
+
+
+bool Invocation::compileNative(JitCompiler& jit) const {
+    return jit.call(functionName, arguments, tailCall);
+}
@@ -0,0 +1,588 @@
+#ifndef JIT_H
+#define JIT_H
+
+
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "expressions.h"
+
+
+// Machine code is only generated for x86-64, elsewhere every function stays
+// interpreted
+#if defined(__x86_64__) || defined(_M_X64)
+#define JIT_X86_64
+#endif
+
+
+/**
+ * @brief Counters describing the work of the JIT.
+ *
+ */
+struct JitStatistics {
+    /**
+     * @brief The number of functions compiled to machine code.
+     *
+     */
+    uint64_t compiled = 0;
+
+    /**
+     * @brief The number of hot functions whose body could not be compiled.
+     *
+     */
+    uint64_t rejected = 0;
+
+    /**
+     * @brief The number of calls entering machine code from an interpreter.
+     *
+     */
+    uint64_t calls = 0;
+
+    /**
+     * @brief The number of functions whose machine code bailed out and was
+     * discarded.
+     *
+     */
+    uint64_t deoptimized = 0;
+
+    /**
+     * @brief The number of calls that recursed deeper than the stack budget
+     * of the machine code and continued in the interpreter.
+     *
+     */
+    uint64_t tooDeep = 0;
+};
+
+
+/**
+ * @brief Executable pages holding the machine code of one function.
+ *
+ */
+class MachineCode {
+public:
+    /**
+     * @brief The signature of the entry point.
+     *
+     * The arguments are read from an array of ints. <depth> is the number of
+     * nested calls already used up out of the maximum depth compiled into
+     * the code. The result is returned in the lower 32 bits, or
+     * JitFunction::BAILOUT or JitFunction::TOO_DEEP.
+     *
+     */
+    typedef uint64_t (*Entry)(const int32_t* arguments, uint32_t depth);
+
+    /**
+     * @brief Copy machine code into new executable pages.
+     *
+     * @param code the machine code, starting with the entry point.
+     * @return std::unique_ptr<MachineCode> the pages, nullptr if they could
+     * not be allocated.
+     */
+    static std::unique_ptr<MachineCode> load(const std::vector<uint8_t>& code);
+
+    MachineCode(const MachineCode&) = delete;
+    MachineCode& operator=(const MachineCode&) = delete;
+
+    /**
+     * @brief Destroy the Machine Code object, unmapping its pages.
+     *
+     */
+    ~MachineCode();
+
+    /**
+     * @brief Get the entry point of the code.
+     *
+     * @return Entry the entry point.
+     */
+    Entry getEntry() const;
+
+private:
+    /**
+     * @brief Construct a new Machine Code object owning mapped pages.
+     *
+     * @param pages the start of the pages.
+     * @param size the size of the pages in bytes.
+     */
+    MachineCode(void* pages, size_t size);
+
+    /**
+     * @brief The start of the pages.
+     *
+     */
+    void* pages;
+
+    /**
+     * @brief The size of the pages in bytes.
+     *
+     */
+    size_t size;
+};
+
+
+/**
+ * @brief Translates the body of a CustomFunction into x86-64 machine code.
+ *
+ * Only bodies computing on INTs are supported: INT literals, the parameters,
+ * arithmetic, comparisons, connectives, blocks without variables, IFs with
+ * an ELSE and calls of the function itself. Every expression emits its code
+ * through compileNative, leaving its value in eax. Operands are kept on the
+ * machine stack while the other operand is computed.
+ *
+ * Self calls call the compiled body directly, self tail calls jump back to
+ * its start. The code uses no registers the calling convention requires to
+ * be preserved except rbp, which the entry point saves, and calls nothing
+ * outside the code, so it works with the System V and the Windows calling
+ * conventions alike. A division by zero bails out: the entry point returns
+ * JitFunction::BAILOUT straight from any depth. Recursing deeper than the
+ * stack budget returns JitFunction::TOO_DEEP the same way.
+ *
+ */
+class JitCompiler {
+public:
+    /**
+     * @brief Construct a new Jit Compiler object.
+     *
+     * @param program the program holding the body.
+     * @param function the function to compile.
+     */
+    JitCompiler(const Program& program, const CustomFunction& function);
+
+    /**
+     * @brief Compile the body of the function, preceded by the entry point.
+     *
+     * @param stackBudget the bytes of C++ stack the nested calls of the code
+     * may use, which limits the depth of its recursion.
+     * @return true if the body was compiled, see getCode.
+     * @return false if the JIT does not support it.
+     */
+    bool compileFunction(size_t stackBudget);
+
+    /**
+     * @brief Emit the machine code for an expression of the body.
+     *
+     * @param id the id of the expression.
+     * @return true if the expression was compiled.
+     * @return false if the JIT does not support it.
+     */
+    bool compile(NodeId id);
+
+    /**
+     * @brief Load an INT constant.
+     *
+     * @param value the constant.
+     */
+    void loadConstant(int value);
+
+    /**
+     * @brief Load a parameter of the function.
+     *
+     * @param name the name of the parameter.
+     * @return true if the value was loaded.
+     * @return false if <name> is no parameter.
+     */
+    bool loadParameter(SymbolId name);
+
+    /**
+     * @brief Push the value just computed, the left operand of an operation.
+     *
+     */
+    void pushOperand();
+
+    /**
+     * @brief Combine the pushed left operand with the value just computed.
+     *
+     * @param op the operation, one of the generic arithmetic and comparison
+     * instructions of the bytecode like ADD or LESS.
+     */
+    void operate(OpCode op);
+
+    /**
+     * @brief Jump if the value just computed is <value>.
+     *
+     * @param value the value to compare with.
+     * @return size_t the jump, to be passed to bind.
+     */
+    size_t jumpIfEquals(int value);
+
+    /**
+     * @brief Jump unconditionally.
+     *
+     * @return size_t the jump, to be passed to bind.
+     */
+    size_t jump();
+
+    /**
+     * @brief Let a jump continue at the code emitted next.
+     *
+     * @param jump the jump returned by jumpIfEquals or jump.
+     */
+    void bind(size_t jump);
+
+    /**
+     * @brief Call the function being compiled. Whether the name refers to it
+     * is checked by JitFunction before entering the code.
+     *
+     * @param name the name of the function called.
+     * @param arguments the arguments of the call.
+     * @param tailCall whether the call replaces the calling function.
+     * @return true if the call was compiled.
+     * @return false if an argument is not supported, <name> is a parameter
+     * or the number of arguments is wrong.
+     */
+    bool call(SymbolId name, const std::vector<NodeId>& arguments,
+        bool tailCall);
+
+    /**
+     * @brief Get the compiled machine code.
+     *
+     * @return const std::vector<uint8_t>& the code.
+     */
+    const std::vector<uint8_t>& getCode() const;
+
+    /**
+     * @brief Get the names called by the body.
+     *
+     * @return const std::vector<SymbolId>& the names, each listed once.
+     */
+    const std::vector<SymbolId>& getCallees() const;
+
+    /**
+     * @brief Get the number of calls in the body that are no tail calls.
+     *
+     * @return uint32_t the number of calls.
+     */
+    uint32_t getNestedCalls() const;
+
+    /**
+     * @brief Get the number of nested calls the code may make within its
+     * stack budget.
+     *
+     * @return uint32_t the maximum depth, at least 1.
+     */
+    uint32_t getMaxDepth() const;
+
+private:
+    /**
+     * @brief Append bytes to the code.
+     *
+     * @param bytes the bytes.
+     */
+    void emit(std::initializer_list<uint8_t> bytes);
+
+    /**
+     * @brief Append a 32 bit value to the code.
+     *
+     * @param value the value, stored little endian.
+     */
+    void emit32(uint32_t value);
+
+    /**
+     * @brief Append the 32 bit offset from the end of the offset to
+     * <target>, e.g. of a call.
+     *
+     * @param target the position in the code.
+     */
+    void emitRelative(size_t target);
+
+    /**
+     * @brief Get the offset of parameter <slot> from rbp in the body.
+     *
+     * @param slot the slot of the parameter.
+     * @return uint32_t the offset.
+     */
+    uint32_t parameterOffset(uint32_t slot) const;
+
+    /**
+     * @brief The program holding the body.
+     *
+     */
+    const Program& program;
+
+    /**
+     * @brief The function being compiled.
+     *
+     */
+    const CustomFunction& function;
+
+    /**
+     * @brief The machine code emitted so far.
+     *
+     */
+    std::vector<uint8_t> code;
+
+    /**
+     * @brief The position of the code returning JitFunction::BAILOUT.
+     *
+     */
+    size_t bailout = 0;
+
+    /**
+     * @brief The position of the code returning JitFunction::TOO_DEEP.
+     *
+     */
+    size_t tooDeep = 0;
+
+    /**
+     * @brief The position of the body, called by self calls.
+     *
+     */
+    size_t body = 0;
+
+    /**
+     * @brief The position after the prologue of the body, where self tail
+     * calls jump to.
+     *
+     */
+    size_t start = 0;
+
+    /**
+     * @brief The names called by the body.
+     *
+     */
+    std::vector<SymbolId> callees;
+
+    /**
+     * @brief The number of calls that are no tail calls.
+     *
+     */
+    uint32_t nestedCalls = 0;
+
+    /**
+     * @brief The number of operands currently pushed by the body.
+     *
+     */
+    uint32_t pushed = 0;
+
+    /**
+     * @brief The largest number of operands the body pushes at once, which
+     * with the return address and rbp makes up the frame of a nested call.
+     *
+     */
+    uint32_t maxPushed = 0;
+
+    /**
+     * @brief The number of nested calls the code may make.
+     *
+     */
+    uint32_t maxDepth = 0;
+};
+
+
+/**
+ * @brief The JIT state of a CustomFunction: counts its calls and runs hot
+ * calls as machine code.
+ *
+ * Once a function was called <threshold> times, its body is compiled with
+ * the JitCompiler. Calls whose arguments are all INTs then run as machine
+ * code, other calls stay interpreted. Before entering the code, every name
+ * the body calls is looked up from the environment the function was defined
+ * in and must refer to the function itself, which holds for all nested calls
+ * as the environments between only bind parameters.
+ *
+ * The compiled bodies have no side effects, so a call that bails out is
+ * simply evaluated again by the interpreter, which reports the error. The
+ * machine code is discarded then and the function stays interpreted.
+ *
+ * Nested calls of the machine code run on the C++ stack, so they may only
+ * use the stack budget, which keeps deep scripts working on threads with
+ * small stacks. A call recursing deeper is evaluated again as well, and
+ * the interpreter makes the calls in frames of its own. The calls nested
+ * in it are interpreted too, until they are deep enough to give the code
+ * its whole budget again, while the machine code is kept. Memoized functions calling themselves more than once
+ * stay interpreted as well, as their machine code would repeat the calls
+ * the memo table saves.
+ *
+ */
+class JitFunction {
+public:
+    /**
+     * @brief The default number of calls after which a function is compiled.
+     *
+     */
+    static const uint32_t DEFAULT_THRESHOLD = 1000;
+
+    /**
+     * @brief The default number of bytes of C++ stack the nested calls of
+     * machine code may use.
+     *
+     */
+    static const size_t DEFAULT_STACK_BUDGET = 16 * 1024;
+
+    /**
+     * @brief The value returned by the entry point if the code bailed out.
+     *
+     */
+    static const uint64_t BAILOUT = UINT64_MAX;
+
+    /**
+     * @brief The value returned by the entry point if the code recursed
+     * deeper than its stack budget allows.
+     *
+     */
+    static const uint64_t TOO_DEEP = UINT64_MAX - 1;
+
+    /**
+     * @brief Construct a new Jit Function object.
+     *
+     * @param program the program holding the body.
+     * @param function the function to compile. Must outlive its calls.
+     */
+    JitFunction(const Program& program, const CustomFunction& function);
+
+    /**
+     * @brief Count a call and run it as machine code if the function is hot.
+     *
+     * @param self the function called, <function> or the CompiledFunction
+     * compiled from it.
+     * @param arguments the arguments of the call.
+     * @param caller the parent of the environment of the call, where the
+     * names the body calls are looked up.
+     * @param maxDepth the number of nested calls allowed, including this one.
+     * @param result set to the value of the call if it ran as machine code.
+     * @return true if the call ran as machine code.
+     * @return false if it has to be interpreted.
+     */
+    bool run(const Function* self, const ExpressionValue* arguments,
+        Environment* caller, size_t maxDepth, ExpressionValue& result);
+
+    /**
+     * @brief Check whether hot functions are compiled at all.
+     *
+     * @return true if the threshold is larger than 0.
+     * @return false otherwise.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Set the number of calls after which a function is compiled. 0
+     * turns the JIT off.
+     *
+     * @param threshold the number of calls.
+     */
+    static void setThreshold(uint32_t threshold);
+
+    /**
+     * @brief Set the bytes of C++ stack the nested calls of machine code may
+     * use, for the functions compiled from then on.
+     *
+     * @param stackBudget the number of bytes.
+     */
+    static void setStackBudget(size_t stackBudget);
+
+    /**
+     * @brief Get the counters of all functions.
+     *
+     * @return const JitStatistics& the statistics.
+     */
+    static const JitStatistics& getStatistics();
+
+    /**
+     * @brief Reset the counters of all functions to 0.
+     *
+     */
+    static void resetStatistics();
+
+private:
+    /**
+     * @brief Compile the body of the function.
+     *
+     * @return true if the code is ready to run.
+     * @return false if the function stays interpreted.
+     */
+    bool compile();
+
+    /**
+     * @brief Check that every name the body calls refers to <self>.
+     *
+     * @param self the function called.
+     * @param caller the parent of the environment of the call.
+     * @return true if the calls in the code call <self>.
+     * @return false otherwise.
+     */
+    bool checkCallees(const Function* self, Environment* caller);
+
+    /**
+     * @brief The program holding the body.
+     *
+     */
+    const Program& program;
+
+    /**
+     * @brief The function to compile.
+     *
+     */
+    const CustomFunction& function;
+
+    /**
+     * @brief The number of calls counted so far.
+     *
+     */
+    uint64_t calls = 0;
+
+    /**
+     * @brief Whether the function was given up on, because its body is not
+     * supported or its code bailed out.
+     *
+     */
+    bool interpreted = false;
+
+    /**
+     * @brief The machine code, nullptr until the function is hot.
+     *
+     */
+    std::unique_ptr<MachineCode> code;
+
+    /**
+     * @brief The number of nested calls the machine code may make.
+     *
+     */
+    uint32_t nativeDepth = 0;
+
+    /**
+     * @brief The number of calls left to interpret after a call recursed
+     * deeper than <nativeDepth>.
+     *
+     */
+    uint32_t interpretedCalls = 0;
+
+    /**
+     * @brief The names called by the body.
+     *
+     */
+    std::vector<SymbolId> callees;
+
+    /**
+     * @brief The binding cache of every name in <callees>.
+     *
+     */
+    std::vector<BindingCache> calleeCaches;
+
+    /**
+     * @brief The arguments passed to the entry point.
+     *
+     */
+    std::vector<int32_t> intArguments;
+
+    /**
+     * @brief The number of calls after which a function is compiled.
+     *
+     */
+    static uint32_t threshold;
+
+    /**
+     * @brief The bytes of C++ stack the nested calls of machine code may use.
+     *
+     */
+    static size_t stackBudget;
+
+    /**
+     * @brief The counters of all functions.
+     *
+     */
+    static JitStatistics statistics;
+};
+
+
+#endif
@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "parser.h"
+#include "compiler.h"
+#include "jit.h"
+#include "vm.h"
+
+
+#ifdef JIT_X86_64
+
+std::unique_ptr<Program> parseHotProgram(const char* program) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    // The calls are counted, so they must not be inlined
+    parser->setInlineBudget(0);
+
+    return parser->parseAll();
+}
+
+ExpressionValue runHot(const char* program, bool onTree,
+        size_t maxDepth = VirtualMachine::DEFAULT_MAX_DEPTH) {
+    GlobalEnvironment globalEnv;
+    auto parsed = parseHotProgram(program);
+
+    JitFunction::resetStatistics();
+    JitFunction::setThreshold(1);
+    MemoTable::setCapacity(0);
+
+    ExpressionValue result;
+    try {
+        if (onTree) {
+            result = parsed->evaluate(&globalEnv);
+        } else {
+            Compiler compiler;
+            auto compiled = compiler.compileProgram(*parsed);
+
+            VirtualMachine vm;
+            vm.setMaxDepth(maxDepth);
+            result = vm.run(*compiled, &globalEnv);
+        }
+    } catch (...) {
+        JitFunction::setThreshold(JitFunction::DEFAULT_THRESHOLD);
+        MemoTable::setCapacity(MemoTable::DEFAULT_CAPACITY);
+        throw;
+    }
+
+    JitFunction::setThreshold(JitFunction::DEFAULT_THRESHOLD);
+    MemoTable::setCapacity(MemoTable::DEFAULT_CAPACITY);
+
+    return result;
+}
+
+
+void runOnThread(size_t stackSize, std::function<void()> run) {
+#ifdef _WIN32
+    HANDLE thread = CreateThread(nullptr, stackSize,
+        [](LPVOID argument) -> DWORD {
+            (*static_cast<std::function<void()>*>(argument))();
+            return 0;
+        }, &run, STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+    ASSERT_NE(thread, nullptr);
+
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, stackSize);
+
+    pthread_t thread;
+    int error = pthread_create(&thread, &attributes,
+        [](void* argument) -> void* {
+            (*static_cast<std::function<void()>*>(argument))();
+            return nullptr;
+        }, &run);
+    pthread_attr_destroy(&attributes);
+    ASSERT_EQ(error, 0);
+
+    pthread_join(thread, nullptr);
+#endif
+}
+
+
+TEST(Jit, CompilesHotFunctions) {
+    const char* program =
+        "   fib = FUN x {                         "
+        "      IF x <= 2 || x == 0 {              "
+        "          1                              "
+        "      } ELSE {                           "
+        "          fib(x - 1) + fib(x - 2) * (4 / 2) / 2"
+        "      }                                  "
+        "   }                                     "
+        "   fib(20)                               ";
+
+    for (bool onTree : { true, false }) {
+        auto result = runHot(program, onTree);
+
+        ASSERT_EQ(result.type, ExpressionValueType::INT);
+        ASSERT_EQ(result.payloadInt, 6765);
+        ASSERT_EQ(JitFunction::getStatistics().compiled, 1);
+        ASSERT_EQ(JitFunction::getStatistics().calls, 1);
+    }
+}
+
+TEST(Jit, TailCallsJumpBack) {
+    const char* program =
+        "   count = FUN n, acc {                  "
+        "      IF n == 0 { acc } ELSE { count(n - 1, acc + 1) }"
+        "   }                                     "
+        "   count(1000000, 0)                     ";
+
+    for (bool onTree : { true, false }) {
+        auto result = runHot(program, onTree);
+
+        ASSERT_EQ(result.type, ExpressionValueType::INT);
+        ASSERT_EQ(result.payloadInt, 1000000);
+        ASSERT_EQ(JitFunction::getStatistics().deoptimized, 0);
+    }
+}
+
+TEST(Jit, OtherTypesAreInterpreted) {
+    auto result = runHot("f = FUN a { a * a } f(1) f(1.5)", true);
+
+    ASSERT_EQ(result.type, ExpressionValueType::FLOAT);
+    ASSERT_FLOAT_EQ(result.payloadFloat, 2.25f);
+    ASSERT_EQ(JitFunction::getStatistics().calls, 1);
+}
+
+TEST(Jit, DivisionByZeroDeoptimizes) {
+    for (bool onTree : { true, false }) {
+        ASSERT_THROW(runHot("f = FUN a { 10 / a } f(5) f(0)", onTree),
+            std::exception);
+        ASSERT_EQ(JitFunction::getStatistics().calls, 1);
+        ASSERT_EQ(JitFunction::getStatistics().deoptimized, 1);
+    }
+
+    auto result = runHot("f = FUN a { 10 / a } f(0 - 1)", true);
+    ASSERT_EQ(result.payloadInt, -10);
+}
+
+TEST(Jit, DeepRecursionContinuesInTheInterpreter) {
+    const char* program =
+        "   depth = FUN n { IF n == 0 { 0 } ELSE { 1 + depth(n - 1) } }"
+        "   depth(5000)                           ";
+
+    // The VirtualMachine recurses on the heap where the code gave up, the
+    // code is kept for the calls further down
+    auto result = runHot(program, false);
+
+    ASSERT_EQ(result.payloadInt, 5000);
+    ASSERT_GT(JitFunction::getStatistics().tooDeep, 0);
+    ASSERT_GT(JitFunction::getStatistics().calls, 0);
+    ASSERT_EQ(JitFunction::getStatistics().deoptimized, 0);
+
+    // The machine code does not recurse deeper than the VirtualMachine may
+    ASSERT_THROW(runHot(program, false, 100), std::exception);
+}
+
+TEST(Jit, DeepRecursionFitsSmallStacks) {
+    const char* program =
+        "   depth = FUN n { IF n == 0 { 0 } ELSE { 1 + depth(n - 1) } }"
+        "   depth(100000)                         ";
+
+    // Like a worker thread of an application embedding the interpreter
+    ExpressionValue result;
+    runOnThread(64 * 1024, [&]() {
+        result = runHot(program, false, 200000);
+    });
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 100000);
+    ASSERT_GT(JitFunction::getStatistics().calls, 0);
+}
+
+TEST(Jit, CallsAreCheckedBeforeEntering) {
+    auto result = runHot(
+        "   f = FUN n { IF n == 0 { 0 } ELSE { f(n - 1) + 1 } }"
+        "   g = f                                 "
+        "   f = FUN n { 0 - n }                   "
+        "   g(3)                                  ", true);
+
+    // g calls the new f, so the machine code of the old one is not used
+    ASSERT_EQ(result.payloadInt, -1);
+}
+
+TEST(Jit, UnsupportedFunctionsStayInterpreted) {
+    auto result = runHot(
+        "   f = FUN a { b = a + 1; b * 2 }        "
+        "   s = FUN a { \"a\" }                   "
+        "   f(1) s(1)                             ", true);
+
+    ASSERT_EQ(result.getString(), "a");
+    ASSERT_EQ(JitFunction::getStatistics().compiled, 0);
+    ASSERT_EQ(JitFunction::getStatistics().rejected, 2);
+}
+
+#endif
@@ -0,0 +1,131 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "parser.h"
+#include "compiler.h"
+#include "vm.h"
+
+
+/**
+ * @brief Generate a script counting to <iterations> with a FOR loop.
+ *
+ * @param iterations the number of iterations.
+ * @return std::string the generated script.
+ */
+std::string generateLoop(long iterations) {
+    auto limit = std::to_string(iterations);
+
+    return "count = 0\n"
+        "FOR i = 0, i < " + limit + ", i = i + 1 {\n"
+        "    count = count + 1\n"
+        "}\n"
+        "count\n";
+}
+
+
+/**
+ * @brief Generate a script counting to <iterations> with a tail recursive
+ * function.
+ *
+ * @param iterations the number of calls.
+ * @return std::string the generated script.
+ */
+std::string generateRecursion(long iterations) {
+    auto limit = std::to_string(iterations);
+
+    return "count = FUN i, n, total {\n"
+        "    IF i < n {\n"
+        "        count(i + 1, n, total + 1)\n"
+        "    } ELSE {\n"
+        "        total\n"
+        "    }\n"
+        "}\n"
+        "count(0, " + limit + ", 0)\n";
+}
+
+
+/**
+ * @brief Run <script> and report the best time out of <runs> runs.
+ *
+ * @param name the name printed with the result.
+ * @param script the script to run.
+ * @param iterations the number of iterations the script makes.
+ * @param runs the number of runs.
+ * @param useTreeEvaluator whether to evaluate the tree instead of running
+ * the bytecode.
+ * @return double the best time in seconds.
+ */
+double benchmark(const std::string& name, std::string& script,
+        long iterations, int runs, bool useTreeEvaluator) {
+    double best = 0;
+
+    for (int run = 0; run < runs; run++) {
+        std::unique_ptr<Input> input = std::make_unique<StringInput>(script);
+        auto tokenizer = std::make_unique<Tokenizer>(input);
+        auto parser = std::make_unique<Parser>(tokenizer);
+
+        GlobalEnvironment globalEnv;
+        Environment* env = &globalEnv;
+
+        auto program = parser->parseAll();
+        ExpressionValue result;
+
+        auto start = std::chrono::steady_clock::now();
+
+        if (useTreeEvaluator) {
+            result = program->evaluate(env);
+        } else {
+            Compiler compiler;
+            auto compiled = compiler.compileProgram(*program);
+
+            VirtualMachine vm;
+            result = vm.run(*compiled, env);
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        if (result.type != ExpressionValueType::INT
+                || result.payloadInt != iterations) {
+            throw std::exception("Wrong result");
+        }
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    std::cout << name << ": " << best * 1000 << " ms, "
+        << iterations / best / 1e6 << " M iterations/s" << std::endl;
+
+    return best;
+}
+
+
+int main(int argc, char* argv[]) {
+    long iterations = argc > 1 ? std::atol(argv[1]) : 1000000;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    // Every call has new arguments, remembering them only costs time
+    MemoTable::setCapacity(0);
+
+    auto loop = generateLoop(iterations);
+    auto recursion = generateRecursion(iterations);
+
+    std::cout << "Counting to " << iterations << ", best of " << runs
+        << " runs" << std::endl;
+
+    for (bool useTreeEvaluator: { true, false }) {
+        std::string engine = useTreeEvaluator ? "tree" : "vm  ";
+
+        double loopTime = benchmark(engine + " loop     ", loop, iterations,
+            runs, useTreeEvaluator);
+        double recursionTime = benchmark(engine + " recursion", recursion,
+            iterations, runs, useTreeEvaluator);
+
+        std::cout << engine << " speedup of the loop: "
+            << recursionTime / loopTime << "x" << std::endl;
+    }
+}
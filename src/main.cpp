@@ -1,31 +1,167 @@
 #include <iostream>
 
 #include "parser.h"
+#include "compiler.h"
+#include "emitter.h"
+#include "jit.h"
+#include "vm.h"
+
+
+/**
+ * @brief Parse a size in bytes with an optional K or M suffix.
+ *
+ * @param text the size, e.g. 64M.
+ * @return size_t the size in bytes. Throws if <text> is not a size.
+ */
+size_t parseSize(const std::string& text) {
+    size_t end;
+    size_t size = std::stoull(text, &end);
+    std::string suffix = text.substr(end);
+
+    if (suffix == "K" || suffix == "k") {
+        size *= 1024;
+    } else if (suffix == "M" || suffix == "m") {
+        size *= 1024 * 1024;
+    } else if (!suffix.empty()) {
+        throw std::exception("Invalid size");
+    }
+
+    return size;
+}
 
 
 int main(int argc, char* argv[]) {
-    if (argc == 2) {
-        auto filename = std::string(argv[1]);
+    bool useTreeEvaluator = false;
+    bool printStatistics = false;
+    bool emitCpp = false;
+    size_t maxDepth = VirtualMachine::DEFAULT_MAX_DEPTH;
+    uint32_t maxNesting = Parser::DEFAULT_MAX_DEPTH;
+    uint32_t inlineBudget = Optimizer::DEFAULT_INLINE_BUDGET;
+    std::string filename;
 
-        std::unique_ptr<Input> input = std::make_unique<FileInput>(filename);
+    for (int i = 1; i < argc; i++) {
+        auto arg = std::string(argv[i]);
+
+        if (arg == "--engine=tree") {
+            useTreeEvaluator = true;
+        } else if (arg == "--engine=vm") {
+            useTreeEvaluator = false;
+        } else if (arg == "--emit-cpp") {
+            emitCpp = true;
+        } else if (arg == "--stats") {
+            printStatistics = true;
+        } else if (arg.rfind("--heap-size=", 0) == 0) {
+            Heap::global().setHeapLimit(parseSize(arg.substr(12)));
+        } else if (arg.rfind("--nursery-size=", 0) == 0) {
+            Heap::global().setNurserySize(parseSize(arg.substr(15)));
+        } else if (arg.rfind("--max-depth=", 0) == 0) {
+            maxDepth = std::stoull(arg.substr(12));
+        } else if (arg.rfind("--memo-size=", 0) == 0) {
+            MemoTable::setCapacity(std::stoull(arg.substr(12)));
+        } else if (arg.rfind("--jit-threshold=", 0) == 0) {
+            JitFunction::setThreshold(
+                static_cast<uint32_t>(std::stoul(arg.substr(16))));
+        } else if (arg.rfind("--jit-stack=", 0) == 0) {
+            JitFunction::setStackBudget(parseSize(arg.substr(12)));
+        } else if (arg == "--no-inline") {
+            inlineBudget = 0;
+        } else if (arg.rfind("--inline-budget=", 0) == 0) {
+            inlineBudget = static_cast<uint32_t>(std::stoul(arg.substr(16)));
+        } else if (arg.rfind("--max-nesting=", 0) == 0) {
+            maxNesting = static_cast<uint32_t>(std::stoul(arg.substr(14)));
+        } else {
+            filename = arg;
+        }
+    }
+
+    if (!filename.empty()) {
+        std::unique_ptr<Input> input = std::make_unique<MappedFileInput>(filename);
         auto tokenizer = std::make_unique<Tokenizer>(std::move(input));
         auto parser = std::make_unique<Parser>(std::move(tokenizer));
+        parser->setMaxDepth(maxNesting);
+        parser->setInlineBudget(inlineBudget);
+
+        GlobalEnvironment globalEnv;
+        Environment* env = &globalEnv;
+
+        std::unique_ptr<Program> program;
+        ExpressionValue result;
 
-        std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+        try {
+            program = parser->parseAll();
 
-        auto tree = parser->parseAll();
-        auto result = tree->evaluate(env);
+            if (emitCpp) {
+                CppEmitter emitter;
+                std::cout << emitter.emitProgram(*program, filename);
 
-        switch (result->type) {
+                return 0;
+            } else if (useTreeEvaluator) {
+                result = program->evaluate(env);
+            } else {
+                Compiler compiler;
+                auto compiled = compiler.compileProgram(*program);
+
+                VirtualMachine vm;
+                vm.setMaxDepth(maxDepth);
+                result = vm.run(*compiled, env);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+
+            return 1;
+        }
+
+        switch (result.type) {
             case ExpressionValueType::INT:
-                std::cout << result->payloadInt;
+                std::cout << result.payloadInt;
                 break;
             case ExpressionValueType::FLOAT:
-                std::cout << result->payloadFloat;
+                std::cout << result.payloadFloat;
                 break;
             case ExpressionValueType::STRING:
-                std::cout << result->payloadStr;
+                std::cout << result.getString();
+                break;
+            default:
                 break;
         }
+
+        if (printStatistics) {
+            std::cerr << std::endl
+                << "Expressions removed by the optimizer: "
+                << parser->getRemovedNodes() << std::endl
+                << "Calls inlined: " << parser->getInlinedCalls() << std::endl
+                << "Environment allocations elided: "
+                << Block::getElidedEnvironments() << std::endl;
+
+            auto& memo = MemoTable::getStatistics();
+            std::cerr << "Memo hits: " << memo.hits << std::endl
+                << "Memo misses: " << memo.misses << std::endl
+                << "Memo tables flushed: " << memo.flushes << std::endl;
+
+            auto& jit = JitFunction::getStatistics();
+            std::cerr << "JIT functions compiled: " << jit.compiled << std::endl
+                << "JIT functions rejected: " << jit.rejected << std::endl
+                << "JIT calls: " << jit.calls << std::endl
+                << "JIT deoptimizations: " << jit.deoptimized << std::endl
+                << "JIT calls too deep: " << jit.tooDeep << std::endl;
+
+            auto& calls = Environment::getCacheStatistics();
+            std::cerr << "Call site cache hits: " << calls.hits << std::endl
+                << "Call site cache misses: " << calls.misses << std::endl;
+
+            auto& gc = Heap::global().getStatistics();
+            std::cerr << "GC collections: " << gc.collections << std::endl
+                << "GC objects allocated: " << gc.objectsAllocated
+                << " (" << gc.bytesAllocated << " bytes)" << std::endl
+                << "GC objects freed: " << gc.objectsFreed
+                << " (" << gc.bytesFreed << " bytes)" << std::endl
+                << "GC peak live bytes: " << gc.peakLiveBytes << std::endl
+                << "GC pause time: " << gc.pauseSeconds * 1000 << " ms"
+                << std::endl
+                << "Nursery objects allocated: " << gc.youngObjectsAllocated
+                << std::endl
+                << "Nursery objects promoted: " << gc.objectsPromoted
+                << std::endl;
+        }
     }
 }
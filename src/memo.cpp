@@ -0,0 +1,100 @@
+#include "memo.h"
+
+#include <cstring>
+
+
+bool MemoKey::operator==(const MemoKey& other) const {
+    return count == other.count && std::memcmp(arguments, other.arguments,
+        count * sizeof(arguments[0])) == 0;
+}
+
+
+size_t MemoKeyHash::operator()(const MemoKey& key) const {
+    size_t hash = key.count;
+
+    for (uint32_t i = 0; i < key.count; i++) {
+        hash ^= std::hash<uint64_t>()(key.arguments[i]) + 0x9e3779b9
+            + (hash << 6) + (hash >> 2);
+    }
+
+    return hash;
+}
+
+
+size_t MemoTable::capacity = MemoTable::DEFAULT_CAPACITY;
+
+MemoStatistics MemoTable::statistics;
+
+bool MemoTable::makeKey(const ExpressionValue* arguments, uint32_t count,
+        MemoKey& key) {
+    if (count > MemoKey::MAX_ARGUMENTS) {
+        return false;
+    }
+
+    key.count = count;
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t bits;
+
+        switch (arguments[i].type) {
+            case ExpressionValueType::INT:
+                std::memcpy(&bits, &arguments[i].payloadInt, sizeof(bits));
+                break;
+            case ExpressionValueType::FLOAT:
+                // Compared by their bits, so 0.0 and -0.0 are different keys
+                std::memcpy(&bits, &arguments[i].payloadFloat, sizeof(bits));
+                break;
+            default:
+                return false;
+        }
+
+        key.arguments[i] = static_cast<uint64_t>(arguments[i].type) << 32 | bits;
+    }
+
+    return true;
+}
+
+bool MemoTable::lookup(const MemoKey& key, ExpressionValue& result) {
+    auto it = results.find(key);
+
+    if (it == results.end()) {
+        statistics.misses++;
+
+        return false;
+    }
+
+    statistics.hits++;
+    result = it->second;
+
+    return true;
+}
+
+void MemoTable::store(const MemoKey& key, const ExpressionValue& result) {
+    if (result.type != ExpressionValueType::INT
+            && result.type != ExpressionValueType::FLOAT) {
+        return;
+    }
+
+    if (results.size() >= capacity) {
+        results.clear();
+        statistics.flushes++;
+    }
+
+    results[key] = result;
+}
+
+bool MemoTable::isEnabled() {
+    return capacity > 0;
+}
+
+void MemoTable::setCapacity(size_t capacity) {
+    MemoTable::capacity = capacity;
+}
+
+const MemoStatistics& MemoTable::getStatistics() {
+    return statistics;
+}
+
+void MemoTable::resetStatistics() {
+    statistics = MemoStatistics();
+}
@@ -0,0 +1,172 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "value.h"
+
+
+/**
+ * @brief The arguments of a call, each packed into its type and the bits of
+ * its INT or FLOAT payload. The arguments are held inline, so building and
+ * looking up a key does not allocate.
+ *
+ */
+struct MemoKey {
+    /**
+     * @brief The largest number of arguments a memoized call may have.
+     *
+     */
+    static const uint32_t MAX_ARGUMENTS = 8;
+
+    /**
+     * @brief The packed arguments, only the first <count> are used.
+     *
+     */
+    uint64_t arguments[MAX_ARGUMENTS];
+
+    /**
+     * @brief The number of arguments.
+     *
+     */
+    uint32_t count = 0;
+
+    bool operator==(const MemoKey& other) const;
+};
+
+
+/**
+ * @brief Hash function for MemoKeys.
+ *
+ */
+struct MemoKeyHash {
+    size_t operator()(const MemoKey& key) const;
+};
+
+
+/**
+ * @brief Counters describing how often memoized results were reused.
+ *
+ */
+struct MemoStatistics {
+    /**
+     * @brief The number of calls answered from a memo table.
+     *
+     */
+    uint64_t hits = 0;
+
+    /**
+     * @brief The number of calls of memoized functions that were evaluated.
+     *
+     */
+    uint64_t misses = 0;
+
+    /**
+     * @brief The number of times a full memo table was cleared.
+     *
+     */
+    uint64_t flushes = 0;
+};
+
+
+/**
+ * @brief The results of earlier calls of a pure function, keyed by their
+ * arguments.
+ *
+ * Only calls whose arguments and result are INT or FLOAT values are
+ * memoized, so the table holds no references into the heap. Every table
+ * holds at most <capacity> results and is cleared once it is full.
+ *
+ */
+class MemoTable {
+public:
+    /**
+     * @brief The default number of results kept per function.
+     *
+     */
+    static const size_t DEFAULT_CAPACITY = 4096;
+
+    /**
+     * @brief Build the key of a call.
+     *
+     * @param arguments the arguments of the call.
+     * @param count the number of arguments.
+     * @param key the key to fill.
+     * @return true if all arguments are INT or FLOAT values.
+     * @return false if the call cannot be memoized, also when it has more
+     * than MemoKey::MAX_ARGUMENTS arguments.
+     */
+    static bool makeKey(const ExpressionValue* arguments, uint32_t count,
+        MemoKey& key);
+
+    /**
+     * @brief Look up the result of an earlier call, counting a hit or miss.
+     *
+     * @param key the key of the call.
+     * @param result set to the result if one is found.
+     * @return true if the result was found.
+     * @return false otherwise.
+     */
+    bool lookup(const MemoKey& key, ExpressionValue& result);
+
+    /**
+     * @brief Remember the result of a call, if it is an INT or FLOAT value.
+     *
+     * @param key the key of the call.
+     * @param result the value the call returned.
+     */
+    void store(const MemoKey& key, const ExpressionValue& result);
+
+    /**
+     * @brief Check whether calls are memoized at all.
+     *
+     * @return true if the capacity is larger than 0.
+     * @return false otherwise.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief Set the number of results kept per function. 0 turns
+     * memoization off.
+     *
+     * @param capacity the number of results.
+     */
+    static void setCapacity(size_t capacity);
+
+    /**
+     * @brief Get the counters of all memo tables.
+     *
+     * @return const MemoStatistics& the statistics.
+     */
+    static const MemoStatistics& getStatistics();
+
+    /**
+     * @brief Reset the counters of all memo tables to 0.
+     *
+     */
+    static void resetStatistics();
+
+private:
+    /**
+     * @brief The results by the key of their call.
+     *
+     */
+    std::unordered_map<MemoKey, ExpressionValue, MemoKeyHash> results;
+
+    /**
+     * @brief The number of results kept per function.
+     *
+     */
+    static size_t capacity;
+
+    /**
+     * @brief The counters of all memo tables.
+     *
+     */
+    static MemoStatistics statistics;
+};
+
+
+#endif
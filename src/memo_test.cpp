@@ -0,0 +1,73 @@
+#include <gtest/gtest.h>
+
+#include "memo.h"
+
+
+TEST(MemoTable, KeysOnlyScalarArguments) {
+    ExpressionValue arguments[] = { ExpressionValue(1), ExpressionValue(1.0f) };
+    MemoKey key;
+
+    ASSERT_TRUE(MemoTable::makeKey(arguments, 2, key));
+    ASSERT_EQ(key.count, 2);
+    ASSERT_NE(key.arguments[0], key.arguments[1]);
+
+    arguments[1] = ExpressionValue(std::string("1"));
+    ASSERT_FALSE(MemoTable::makeKey(arguments, 2, key));
+}
+
+TEST(MemoTable, KeysAtMostMaxArguments) {
+    ExpressionValue arguments[MemoKey::MAX_ARGUMENTS + 1];
+    for (auto& argument: arguments) {
+        argument = ExpressionValue(1);
+    }
+    MemoKey key;
+
+    ASSERT_TRUE(MemoTable::makeKey(arguments, MemoKey::MAX_ARGUMENTS, key));
+    ASSERT_FALSE(MemoTable::makeKey(arguments, MemoKey::MAX_ARGUMENTS + 1,
+        key));
+}
+
+TEST(MemoTable, StoresScalarResults) {
+    MemoTable::resetStatistics();
+    MemoTable table;
+    ExpressionValue arguments[] = { ExpressionValue(3) };
+    MemoKey key;
+    MemoTable::makeKey(arguments, 1, key);
+
+    ExpressionValue result;
+    ASSERT_FALSE(table.lookup(key, result));
+
+    table.store(key, ExpressionValue(9));
+    ASSERT_TRUE(table.lookup(key, result));
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 9);
+
+    MemoKey other;
+    arguments[0] = ExpressionValue(4);
+    MemoTable::makeKey(arguments, 1, other);
+    table.store(other, ExpressionValue());
+    ASSERT_FALSE(table.lookup(other, result));
+
+    ASSERT_EQ(MemoTable::getStatistics().hits, 1);
+    ASSERT_EQ(MemoTable::getStatistics().misses, 2);
+}
+
+TEST(MemoTable, FullTableIsFlushed) {
+    MemoTable::resetStatistics();
+    MemoTable::setCapacity(2);
+    MemoTable table;
+    MemoKey keys[3];
+
+    for (int i = 0; i < 3; i++) {
+        ExpressionValue argument(i);
+        MemoTable::makeKey(&argument, 1, keys[i]);
+        table.store(keys[i], argument);
+    }
+
+    ExpressionValue result;
+    ASSERT_EQ(MemoTable::getStatistics().flushes, 1);
+    ASSERT_FALSE(table.lookup(keys[0], result));
+    ASSERT_TRUE(table.lookup(keys[2], result));
+
+    MemoTable::setCapacity(MemoTable::DEFAULT_CAPACITY);
+}
@@ -0,0 +1,150 @@
+#include "native.h"
+
+
+TailCall NativeFunction::pendingCall;
+
+NativeFunction::NativeFunction(Body body,
+        const std::vector<SymbolId>& parameters, bool pure): body(body) {
+    for (auto it = parameters.begin(); it != parameters.end(); it++) {
+        parameterScope.declare(*it);
+    }
+
+    setPure(pure);
+}
+
+ExpressionValue NativeFunction::evaluate(
+        Environment* env) {
+    MemoKey key;
+    uint32_t argCount = parameterScope.size();
+    bool memoized = isMemoized() && MemoTable::makeKey(
+        argCount > 0 ? &env->getSlot(0) : nullptr, argCount, key);
+
+    ExpressionValue result;
+    if (memoized && memoTable.lookup(key, result)) {
+        return result;
+    }
+
+    NurseryRegion region(Heap::global());
+    Environment* caller = env->getParent();
+    result = body(env);
+
+    while (pendingCall.pending) {
+        // The function making the tail call has returned, so have its
+        // environments and temporaries
+        Heap::global().releaseNursery(region.getMark());
+        result = evaluateTailCall(caller);
+    }
+
+    if (memoized) {
+        memoTable.store(key, result);
+    }
+
+    return result.escape(region.getMark());
+}
+
+ExpressionValue NativeFunction::tailCall(const ExpressionValue& function,
+        Environment* arguments) {
+    if (!dynamic_cast<NativeFunction*>(function.getFunction().get())) {
+        return function.getFunction()->evaluate(arguments);
+    }
+
+    uint32_t argCount = function.getFunction()->getParameterScope().size();
+
+    pendingCall.arguments.resize(argCount);
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        pendingCall.arguments[slot] = arguments->getSlot(slot).promote();
+    }
+
+    pendingCall.function = function.promote();
+    pendingCall.pending = true;
+
+    return ExpressionValue();
+}
+
+ExpressionValue NativeFunction::evaluateTailCall(Environment* caller) {
+    pendingCall.pending = false;
+
+    auto functionVar = pendingCall.function;
+    auto function = static_cast<NativeFunction*>(
+        functionVar.getFunction().get());
+
+    auto functionEnv = Function::createEnvironment(functionVar, caller);
+    Pin pinFunction(functionVar.payloadObject);
+    Pin pinEnv(functionEnv);
+
+    for (uint32_t slot = 0; slot < pendingCall.arguments.size(); slot++) {
+        functionEnv->bindSlot(slot, pendingCall.arguments[slot]);
+    }
+
+    return function->body(functionEnv);
+}
+
+
+ExpressionValue NativeRuntime::string(const char* text, size_t length) {
+    ExpressionValue value(std::string(text, length));
+    value.payloadObject->pinCount++;
+
+    return value;
+}
+
+Environment* NativeRuntime::prepareCall(const ExpressionValue& function,
+        uint32_t argCount, Environment* caller) {
+    if (function.type != ExpressionValueType::FUNCTION) {
+        throw std::exception("Only invoke functions");
+    }
+
+    auto& parameterScope = function.getFunction()->getParameterScope();
+
+    if (parameterScope.size() != argCount) {
+        throw std::exception("Function arguments do not map to parameters");
+    }
+
+    return Function::createEnvironment(function, caller);
+}
+
+int NativeRuntime::divide(int left, int right) {
+    if (right == 0) {
+        throw std::exception("Division: Division by zero");
+    }
+
+    return left / right;
+}
+
+int NativeRuntime::connective(const ExpressionValue& value,
+        const char* error) {
+    if (value.type != ExpressionValueType::INT) {
+        throw std::exception(error);
+    }
+
+    return value.payloadInt;
+}
+
+int NativeRuntime::run(NativeFunction::Body program) {
+    GlobalEnvironment globalEnv;
+    ExpressionValue result;
+
+    try {
+        NurseryRegion region(Heap::global());
+        result = program(&globalEnv).escape(region.getMark());
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+
+        return 1;
+    }
+
+    switch (result.type) {
+        case ExpressionValueType::INT:
+            std::cout << result.payloadInt;
+            break;
+        case ExpressionValueType::FLOAT:
+            std::cout << result.payloadFloat;
+            break;
+        case ExpressionValueType::STRING:
+            std::cout << result.getString();
+            break;
+        default:
+            break;
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "expressions.h"
+
+
+/**
+ * @brief A function emitted as C++ by the CppEmitter.
+ *
+ * Calls work like calls of a CustomFunction: the arguments are bound in a
+ * new environment whose parent is the environment the function was defined
+ * in, results of pure functions
+ * are memoized and tail calls replace the calling function.
+ *
+ */
+class NativeFunction: public Function {
+public:
+    /**
+     * @brief The emitted body, evaluating the function in the environment
+     * holding its arguments.
+     *
+     */
+    typedef ExpressionValue (*Body)(Environment* env);
+
+    /**
+     * @brief Construct a new Native Function object.
+     *
+     * @param body the emitted body.
+     * @param parameters the names of the parameters.
+     * @param pure whether the results of calls may be memoized.
+     */
+    NativeFunction(Body body, const std::vector<SymbolId>& parameters,
+        bool pure);
+
+    /**
+     * @brief Evaluate the function, including the tail calls it makes.
+     *
+     * @param env the environment holding the arguments.
+     * @return ExpressionValue the result of the function.
+     */
+    ExpressionValue evaluate(
+        Environment* env);
+
+    /**
+     * @brief Make a call in tail position. Calls of other NativeFunctions
+     * are left to the function making the call, which evaluates them once
+     * it has returned.
+     *
+     * @param function the function to call.
+     * @param arguments the environment holding the arguments.
+     * @return ExpressionValue the result of the call, an empty value if the
+     * call is left to the caller.
+     */
+    static ExpressionValue tailCall(const ExpressionValue& function,
+        Environment* arguments);
+
+private:
+    /**
+     * @brief Evaluate the pending tail call.
+     *
+     * @param caller the parent of the environment of the function making
+     * the call, used as parent for functions without closure.
+     * @return ExpressionValue the result of the call.
+     */
+    static ExpressionValue evaluateTailCall(Environment* caller);
+
+    /**
+     * @brief The emitted body.
+     *
+     */
+    Body body;
+
+    /**
+     * @brief The tail call requested by the function returning last.
+     *
+     */
+    static TailCall pendingCall;
+};
+
+
+/**
+ * @brief Helpers the code emitted by the CppEmitter calls into.
+ *
+ */
+class NativeRuntime {
+public:
+    /**
+     * @brief Create a string constant, which is never collected.
+     *
+     * @param text the characters of the string.
+     * @param length the number of characters.
+     * @return ExpressionValue the string.
+     */
+    static ExpressionValue string(const char* text, size_t length);
+
+    /**
+     * @brief Check a function value and create the environment for its
+     * arguments.
+     *
+     * @param function the value called.
+     * @param argCount the number of arguments passed.
+     * @param caller the environment the call is made in.
+     * @return Environment* the environment to bind the arguments in.
+     * Throws if <function> is no function or takes other arguments.
+     */
+    static Environment* prepareCall(const ExpressionValue& function,
+        uint32_t argCount, Environment* caller);
+
+    /**
+     * @brief Apply an arithmetic operation, natively if both operands are
+     * INTs or both are FLOATs.
+     *
+     * @tparam Operation the expression class, like Addition.
+     * @tparam Native the C++ operation, like std::plus<>.
+     * @param left the left operand.
+     * @param right the right operand.
+     * @param native the C++ operation.
+     * @return ExpressionValue the result. Throws like Operation::apply.
+     */
+    template <typename Operation, typename Native>
+    static ExpressionValue operate(const ExpressionValue& left,
+            const ExpressionValue& right, Native native) {
+        if (left.type == right.type) {
+            if (left.type == ExpressionValueType::INT) {
+                return ExpressionValue(native(left.payloadInt,
+                    right.payloadInt));
+            } else if (left.type == ExpressionValueType::FLOAT) {
+                return ExpressionValue(native(left.payloadFloat,
+                    right.payloadFloat));
+            }
+        }
+
+        return Operation::apply(left, right);
+    }
+
+    /**
+     * @brief Compare two values, natively if both are INTs or both are
+     * FLOATs.
+     *
+     * @tparam Operation the expression class, like LessThanComparison.
+     * @tparam Native the C++ comparison, like std::less<>.
+     * @param left the left operand.
+     * @param right the right operand.
+     * @param native the C++ comparison.
+     * @return int 1 if the comparison holds, 0 otherwise. Throws like
+     * Operation::apply.
+     */
+    template <typename Operation, typename Native>
+    static int compare(const ExpressionValue& left,
+            const ExpressionValue& right, Native native) {
+        if (left.type == right.type) {
+            if (left.type == ExpressionValueType::INT) {
+                return native(left.payloadInt, right.payloadInt) ? 1 : 0;
+            } else if (left.type == ExpressionValueType::FLOAT) {
+                return native(left.payloadFloat, right.payloadFloat) ? 1 : 0;
+            }
+        }
+
+        return Operation::apply(left, right).payloadInt;
+    }
+
+    /**
+     * @brief Divide two INTs.
+     *
+     * @param left the dividend.
+     * @param right the divisor.
+     * @return int the quotient. Throws if <right> is 0.
+     */
+    static int divide(int left, int right);
+
+    /**
+     * @brief Get the left operand of an and or or as an int.
+     *
+     * @param value the left operand.
+     * @param error the message to throw if it is no INT.
+     * @return int the payload of <value>.
+     */
+    static int connective(const ExpressionValue& value, const char* error);
+
+    /**
+     * @brief Check whether a value counts as true in a condition.
+     *
+     * @param value the value of the condition.
+     * @return true if <value> is a nonzero INT.
+     * @return false otherwise.
+     */
+    static bool isTrue(const ExpressionValue& value) {
+        return value.type == ExpressionValueType::INT && value.payloadInt != 0;
+    }
+
+    /**
+     * @brief Run an emitted program in a new global environment and print
+     * its result like the interpreter does.
+     *
+     * @param program the emitted root of the program.
+     * @return int the exit code, 1 if the program failed.
+     */
+    static int run(NativeFunction::Body program);
+};
+
+
+#endif
@@ -0,0 +1,24 @@
+"""Compiles no-pain scripts into native binaries."""
+
+def npn_binary(name, src, **kwargs):
+    """Emits <src> as C++ with `main --emit-cpp` and builds it as a cc_binary.
+
+    Args:
+      name: the name of the binary.
+      src: the .npn script.
+      **kwargs: passed on to the cc_binary.
+    """
+    native.genrule(
+        name = name + "_cpp",
+        srcs = [src],
+        outs = [name + ".cpp"],
+        cmd = "$(location //src:main) --emit-cpp $< > $@",
+        tools = ["//src:main"],
+    )
+
+    native.cc_binary(
+        name = name,
+        srcs = [name + ".cpp"],
+        deps = ["//src:runtime"],
+        **kwargs
+    )
@@ -0,0 +1,673 @@
+#include "optimizer.h"
+
+#include "program.h"
+
+
+void Optimizer::optimizeProgram(Program& program) {
+    this->program = &program;
+    sizes.clear();
+    size = 0;
+    removedNodes = 0;
+    createdNodes = 0;
+    depth = 0;
+    leftOperands = 0;
+    inlining = false;
+    statement = 0;
+    definitions.clear();
+    variableNames.clear();
+    localNames.clear();
+    assignedNames.clear();
+    enclosingParameters.clear();
+    inlinedCalls = 0;
+
+    program.setRoot(optimize(program.getRoot()));
+
+    for (auto it = variableNames.begin(); it != variableNames.end(); it++) {
+        definitions.erase(*it);
+    }
+
+    if (inlineBudget == 0 || definitions.empty()) {
+        return;
+    }
+
+    inlining = true;
+    size = 0;
+    statement = 0;
+
+    program.setRoot(optimize(program.getRoot()));
+}
+
+NodeId Optimizer::optimize(NodeId id) {
+    if (depth - leftOperands >= maxDepth || depth >= maxTreeDepth) {
+        throw std::exception("Expression nested too deeply");
+    }
+
+    if (depth == 1) {
+        // A top level expression of the root block
+        statement++;
+    }
+
+    uint32_t before = size;
+    size++;
+    depth++;
+
+    NodeId replacement = program->get(id).optimize(*this);
+
+    depth--;
+
+    if (replacement == NO_NODE) {
+        replacement = id;
+    } else {
+        // The expression itself, its dropped children are removed already
+        removedNodes++;
+        size--;
+    }
+
+    if (sizes.size() <= replacement) {
+        sizes.resize(replacement + 1);
+    }
+    sizes[replacement] = size - before;
+
+    return replacement;
+}
+
+NodeId Optimizer::optimizeLeftOperand(NodeId id) {
+    leftOperands++;
+    NodeId replacement = optimize(id);
+    leftOperands--;
+
+    return replacement;
+}
+
+const ExpressionValue* Optimizer::getLiteral(NodeId id) const {
+    auto literal = dynamic_cast<const Literal*>(&program->get(id));
+
+    return literal ? &literal->getValue() : nullptr;
+}
+
+ExpressionValueType Optimizer::getType(NodeId id) const {
+    return program->get(id).getType(*this);
+}
+
+bool Optimizer::isIdentity(NodeId id, int number, NodeId other) const {
+    auto value = getLiteral(id);
+    if (!value || getType(other) != value->type) {
+        return false;
+    }
+
+    switch (value->type) {
+        case ExpressionValueType::INT:
+            return value->payloadInt == number;
+        case ExpressionValueType::FLOAT:
+            return value->payloadFloat == number;
+        default:
+            return false;
+    }
+}
+
+NodeId Optimizer::fold(ExpressionValue (*operation)(
+            const ExpressionValue&, const ExpressionValue&),
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue) {
+    // Temporaries like concatenated strings are promoted by the literal
+    NurseryRegion region(Heap::global());
+    ExpressionValue value;
+
+    try {
+        value = operation(leftValue, rightValue);
+    } catch (const std::exception&) {
+        // Left for the runtime to report
+        return NO_NODE;
+    }
+
+    NodeId literal = program->create<Literal>(value);
+    createdNodes++;
+    size++;
+
+    return literal;
+}
+
+void Optimizer::remove(NodeId id) {
+    removedNodes += sizes[id];
+    size -= sizes[id];
+}
+
+void Optimizer::addAssignment(SymbolId name, NodeId value) {
+    if (inlining) {
+        return;
+    }
+
+    auto wrapper = dynamic_cast<const FunctionWrapper*>(&program->get(value));
+
+    if (wrapper && depth == 2 && definitions.count(name) == 0) {
+        definitions[name] = Definition{ &wrapper->getFunction(), statement };
+    } else {
+        variableNames.insert(name);
+    }
+
+    if (depth != 2) {
+        localNames.insert(name);
+    } else {
+        // Keeps the first statement
+        assignedNames.emplace(name, statement);
+    }
+}
+
+void Optimizer::beginFunction(const std::vector<SymbolId>& names) {
+    if (!inlining) {
+        variableNames.insert(names.begin(), names.end());
+        localNames.insert(names.begin(), names.end());
+    }
+
+    enclosingParameters.push_back(&names);
+}
+
+void Optimizer::endFunction() {
+    enclosingParameters.pop_back();
+}
+
+bool Optimizer::isBound(SymbolId name) const {
+    for (auto it = enclosingParameters.begin();
+            it != enclosingParameters.end(); it++) {
+        if (std::find((*it)->begin(), (*it)->end(), name) != (*it)->end()) {
+            return true;
+        }
+    }
+
+    if (localNames.count(name) > 0) {
+        // A variable of a function or block may hide it and not be
+        // assigned yet
+        return false;
+    }
+
+    auto assigned = assignedNames.find(name);
+
+    return assigned != assignedNames.end() && assigned->second < statement;
+}
+
+NodeId Optimizer::inlineCall(SymbolId name,
+        const std::vector<NodeId>& arguments) {
+    if (!inlining) {
+        return NO_NODE;
+    }
+
+    auto definition = definitions.find(name);
+    if (definition == definitions.end()
+            || definition->second.statement >= statement) {
+        // Also calls from the function itself, which may run before it is
+        // assigned
+        return NO_NODE;
+    }
+
+    auto& function = *definition->second.function;
+    if (function.getParameterNames().size() != arguments.size()) {
+        return NO_NODE;
+    }
+
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        // The copy may evaluate an argument any number of times, so it
+        // must have no effects and never throw
+        auto argument = dynamic_cast<const Name*>(&program->get(*it));
+
+        if (!getLiteral(*it) && !(argument && isBound(argument->name))) {
+            return NO_NODE;
+        }
+    }
+
+    parameters = &function.getParameterNames();
+    this->arguments = &arguments;
+    copiedNodes = 0;
+
+    NodeId body = copy(function.getBody());
+
+    parameters = nullptr;
+    this->arguments = nullptr;
+
+    if (body == NO_NODE || copiedNodes > inlineBudget) {
+        // Partial copies stay unreachable in the arena
+        return NO_NODE;
+    }
+
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        remove(*it);
+    }
+
+    createdNodes += copiedNodes;
+    inlinedCalls++;
+
+    return optimize(body);
+}
+
+NodeId Optimizer::copy(NodeId id) {
+    return program->get(id).copy(*this);
+}
+
+NodeId Optimizer::copyName(const Name& name) {
+    if (parameters) {
+        for (size_t i = 0; i < parameters->size(); i++) {
+            if ((*parameters)[i] != name.name) {
+                continue;
+            }
+
+            // The argument refers to the variables of the caller
+            auto enclosing = parameters;
+            parameters = nullptr;
+            NodeId argument = copy((*arguments)[i]);
+            parameters = enclosing;
+
+            return argument;
+        }
+
+        if (localNames.count(name.name) > 0) {
+            // The caller may hide the variable the body reads
+            return NO_NODE;
+        }
+    }
+
+    return create<Name>(name);
+}
+
+Program& Optimizer::getProgram() {
+    return *program;
+}
+
+uint32_t Optimizer::getRemovedNodes() const {
+    return removedNodes > createdNodes ? removedNodes - createdNodes : 0;
+}
+
+uint32_t Optimizer::getInlinedCalls() const {
+    return inlinedCalls;
+}
+
+void Optimizer::setMaxDepth(uint32_t maxDepth, uint32_t maxTreeDepth) {
+    this->maxDepth = maxDepth;
+    this->maxTreeDepth = maxTreeDepth;
+}
+
+void Optimizer::setInlineBudget(uint32_t inlineBudget) {
+    this->inlineBudget = inlineBudget;
+}
+
+
+NodeId Expression::copy(Optimizer& optimizer) const {
+    return NO_NODE;
+}
+
+ExpressionValueType Expression::getType(const Optimizer& optimizer) const {
+    return ExpressionValueType::UNDEFINED;
+}
+
+
+NodeId Literal::optimize(Optimizer& optimizer) {
+    return NO_NODE;
+}
+
+NodeId Literal::copy(Optimizer& optimizer) const {
+    return optimizer.create<Literal>(value);
+}
+
+ExpressionValueType Literal::getType(const Optimizer& optimizer) const {
+    return value.type;
+}
+
+
+NodeId Name::optimize(Optimizer& optimizer) {
+    return NO_NODE;
+}
+
+NodeId Name::copy(Optimizer& optimizer) const {
+    return optimizer.copyName(*this);
+}
+
+
+NodeId BinaryOperation::optimizeOperation(Optimizer& optimizer,
+        ExpressionValue (*operation)(
+            const ExpressionValue&, const ExpressionValue&)) {
+    left = optimizer.optimizeLeftOperand(left);
+    right = optimizer.optimize(right);
+
+    auto leftValue = optimizer.getLiteral(left);
+    auto rightValue = optimizer.getLiteral(right);
+    if (!leftValue || !rightValue) {
+        return NO_NODE;
+    }
+
+    NodeId folded = optimizer.fold(operation, *leftValue, *rightValue);
+    if (folded != NO_NODE) {
+        optimizer.remove(left);
+        optimizer.remove(right);
+    }
+
+    return folded;
+}
+
+template <typename T>
+NodeId BinaryOperation::copyOperation(Optimizer& optimizer) const {
+    NodeId leftCopy = optimizer.copy(left);
+    if (leftCopy == NO_NODE) {
+        return NO_NODE;
+    }
+
+    NodeId rightCopy = optimizer.copy(right);
+    if (rightCopy == NO_NODE) {
+        return NO_NODE;
+    }
+
+    return optimizer.create<T>(leftCopy, rightCopy);
+}
+
+ExpressionValueType BinaryOperation::getOperandType(
+        const Optimizer& optimizer) const {
+    auto type = optimizer.getType(left);
+
+    return type != ExpressionValueType::UNDEFINED
+        ? type : optimizer.getType(right);
+}
+
+NodeId Addition::optimize(Optimizer& optimizer) {
+    NodeId folded = optimizeOperation(optimizer, apply);
+    if (folded != NO_NODE) {
+        return folded;
+    }
+
+    if (optimizer.isIdentity(right, 0, left)) {
+        optimizer.remove(right);
+        return left;
+    } else if (optimizer.isIdentity(left, 0, right)) {
+        optimizer.remove(left);
+        return right;
+    }
+
+    return NO_NODE;
+}
+
+NodeId Addition::copy(Optimizer& optimizer) const {
+    return copyOperation<Addition>(optimizer);
+}
+
+ExpressionValueType Addition::getType(const Optimizer& optimizer) const {
+    return getOperandType(optimizer);
+}
+
+NodeId Subtraction::optimize(Optimizer& optimizer) {
+    NodeId folded = optimizeOperation(optimizer, apply);
+    if (folded != NO_NODE) {
+        return folded;
+    }
+
+    if (optimizer.isIdentity(right, 0, left)) {
+        optimizer.remove(right);
+        return left;
+    }
+
+    return NO_NODE;
+}
+
+NodeId Subtraction::copy(Optimizer& optimizer) const {
+    return copyOperation<Subtraction>(optimizer);
+}
+
+ExpressionValueType Subtraction::getType(const Optimizer& optimizer) const {
+    return getOperandType(optimizer);
+}
+
+NodeId Multiplication::optimize(Optimizer& optimizer) {
+    NodeId folded = optimizeOperation(optimizer, apply);
+    if (folded != NO_NODE) {
+        return folded;
+    }
+
+    if (optimizer.isIdentity(right, 1, left)) {
+        optimizer.remove(right);
+        return left;
+    } else if (optimizer.isIdentity(left, 1, right)) {
+        optimizer.remove(left);
+        return right;
+    }
+
+    return NO_NODE;
+}
+
+NodeId Multiplication::copy(Optimizer& optimizer) const {
+    return copyOperation<Multiplication>(optimizer);
+}
+
+ExpressionValueType Multiplication::getType(const Optimizer& optimizer) const {
+    return getOperandType(optimizer);
+}
+
+NodeId Division::optimize(Optimizer& optimizer) {
+    NodeId folded = optimizeOperation(optimizer, apply);
+    if (folded != NO_NODE) {
+        return folded;
+    }
+
+    if (optimizer.isIdentity(right, 1, left)) {
+        optimizer.remove(right);
+        return left;
+    }
+
+    return NO_NODE;
+}
+
+NodeId Division::copy(Optimizer& optimizer) const {
+    return copyOperation<Division>(optimizer);
+}
+
+ExpressionValueType Division::getType(const Optimizer& optimizer) const {
+    return getOperandType(optimizer);
+}
+
+NodeId EqualComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId EqualComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<EqualComparison>(optimizer);
+}
+
+NodeId GreaterThanComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId GreaterThanComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<GreaterThanComparison>(optimizer);
+}
+
+NodeId GreaterThanOrEqualComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId GreaterThanOrEqualComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<GreaterThanOrEqualComparison>(optimizer);
+}
+
+NodeId LessThanComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId LessThanComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<LessThanComparison>(optimizer);
+}
+
+NodeId LessThanOrEqualComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId LessThanOrEqualComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<LessThanOrEqualComparison>(optimizer);
+}
+
+NodeId NotEqualComparison::optimize(Optimizer& optimizer) {
+    return optimizeOperation(optimizer, apply);
+}
+
+NodeId NotEqualComparison::copy(Optimizer& optimizer) const {
+    return copyOperation<NotEqualComparison>(optimizer);
+}
+
+
+NodeId AndConnective::optimize(Optimizer& optimizer) {
+    left = optimizer.optimizeLeftOperand(left);
+    right = optimizer.optimize(right);
+
+    auto leftValue = optimizer.getLiteral(left);
+    if (!leftValue || leftValue->type != ExpressionValueType::INT) {
+        return NO_NODE;
+    }
+
+    if (leftValue->payloadInt == 0) {
+        optimizer.remove(right);
+        return left;
+    } else {
+        optimizer.remove(left);
+        return right;
+    }
+}
+
+NodeId AndConnective::copy(Optimizer& optimizer) const {
+    return copyOperation<AndConnective>(optimizer);
+}
+
+
+NodeId OrConnective::optimize(Optimizer& optimizer) {
+    left = optimizer.optimizeLeftOperand(left);
+    right = optimizer.optimize(right);
+
+    auto leftValue = optimizer.getLiteral(left);
+    if (!leftValue || leftValue->type != ExpressionValueType::INT) {
+        return NO_NODE;
+    }
+
+    if (leftValue->payloadInt == 1) {
+        optimizer.remove(right);
+        return left;
+    } else {
+        optimizer.remove(left);
+        return right;
+    }
+}
+
+NodeId OrConnective::copy(Optimizer& optimizer) const {
+    return copyOperation<OrConnective>(optimizer);
+}
+
+
+NodeId Assignment::optimize(Optimizer& optimizer) {
+    right = optimizer.optimize(right);
+    optimizer.addAssignment(left.name, right);
+
+    return NO_NODE;
+}
+
+
+NodeId Block::optimize(Optimizer& optimizer) {
+    for (auto it = exprList.begin(); it != exprList.end(); it++) {
+        *it = optimizer.optimize(*it);
+    }
+
+    return NO_NODE;
+}
+
+NodeId Block::copy(Optimizer& optimizer) const {
+    std::vector<NodeId> copies;
+
+    for (auto it = exprList.begin(); it != exprList.end(); it++) {
+        NodeId copy = optimizer.copy(*it);
+        if (copy == NO_NODE) {
+            return NO_NODE;
+        }
+
+        copies.push_back(copy);
+    }
+
+    NodeId block = optimizer.create<Block>();
+    for (auto it = copies.begin(); it != copies.end(); it++) {
+        optimizer.getProgram().get<Block>(block).addExpression(*it);
+    }
+
+    return block;
+}
+
+
+NodeId IfStatement::optimize(Optimizer& optimizer) {
+    condition = optimizer.optimize(condition);
+    ifBlock = optimizer.optimize(ifBlock);
+
+    if (elseBlock != NO_NODE) {
+        elseBlock = optimizer.optimize(elseBlock);
+    }
+
+    auto conditionValue = optimizer.getLiteral(condition);
+    if (!conditionValue || elseBlock == NO_NODE) {
+        return NO_NODE;
+    }
+
+    optimizer.remove(condition);
+
+    if (conditionValue->type == ExpressionValueType::INT
+            && conditionValue->payloadInt != 0) {
+        optimizer.remove(elseBlock);
+        return ifBlock;
+    } else {
+        optimizer.remove(ifBlock);
+        return elseBlock;
+    }
+}
+
+NodeId IfStatement::copy(Optimizer& optimizer) const {
+    NodeId conditionCopy = optimizer.copy(condition);
+    NodeId ifCopy = optimizer.copy(ifBlock);
+    NodeId elseCopy = elseBlock == NO_NODE ? NO_NODE : optimizer.copy(elseBlock);
+
+    if (conditionCopy == NO_NODE || ifCopy == NO_NODE
+            || (elseBlock != NO_NODE && elseCopy == NO_NODE)) {
+        return NO_NODE;
+    }
+
+    return optimizer.create<IfStatement>(conditionCopy, ifCopy, elseCopy);
+}
+
+
+NodeId WhileLoop::optimize(Optimizer& optimizer) {
+    condition = optimizer.optimize(condition);
+
+    for (auto it = body.begin(); it != body.end(); it++) {
+        *it = optimizer.optimize(*it);
+    }
+
+    if (step != NO_NODE) {
+        step = optimizer.optimize(step);
+    }
+
+    return NO_NODE;
+}
+
+
+NodeId ForLoop::optimize(Optimizer& optimizer) {
+    init = optimizer.optimize(init);
+
+    return WhileLoop::optimize(optimizer);
+}
+
+
+void CustomFunction::optimize(Optimizer& optimizer) {
+    optimizer.beginFunction(getParameterNames());
+    body = optimizer.optimize(body);
+    optimizer.endFunction();
+}
+
+
+NodeId FunctionWrapper::optimize(Optimizer& optimizer) {
+    function->optimize(optimizer);
+
+    return NO_NODE;
+}
+
+
+NodeId Invocation::optimize(Optimizer& optimizer) {
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        *it = optimizer.optimize(*it);
+    }
+
+    return optimizer.inlineCall(functionName, arguments);
+}
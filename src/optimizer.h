@@ -0,0 +1,415 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "expressions.h"
+#include "program.h"
+
+
+/**
+ * @brief Static pass which simplifies the tree before it is resolved.
+ *
+ * Binary operations on two literals are folded into one literal holding
+ * their value, like 2 * 3 or the concatenation of two string literals.
+ * Operations which throw for their operands are left for the runtime to
+ * report. If statements with a literal condition are replaced by the branch
+ * they take, and connectives with a literal left operand by the operand
+ * they return.
+ *
+ * Multiplying or dividing by 1 and adding or subtracting 0 are simplified
+ * to the other operand if it is known to be of the same type as the
+ * literal, like the result of an operation on an INT literal. Otherwise
+ * the operation is kept, as it throws for operands of different types.
+ * Identities that drop an operand which is not a literal, like x && 0, are
+ * kept, the operand is still evaluated for its side effects and type errors.
+ *
+ * Calls of small functions are inlined in a second pass: the call is
+ * replaced by a copy of the body in which every parameter is replaced by a
+ * copy of its argument. Other names in the copy are looked up at the call
+ * instead of where the function is defined, so the body may only read
+ * names that no parameter and no variable inside a function or block
+ * hides. Only bodies of literals, names, operations, IFs and blocks
+ * without variables are copied, so the copy has no side effects and calls
+ * nothing that could look up the parameters. The arguments must be
+ * literals or names which are always bound, as the copy may evaluate an
+ * argument more than once or not at all.
+ *
+ * The called name has to be provably bound to the function: it is assigned
+ * the function in a top level expression of the program, is assigned
+ * nothing else anywhere and is no parameter, and the call comes from a
+ * later top level expression, which only runs after the assignment. The
+ * copy may not exceed the inline budget, counted in expressions.
+ *
+ * Every expression replaces itself by the NodeId its optimize returns.
+ * Replaced expressions stay in the arena of the program, but are no longer
+ * reachable from its root.
+ *
+ */
+class Optimizer {
+public:
+    /**
+     * @brief The default number of expressions an inlined call may be
+     * replaced with.
+     *
+     */
+    static const uint32_t DEFAULT_INLINE_BUDGET = 32;
+
+    /**
+     * @brief Optimize a whole program, usually before it is resolved in
+     * Parser::parseAll. Replaces the root if needed.
+     *
+     * @param program the program to optimize, starting at its root.
+     */
+    void optimizeProgram(Program& program);
+
+    /**
+     * @brief Optimize an expression of the program being optimized.
+     *
+     * @param id the id of the expression.
+     * @return NodeId the expression replacing it, <id> if it is kept.
+     */
+    NodeId optimize(NodeId id);
+
+    /**
+     * @brief Optimize the left operand of a binary operation. Chains like
+     * a + b + c nest on the left, which does not count towards the limit of
+     * the depth.
+     *
+     * @param id the id of the operand.
+     * @return NodeId the expression replacing it, <id> if it is kept.
+     */
+    NodeId optimizeLeftOperand(NodeId id);
+
+    /**
+     * @brief Get the value of an expression if it is a literal.
+     *
+     * @param id the id of the expression.
+     * @return const ExpressionValue* the value of the literal, nullptr if
+     * the expression is no literal.
+     */
+    const ExpressionValue* getLiteral(NodeId id) const;
+
+    /**
+     * @brief Get the type of the value an expression evaluates to, as far as
+     * it is known without running it.
+     *
+     * @param id the id of the expression.
+     * @return ExpressionValueType the type, UNDEFINED if it is not known.
+     */
+    ExpressionValueType getType(NodeId id) const;
+
+    /**
+     * @brief Check whether an expression is the INT or FLOAT literal
+     * <number> and <other> is known to be of the same type, so an operation
+     * on both keeps the value of <other>, like x + 0 for an INT x.
+     *
+     * @param id the id of the expression.
+     * @param number the number to compare to, e.g. 0 or 1.
+     * @param other the id of the other operand.
+     * @return true if the expression is a literal equal to <number> of the
+     * type of <other>.
+     * @return false otherwise.
+     */
+    bool isIdentity(NodeId id, int number, NodeId other) const;
+
+    /**
+     * @brief Apply an operation to two literal operands and create a literal
+     * holding the result.
+     *
+     * @param operation the apply function of the operation.
+     * @param leftValue the value of the left operand.
+     * @param rightValue the value of the right operand.
+     * @return NodeId the new literal, NO_NODE if the operation throws.
+     */
+    NodeId fold(ExpressionValue (*operation)(
+            const ExpressionValue&, const ExpressionValue&),
+        const ExpressionValue& leftValue, const ExpressionValue& rightValue);
+
+    /**
+     * @brief Remove an optimized expression and everything below it from the
+     * tree.
+     *
+     * @param id the id of the expression.
+     */
+    void remove(NodeId id);
+
+    /**
+     * @brief Record an assignment of the expression <value> to <name>. Only
+     * collected in the first pass.
+     *
+     * @param name the name assigned to.
+     * @param value the optimized expression assigned.
+     */
+    void addAssignment(SymbolId name, NodeId value);
+
+    /**
+     * @brief Enter a function. Its parameters, which may hold anything, are
+     * collected in the first pass, and are bound while its body is
+     * optimized.
+     *
+     * @param names the names of the parameters.
+     */
+    void beginFunction(const std::vector<SymbolId>& names);
+
+    /**
+     * @brief Leave the function entered last.
+     *
+     */
+    void endFunction();
+
+    /**
+     * @brief Check whether reading a name in the expression being optimized
+     * always finds a variable, because it is a parameter of an enclosing
+     * function or is assigned by an earlier top level expression.
+     *
+     * @param name the name to check.
+     * @return true if the name is always bound.
+     * @return false if reading it may throw.
+     */
+    bool isBound(SymbolId name) const;
+
+    /**
+     * @brief Replace a call by a copy of the body of the function called, if
+     * it can be inlined.
+     *
+     * @param name the name of the function called.
+     * @param arguments the optimized arguments of the call.
+     * @return NodeId the optimized copy, NO_NODE if the call is kept.
+     */
+    NodeId inlineCall(SymbolId name, const std::vector<NodeId>& arguments);
+
+    /**
+     * @brief Copy an expression and its children, replacing the parameters of
+     * the function being inlined by its arguments.
+     *
+     * @param id the id of the expression.
+     * @return NodeId the copy, NO_NODE if the expression cannot be copied.
+     */
+    NodeId copy(NodeId id);
+
+    /**
+     * @brief Copy a name, or the argument if it is a parameter of the
+     * function being inlined.
+     *
+     * @param name the name to copy.
+     * @return NodeId the copy, NO_NODE if the argument cannot be copied.
+     */
+    NodeId copyName(const Name& name);
+
+    /**
+     * @brief Allocate a new expression of a copy in the program.
+     *
+     * @tparam T the type of the expression.
+     * @param args the arguments passed to the constructor of <T>.
+     * @return NodeId the id of the new expression.
+     */
+    template <typename T, typename... Args>
+    NodeId create(Args&&... args) {
+        copiedNodes++;
+
+        return program->create<T>(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Get the program being optimized.
+     *
+     * @return Program& the program.
+     */
+    Program& getProgram();
+
+    /**
+     * @brief Get the number of expressions the last program shrank by.
+     *
+     * @return uint32_t the number of expressions removed, minus the literals
+     * and inlined copies created for them, 0 if the program grew.
+     */
+    uint32_t getRemovedNodes() const;
+
+    /**
+     * @brief Get the number of calls inlined in the last program.
+     *
+     * @return uint32_t the number of calls.
+     */
+    uint32_t getInlinedCalls() const;
+
+    /**
+     * @brief Set the number of expressions an inlined call may be replaced
+     * with. 0 turns inlining off.
+     *
+     * @param inlineBudget the number of expressions.
+     */
+    void setInlineBudget(uint32_t inlineBudget);
+
+    /**
+     * @brief Set the limits of the depth of the tree. Optimizing a deeper
+     * program throws.
+     *
+     * @param maxDepth the number of expressions that may be nested, not
+     * counting left operands of binary operations.
+     * @param maxTreeDepth the number of expressions that may be nested
+     * counting them, which still limits long chains like a + b + c.
+     */
+    void setMaxDepth(uint32_t maxDepth, uint32_t maxTreeDepth);
+
+private:
+    /**
+     * @brief A function assigned to a name in a top level expression.
+     *
+     */
+    struct Definition {
+        /**
+         * @brief The function assigned.
+         *
+         */
+        const CustomFunction* function;
+
+        /**
+         * @brief The index of the top level expression assigning it.
+         *
+         */
+        uint32_t statement;
+    };
+
+    /**
+     * @brief The program being optimized.
+     *
+     */
+    Program* program = nullptr;
+
+    /**
+     * @brief The number of expressions below and including every optimized
+     * expression, indexed by NodeId.
+     *
+     */
+    std::vector<uint32_t> sizes;
+
+    /**
+     * @brief The number of expressions in the optimized tree so far.
+     *
+     */
+    uint32_t size = 0;
+
+    /**
+     * @brief The number of expressions removed from the tree.
+     *
+     */
+    uint32_t removedNodes = 0;
+
+    /**
+     * @brief The number of literals created by folding.
+     *
+     */
+    uint32_t createdNodes = 0;
+
+    /**
+     * @brief The number of expressions currently being optimized.
+     *
+     */
+    uint32_t depth = 0;
+
+    /**
+     * @brief The number of left operands among the expressions currently
+     * being optimized, which are not counted against <maxDepth>.
+     *
+     */
+    uint32_t leftOperands = 0;
+
+    /**
+     * @brief The limit of <depth>, without the left operands.
+     *
+     */
+    uint32_t maxDepth = UINT32_MAX;
+
+    /**
+     * @brief The limit of <depth>, with the left operands.
+     *
+     */
+    uint32_t maxTreeDepth = UINT32_MAX;
+
+    /**
+     * @brief Whether the second pass, which inlines calls, is running.
+     *
+     */
+    bool inlining = false;
+
+    /**
+     * @brief The index of the top level expression being optimized.
+     *
+     */
+    uint32_t statement = 0;
+
+    /**
+     * @brief The function assigned to each name in a top level expression.
+     *
+     */
+    std::unordered_map<SymbolId, Definition> definitions;
+
+    /**
+     * @brief The names which are parameters, are assigned something else or
+     * are assigned more than once.
+     *
+     */
+    std::unordered_set<SymbolId> variableNames;
+
+    /**
+     * @brief The index of the first top level expression assigning each
+     * name.
+     *
+     */
+    std::unordered_map<SymbolId, uint32_t> assignedNames;
+
+    /**
+     * @brief The parameters of the functions enclosing the expression being
+     * optimized.
+     *
+     */
+    std::vector<const std::vector<SymbolId>*> enclosingParameters;
+
+    /**
+     * @brief The names which are parameters or are assigned in a function
+     * or block, which may hide the top level variable of the same name.
+     *
+     */
+    std::unordered_set<SymbolId> localNames;
+
+    /**
+     * @brief The parameters of the function being inlined, nullptr while
+     * an argument is copied.
+     *
+     */
+    const std::vector<SymbolId>* parameters = nullptr;
+
+    /**
+     * @brief The arguments of the call being inlined.
+     *
+     */
+    const std::vector<NodeId>* arguments = nullptr;
+
+    /**
+     * @brief The number of expressions created for the copy being made.
+     *
+     */
+    uint32_t copiedNodes = 0;
+
+    /**
+     * @brief The number of calls inlined.
+     *
+     */
+    uint32_t inlinedCalls = 0;
+
+    /**
+     * @brief The limit of the size of an inlined copy.
+     *
+     */
+    uint32_t inlineBudget = DEFAULT_INLINE_BUDGET;
+};
+
+
+#endif
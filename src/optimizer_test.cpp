@@ -0,0 +1,202 @@
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "optimizer.h"
+
+
+struct Optimized {
+    ExpressionValue result;
+    uint32_t removedNodes;
+    uint32_t inlinedCalls;
+};
+
+
+Optimized evaluateOptimized(const char* program,
+        uint32_t inlineBudget = Optimizer::DEFAULT_INLINE_BUDGET) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    parser->setInlineBudget(inlineBudget);
+
+    auto parsed = parser->parseAll();
+
+    return Optimized{ parsed->evaluate(env).promote(),
+        parser->getRemovedNodes(), parser->getInlinedCalls() };
+}
+
+
+TEST(Optimizer, FoldsConstantOperations) {
+    auto optimized = evaluateOptimized("2 * 3 + 4");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::INT);
+    ASSERT_EQ(optimized.result.payloadInt, 10);
+    // Five expressions folded into one literal
+    ASSERT_EQ(optimized.removedNodes, 4);
+}
+
+TEST(Optimizer, FoldsStringConcatenations) {
+    auto optimized = evaluateOptimized("\"Hello, \" + \"world!\"");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::STRING);
+    ASSERT_EQ(optimized.result.getString(), "Hello, world!");
+    ASSERT_EQ(optimized.removedNodes, 2);
+}
+
+TEST(Optimizer, SimplifiesIdentities) {
+    auto optimized = evaluateOptimized("x = 5 (x * 1 + 0) / 1 - 0");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::INT);
+    ASSERT_EQ(optimized.result.payloadInt, 5);
+    // x * 1 is kept, the type of x is not known, but it is an INT after it
+    ASSERT_EQ(optimized.removedNodes, 6);
+}
+
+TEST(Optimizer, KeepsIdentitiesOfOperandsOfOtherTypes) {
+    ASSERT_THROW(evaluateOptimized("x = \"a\" x * 1"), std::exception);
+    ASSERT_THROW(evaluateOptimized("x = \"a\" 0 + x"), std::exception);
+    ASSERT_THROW(evaluateOptimized("x = 2.5 x + 0"), std::exception);
+    ASSERT_THROW(evaluateOptimized("x = 2.5 (x * 2.0) / 1"), std::exception);
+
+    auto optimized = evaluateOptimized("x = 2.5 (x * 2.0) - 0.0");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::FLOAT);
+    ASSERT_EQ(optimized.result.payloadFloat, 5.0);
+    ASSERT_EQ(optimized.removedNodes, 2);
+}
+
+TEST(Optimizer, FoldsConstantConditions) {
+    auto optimized = evaluateOptimized(
+        "IF 1 > 2 { undefined } ELSE { 3 + 4 }");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::INT);
+    ASSERT_EQ(optimized.result.payloadInt, 7);
+    // Both operations folded, the if replaced by the else branch
+    ASSERT_EQ(optimized.removedNodes, 9);
+}
+
+TEST(Optimizer, FoldsConnectivesWithConstantLeftOperand) {
+    auto optimized = evaluateOptimized("(0 && undefined(1)) || (1 && 5)");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::INT);
+    ASSERT_EQ(optimized.result.payloadInt, 5);
+    ASSERT_EQ(optimized.removedNodes, 7);
+}
+
+TEST(Optimizer, KeepsOperandsWithSideEffects) {
+    auto optimized = evaluateOptimized("x = 1 (x = 2) && 0 x");
+
+    ASSERT_EQ(optimized.result.type, ExpressionValueType::INT);
+    ASSERT_EQ(optimized.result.payloadInt, 2);
+    ASSERT_EQ(optimized.removedNodes, 0);
+}
+
+TEST(Optimizer, LeavesErrorsToTheRuntime) {
+    ASSERT_THROW(evaluateOptimized("1 / 0"), std::exception);
+    ASSERT_THROW(evaluateOptimized("1 + \"one\""), std::exception);
+}
+
+TEST(Optimizer, InlinesSmallFunctions) {
+    const char* program =
+        "   square = FUN x { x * x }              "
+        "   sumSquares = FUN a, b { square(a) + square(b) }"
+        "   sumSquares(3, 4)                      ";
+
+    auto optimized = evaluateOptimized(program);
+
+    ASSERT_EQ(optimized.result.payloadInt, 25);
+    // Both calls in sumSquares, then sumSquares itself, folded to 25
+    ASSERT_EQ(optimized.inlinedCalls, 3);
+
+    optimized = evaluateOptimized(program, 0);
+
+    ASSERT_EQ(optimized.result.payloadInt, 25);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+}
+
+TEST(Optimizer, InlinesFunctionsReadingTopLevelVariables) {
+    auto optimized = evaluateOptimized(
+        "   k = 2                                 "
+        "   scale = FUN x { x * k }               "
+        "   scale(3) + scale(4)                   ");
+
+    ASSERT_EQ(optimized.result.payloadInt, 14);
+    ASSERT_EQ(optimized.inlinedCalls, 2);
+}
+
+TEST(Optimizer, KeepsCallsOfBodiesReadingHiddenVariables) {
+    auto optimized = evaluateOptimized(
+        "   k = 2                                 "
+        "   scale = FUN x { x * k }               "
+        "   g = FUN k { scale(3) }                "
+        "   g(5)                                  ");
+
+    // scale reads the k it is defined with, not the parameter of g
+    ASSERT_EQ(optimized.result.payloadInt, 6);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+}
+
+TEST(Optimizer, KeepsCallsOfNamesThatMayChange) {
+    auto optimized = evaluateOptimized(
+        "   f = FUN x { x + 1 }                   "
+        "   g = FUN y { f(y) }                    "
+        "   f = FUN x { x * 2 }                   "
+        "   g(5)                                  ");
+
+    ASSERT_EQ(optimized.result.payloadInt, 10);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+
+    // Called before it is assigned, and called through a parameter
+    optimized = evaluateOptimized(
+        "   g = FUN y { f(y) }                    "
+        "   f = FUN x { x + 1 }                   "
+        "   apply = FUN f { f(2) }                "
+        "   g(1) + apply(f)                       ");
+
+    ASSERT_EQ(optimized.result.payloadInt, 5);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+}
+
+TEST(Optimizer, KeepsCallsOfArgumentsWhichMayThrow) {
+    // Unused parameters still evaluate their argument
+    ASSERT_THROW(evaluateOptimized("k = FUN x { 5 } k(1 / 0)"),
+        std::exception);
+    ASSERT_THROW(evaluateOptimized("k = FUN x { 5 } k(y)"), std::exception);
+    ASSERT_THROW(evaluateOptimized("f = FUN x, y { y } f(nope, 2)"),
+        std::exception);
+    // y is assigned after the call
+    ASSERT_THROW(evaluateOptimized("k = FUN x { 5 } k(y) y = 1"),
+        std::exception);
+}
+
+TEST(Optimizer, EvaluatesArgumentsOnce) {
+    auto optimized = evaluateOptimized(
+        "   n = 0                                 "
+        "   square = FUN x { x * x }              "
+        "   square(n = n + 3) + n                 ");
+
+    ASSERT_EQ(optimized.result.payloadInt, 12);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+
+    // Variables are copied as they read the same value every time, but
+    // n + 1 would be computed twice
+    optimized = evaluateOptimized(
+        "   n = 3                                 "
+        "   square = FUN x { x * x }              "
+        "   square(n) + square(n + 1)             ");
+
+    ASSERT_EQ(optimized.result.payloadInt, 25);
+    ASSERT_EQ(optimized.inlinedCalls, 1);
+}
+
+TEST(Optimizer, KeepsCallsOfLargeFunctionsAndFunctionsWithVariables) {
+    auto optimized = evaluateOptimized(
+        "   f = FUN x { y = x + 1; y * 2 }        "
+        "   g = FUN x { x * x * x * x }           "
+        "   f(1) + g(2)                           ", 6);
+
+    ASSERT_EQ(optimized.result.payloadInt, 20);
+    ASSERT_EQ(optimized.inlinedCalls, 0);
+}
@@ -1,48 +1,56 @@
 #include "parser.h"
 
+#include "optimizer.h"
+#include "resolver.h"
+
 
 Parser::Parser(std::unique_ptr<Tokenizer>& tokenizer):
-    tokenizer(std::move(tokenizer)) {}
+    tokenizer(std::move(tokenizer)), program(std::make_unique<Program>()) {}
+
+
+Program& Parser::getProgram() {
+    return *program;
+}
 
 
-std::unique_ptr<Expression> Parser::parseParentheses() {
+NodeId Parser::parseParentheses() {
     auto left = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::OPEN_PAR)) {
+    if (left.isType(TokenType::OPEN_PAR)) {
         tokenizer->getNextToken();
         auto ret = parseExpression();
         tokenizer->getNextToken(); // Remove closing parenthesis
         return ret;
-    } else if (left->isType(TokenType::NAME)) {
+    } else if (left.isType(TokenType::NAME)) {
         tokenizer->getNextToken();
-        return std::make_unique<Name>(*left);
-    } else if (left->isType(TokenType::INT) || left->isType(TokenType::FLOAT)
-            || left->isType(TokenType::STRING)) {
+        return program->create<Name>(left);
+    } else if (left.isType(TokenType::INT) || left.isType(TokenType::FLOAT)
+            || left.isType(TokenType::STRING)) {
         tokenizer->getNextToken();
-        return std::make_unique<Literal>(*left);
+        return program->create<Literal>(left);
     } else {
         throw std::exception("Wrong type for left operand");
     }
 }
 
 
-std::unique_ptr<Expression> Parser::parseInvocation() {
+NodeId Parser::parseInvocation() {
     auto left = tokenizer->peekNextToken();
     auto leftOperand = parseParentheses();
 
     auto middle = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::NAME) && middle->isType(TokenType::OPEN_PAR)) {
-        auto name = std::make_unique<Name>(*left);
+    if (left.isType(TokenType::NAME) && middle.isType(TokenType::OPEN_PAR)) {
+        Name name(left);
         tokenizer->getNextToken();
 
         bool nextIsComma = false;
-        auto invocation = std::make_unique<Invocation>(name);
+        auto invocationId = program->create<Invocation>(name);
 
         auto next = tokenizer->peekNextToken();
-        while (!next->isType(TokenType::CLOSE_PAR)) {
+        while (!next.isType(TokenType::CLOSE_PAR)) {
             if (nextIsComma) {
-                if (!next->isType(TokenType::COMMA)) {
+                if (!next.isType(TokenType::COMMA)) {
                     throw std::exception("Comma required in argument list");
                 }
 
@@ -50,35 +58,36 @@ std::unique_ptr<Expression> Parser::parseInvocation() {
             }
 
             auto arg = parseExpression();
-            invocation->addArgument(arg);
+            program->get<Invocation>(invocationId).addArgument(arg);
             
             nextIsComma = true;
             next = tokenizer->peekNextToken();
         }
         auto var = tokenizer->getNextToken();
 
-        return invocation;
+        return invocationId;
     } else {
         return leftOperand;
     }
 }
 
 
-std::unique_ptr<Expression> Parser::parseBlock() {
+NodeId Parser::parseBlock() {
     auto left = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::OPEN_BLOCK)) {
+    if (left.isType(TokenType::OPEN_BLOCK)) {
         auto token = tokenizer->getNextToken();
-        auto block = std::make_unique<Block>();
+        auto block = program->create<Block>();
 
-        while (!token->isType(TokenType::END_OF_FILE)
-                && !token->isType(TokenType::CLOSE_BLOCK)) {
-            block->addExpression(parseExpression());
+        while (!token.isType(TokenType::END_OF_FILE)
+                && !token.isType(TokenType::CLOSE_BLOCK)) {
+            auto expr = parseExpression();
+            program->get<Block>(block).addExpression(expr);
             
             token = tokenizer->getNextToken();
         }
 
-        if (token->isType(TokenType::END_OF_FILE)) {
+        if (token.isType(TokenType::END_OF_FILE)) {
             throw std::exception("Block not closed");
         }
 
@@ -89,44 +98,46 @@ std::unique_ptr<Expression> Parser::parseBlock() {
 }
 
 
-std::unique_ptr<Expression> Parser::parseIfExpression() {
+NodeId Parser::parseIfExpression() {
     auto left = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::IF)) {
+    if (left.isType(TokenType::IF)) {
         tokenizer->getNextToken();
         auto condition = parseExpression();
 
-        std::unique_ptr<Block> ifBlock = std::make_unique<Block>();
-        ifBlock->addExpression(parseBlock());
+        auto ifBlock = program->create<Block>();
+        auto ifBody = parseBlock();
+        program->get<Block>(ifBlock).addExpression(ifBody);
 
-        std::unique_ptr<Block> elseBlock = std::make_unique<Block>();
+        auto elseBlock = program->create<Block>();
 
         left = tokenizer->peekNextToken();
-        if (left->isType(TokenType::ELSE)) {
+        if (left.isType(TokenType::ELSE)) {
             tokenizer->getNextToken();
-            elseBlock->addExpression(parseIfExpression());
+            auto elseBody = parseIfExpression();
+            program->get<Block>(elseBlock).addExpression(elseBody);
         }
 
-        return std::make_unique<IfStatement>(condition, ifBlock, elseBlock);
+        return program->create<IfStatement>(condition, ifBlock, elseBlock);
     } else {
         return parseBlock();
     }
 }
 
 
-std::unique_ptr<Expression> Parser::parseFunctionDeclaration() {
+NodeId Parser::parseFunctionDeclaration() {
     auto left = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::FUN)) {
+    if (left.isType(TokenType::FUN)) {
         tokenizer->getNextToken();
 
-        auto functionDeclaration = std::make_shared<CustomFunction>();
+        auto functionDeclaration = std::make_shared<CustomFunction>(*program);
         bool nextIsComma = false;
 
         auto next = tokenizer->peekNextToken();
-        while (!next->isType(TokenType::OPEN_BLOCK)) {
+        while (!next.isType(TokenType::OPEN_BLOCK)) {
             if (nextIsComma) {
-                if (!next->isType(TokenType::COMMA)) {
+                if (!next.isType(TokenType::COMMA)) {
                     throw std::exception("Comma required in parameter list");
                 }
 
@@ -134,11 +145,11 @@ std::unique_ptr<Expression> Parser::parseFunctionDeclaration() {
             }
             next = tokenizer->peekNextToken();
 
-            if (!next->isType(TokenType::NAME)) {
+            if (!next.isType(TokenType::NAME)) {
                 throw std::exception("Only names in parameter list");
             }
 
-            auto name = std::make_unique<Name>(*tokenizer->getNextToken());
+            Name name(tokenizer->getNextToken());
             functionDeclaration->addParameter(name);
 
             nextIsComma = true;
@@ -148,81 +159,147 @@ std::unique_ptr<Expression> Parser::parseFunctionDeclaration() {
         auto body = parseBlock();
         functionDeclaration->setBody(body);
 
-        auto wrapper = std::make_unique<FunctionWrapper>(functionDeclaration);
-        return wrapper;
+        return program->create<FunctionWrapper>(functionDeclaration);
+    } else {
+        return parseLoop();
+    }
+}
+
+
+NodeId Parser::parseLoop() {
+    auto left = tokenizer->peekNextToken();
+
+    if (left.isType(TokenType::WHILE)) {
+        tokenizer->getNextToken();
+        auto condition = parseExpression();
+
+        auto loop = program->create<WhileLoop>(condition);
+        parseLoopBody(loop);
+
+        return loop;
+    } else if (left.isType(TokenType::FOR)) {
+        tokenizer->getNextToken();
+        auto init = parseExpression();
+        expectComma();
+        auto condition = parseExpression();
+        expectComma();
+        auto step = parseExpression();
+
+        auto loop = program->create<ForLoop>(init, condition, step);
+        parseLoopBody(loop);
+
+        return loop;
     } else {
         return parseIfExpression();
     }
 }
 
 
-std::unique_ptr<Expression> Parser::parseMulOrDiv() {
+void Parser::parseLoopBody(NodeId loop) {
+    auto token = tokenizer->getNextToken();
+
+    if (!token.isType(TokenType::OPEN_BLOCK)) {
+        throw std::exception("Loop body must be a block");
+    }
+
+    while (!token.isType(TokenType::END_OF_FILE)
+            && !token.isType(TokenType::CLOSE_BLOCK)) {
+        auto expr = parseExpression();
+        program->get<WhileLoop>(loop).addExpression(expr);
+
+        token = tokenizer->getNextToken();
+    }
+
+    if (token.isType(TokenType::END_OF_FILE)) {
+        throw std::exception("Block not closed");
+    }
+}
+
+
+void Parser::expectComma() {
+    if (!tokenizer->getNextToken().isType(TokenType::COMMA)) {
+        throw std::exception("Comma required in FOR loop");
+    }
+}
+
+
+NodeId Parser::parseMulOrDiv() {
     auto leftOperand = parseFunctionDeclaration();
 
     while (true) {
         auto middle = tokenizer->peekNextToken();
-        if (middle->isType(TokenType::MULTIPLY)) {
+        if (middle.isType(TokenType::MULTIPLY)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<Multiplication>(
-                std::move(leftOperand), parseParentheses());
-        } else if (middle->isType(TokenType::DIVIDE)) {
+            auto rightOperand = parseParentheses();
+            leftOperand = program->create<Multiplication>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::DIVIDE)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<Division>(
-                std::move(leftOperand), parseParentheses());
+            auto rightOperand = parseParentheses();
+            leftOperand = program->create<Division>(
+                leftOperand, rightOperand);
         } else {
             return leftOperand;
         }
     }
 }
 
-std::unique_ptr<Expression> Parser::parseAddOrSub() {
+NodeId Parser::parseAddOrSub() {
     auto leftOperand = parseMulOrDiv();
 
     while (true) {
         auto middle = tokenizer->peekNextToken();
-        if (middle->isType(TokenType::ADD)) {
+        if (middle.isType(TokenType::ADD)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<Addition>(
-                std::move(leftOperand), parseMulOrDiv());
-        } else if (middle->isType(TokenType::SUBTRACT)) {
+            auto rightOperand = parseMulOrDiv();
+            leftOperand = program->create<Addition>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::SUBTRACT)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<Subtraction>(
-                std::move(leftOperand), parseMulOrDiv());
+            auto rightOperand = parseMulOrDiv();
+            leftOperand = program->create<Subtraction>(
+                leftOperand, rightOperand);
         } else {
             return leftOperand;
         }
     }
 }
 
-std::unique_ptr<Expression> Parser::parseComparison() {
+NodeId Parser::parseComparison() {
     auto leftOperand = parseAddOrSub();
 
     while (true) {
         auto middle = tokenizer->peekNextToken();
-        if (middle->isType(TokenType::EQUALS)) {
+        if (middle.isType(TokenType::EQUALS)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<EqualComparison>(
-                std::move(leftOperand), parseAddOrSub());
-        } else if (middle->isType(TokenType::GREATER)) {
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<EqualComparison>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::GREATER)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<GreaterThanComparison>(
-                std::move(leftOperand), parseAddOrSub());
-        } else if (middle->isType(TokenType::GREATER_OR_EQUALS)) {
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<GreaterThanComparison>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::GREATER_OR_EQUALS)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<GreaterThanOrEqualComparison>(
-                std::move(leftOperand), parseAddOrSub());
-        } else if (middle->isType(TokenType::LESS)) {
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<GreaterThanOrEqualComparison>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::LESS)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<LessThanComparison>(
-                std::move(leftOperand), parseAddOrSub());
-        } else if (middle->isType(TokenType::LESS_OR_EQUALS)) {
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<LessThanComparison>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::LESS_OR_EQUALS)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<LessThanOrEqualComparison>(
-                std::move(leftOperand), parseAddOrSub());
-        } else if (middle->isType(TokenType::NOT_EQUALS)) {
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<LessThanOrEqualComparison>(
+                leftOperand, rightOperand);
+        } else if (middle.isType(TokenType::NOT_EQUALS)) {
             tokenizer->getNextToken();
-            leftOperand = std::make_unique<NotEqualComparison>(
-                std::move(leftOperand), parseAddOrSub());
+            auto rightOperand = parseAddOrSub();
+            leftOperand = program->create<NotEqualComparison>(
+                leftOperand, rightOperand);
         } else {
             return leftOperand;
         }
@@ -230,16 +307,17 @@ std::unique_ptr<Expression> Parser::parseComparison() {
 }
 
 
-std::unique_ptr<Expression> Parser::parseAnd() {
+NodeId Parser::parseAnd() {
     auto leftOperand = parseComparison();
 
     while (true) {
         auto middle = tokenizer->peekNextToken();
-        if (middle->isType(TokenType::AND)) {
+        if (middle.isType(TokenType::AND)) {
             tokenizer->getNextToken();
 
-            leftOperand = std::make_unique<AndConnective>(
-                std::move(leftOperand), parseComparison());
+            auto rightOperand = parseComparison();
+            leftOperand = program->create<AndConnective>(
+                leftOperand, rightOperand);
         } else {
             return leftOperand;
         }
@@ -247,16 +325,17 @@ std::unique_ptr<Expression> Parser::parseAnd() {
 }
 
 
-std::unique_ptr<Expression> Parser::parseOr() {
+NodeId Parser::parseOr() {
     auto leftOperand = parseAnd();
 
     while (true) {
         auto middle = tokenizer->peekNextToken();
-        if (middle->isType(TokenType::OR)) {
+        if (middle.isType(TokenType::OR)) {
             tokenizer->getNextToken();
 
-            leftOperand = std::make_unique<OrConnective>(
-                std::move(leftOperand), parseComparison());
+            auto rightOperand = parseComparison();
+            leftOperand = program->create<OrConnective>(
+                leftOperand, rightOperand);
         } else {
             return leftOperand;
         }
@@ -264,33 +343,79 @@ std::unique_ptr<Expression> Parser::parseOr() {
 }
 
 
-std::unique_ptr<Expression> Parser::parseAssignment() {
+NodeId Parser::parseAssignment() {
     auto left = tokenizer->peekNextToken();
     auto leftOperand = parseOr();
 
     auto middle = tokenizer->peekNextToken();
 
-    if (left->isType(TokenType::NAME) && middle->isType(TokenType::ASSIGN)) {
-        auto name = std::make_unique<Name>(*left);
+    if (left.isType(TokenType::NAME) && middle.isType(TokenType::ASSIGN)) {
+        Name name(left);
         tokenizer->getNextToken();
-        return std::make_unique<Assignment>(std::move(name), parseExpression());
+        auto right = parseExpression();
+        return program->create<Assignment>(name, right);
     } else {
         return leftOperand;
     }
 }
 
-std::unique_ptr<Expression> Parser::parseExpression() {
-    return parseAssignment();
+NodeId Parser::parseExpression() {
+    if (depth >= maxDepth) {
+        throw std::exception("Expression nested too deeply");
+    }
+
+    depth++;
+    auto expr = parseAssignment();
+    depth--;
+
+    return expr;
+}
+
+void Parser::setMaxDepth(uint32_t maxDepth) {
+    this->maxDepth = maxDepth;
+}
+
+void Parser::setInlineBudget(uint32_t inlineBudget) {
+    this->inlineBudget = inlineBudget;
+}
+
+uint32_t Parser::getRemovedNodes() const {
+    return removedNodes;
+}
+
+uint32_t Parser::getInlinedCalls() const {
+    return inlinedCalls;
 }
 
-std::unique_ptr<Expression> Parser::parseAll() {
-    auto globalBlock = std::make_unique<Block>();
+std::unique_ptr<Program> Parser::parseAll() {
+    depth = 0;
+    auto globalBlock = program->create<Block>();
 
     auto next = tokenizer->peekNextToken();
-    while (!next->isType(TokenType::END_OF_FILE)) {
-        globalBlock->addExpression(parseExpression());
+    while (!next.isType(TokenType::END_OF_FILE)) {
+        auto expr = parseExpression();
+        program->get<Block>(globalBlock).addExpression(expr);
         next = tokenizer->peekNextToken();
     }
 
-    return globalBlock;
+    program->setRoot(globalBlock);
+
+    uint32_t maxTreeDepth = maxDepth < UINT32_MAX / CHAIN_FACTOR
+        ? maxDepth * CHAIN_FACTOR : UINT32_MAX;
+
+    Optimizer optimizer;
+    optimizer.setMaxDepth(maxDepth, maxTreeDepth);
+    optimizer.setInlineBudget(inlineBudget);
+    optimizer.optimizeProgram(*program);
+    removedNodes = optimizer.getRemovedNodes();
+    inlinedCalls = optimizer.getInlinedCalls();
+
+    Resolver resolver;
+    resolver.setMaxDepth(maxDepth, maxTreeDepth);
+    resolver.resolveProgram(*program);
+
+    auto parsed = std::move(program);
+    program = std::make_unique<Program>();
+
+    return parsed;
 }
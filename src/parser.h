@@ -5,15 +5,37 @@
 #include <memory>
 #include <vector>
 
-#include "expressions.h"
+#include "optimizer.h"
+#include "program.h"
 
 
 /**
  * @brief Parser to turn no-pain code scripts into an expression tree.
  * 
+ * The parser and all passes over the tree recurse on the C++ stack, so the
+ * nesting depth of expressions is limited. Deeper scripts are rejected with
+ * an error instead of overflowing the stack. Chains like a + b + c nest on
+ * the left and do not count, as the parser reads them in a loop. The other
+ * passes recurse along them, but need less stack per expression than the
+ * parser per level, so chains only make the tree CHAIN_FACTOR times deeper
+ * than the limit.
+ * 
  */
 class Parser {
 public:
+    /**
+     * @brief The default limit of the nesting depth of expressions.
+     * 
+     */
+    static const uint32_t DEFAULT_MAX_DEPTH = 1000;
+
+    /**
+     * @brief How many times deeper than the nesting limit chains of
+     * operations may make the tree.
+     * 
+     */
+    static const uint32_t CHAIN_FACTOR = 4;
+
     /**
      * @brief Construct a new Parser object
      * 
@@ -22,115 +44,212 @@ public:
     Parser(std::unique_ptr<Tokenizer>& tokenizer);
 
     /**
-     * @brief Parse all tokens retrievable from the tokenizer
+     * @brief Parse all tokens retrievable from the tokenizer, optimize the
+     * resulting tree and resolve its variables.
      * 
-     * @return std::unique_ptr<Expression> the Expression Tree created from all
-     * tokens
+     * @return std::unique_ptr<Program> the Program holding the Expression
+     * Tree created from all tokens. Its root is a Block.
      */
-    std::unique_ptr<Expression> parseAll();
+    std::unique_ptr<Program> parseAll();
 
     /**
      * @brief Parse one expression.
      * 
-     * @return std::unique_ptr<Expression> The expression that has been parsed.
+     * @return NodeId The expression that has been parsed.
+     */
+    NodeId parseExpression();
+
+    /**
+     * @brief Set the limit of the nesting depth of expressions, both while
+     * parsing and in the resolved tree. Throws if a script exceeds it.
+     * 
+     * @param maxDepth the number of expressions that may be nested.
+     */
+    void setMaxDepth(uint32_t maxDepth);
+
+    /**
+     * @brief Set the number of expressions a call inlined by the Optimizer
+     * may be replaced with. 0 turns inlining off.
+     * 
+     * @param inlineBudget the number of expressions.
      */
-    std::unique_ptr<Expression> parseExpression();
+    void setInlineBudget(uint32_t inlineBudget);
+
+    /**
+     * @brief Get the number of expressions the Optimizer removed from the
+     * last program returned by parseAll.
+     * 
+     * @return uint32_t the number of expressions removed.
+     */
+    uint32_t getRemovedNodes() const;
+
+    /**
+     * @brief Get the number of calls the Optimizer inlined in the last
+     * program returned by parseAll.
+     * 
+     * @return uint32_t the number of calls inlined.
+     */
+    uint32_t getInlinedCalls() const;
+
+    /**
+     * @brief Get the program the parsed expressions are allocated in.
+     * 
+     * @return Program& the program being built.
+     */
+    Program& getProgram();
 
 private:
     /**
      * @brief Attempt to parse a block of expressions.
      * 
-     * @return std::unique_ptr<Expression> the parsed block, or any other
+     * @return NodeId the parsed block, or any other
      * expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseBlock();
+    NodeId parseBlock();
 
     /**
      * @brief Attempt to parse an assignment statement.
      * 
-     * @return std::unique_ptr<Expression> the parsed assignment, or any other
+     * @return NodeId the parsed assignment, or any other
      * expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseAssignment();
+    NodeId parseAssignment();
 
     /**
      * @brief Attempt to parse an or expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed or expression, or any
+     * @return NodeId the parsed or expression, or any
      * other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseOr();
+    NodeId parseOr();
 
     /**
      * @brief Attempt to parse an and expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed and expression, or any
+     * @return NodeId the parsed and expression, or any
      * other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseAnd();
+    NodeId parseAnd();
 
     /**
      * @brief Attempt to parse a comparison expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed comparison expression,
+     * @return NodeId the parsed comparison expression,
      * or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseComparison();
+    NodeId parseComparison();
 
     /**
      * @brief Attempt to parse an addition or subtraction expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed addition/subtraction
+     * @return NodeId the parsed addition/subtraction
      * expression, or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseAddOrSub();
+    NodeId parseAddOrSub();
 
     /**
      * @brief Attempt to parse a multiplication or division expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed multiplication/division
+     * @return NodeId the parsed multiplication/division
      * expression, or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseMulOrDiv();
+    NodeId parseMulOrDiv();
 
     /**
      * @brief Attempt to parse a function declaration expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed function declaration
+     * @return NodeId the parsed function declaration
+     * expression, or any other expression further down the priority tree.
+     */
+    NodeId parseFunctionDeclaration();
+
+    /**
+     * @brief Attempt to parse a WHILE or FOR loop.
+     * 
+     * @return NodeId the parsed loop
      * expression, or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseFunctionDeclaration();
+    NodeId parseLoop();
+
+    /**
+     * @brief Parse the block of a loop into its body.
+     * 
+     * @param loop the WhileLoop or ForLoop to add the expressions to.
+     */
+    void parseLoopBody(NodeId loop);
+
+    /**
+     * @brief Consume a comma separating the parts of a FOR loop.
+     * 
+     */
+    void expectComma();
 
     /**
      * @brief Attempt to parse an if expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed if
+     * @return NodeId the parsed if
      * expression, or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseIfExpression();
+    NodeId parseIfExpression();
 
     /**
      * @brief Attempt to parse an invocation expression.
      * 
-     * @return std::unique_ptr<Expression> the parsed invocation
+     * @return NodeId the parsed invocation
      * expression, or any other expression further down the priority tree.
      */
-    std::unique_ptr<Expression> parseInvocation();
+    NodeId parseInvocation();
 
     /**
      * @brief Attempt to parse parentheses which have priority over anything
      * else.
      * 
-     * @return std::unique_ptr<Expression> the parsed expression which was
+     * @return NodeId the parsed expression which was
      * surrounded by parentheses.
      */
-    std::unique_ptr<Expression> parseParentheses();
+    NodeId parseParentheses();
 
     /**
      * @brief The tokenizer to use to retrieve all tokens.
      * 
      */
     std::unique_ptr<Tokenizer> tokenizer;
+
+    /**
+     * @brief The program all parsed expressions are allocated in.
+     * 
+     */
+    std::unique_ptr<Program> program;
+
+    /**
+     * @brief The number of expressions currently being parsed.
+     * 
+     */
+    uint32_t depth = 0;
+
+    /**
+     * @brief The limit of the nesting depth of expressions.
+     * 
+     */
+    uint32_t maxDepth = DEFAULT_MAX_DEPTH;
+
+    /**
+     * @brief The number of expressions removed from the last program.
+     * 
+     */
+    uint32_t removedNodes = 0;
+
+    /**
+     * @brief The limit of the size of inlined calls.
+     * 
+     */
+    uint32_t inlineBudget = Optimizer::DEFAULT_INLINE_BUDGET;
+
+    /**
+     * @brief The number of calls inlined in the last program.
+     * 
+     */
+    uint32_t inlinedCalls = 0;
 };
 
 
@@ -3,161 +3,172 @@
 
 
 TEST(Parser, SimpleAddition) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 + 5");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 15);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 15);
 }
 
 TEST(Parser, ChainedSubtraction) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("50 - 30 - 10");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 10);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 10);
 }
 
 
 TEST(Parser, MultiplicationAndAddition) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 + 5 * 3");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 25);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 25);
 }
 
 
 TEST(Parser, ArithmeticWithParentheses) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("(10 + 5) * 3");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 45);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 45);
 }
 
 
 TEST(Parser, OrConnective) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 == 11 || 10 == 11 || 5 == 5");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 
 TEST(Parser, Assignment) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("x = (10 + 5) * 3");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
     // Test if assignment passes value through
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 45);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 45);
 
-    auto variable = env->getVariable(std::string("x"));
-    ASSERT_EQ(variable->type, ExpressionValueType::INT);
-    ASSERT_EQ(variable->payloadInt, 45);
+    auto variable = env->getVariable(intern("x"));
+    ASSERT_EQ(variable.type, ExpressionValueType::INT);
+    ASSERT_EQ(variable.payloadInt, 45);
 }
 
 
 TEST(Parser, SimpleEqualityComparisonTrue) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 == 10");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 
 TEST(Parser, SimpleEqualityComparisonFalse) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 == 9");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 0);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 0);
 }
 
 
 TEST(Parser, ChainedEqualityComparison) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("10 == 10 == 1");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
 }
 
 
 TEST(Parser, IfStatementSimple) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     std::unique_ptr<Input> input = std::make_unique<StringInput>("IF 10 == 10 == 1 10 ELSE 5");
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
     auto tree = parser->parseExpression();
-    auto result = tree->evaluate(env);
+    auto result = parser->getProgram().evaluate(tree, env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 10);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 10);
 }
 
 
 TEST(Parser, IfStatementComplex) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     const char* program =
         "   var = 10 == 10         "
@@ -173,16 +184,17 @@ TEST(Parser, IfStatementComplex) {
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
-    auto tree = parser->parseAll();
-    auto result = tree->evaluate(env);
+    auto parsed = parser->parseAll();
+    auto result = parsed->evaluate(env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 25);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 25);
 }
 
 
 TEST(Parser, Invocation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     const char* program = "print(\"TEST\")";
 
@@ -190,13 +202,14 @@ TEST(Parser, Invocation) {
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
-    auto tree = parser->parseAll();
-    auto result = tree->evaluate(env);
+    auto parsed = parser->parseAll();
+    auto result = parsed->evaluate(env);
 }
 
 
 TEST(Parser, FunctionDeclarationAndInvocation) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     const char* program =
         "   func = FUN test {                              "
@@ -209,16 +222,17 @@ TEST(Parser, FunctionDeclarationAndInvocation) {
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
-    auto tree = parser->parseAll();
-    auto result = tree->evaluate(env);
+    auto parsed = parser->parseAll();
+    auto result = parsed->evaluate(env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 1000);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1000);
 }
 
 
 TEST(Parser, RecursiveFibonacci) {
-    std::shared_ptr<Environment> env = std::make_shared<GlobalEnvironment>();
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
 
     const char* program =
         "   fib = FUN x {                         "
@@ -236,10 +250,67 @@ TEST(Parser, RecursiveFibonacci) {
     auto tokenizer = std::make_unique<Tokenizer>(input);
     auto parser = std::make_unique<Parser>(tokenizer);
 
-    auto tree = parser->parseAll();
-    auto result = tree->evaluate(env);
+    auto parsed = parser->parseAll();
+    auto result = parsed->evaluate(env);
 
-    ASSERT_EQ(result->type, ExpressionValueType::INT);
-    ASSERT_EQ(result->payloadInt, 8);
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 8);
 }
 
+
+TEST(Parser, NestingDepthIsLimited) {
+    std::string nested = std::string(200, '(') + "1" + std::string(200, ')');
+    std::string rightNested = "1";
+    for (int i = 0; i < 200; i++) {
+        rightNested += " + (1";
+    }
+    rightNested += std::string(200, ')');
+
+    for (auto script: { nested, rightNested }) {
+        std::unique_ptr<Input> input = std::make_unique<StringInput>(script);
+        auto tokenizer = std::make_unique<Tokenizer>(input);
+        auto parser = std::make_unique<Parser>(tokenizer);
+        parser->setMaxDepth(100);
+
+        ASSERT_THROW(parser->parseAll(), std::exception);
+    }
+}
+
+TEST(Parser, ChainsOfOperationsAreNotNested) {
+    std::string chained = "x = 1 x";
+    for (int i = 1; i < 1500; i++) {
+        chained += " + x";
+    }
+
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(chained);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto program = parser->parseAll();
+
+    GlobalEnvironment globalEnv;
+    auto result = program->evaluate(&globalEnv);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1500);
+}
+
+
+TEST(Parser, ChainsOfOperationsAreLimited) {
+    for (int terms: { 300, 500 }) {
+        std::string chained = "x = 1 x";
+        for (int i = 1; i < terms; i++) {
+            chained += " + x";
+        }
+
+        std::unique_ptr<Input> input = std::make_unique<StringInput>(chained);
+        auto tokenizer = std::make_unique<Tokenizer>(input);
+        auto parser = std::make_unique<Parser>(tokenizer);
+        parser->setMaxDepth(100);
+
+        if (terms < 400) {
+            ASSERT_NO_THROW(parser->parseAll());
+        } else {
+            ASSERT_THROW(parser->parseAll(), std::exception);
+        }
+    }
+}
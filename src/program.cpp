@@ -0,0 +1,45 @@
+#include "program.h"
+
+
+Program::Program(): blockUsed(BLOCK_SIZE), root(NO_NODE) {}
+
+Program::~Program() {
+    for (auto it = nodes.rbegin(); it != nodes.rend(); it++) {
+        (*it)->~Expression();
+    }
+}
+
+void* Program::allocate(size_t size, size_t alignment) {
+    size_t offset = (blockUsed + alignment - 1) & ~(alignment - 1);
+
+    if (offset + size > BLOCK_SIZE) {
+        if (size > BLOCK_SIZE) {
+            throw std::exception("Expression too large for the arena");
+        }
+
+        blocks.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        offset = 0;
+    }
+
+    blockUsed = offset + size;
+
+    return blocks.back().get() + offset;
+}
+
+ExpressionValue Program::evaluate(Environment* env) {
+    NurseryRegion region(Heap::global());
+
+    return evaluate(root, env).escape(region.getMark());
+}
+
+void Program::setRoot(NodeId root) {
+    this->root = root;
+}
+
+NodeId Program::getRoot() const {
+    return root;
+}
+
+uint32_t Program::size() const {
+    return static_cast<uint32_t>(nodes.size());
+}
@@ -0,0 +1,172 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "expressions.h"
+
+
+/**
+ * @brief The expression tree of a parsed script.
+ *
+ * All expressions are allocated contiguously in an arena owned by the
+ * program and refer to each other by NodeId. The arena is freed in one go
+ * when the program is destroyed.
+ *
+ */
+class Program {
+public:
+    /**
+     * @brief Construct a new empty Program object.
+     *
+     */
+    Program();
+
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+
+    /**
+     * @brief Destroy the Program object together with all its expressions.
+     *
+     */
+    ~Program();
+
+    /**
+     * @brief Allocate a new expression in the arena.
+     *
+     * @tparam T the type of the expression.
+     * @param args the arguments passed to the constructor of <T>.
+     * @return NodeId the id of the new expression.
+     */
+    template <typename T, typename... Args>
+    NodeId create(Args&&... args) {
+        void* memory = allocate(sizeof(T), alignof(T));
+        nodes.push_back(new (memory) T(std::forward<Args>(args)...));
+
+        return static_cast<NodeId>(nodes.size() - 1);
+    }
+
+    /**
+     * @brief Get the expression with id <id>.
+     *
+     * @param id the id returned by create.
+     * @return Expression& the expression.
+     */
+    Expression& get(NodeId id) {
+        return *nodes[id];
+    }
+
+    /**
+     * @brief Get the expression with id <id>.
+     *
+     * @param id the id returned by create.
+     * @return const Expression& the expression.
+     */
+    const Expression& get(NodeId id) const {
+        return *nodes[id];
+    }
+
+    /**
+     * @brief Get the expression with id <id> as its concrete type.
+     *
+     * @tparam T the type the expression was created with.
+     * @param id the id returned by create.
+     * @return T& the expression.
+     */
+    template <typename T>
+    T& get(NodeId id) {
+        return static_cast<T&>(*nodes[id]);
+    }
+
+    /**
+     * @brief Evaluate the expression with id <id>.
+     *
+     * @param id the id of the expression.
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue the value of the expression.
+     */
+    ExpressionValue evaluate(NodeId id, Environment* env) {
+        return nodes[id]->evaluate(*this, env);
+    }
+
+    /**
+     * @brief Evaluate the whole program, starting at its root. Everything
+     * the program allocates in the nursery is released when it finishes.
+     *
+     * @param env The environment which provides the context for the variables.
+     * @return ExpressionValue the value of the root expression.
+     */
+    ExpressionValue evaluate(Environment* env);
+
+    /**
+     * @brief Set the root expression, usually the Block holding all top level
+     * expressions.
+     *
+     * @param root the id of the root expression.
+     */
+    void setRoot(NodeId root);
+
+    /**
+     * @brief Get the root expression.
+     *
+     * @return NodeId the id of the root expression.
+     */
+    NodeId getRoot() const;
+
+    /**
+     * @brief Get the number of expressions in this program.
+     *
+     * @return uint32_t the number of expressions.
+     */
+    uint32_t size() const;
+
+private:
+    /**
+     * @brief Reserve memory in the arena, starting a new arena block if the
+     * current one is full.
+     *
+     * @param size the number of bytes to reserve.
+     * @param alignment the alignment the memory needs.
+     * @return void* the reserved memory.
+     */
+    void* allocate(size_t size, size_t alignment);
+
+    /**
+     * @brief The size of every arena block in bytes.
+     *
+     */
+    static const size_t BLOCK_SIZE = 64 * 1024;
+
+    /**
+     * @brief The arena blocks, the last one is filled next.
+     *
+     */
+    std::vector<std::unique_ptr<char[]>> blocks;
+
+    /**
+     * @brief The number of bytes used in the last arena block.
+     *
+     */
+    size_t blockUsed;
+
+    /**
+     * @brief The node table mapping every NodeId to its expression.
+     *
+     */
+    std::vector<Expression*> nodes;
+
+    /**
+     * @brief The root expression.
+     *
+     */
+    NodeId root;
+};
+
+
+#endif
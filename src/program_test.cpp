@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include "parser.h"
+
+
+TEST(Program, NodesAreIndexedInCreationOrder) {
+    Program program;
+
+    Token token(TokenType::INT);
+    token.payloadInt = 10;
+
+    auto left = program.create<Literal>(token);
+    auto right = program.create<Literal>(token);
+    auto addition = program.create<Addition>(left, right);
+
+    ASSERT_EQ(left, 0);
+    ASSERT_EQ(right, 1);
+    ASSERT_EQ(addition, 2);
+    ASSERT_EQ(program.size(), 3);
+    ASSERT_EQ(program.getRoot(), NO_NODE);
+}
+
+
+TEST(Program, ArenaGrowsBeyondOneBlock) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Program program;
+
+    // 1 + 1 + ... + 1 with enough nodes to fill several arena blocks
+    Token token(TokenType::INT);
+    token.payloadInt = 1;
+
+    auto sum = program.create<Literal>(token);
+    for (int i = 1; i < 10000; i++) {
+        auto one = program.create<Literal>(token);
+        sum = program.create<Addition>(sum, one);
+    }
+    program.setRoot(sum);
+
+    auto result = program.evaluate(env);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 10000);
+    ASSERT_EQ(program.size(), 19999);
+}
+
+
+TEST(Program, ParseAllSetsRoot) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>("x = 4 x * 2");
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+
+    auto program = parser->parseAll();
+    ASSERT_NE(program->getRoot(), NO_NODE);
+
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    auto result = program->evaluate(env);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 8);
+}
@@ -0,0 +1,499 @@
+#include "resolver.h"
+
+#include "program.h"
+
+
+void Resolver::resolveProgram(Program& program) {
+    this->program = &program;
+    scopes.clear();
+    tailCallCandidates.clear();
+    dynamicNames.clear();
+    dynamicAssignments = false;
+    purityFacts.clear();
+    openFunctions.clear();
+    functionNames.clear();
+    impureNames.clear();
+    elidedScopes = 0;
+    tailCalls = 0;
+    pureFunctions = 0;
+    depth = 0;
+    leftOperands = 0;
+
+    declarationsComplete = false;
+    resolve(program.getRoot());
+
+    declarationsComplete = true;
+    resolve(program.getRoot());
+
+    markTailCalls();
+    markPureFunctions();
+}
+
+void Resolver::resolve(NodeId id) {
+    resolve(id, false);
+}
+
+void Resolver::resolve(NodeId id, bool tail) {
+    if (depth - leftOperands >= maxDepth || depth >= maxTreeDepth) {
+        throw std::exception("Expression nested too deeply");
+    }
+
+    bool enclosingTail = tailPosition;
+    tailPosition = tail;
+    depth++;
+
+    program->get(id).resolve(*this);
+
+    depth--;
+    tailPosition = enclosingTail;
+}
+
+void Resolver::resolveLeftOperand(NodeId id) {
+    leftOperands++;
+    resolve(id);
+    leftOperands--;
+}
+
+bool Resolver::isTailPosition() const {
+    return tailPosition;
+}
+
+bool Resolver::canElide(const Scope& scope) {
+    if (!declarationsComplete || scope.size() > 0) {
+        return false;
+    }
+
+    elidedScopes++;
+
+    return true;
+}
+
+uint32_t Resolver::getElidedScopes() const {
+    return elidedScopes;
+}
+
+void Resolver::beginScope(Scope& scope) {
+    scopes.push_back(OpenScope{ &scope, &scope, nullptr });
+}
+
+void Resolver::beginFunction(Function& function) {
+    // Captures found while collecting declarations may be stale
+    function.clearCaptures();
+    scopes.push_back(OpenScope{ nullptr, &function.getParameterScope(),
+        &function });
+}
+
+void Resolver::endScope() {
+    scopes.pop_back();
+}
+
+VariableLocation Resolver::lookup(SymbolId name) const {
+    VariableLocation location;
+    uint32_t depth = 0;
+
+    for (auto it = scopes.rbegin(); it != scopes.rend(); it++) {
+        uint32_t slot;
+
+        if (it->scope->find(name, slot)) {
+            location.kind = VariableKind::LOCAL;
+            location.depth = depth;
+            location.slot = slot;
+
+            return location;
+        }
+
+        if (!it->block) {
+            // Free variable of a function, see reference
+            return location;
+        }
+
+        depth++;
+    }
+
+    location.kind = VariableKind::GLOBAL;
+
+    return location;
+}
+
+VariableLocation Resolver::reference(SymbolId name) {
+    auto location = find(name, scopes.size());
+
+    if (location.kind == VariableKind::DYNAMIC) {
+        dynamicNames.insert(name);
+    }
+
+    return location;
+}
+
+VariableLocation Resolver::find(SymbolId name, size_t end) {
+    VariableLocation location;
+    uint32_t depth = 0;
+
+    for (size_t index = end; index > 0; index--) {
+        auto& open = scopes[index - 1];
+        uint32_t slot;
+
+        if (open.scope->find(name, slot)) {
+            size_t function = open.block ? innermostFunction(index - 1) : 0;
+
+            if (function > 0) {
+                // Assignments in a function update the variable of the same
+                // name around it, the variable of the body is only used if
+                // there is none
+                auto outer = capture(name, function, end);
+
+                if (outer.kind == VariableKind::CAPTURED) {
+                    return outer;
+                }
+            }
+
+            location.kind = VariableKind::LOCAL;
+            location.depth = depth;
+            location.slot = slot;
+
+            return location;
+        }
+
+        if (open.function) {
+            return capture(name, index, end);
+        }
+
+        depth++;
+    }
+
+    location.kind = VariableKind::GLOBAL;
+
+    return location;
+}
+
+VariableLocation Resolver::capture(SymbolId name, size_t function,
+        size_t end) {
+    // Looked up from where the function is defined
+    auto outer = find(name, function - 1);
+
+    if (outer.kind == VariableKind::GLOBAL) {
+        return outer;
+    }
+
+    VariableLocation location;
+    location.kind = VariableKind::CAPTURED;
+    location.depth = static_cast<uint32_t>(end - function);
+    location.slot = scopes[function - 1].function->capture(outer);
+
+    if (declarationsComplete) {
+        // The closure keeps the environments up to the enclosing function
+        // alive, so none of them may live in the nursery
+        for (size_t index = function - 1; index > 0; index--) {
+            scopes[index - 1].scope->setCaptured();
+
+            if (scopes[index - 1].function) {
+                break;
+            }
+        }
+    }
+
+    return location;
+}
+
+size_t Resolver::innermostFunction(size_t end) const {
+    for (size_t index = end; index > 0; index--) {
+        if (scopes[index - 1].function) {
+            return index;
+        }
+    }
+
+    return 0;
+}
+
+VariableLocation Resolver::declare(SymbolId name) {
+    auto location = find(name, scopes.size());
+
+    if (location.kind == VariableKind::LOCAL
+            || location.kind == VariableKind::CAPTURED) {
+        return location;
+    }
+
+    if (scopes.empty() || !scopes.back().block) {
+        // No block to declare the variable in, assign it by name
+        dynamicAssignments = true;
+        dynamicNames.insert(name);
+
+        return VariableLocation();
+    }
+
+    location.kind = VariableKind::LOCAL;
+    location.depth = 0;
+    location.slot = scopes.back().block->declare(name);
+
+    return location;
+}
+
+void Resolver::addTailCall(Invocation& invocation) {
+    if (!declarationsComplete) {
+        return;
+    }
+
+    TailCallCandidate candidate{ &invocation, {} };
+
+    for (auto it = scopes.rbegin(); it != scopes.rend(); it++) {
+        candidate.frames.push_back(it->scope);
+
+        if (!it->block) {
+            tailCallCandidates.push_back(std::move(candidate));
+
+            return;
+        }
+    }
+
+    // Not inside a function, there is nothing to return to
+}
+
+uint32_t Resolver::getTailCalls() const {
+    return tailCalls;
+}
+
+void Resolver::setMaxDepth(uint32_t maxDepth, uint32_t maxTreeDepth) {
+    this->maxDepth = maxDepth;
+    this->maxTreeDepth = maxTreeDepth;
+}
+
+void Resolver::beginPurityCheck(CustomFunction& function) {
+    if (!declarationsComplete) {
+        return;
+    }
+
+    // Parameters may be bound to any value by the caller
+    auto& names = function.getParameterNames();
+    impureNames.insert(names.begin(), names.end());
+
+    openFunctions.push_back(purityFacts.size());
+    purityFacts.push_back(PurityFacts{ &function, true, {} });
+}
+
+void Resolver::endPurityCheck() {
+    if (!declarationsComplete) {
+        return;
+    }
+
+    openFunctions.pop_back();
+}
+
+void Resolver::markImpure() {
+    if (!openFunctions.empty()) {
+        purityFacts[openFunctions.back()].pure = false;
+    }
+}
+
+void Resolver::addCallee(SymbolId name) {
+    if (!openFunctions.empty()) {
+        purityFacts[openFunctions.back()].callees.insert(name);
+    }
+}
+
+void Resolver::addAssignment(SymbolId name, NodeId value) {
+    if (!declarationsComplete) {
+        return;
+    }
+
+    auto wrapper = dynamic_cast<FunctionWrapper*>(&program->get(value));
+    if (!wrapper || functionNames.count(name) > 0) {
+        impureNames.insert(name);
+        return;
+    }
+
+    // The function was resolved right before, search from the end
+    for (size_t index = purityFacts.size(); index > 0; index--) {
+        if (purityFacts[index - 1].function == &wrapper->getFunction()) {
+            functionNames[name] = index - 1;
+            return;
+        }
+    }
+}
+
+uint32_t Resolver::getPureFunctions() const {
+    return pureFunctions;
+}
+
+bool Resolver::isPureFunctionName(SymbolId name) const {
+    auto function = functionNames.find(name);
+
+    return impureNames.count(name) == 0 && function != functionNames.end()
+        && purityFacts[function->second].pure;
+}
+
+void Resolver::markPureFunctions() {
+    bool changed = true;
+
+    while (changed) {
+        changed = false;
+
+        for (auto it = purityFacts.begin(); it != purityFacts.end(); it++) {
+            if (!it->pure) {
+                continue;
+            }
+
+            for (auto callee = it->callees.begin();
+                    callee != it->callees.end(); callee++) {
+                if (!isPureFunctionName(*callee)) {
+                    it->pure = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (auto it = purityFacts.begin(); it != purityFacts.end(); it++) {
+        it->function->setPure(it->pure);
+
+        if (it->pure) {
+            pureFunctions++;
+        }
+    }
+}
+
+void Resolver::markTailCalls() {
+    if (dynamicAssignments) {
+        return;
+    }
+
+    for (auto it = tailCallCandidates.begin();
+            it != tailCallCandidates.end(); it++) {
+        bool shadows = false;
+
+        for (auto frame = it->frames.begin(); frame != it->frames.end();
+                frame++) {
+            auto& names = (*frame)->getNames();
+
+            for (auto name = names.begin(); name != names.end(); name++) {
+                shadows = shadows || dynamicNames.count(*name) > 0;
+            }
+        }
+
+        if (!shadows) {
+            it->invocation->setTailCall(true);
+            tailCalls++;
+        }
+    }
+}
+
+
+void Literal::resolve(Resolver& resolver) {}
+
+
+void Name::resolve(Resolver& resolver) {
+    location = resolver.reference(name);
+
+    if (location.kind != VariableKind::LOCAL) {
+        resolver.markImpure();
+    }
+}
+
+
+void BinaryOperation::resolve(Resolver& resolver) {
+    resolver.resolveLeftOperand(left);
+    resolver.resolve(right);
+}
+
+
+void Assignment::resolve(Resolver& resolver) {
+    resolver.resolve(right);
+    left.location = resolver.declare(left.name);
+
+    if (left.location.kind != VariableKind::LOCAL) {
+        resolver.markImpure();
+    }
+    resolver.addAssignment(left.name, right);
+}
+
+
+void Block::resolve(Resolver& resolver) {
+    needsEnvironment = !resolver.canElide(scope);
+
+    if (needsEnvironment) {
+        resolver.beginScope(scope);
+    }
+
+    for (auto it = exprList.begin(); it != exprList.end(); it++) {
+        resolver.resolve(*it,
+            it == exprList.end() - 1 && resolver.isTailPosition());
+    }
+
+    if (needsEnvironment) {
+        resolver.endScope();
+    }
+}
+
+
+void IfStatement::resolve(Resolver& resolver) {
+    resolver.resolve(condition);
+    resolver.resolve(ifBlock, resolver.isTailPosition());
+
+    if (elseBlock != NO_NODE) {
+        resolver.resolve(elseBlock, resolver.isTailPosition());
+    }
+}
+
+
+void WhileLoop::resolve(Resolver& resolver) {
+    needsEnvironment = !resolver.canElide(scope);
+
+    if (needsEnvironment) {
+        resolver.beginScope(scope);
+    }
+
+    resolver.resolve(condition);
+
+    for (auto it = body.begin(); it != body.end(); it++) {
+        resolver.resolve(*it);
+    }
+
+    if (step != NO_NODE) {
+        resolver.resolve(step);
+    }
+
+    if (needsEnvironment) {
+        resolver.endScope();
+    }
+}
+
+
+void ForLoop::resolve(Resolver& resolver) {
+    resolver.resolve(init);
+    WhileLoop::resolve(resolver);
+}
+
+
+void CustomFunction::resolve(Resolver& resolver) {
+    resolver.beginFunction(*this);
+    resolver.beginPurityCheck(*this);
+    resolver.resolve(body, true);
+    resolver.endPurityCheck();
+    resolver.endScope();
+}
+
+
+void FunctionWrapper::resolve(Resolver& resolver) {
+    function->resolve(resolver);
+}
+
+
+void Invocation::resolve(Resolver& resolver) {
+    functionLocation = resolver.reference(functionName);
+    tailCall = false;
+
+    if (functionLocation.kind == VariableKind::LOCAL) {
+        // A parameter or variable of the function, which may hold anything
+        resolver.markImpure();
+    } else {
+        resolver.addCallee(functionName);
+    }
+
+    if (resolver.isTailPosition()) {
+        resolver.addTailCall(*this);
+    }
+
+    for (auto it = arguments.begin(); it != arguments.end(); it++) {
+        resolver.resolve(*it);
+    }
+}
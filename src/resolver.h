@@ -0,0 +1,480 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "expressions.h"
+
+
+/**
+ * @brief Static pass which assigns every variable reference a location in
+ * the environments created at runtime.
+ *
+ * The resolver walks the tree in evaluation order and mirrors the chain of
+ * environments: every Block and every function call opens a scope. Names
+ * found in a scope of the enclosing function resolve to a (depth, slot)
+ * pair. Names not found there are free variables of the function. They are
+ * looked up lexically, where the function is defined, and the function
+ * captures them: the variable gets an index in the closure record of the
+ * function, see Function::capture. Only the variables the body actually
+ * references are captured. The scopes declaring them are marked captured,
+ * so their environments outlive the closures. Names not found anywhere are
+ * globals like print. Assignments update the variable of the same name
+ * around the function, which is captured the same way, unless it is hidden
+ * by a parameter. Only names not declared around the function declare a
+ * new variable in the innermost block.
+ *
+ * Variables around a function may be declared after it, so a name the first
+ * pass declares in the function may still resolve to the variable around
+ * it in the second pass. Its slot in the function is never used then.
+ *
+ * A program is resolved twice. The first pass collects all declarations,
+ * the second pass leaves out blocks which declare nothing. Those blocks are
+ * evaluated in the environment around them, so they do not count towards
+ * the depth of a location.
+ *
+ * Invocations that are the last expression of a function body, also through
+ * blocks and the branches of if statements, are made tail calls. A tail
+ * call leaves out the environments of the function making it, so it is
+ * only made if none of them declares a name that is looked up dynamically
+ * anywhere in the program, and only if no assignment is resolved
+ * dynamically.
+ *
+ * Functions are marked pure if their body only reads and assigns its own
+ * variables and only calls names of pure functions. A name counts as the
+ * name of a pure function if it is assigned exactly one function anywhere
+ * in the program, that function is pure and the name is no parameter and
+ * is assigned nothing else. Calling print, or anything else not defined in
+ * the program, makes a function impure.
+ *
+ */
+class Resolver {
+public:
+    /**
+     * @brief Resolve a whole program, usually the one returned by
+     * Parser::parseAll.
+     *
+     * @param program the program to resolve, starting at its root.
+     */
+    void resolveProgram(Program& program);
+
+    /**
+     * @brief Resolve an expression of the program being resolved.
+     *
+     * @param id the id of the expression.
+     */
+    void resolve(NodeId id);
+
+    /**
+     * @brief Resolve an expression of the program being resolved, which may
+     * be in tail position.
+     *
+     * @param id the id of the expression.
+     * @param tail whether the value of the expression is returned by the
+     * function around it.
+     */
+    void resolve(NodeId id, bool tail);
+
+    /**
+     * @brief Resolve the left operand of a binary operation. Chains like
+     * a + b + c nest on the left, which does not count towards the limit of
+     * the depth.
+     *
+     * @param id the id of the operand.
+     */
+    void resolveLeftOperand(NodeId id);
+
+    /**
+     * @brief Check whether the expression being resolved is in tail
+     * position.
+     *
+     * @return true if its value is returned by the function around it.
+     * @return false otherwise.
+     */
+    bool isTailPosition() const;
+
+    /**
+     * @brief Check whether a block can be evaluated without its own
+     * environment. Always false until all declarations are collected.
+     *
+     * @param scope the scope of the block.
+     * @return true if the block declares no variables and does not need to
+     * be opened with beginScope.
+     * @return false otherwise.
+     */
+    bool canElide(const Scope& scope);
+
+    /**
+     * @brief Get the number of blocks found in the last program which do
+     * not need their own environment.
+     *
+     * @return uint32_t the number of blocks.
+     */
+    uint32_t getElidedScopes() const;
+
+    /**
+     * @brief Open the scope of a block.
+     *
+     * @param scope the scope variables of the block are declared in.
+     */
+    void beginScope(Scope& scope);
+
+    /**
+     * @brief Open the parameter scope of a function. Lookups do not
+     * continue past it, references of names declared outside are captured.
+     *
+     * @param function the function whose body is resolved next.
+     */
+    void beginFunction(Function& function);
+
+    /**
+     * @brief Close the innermost scope.
+     *
+     */
+    void endScope();
+
+    /**
+     * @brief Find the location of a variable that is read, within the
+     * innermost function.
+     *
+     * @param name the name of the variable.
+     * @return VariableLocation where the variable is found at runtime.
+     */
+    VariableLocation lookup(SymbolId name) const;
+
+    /**
+     * @brief Find the location of a variable that is read by an expression
+     * of the program, capturing free variables of functions.
+     *
+     * @param name the name of the variable.
+     * @return VariableLocation where the variable is found at runtime.
+     */
+    VariableLocation reference(SymbolId name);
+
+    /**
+     * @brief Find the location of a variable that is assigned, declaring it
+     * in the innermost block if it is not found in the function or around
+     * it.
+     *
+     * @param name the name of the variable.
+     * @return VariableLocation where the variable is stored at runtime.
+     */
+    VariableLocation declare(SymbolId name);
+
+    /**
+     * @brief Consider an invocation in tail position for a tail call.
+     *
+     * @param invocation the invocation.
+     */
+    void addTailCall(Invocation& invocation);
+
+    /**
+     * @brief Get the number of tail calls found in the last program.
+     *
+     * @return uint32_t the number of invocations made tail calls.
+     */
+    uint32_t getTailCalls() const;
+
+    /**
+     * @brief Set the limits of the depth of the tree. Resolving a deeper
+     * program throws, before any other pass recurses that deep.
+     *
+     * @param maxDepth the number of expressions that may be nested, not
+     * counting left operands of binary operations.
+     * @param maxTreeDepth the number of expressions that may be nested
+     * counting them, which still limits long chains like a + b + c.
+     */
+    void setMaxDepth(uint32_t maxDepth, uint32_t maxTreeDepth);
+
+    /**
+     * @brief Start collecting what the body of a function reads, assigns
+     * and calls.
+     *
+     * @param function the function whose body is resolved next.
+     */
+    void beginPurityCheck(CustomFunction& function);
+
+    /**
+     * @brief Stop collecting for the innermost function.
+     *
+     */
+    void endPurityCheck();
+
+    /**
+     * @brief Mark the innermost function as impure, e.g. because it reads
+     * a variable of its caller.
+     *
+     */
+    void markImpure();
+
+    /**
+     * @brief Record a call of the function stored under <name> by the
+     * innermost function.
+     *
+     * @param name the name of the function called.
+     */
+    void addCallee(SymbolId name);
+
+    /**
+     * @brief Record an assignment of the expression <value> to <name>.
+     *
+     * @param name the name assigned to.
+     * @param value the expression assigned.
+     */
+    void addAssignment(SymbolId name, NodeId value);
+
+    /**
+     * @brief Get the number of functions found to be pure in the last
+     * program.
+     *
+     * @return uint32_t the number of pure functions.
+     */
+    uint32_t getPureFunctions() const;
+
+private:
+    /**
+     * @brief A scope that is currently open.
+     *
+     */
+    struct OpenScope {
+        /**
+         * @brief The scope of a block, nullptr for a parameter scope.
+         *
+         */
+        Scope* block;
+
+        /**
+         * @brief The scope searched by lookups.
+         *
+         */
+        Scope* scope;
+
+        /**
+         * @brief The function whose parameters <scope> declares, nullptr for
+         * the scope of a block.
+         *
+         */
+        Function* function;
+    };
+
+    /**
+     * @brief An invocation in tail position of a function.
+     *
+     */
+    struct TailCallCandidate {
+        /**
+         * @brief The invocation.
+         *
+         */
+        Invocation* invocation;
+
+        /**
+         * @brief The scopes of the function around the invocation, whose
+         * environments a tail call leaves out.
+         *
+         */
+        std::vector<const Scope*> frames;
+    };
+
+    /**
+     * @brief What the body of a function does that decides its purity.
+     *
+     */
+    struct PurityFacts {
+        /**
+         * @brief The function.
+         *
+         */
+        CustomFunction* function;
+
+        /**
+         * @brief Whether nothing found so far makes the function impure.
+         *
+         */
+        bool pure;
+
+        /**
+         * @brief The names of the functions called by the body.
+         *
+         */
+        std::unordered_set<SymbolId> callees;
+    };
+
+    /**
+     * @brief Find the location of a variable in the scopes open around a
+     * point, capturing it in the functions it is free in. A variable of a
+     * function body is skipped if the name is declared around the function.
+     *
+     * @param name the name of the variable.
+     * @param end the number of open scopes, from the outermost, to search.
+     * @return VariableLocation where the variable is found at runtime from
+     * the innermost of the scopes.
+     */
+    VariableLocation find(SymbolId name, size_t end);
+
+    /**
+     * @brief Capture a free variable of a function.
+     *
+     * @param name the name of the variable.
+     * @param function the number of open scopes up to and including the
+     * parameter scope of the function.
+     * @param end the number of open scopes at the reference.
+     * @return VariableLocation the captured variable, GLOBAL if it is not
+     * declared around the function.
+     */
+    VariableLocation capture(SymbolId name, size_t function, size_t end);
+
+    /**
+     * @brief Find the innermost function open around a point.
+     *
+     * @param end the number of open scopes, from the outermost, to search.
+     * @return size_t the number of open scopes up to and including its
+     * parameter scope, 0 at the top level.
+     */
+    size_t innermostFunction(size_t end) const;
+
+    /**
+     * @brief Make the candidates tail calls whose frames declare no name
+     * that is looked up dynamically.
+     *
+     */
+    void markTailCalls();
+
+    /**
+     * @brief Mark the functions pure that only call pure functions, starting
+     * from the assumption that all functions without impure bodies are.
+     *
+     */
+    void markPureFunctions();
+
+    /**
+     * @brief Check whether a name refers to a pure function wherever it is
+     * looked up.
+     *
+     * @param name the name.
+     * @return true if it is the name of exactly one function, which is pure.
+     * @return false otherwise.
+     */
+    bool isPureFunctionName(SymbolId name) const;
+
+    /**
+     * @brief The open scopes, innermost last.
+     *
+     */
+    std::vector<OpenScope> scopes;
+
+    /**
+     * @brief The invocations in tail position of a function.
+     *
+     */
+    std::vector<TailCallCandidate> tailCallCandidates;
+
+    /**
+     * @brief The names looked up dynamically anywhere in the program.
+     *
+     */
+    std::unordered_set<SymbolId> dynamicNames;
+
+    /**
+     * @brief The facts of all functions in the program.
+     *
+     */
+    std::vector<PurityFacts> purityFacts;
+
+    /**
+     * @brief The indices into <purityFacts> of the functions being
+     * resolved, innermost last.
+     *
+     */
+    std::vector<size_t> openFunctions;
+
+    /**
+     * @brief The index into <purityFacts> of the only function assigned to
+     * a name.
+     *
+     */
+    std::unordered_map<SymbolId, size_t> functionNames;
+
+    /**
+     * @brief The names which are parameters, are assigned something else
+     * than a function or more than one function.
+     *
+     */
+    std::unordered_set<SymbolId> impureNames;
+
+    /**
+     * @brief Whether an assignment was resolved dynamically, which may
+     * store to any environment on the chain.
+     *
+     */
+    bool dynamicAssignments = false;
+
+    /**
+     * @brief Whether the expression being resolved is in tail position.
+     *
+     */
+    bool tailPosition = false;
+
+    /**
+     * @brief The number of expressions currently being resolved.
+     *
+     */
+    uint32_t depth = 0;
+
+    /**
+     * @brief The number of left operands among the expressions currently
+     * being resolved, which are not counted against <maxDepth>.
+     *
+     */
+    uint32_t leftOperands = 0;
+
+    /**
+     * @brief The limit of the depth of the tree, without the left operands.
+     *
+     */
+    uint32_t maxDepth = UINT32_MAX;
+
+    /**
+     * @brief The limit of the depth of the tree, with the left operands.
+     *
+     */
+    uint32_t maxTreeDepth = UINT32_MAX;
+
+    /**
+     * @brief The program being resolved.
+     *
+     */
+    Program* program = nullptr;
+
+    /**
+     * @brief Whether all declarations of the program are known.
+     *
+     */
+    bool declarationsComplete = false;
+
+    /**
+     * @brief The number of blocks found not to need an environment.
+     *
+     */
+    uint32_t elidedScopes = 0;
+
+    /**
+     * @brief The number of invocations made tail calls.
+     *
+     */
+    uint32_t tailCalls = 0;
+
+    /**
+     * @brief The number of functions found to be pure.
+     *
+     */
+    uint32_t pureFunctions = 0;
+};
+
+
+#endif
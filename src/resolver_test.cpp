@@ -0,0 +1,320 @@
+#include <gtest/gtest.h>
+
+#include "parser.h"
+#include "resolver.h"
+
+
+ExpressionValue evaluateResolved(const char* program) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+
+    auto parsed = parser->parseAll();
+
+    return parsed->evaluate(env);
+}
+
+
+TEST(Resolver, DeclareInBlock) {
+    Resolver resolver;
+    Scope scope;
+
+    resolver.beginScope(scope);
+
+    auto x = resolver.declare(intern("x"));
+    auto y = resolver.declare(intern("y"));
+    auto xAgain = resolver.lookup(intern("x"));
+
+    ASSERT_EQ(x.kind, VariableKind::LOCAL);
+    ASSERT_EQ(x.depth, 0);
+    ASSERT_EQ(x.slot, 0);
+    ASSERT_EQ(y.slot, 1);
+    ASSERT_EQ(xAgain.kind, VariableKind::LOCAL);
+    ASSERT_EQ(xAgain.slot, 0);
+    ASSERT_EQ(scope.size(), 2);
+
+    resolver.endScope();
+}
+
+TEST(Resolver, UndeclaredAtTopLevelIsGlobal) {
+    Resolver resolver;
+    Scope scope;
+
+    resolver.beginScope(scope);
+
+    auto print = resolver.lookup(intern("print"));
+    ASSERT_EQ(print.kind, VariableKind::GLOBAL);
+
+    resolver.endScope();
+}
+
+TEST(Resolver, NestedBlocksCountDepth) {
+    Resolver resolver;
+    Scope outer;
+    Scope inner;
+
+    resolver.beginScope(outer);
+    resolver.declare(intern("a"));
+    resolver.declare(intern("b"));
+
+    resolver.beginScope(inner);
+    auto b = resolver.lookup(intern("b"));
+
+    ASSERT_EQ(b.kind, VariableKind::LOCAL);
+    ASSERT_EQ(b.depth, 1);
+    ASSERT_EQ(b.slot, 1);
+
+    resolver.endScope();
+    resolver.endScope();
+}
+
+TEST(Resolver, FunctionBoundary) {
+    Resolver resolver;
+    Program program;
+    CustomFunction function(program);
+    Scope global;
+    Scope body;
+
+    auto& parameters = function.getParameterScope();
+    parameters.declare(intern("n"));
+
+    resolver.beginScope(global);
+    resolver.declare(intern("outer"));
+
+    resolver.beginFunction(function);
+    resolver.beginScope(body);
+
+    auto n = resolver.lookup(intern("n"));
+    ASSERT_EQ(n.kind, VariableKind::LOCAL);
+    ASSERT_EQ(n.depth, 1);
+    ASSERT_EQ(n.slot, 0);
+
+    auto outer = resolver.lookup(intern("outer"));
+    ASSERT_EQ(outer.kind, VariableKind::DYNAMIC);
+
+    // References capture the variable where the function is defined
+    auto captured = resolver.reference(intern("outer"));
+    ASSERT_EQ(captured.kind, VariableKind::CAPTURED);
+    ASSERT_EQ(captured.depth, 1);
+    ASSERT_EQ(captured.slot, 0);
+    ASSERT_EQ(function.getCaptures().size(), 1);
+    ASSERT_EQ(function.getCaptures()[0].kind, VariableKind::LOCAL);
+    ASSERT_EQ(function.getCaptures()[0].depth, 0);
+    ASSERT_EQ(function.getCaptures()[0].slot, 0);
+
+    // Assignments update the captured variable, unknown names are declared
+    // in the body
+    auto assigned = resolver.declare(intern("outer"));
+    ASSERT_EQ(assigned.kind, VariableKind::CAPTURED);
+    ASSERT_EQ(assigned.slot, 0);
+    ASSERT_EQ(body.size(), 0);
+
+    auto local = resolver.declare(intern("inner"));
+    ASSERT_EQ(local.kind, VariableKind::LOCAL);
+    ASSERT_EQ(local.depth, 0);
+    ASSERT_EQ(body.size(), 1);
+    ASSERT_EQ(parameters.size(), 1);
+
+    // Parameters hide the variables around the function
+    auto parameter = resolver.declare(intern("n"));
+    ASSERT_EQ(parameter.kind, VariableKind::LOCAL);
+    ASSERT_EQ(parameter.depth, 1);
+
+    resolver.endScope();
+    resolver.endScope();
+    resolver.endScope();
+}
+
+TEST(Resolver, FunctionLocals) {
+    auto result = evaluateResolved(
+        "   f = FUN n { a = n * 2; a + 1 }        "
+        "   f(20)                                 ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 41);
+}
+
+TEST(Resolver, FreeVariableIsLookedUpWhereFunctionIsDefined) {
+    auto result = evaluateResolved(
+        "   outer = 1                             "
+        "   get = FUN { outer }                   "
+        "   call = FUN outer { get() }            "
+        "   call(42)                              ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
+}
+
+TEST(Resolver, OnlyReferencedVariablesAreCaptured) {
+    Resolver resolver;
+    Program program;
+    CustomFunction function(program);
+    CustomFunction inner(program);
+    Scope global;
+
+    resolver.beginScope(global);
+    resolver.declare(intern("a"));
+    resolver.declare(intern("b"));
+    resolver.declare(intern("c"));
+
+    resolver.beginFunction(function);
+    resolver.reference(intern("c"));
+    resolver.reference(intern("a"));
+
+    // The inner function captures a from the capture list of the outer one
+    resolver.beginFunction(inner);
+    auto a = resolver.reference(intern("a"));
+    auto print = resolver.reference(intern("print"));
+    resolver.endScope();
+
+    resolver.endScope();
+    resolver.endScope();
+
+    ASSERT_EQ(function.getCaptures().size(), 2);
+    ASSERT_EQ(function.getCaptures()[0].slot, 2);
+    ASSERT_EQ(function.getCaptures()[1].slot, 0);
+
+    ASSERT_EQ(a.kind, VariableKind::CAPTURED);
+    ASSERT_EQ(a.depth, 0);
+    ASSERT_EQ(a.slot, 0);
+    ASSERT_EQ(inner.getCaptures().size(), 1);
+    ASSERT_EQ(inner.getCaptures()[0].kind, VariableKind::CAPTURED);
+    ASSERT_EQ(inner.getCaptures()[0].slot, 1);
+    ASSERT_EQ(print.kind, VariableKind::GLOBAL);
+}
+
+TEST(Resolver, AssignmentInFunctionUpdatesOuterVariable) {
+    auto result = evaluateResolved(
+        "   count = 0                             "
+        "   inc = FUN { count = count + 1 }       "
+        "   inc() inc()                           "
+        "   count                                 ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 2);
+
+    // Also for variables assigned after the function is defined, but not
+    // for parameters of the same name
+    result = evaluateResolved(
+        "   set = FUN { x = 5 }                   "
+        "   setParameter = FUN x { x = 7 }        "
+        "   x = 1                                 "
+        "   set() setParameter(3)                 "
+        "   x                                     ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 5);
+
+    // Nested functions update the same variable as the function around them
+    result = evaluateResolved(
+        "   set = FUN {                           "
+        "      x = 2; scale = FUN { x = x * 10 }; scale()"
+        "   }                                     "
+        "   x = 1                                 "
+        "   set()                                 "
+        "   x                                     ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 20);
+}
+
+TEST(Resolver, BlocksWithoutVariablesAreElided) {
+    // The branches of the IF are wrapped in two blocks each, none of them
+    // declares a variable.
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(
+        "   x = 3                                 "
+        "   IF x > 2 { y = 1; y } ELSE { x }      ");
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+
+    auto& program = parser->getProgram();
+    auto assignment = parser->parseExpression();
+    auto ifStmt = parser->parseExpression();
+
+    auto block = program.create<Block>();
+    program.get<Block>(block).addExpression(assignment);
+    program.get<Block>(block).addExpression(ifStmt);
+    program.setRoot(block);
+
+    Resolver resolver;
+    resolver.resolveProgram(program);
+
+    ASSERT_EQ(resolver.getElidedScopes(), 3);
+
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+    Block::resetElidedEnvironments();
+
+    auto result = program.evaluate(env);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 1);
+    ASSERT_EQ(Block::getElidedEnvironments(), 1);
+}
+
+TEST(Resolver, ElidedBlocksKeepDepth) {
+    auto result = evaluateResolved(
+        "   a = 1                                 "
+        "   f = FUN n { IF n > 0 { b = n; IF b > 1 { a + b } ELSE { b } } ELSE { a } }"
+        "   f(5)                                  ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 6);
+}
+
+TEST(Resolver, InvocationsInTailPositionAreTailCalls) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(
+        "   f = FUN n { IF n > 0 { b = n; f(b - 1) } ELSE { g(n) } }"
+        "   g = FUN n { print(\"\"); n + f(0) }   "
+        "   f(1)                                  ");
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto root = parser->parseAll();
+
+    Resolver resolver;
+    resolver.resolveProgram(*root);
+
+    // f(b - 1) and g(n), but neither print nor f(0) nor the top level call
+    ASSERT_EQ(resolver.getTailCalls(), 2);
+}
+
+TEST(Resolver, TailCallsMayLeaveOutVariablesOfTheCaller) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(
+        "   outer = 1                             "
+        "   get = FUN { outer }                   "
+        "   call = FUN outer { get() }            "
+        "   call(42)                              ");
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto root = parser->parseAll();
+
+    Resolver resolver;
+    resolver.resolveProgram(*root);
+
+    // get never sees the parameter of call
+    ASSERT_EQ(resolver.getTailCalls(), 1);
+}
+
+TEST(Resolver, FunctionsOnlyUsingTheirArgumentsArePure) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(
+        "   f = FUN x { x * 2 }                   "
+        "   g = FUN x { print(\"g\"); x }         "
+        "   h = FUN x { IF x > 0 { h(x - 1) } ELSE { f(x) } }"
+        "   k = FUN x { g(x) }                    "
+        "   y = 1                                 "
+        "   r = FUN x { x + y }                   "
+        "   p = FUN f { f(1) }                    "
+        "   h(3)                                  ");
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+    auto root = parser->parseAll();
+
+    Resolver resolver;
+    resolver.resolveProgram(*root);
+
+    // f itself, but not h as f is also a parameter of p
+    ASSERT_EQ(resolver.getPureFunctions(), 1);
+}
@@ -0,0 +1,250 @@
+#include "scan.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SCAN_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only compile AVX2 intrinsics in functions marked for it,
+// MSVC accepts them anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+
+namespace {
+
+typedef const char* (*ScanFunction)(const char*, const char*);
+
+
+template <CharClass C>
+const char* scanScalar(const char* begin, const char* end) {
+    while (begin < end && isInClass(C, *begin)) {
+        begin++;
+    }
+
+    return begin;
+}
+
+
+#ifdef SCAN_X86_64
+
+inline uint32_t countTrailingZeros(uint32_t mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+
+/**
+ * @brief Mark the bytes in [low, low + range], compared unsigned.
+ * 
+ */
+inline __m128i inRange(__m128i chars, char low, char range) {
+    __m128i offset = _mm_sub_epi8(chars, _mm_set1_epi8(low));
+    return _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(range)), offset);
+}
+
+/**
+ * @brief Mark the bytes which are in the character class <C>, the vector
+ * version of isInClass.
+ * 
+ */
+template <CharClass C>
+inline __m128i classify(__m128i chars) {
+    switch (C) {
+        case CharClass::WHITESPACE:
+            return _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')),
+                inRange(chars, '\t', '\r' - '\t'));
+        case CharClass::NAME:
+            return inRange(_mm_or_si128(chars, _mm_set1_epi8(0x20)),
+                'a', 'z' - 'a');
+        case CharClass::NUMBER:
+            return _mm_or_si128(inRange(chars, '0', 9),
+                _mm_cmpeq_epi8(chars, _mm_set1_epi8('.')));
+        case CharClass::STRING_BODY:
+        default:
+            __m128i stop = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')),
+                    _mm_cmpeq_epi8(chars, _mm_set1_epi8('\\'))),
+                _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+            return _mm_xor_si128(stop, _mm_set1_epi8(-1));
+    }
+}
+
+template <CharClass C>
+const char* scanSse2(const char* begin, const char* end) {
+    while (end - begin >= 16) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+        uint32_t outside =
+            ~static_cast<uint32_t>(_mm_movemask_epi8(classify<C>(chars))) & 0xFFFF;
+
+        if (outside) {
+            return begin + countTrailingZeros(outside);
+        }
+
+        begin += 16;
+    }
+
+    return scanScalar<C>(begin, end);
+}
+
+
+TARGET_AVX2 inline __m256i inRange(__m256i chars, char low, char range) {
+    __m256i offset = _mm256_sub_epi8(chars, _mm256_set1_epi8(low));
+    return _mm256_cmpeq_epi8(
+        _mm256_min_epu8(offset, _mm256_set1_epi8(range)), offset);
+}
+
+template <CharClass C>
+TARGET_AVX2 inline __m256i classify(__m256i chars) {
+    switch (C) {
+        case CharClass::WHITESPACE:
+            return _mm256_or_si256(
+                _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')),
+                inRange(chars, '\t', '\r' - '\t'));
+        case CharClass::NAME:
+            return inRange(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)),
+                'a', 'z' - 'a');
+        case CharClass::NUMBER:
+            return _mm256_or_si256(inRange(chars, '0', 9),
+                _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('.')));
+        case CharClass::STRING_BODY:
+        default:
+            __m256i stop = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"')),
+                    _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\\'))),
+                _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+            return _mm256_xor_si256(stop, _mm256_set1_epi8(-1));
+    }
+}
+
+template <CharClass C>
+TARGET_AVX2 const char* scanAvx2(const char* begin, const char* end) {
+    while (end - begin >= 32) {
+        __m256i chars =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+        uint32_t outside =
+            ~static_cast<uint32_t>(_mm256_movemask_epi8(classify<C>(chars)));
+
+        if (outside) {
+            return begin + countTrailingZeros(outside);
+        }
+
+        begin += 32;
+    }
+
+    return scanSse2<C>(begin, end);
+}
+
+
+bool detectAvx2() {
+#ifdef _MSC_VER
+    int info[4];
+
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+        return false;
+    }
+
+    // The operating system has to save the AVX registers as well
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+
+const ScanFunction scalarScans[] = {
+    scanScalar<CharClass::WHITESPACE>, scanScalar<CharClass::NAME>,
+    scanScalar<CharClass::NUMBER>, scanScalar<CharClass::STRING_BODY>
+};
+
+#ifdef SCAN_X86_64
+const ScanFunction sse2Scans[] = {
+    scanSse2<CharClass::WHITESPACE>, scanSse2<CharClass::NAME>,
+    scanSse2<CharClass::NUMBER>, scanSse2<CharClass::STRING_BODY>
+};
+
+const ScanFunction avx2Scans[] = {
+    scanAvx2<CharClass::WHITESPACE>, scanAvx2<CharClass::NAME>,
+    scanAvx2<CharClass::NUMBER>, scanAvx2<CharClass::STRING_BODY>
+};
+#endif
+
+
+const ScanFunction* getScans(ScanLevel level) {
+#ifdef SCAN_X86_64
+    switch (level) {
+        case ScanLevel::AVX2:
+            return avx2Scans;
+        case ScanLevel::SSE2:
+            return sse2Scans;
+        default:
+            break;
+    }
+#endif
+
+    return scalarScans;
+}
+
+}
+
+
+ScanLevel getScanLevel() {
+    static const ScanLevel level =
+        isScanLevelSupported(ScanLevel::AVX2) ? ScanLevel::AVX2
+        : isScanLevelSupported(ScanLevel::SSE2) ? ScanLevel::SSE2
+        : ScanLevel::SCALAR;
+
+    return level;
+}
+
+bool isScanLevelSupported(ScanLevel level) {
+    switch (level) {
+        case ScanLevel::SCALAR:
+            return true;
+#ifdef SCAN_X86_64
+        case ScanLevel::SSE2:
+            // Part of every x86-64 CPU
+            return true;
+        case ScanLevel::AVX2: {
+            static const bool avx2 = detectAvx2();
+            return avx2;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* scan(CharClass charClass, const char* begin, const char* end) {
+    static const ScanFunction* scans = getScans(getScanLevel());
+
+    return scans[static_cast<int>(charClass)](begin, end);
+}
+
+const char* scan(CharClass charClass, const char* begin, const char* end,
+        ScanLevel level) {
+    return getScans(level)[static_cast<int>(charClass)](begin, end);
+}
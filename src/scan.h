@@ -0,0 +1,121 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+
+#include <cstdint>
+
+
+/**
+ * @brief The classes of characters the tokenizer skips over in one go.
+ * 
+ */
+enum class CharClass : uint8_t {
+    /**
+     * @brief Characters for which isspace is true.
+     * 
+     */
+    WHITESPACE,
+
+    /**
+     * @brief Letters, the characters of a name.
+     * 
+     */
+    NAME,
+
+    /**
+     * @brief Digits and the decimal point.
+     * 
+     */
+    NUMBER,
+
+    /**
+     * @brief Everything in a string up to a quote, a backslash or a line
+     * break.
+     * 
+     */
+    STRING_BODY
+};
+
+
+/**
+ * @brief The instruction sets a scan can be implemented with.
+ * 
+ */
+enum class ScanLevel : uint8_t {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+
+/**
+ * @brief Check whether a character belongs to a class.
+ * 
+ * @param charClass the class to check against.
+ * @param c the character.
+ * @return true if <c> is in <charClass>.
+ * @return false otherwise.
+ */
+inline bool isInClass(CharClass charClass, char c) {
+    unsigned char u = static_cast<unsigned char>(c);
+
+    switch (charClass) {
+        case CharClass::WHITESPACE:
+            return u == ' ' || static_cast<unsigned char>(u - '\t') <= '\r' - '\t';
+        case CharClass::NAME:
+            return static_cast<unsigned char>((u | 0x20) - 'a') <= 'z' - 'a';
+        case CharClass::NUMBER:
+            return static_cast<unsigned char>(u - '0') <= 9 || u == '.';
+        case CharClass::STRING_BODY:
+            return u != '"' && u != '\\' && u != '\n';
+    }
+
+    return false;
+}
+
+
+/**
+ * @brief Get the fastest scan implementation the CPU supports. It is
+ * detected once, the first time a scan runs.
+ * 
+ * @return ScanLevel the level used by scan.
+ */
+ScanLevel getScanLevel();
+
+/**
+ * @brief Check whether the CPU supports a scan implementation.
+ * 
+ * @param level the implementation.
+ * @return true if scans at <level> can run.
+ * @return false otherwise.
+ */
+bool isScanLevelSupported(ScanLevel level);
+
+/**
+ * @brief Find the first character in [begin, end) which is not in
+ * <charClass>, using the fastest implementation the CPU supports.
+ * 
+ * @param charClass the class of the characters to skip.
+ * @param begin the first character.
+ * @param end the position after the last character.
+ * @return const char* the first character not in <charClass>, <end> if
+ * there is none.
+ */
+const char* scan(CharClass charClass, const char* begin, const char* end);
+
+/**
+ * @brief Find the first character in [begin, end) which is not in
+ * <charClass>, using the implementation at <level>.
+ * 
+ * @param charClass the class of the characters to skip.
+ * @param begin the first character.
+ * @param end the position after the last character.
+ * @param level a supported implementation.
+ * @return const char* the first character not in <charClass>, <end> if
+ * there is none.
+ */
+const char* scan(CharClass charClass, const char* begin, const char* end,
+    ScanLevel level);
+
+
+#endif
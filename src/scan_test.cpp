@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <random>
+#include <string>
+
+#include "scan.h"
+
+
+const CharClass allClasses[] = {
+    CharClass::WHITESPACE, CharClass::NAME, CharClass::NUMBER,
+    CharClass::STRING_BODY
+};
+
+const ScanLevel allLevels[] = {
+    ScanLevel::SCALAR, ScanLevel::SSE2, ScanLevel::AVX2
+};
+
+
+TEST(Scan, ClassesMatchCType) {
+    for (int c = 0; c < 128; c++) {
+        ASSERT_EQ(isInClass(CharClass::WHITESPACE, c), isspace(c) != 0) << c;
+        ASSERT_EQ(isInClass(CharClass::NAME, c), isalpha(c) != 0) << c;
+        ASSERT_EQ(isInClass(CharClass::NUMBER, c), isdigit(c) || c == '.') << c;
+    }
+
+    for (int c = 128; c < 256; c++) {
+        ASSERT_FALSE(isInClass(CharClass::WHITESPACE, static_cast<char>(c)));
+        ASSERT_FALSE(isInClass(CharClass::NAME, static_cast<char>(c)));
+        ASSERT_FALSE(isInClass(CharClass::NUMBER, static_cast<char>(c)));
+        ASSERT_TRUE(isInClass(CharClass::STRING_BODY, static_cast<char>(c)));
+    }
+}
+
+
+TEST(Scan, StopsAtFirstCharacterOutsideClass) {
+    std::string text = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0";
+
+    for (auto level : allLevels) {
+        if (!isScanLevelSupported(level)) continue;
+
+        const char* end = text.data() + text.size();
+        ASSERT_EQ(scan(CharClass::NAME, text.data(), end, level), end - 1);
+        ASSERT_EQ(scan(CharClass::NUMBER, text.data(), end, level), text.data());
+        ASSERT_EQ(scan(CharClass::NAME, end - 1, end - 1, level), end - 1);
+    }
+}
+
+
+TEST(Scan, LevelsAgreeWithScalar) {
+    // Runs of characters of every class, so the scans stop at every offset
+    // of a vector
+    const char alphabet[] = " \t\n\r\v\fazAZmq09.5\"\\x_{}()\x80\xff";
+    std::mt19937 random(42);
+
+    std::string text;
+    for (int i = 0; i < 4096; i++) {
+        char c = alphabet[random() % (sizeof(alphabet) - 1)];
+        text.append(random() % 40 + 1, c);
+    }
+
+    const char* end = text.data() + text.size();
+
+    for (auto level : allLevels) {
+        if (!isScanLevelSupported(level)) continue;
+
+        for (auto charClass : allClasses) {
+            for (const char* begin = text.data(); begin < end; begin++) {
+                ASSERT_EQ(scan(charClass, begin, end, level),
+                    scan(charClass, begin, end, ScanLevel::SCALAR))
+                    << static_cast<int>(level) << " "
+                    << static_cast<int>(charClass) << " "
+                    << begin - text.data();
+            }
+        }
+    }
+}
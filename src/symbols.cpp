@@ -0,0 +1,82 @@
+#include "symbols.h"
+
+#include <cstring>
+
+
+const SymbolId SymbolTable::NO_SYMBOL;
+
+
+SymbolTable::SymbolTable(): buckets(64, NO_SYMBOL) {}
+
+uint32_t SymbolTable::hash(const char* text, uint32_t length) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for (uint32_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+SymbolId SymbolTable::intern(const char* text, uint32_t length) {
+    uint32_t mask = static_cast<uint32_t>(buckets.size() - 1);
+    uint32_t bucket = hash(text, length) & mask;
+
+    while (buckets[bucket] != NO_SYMBOL) {
+        const std::string& name = names[buckets[bucket]];
+
+        if (name.size() == length && memcmp(name.data(), text, length) == 0) {
+            return buckets[bucket];
+        }
+
+        bucket = (bucket + 1) & mask;
+    }
+
+    SymbolId symbol = static_cast<SymbolId>(names.size());
+    names.emplace_back(text, length);
+    buckets[bucket] = symbol;
+
+    // Keep the load factor at most one half
+    if (names.size() * 2 > buckets.size()) {
+        grow();
+    }
+
+    return symbol;
+}
+
+SymbolId SymbolTable::intern(const std::string& name) {
+    return intern(name.data(), static_cast<uint32_t>(name.size()));
+}
+
+const std::string& SymbolTable::getName(SymbolId symbol) const {
+    return names[symbol];
+}
+
+uint32_t SymbolTable::size() const {
+    return static_cast<uint32_t>(names.size());
+}
+
+SymbolTable& SymbolTable::global() {
+    static SymbolTable table;
+
+    return table;
+}
+
+void SymbolTable::grow() {
+    buckets.assign(buckets.size() * 2, NO_SYMBOL);
+    uint32_t mask = static_cast<uint32_t>(buckets.size() - 1);
+
+    for (SymbolId symbol = 0; symbol < names.size(); symbol++) {
+        const std::string& name = names[symbol];
+        uint32_t bucket =
+            hash(name.data(), static_cast<uint32_t>(name.size())) & mask;
+
+        while (buckets[bucket] != NO_SYMBOL) {
+            bucket = (bucket + 1) & mask;
+        }
+
+        buckets[bucket] = symbol;
+    }
+}
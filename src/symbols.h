@@ -0,0 +1,127 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+
+/**
+ * @brief The dense id of an interned name.
+ * 
+ */
+typedef uint32_t SymbolId;
+
+
+/**
+ * @brief Table mapping every distinct name to a SymbolId.
+ * 
+ * Names are interned once when they are tokenized. Afterwards scopes,
+ * environments and the virtual machine compare and hash the ids instead of
+ * the strings. Ids are handed out in the order names are first seen,
+ * starting at 0.
+ * 
+ */
+class SymbolTable {
+public:
+    /**
+     * @brief Construct a new empty SymbolTable object.
+     * 
+     */
+    SymbolTable();
+
+    /**
+     * @brief Get the id of a name, adding it to the table if it is new.
+     * 
+     * @param text the first character of the name.
+     * @param length the number of characters of the name.
+     * @return SymbolId the id of the name.
+     */
+    SymbolId intern(const char* text, uint32_t length);
+
+    /**
+     * @brief Get the id of a name, adding it to the table if it is new.
+     * 
+     * @param name the name.
+     * @return SymbolId the id of the name.
+     */
+    SymbolId intern(const std::string& name);
+
+    /**
+     * @brief Get the name of an interned symbol.
+     * 
+     * @param symbol the id returned by intern.
+     * @return const std::string& the name. The reference stays valid as long
+     * as the table exists.
+     */
+    const std::string& getName(SymbolId symbol) const;
+
+    /**
+     * @brief Get the number of interned names.
+     * 
+     * @return uint32_t the number of names.
+     */
+    uint32_t size() const;
+
+    /**
+     * @brief Get the table shared by the tokenizer and the interpreter.
+     * 
+     * @return SymbolTable& the global table.
+     */
+    static SymbolTable& global();
+
+private:
+    /**
+     * @brief Hash the characters of a name.
+     * 
+     */
+    static uint32_t hash(const char* text, uint32_t length);
+
+    /**
+     * @brief Double the number of buckets and insert all names again.
+     * 
+     */
+    void grow();
+
+    /**
+     * @brief The names, indexed by their id. A deque so references to them
+     * stay valid when names are added.
+     * 
+     */
+    std::deque<std::string> names;
+
+    /**
+     * @brief Open addressing hash table holding the id of a name or
+     * NO_SYMBOL. Its size is a power of two.
+     * 
+     */
+    std::vector<SymbolId> buckets;
+
+    static const SymbolId NO_SYMBOL = UINT32_MAX;
+};
+
+
+/**
+ * @brief Intern a name in the global symbol table.
+ * 
+ * @param name the name.
+ * @return SymbolId the id of the name.
+ */
+inline SymbolId intern(const std::string& name) {
+    return SymbolTable::global().intern(name);
+}
+
+/**
+ * @brief Get the name of a symbol in the global symbol table.
+ * 
+ * @param symbol the id of the name.
+ * @return const std::string& the name.
+ */
+inline const std::string& getSymbolName(SymbolId symbol) {
+    return SymbolTable::global().getName(symbol);
+}
+
+
+#endif
@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "symbols.h"
+#include "tokenizer.h"
+
+
+TEST(SymbolTable, InternsEqualNamesOnce) {
+    SymbolTable table;
+
+    auto a = table.intern(std::string("alpha"));
+    auto b = table.intern(std::string("beta"));
+    auto aAgain = table.intern("alphabet", 5);
+
+    ASSERT_EQ(a, 0);
+    ASSERT_EQ(b, 1);
+    ASSERT_EQ(aAgain, a);
+    ASSERT_EQ(table.size(), 2);
+    ASSERT_STREQ(table.getName(b).c_str(), "beta");
+}
+
+
+TEST(SymbolTable, KeepsIdsWhenGrowing) {
+    SymbolTable table;
+    const std::string& first = table.getName(table.intern(std::string("v0")));
+
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(table.intern("v" + std::to_string(i)), i);
+    }
+
+    for (int i = 0; i < 1000; i++) {
+        ASSERT_EQ(table.intern("v" + std::to_string(i)), i);
+    }
+
+    ASSERT_EQ(table.size(), 1000);
+    ASSERT_STREQ(first.c_str(), "v0");
+}
+
+
+TEST(SymbolTable, TokenizerInternsNames) {
+    std::unique_ptr<Input> input(new StringInput("counter + counter"));
+    Tokenizer tokenizer(input);
+
+    auto left = tokenizer.getNextToken();
+    tokenizer.getNextToken();
+    auto right = tokenizer.getNextToken();
+
+    ASSERT_EQ(left.payloadSymbol, right.payloadSymbol);
+    ASSERT_EQ(left.payloadSymbol, intern("counter"));
+    ASSERT_STREQ(getSymbolName(left.payloadSymbol).c_str(), "counter");
+}
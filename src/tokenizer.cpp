@@ -1,7 +1,15 @@
 #include "tokenizer.h"
 
+#include <cstring>
 
-Token::Token(TokenType tokenType): tokenType(tokenType) {}
+
+Token::Token(TokenType tokenType, const char* text, uint32_t length):
+    text(text), length(length), line(0), column(0), payloadInt(0),
+    tokenType(tokenType) {
+    if (tokenType == TokenType::NAME && text) {
+        payloadSymbol = SymbolTable::global().intern(text, length);
+    }
+}
 
 TokenType Token::getType() const {
     return tokenType;
@@ -11,234 +19,445 @@ bool Token::isType(TokenType type) const {
     return tokenType == type;
 }
 
+std::string Token::getText() const {
+    return std::string(text, length);
+}
+
+std::string Token::getString() const {
+    std::string ret;
+    ret.reserve(length);
+
+    for (uint32_t i = 0; i < length; i++) {
+        if (text[i] != '\\') {
+            ret += text[i];
+            continue;
+        }
+
+        // The tokenizer only lets through complete escape sequences
+        i++;
+        switch (text[i]) {
+            case 't':
+                ret += '\t';
+                break;
+            case 'r':
+                ret += '\r';
+                break;
+            case 'n':
+                ret += '\n';
+                break;
+            default:
+                ret += text[i];
+                break;
+        }
+    }
+
+    return ret;
+}
+
+
+/**
+ * @brief The spelling of a keyword.
+ * 
+ */
+struct Keyword {
+    const char* spelling;
+    TokenType type;
+};
+
+/**
+ * @brief All keywords. RETURN has a TokenType but no spelling until the
+ * parser supports it.
+ * 
+ */
+static constexpr Keyword keywords[] = {
+    { "IF", TokenType::IF },
+    { "ELSE", TokenType::ELSE },
+    { "FOR", TokenType::FOR },
+    { "WHILE", TokenType::WHILE },
+    { "FUN", TokenType::FUN }
+};
+
+static constexpr uint32_t KEYWORD_COUNT = sizeof(keywords) / sizeof(Keyword);
+
+/**
+ * @brief The number of slots of the keyword hash table, a power of two.
+ * 
+ */
+static constexpr uint32_t KEYWORD_SLOTS = 16;
+
+static constexpr uint32_t spellingLength(const char* spelling) {
+    uint32_t length = 0;
+    while (spelling[length]) length++;
+    return length;
+}
+
+/**
+ * @brief Hash a name by its length, first and last character.
+ * 
+ * @param seed the multiplier picked by findKeywordSeed.
+ * @param text the first character of the name.
+ * @param length the length of the name, at least 1.
+ * @return uint32_t the slot of the name in the keyword table.
+ */
+static constexpr uint32_t keywordHash(uint32_t seed, const char* text,
+        uint32_t length) {
+    return (static_cast<unsigned char>(text[0]) * seed
+        + static_cast<unsigned char>(text[length - 1]) + length)
+        & (KEYWORD_SLOTS - 1);
+}
+
+/**
+ * @brief Check whether <seed> maps every keyword to its own slot.
+ * 
+ */
+static constexpr bool isPerfectSeed(uint32_t seed) {
+    for (uint32_t i = 0; i < KEYWORD_COUNT; i++) {
+        for (uint32_t j = i + 1; j < KEYWORD_COUNT; j++) {
+            const char* a = keywords[i].spelling;
+            const char* b = keywords[j].spelling;
+
+            if (keywordHash(seed, a, spellingLength(a))
+                    == keywordHash(seed, b, spellingLength(b))) {
+                return false;
+            }
+        }
+    }
 
-Tokenizer::Tokenizer(std::unique_ptr<Input>& input):
-    input(std::move(input)) {}
+    return true;
+}
 
-std::shared_ptr<Token> Tokenizer::getStringToken() {
-    auto ret = std::make_shared<Token>(TokenType::STRING);
+/**
+ * @brief Find the smallest seed that makes keywordHash perfect for the
+ * keywords, 0 if there is none.
+ * 
+ */
+static constexpr uint32_t findKeywordSeed() {
+    for (uint32_t seed = 1; seed < 1024; seed++) {
+        if (isPerfectSeed(seed)) {
+            return seed;
+        }
+    }
+
+    return 0;
+}
+
+static constexpr uint32_t KEYWORD_SEED = findKeywordSeed();
+
+static_assert(KEYWORD_SEED != 0,
+    "No perfect hash for the keywords, increase KEYWORD_SLOTS");
+
+/**
+ * @brief The keyword table, mapping every slot to the index of its keyword
+ * in keywords or -1, and to the length of its keyword.
+ * 
+ */
+struct KeywordTable {
+    int8_t slots[KEYWORD_SLOTS];
+    uint8_t lengths[KEYWORD_SLOTS];
+    uint32_t minLength;
+    uint32_t maxLength;
+};
+
+static constexpr KeywordTable buildKeywordTable() {
+    KeywordTable table = {};
+
+    for (uint32_t slot = 0; slot < KEYWORD_SLOTS; slot++) {
+        table.slots[slot] = -1;
+    }
+
+    table.minLength = UINT32_MAX;
+
+    for (uint32_t i = 0; i < KEYWORD_COUNT; i++) {
+        uint32_t length = spellingLength(keywords[i].spelling);
+
+        uint32_t slot = keywordHash(KEYWORD_SEED, keywords[i].spelling, length);
+
+        table.slots[slot] = static_cast<int8_t>(i);
+        table.lengths[slot] = static_cast<uint8_t>(length);
+        table.minLength = length < table.minLength ? length : table.minLength;
+        table.maxLength = length > table.maxLength ? length : table.maxLength;
+    }
+
+    return table;
+}
+
+static constexpr KeywordTable keywordTable = buildKeywordTable();
+
+/**
+ * @brief Look up the keyword spelled like a name with one hash and at most
+ * one comparison.
+ * 
+ * @param text the first character of the name.
+ * @param length the length of the name.
+ * @return TokenType the type of the keyword, NAME if it is none.
+ */
+static TokenType lookupKeyword(const char* text, uint32_t length) {
+    if (length < keywordTable.minLength || length > keywordTable.maxLength) {
+        return TokenType::NAME;
+    }
+
+    uint32_t slot = keywordHash(KEYWORD_SEED, text, length);
+    int8_t index = keywordTable.slots[slot];
+
+    if (index < 0 || keywordTable.lengths[slot] != length
+            || memcmp(text, keywords[index].spelling, length) != 0) {
+        return TokenType::NAME;
+    }
+
+    return keywords[index].type;
+}
 
-    bool escapeNext = false;
 
-    char nextChar = input->getNextChar();
-    while (input->hasNext()) {
-        nextChar = input->getNextChar();
-        if (escapeNext) {
-            escapeNext = false;
-            switch (nextChar) {
+template <typename Reader>
+BasicTokenizer<Reader>::BasicTokenizer(std::unique_ptr<Input>& input):
+    reader(input), nextToken(TokenType::UNKNOWN), peeked(false), line(1) {
+    lineStart = reader.getPosition();
+}
+
+template <typename Reader>
+char BasicTokenizer<Reader>::advance() {
+    char nextChar = reader.get();
+
+    if (nextChar == '\n') {
+        line++;
+        lineStart = reader.getPosition();
+    }
+
+    return nextChar;
+}
+
+template <typename Reader>
+void BasicTokenizer<Reader>::skipWhitespace() {
+    const char* from = reader.getPosition();
+    reader.skip(CharClass::WHITESPACE);
+    const char* to = reader.getPosition();
+
+    for (const char* c = from; c < to; c++) {
+        if (*c == '\n') {
+            line++;
+            lineStart = c + 1;
+        }
+    }
+}
+
+template <typename Reader>
+Token BasicTokenizer<Reader>::startToken() const {
+    Token start(TokenType::UNKNOWN, reader.getPosition());
+    start.line = line;
+    start.column = static_cast<uint32_t>(start.text - lineStart) + 1;
+
+    return start;
+}
+
+template <typename Reader>
+Token BasicTokenizer<Reader>::finishToken(const Token& start, TokenType tokenType) const {
+    Token token(tokenType, start.text,
+        static_cast<uint32_t>(reader.getPosition() - start.text));
+    token.line = start.line;
+    token.column = start.column;
+
+    return token;
+}
+
+template <typename Reader>
+Token BasicTokenizer<Reader>::getStringToken(const Token& start) {
+    advance();
+
+    Token ret(TokenType::STRING, reader.getPosition());
+    ret.line = start.line;
+    ret.column = start.column;
+
+    while (reader.hasNext()) {
+        // Stops at quotes, backslashes and line breaks
+        reader.skip(CharClass::STRING_BODY);
+
+        const char* end = reader.getPosition();
+        if (!reader.hasNext()) {
+            break;
+        }
+
+        char nextChar = advance();
+
+        if (nextChar == '\\') {
+            if (!reader.hasNext()) {
+                break;
+            }
+
+            switch (advance()) {
                 case 't':
-                    ret->payloadStr += '\t';
-                    break;
                 case 'r':
-                    ret->payloadStr += '\r';
-                    break;
                 case 'n':
-                    ret->payloadStr += '\n';
-                    break;
                 case '"':
-                    ret->payloadStr += '"';
-                    break;
                 case '\\':
-                    ret->payloadStr += '\\';
                     break;
                 default:
                     throw std::exception("Malformed escape character");
             }
         } else if (nextChar == '"') {
+            ret.length = static_cast<uint32_t>(end - ret.text);
             return ret;
-        } else {
-            ret->payloadStr += nextChar;
         }
     }
     
     throw std::exception("Reached end of file while tokenizing string");
 }
 
-std::shared_ptr<Token> Tokenizer::getNumericalToken() {
-    std::string numStr;
-    bool isFloat = false;
-
-    char nextChar = input->peekNextChar();
-    while (isdigit(nextChar) || nextChar == '.') {
-        if (nextChar == '.') {
-            if (isFloat)
-                throw std::exception("Malformed floating point number");
+template <typename Reader>
+Token BasicTokenizer<Reader>::getNumericalToken(const Token& start) {
+    reader.skip(CharClass::NUMBER);
 
-            isFloat = true;
-        }
-        numStr += input->getNextChar();
-        if (input->hasNext()) nextChar = input->peekNextChar();
-        else break;
-    }
+    auto ret = finishToken(start, TokenType::INT);
+    auto dot = static_cast<const char*>(memchr(ret.text, '.', ret.length));
 
-    if (isFloat) {
-        auto ret = std::make_shared<Token>(TokenType::FLOAT);
-        ret->payloadFloat = std::stof(numStr);
+    if (dot) {
+        if (memchr(dot + 1, '.', ret.text + ret.length - dot - 1))
+            throw std::exception("Malformed floating point number");
 
-        return ret;
+        ret = finishToken(start, TokenType::FLOAT);
+        ret.payloadFloat = std::stof(ret.getText());
     } else {
-        auto ret = std::make_shared<Token>(TokenType::INT);
-        ret->payloadInt = std::stoi(numStr);
+        ret.payloadInt = std::stoi(ret.getText());
+    }
 
-        return ret;
-    }    
+    return ret;
 }
 
-std::shared_ptr<Token> Tokenizer::getNameToken() {
-   std::string nameStr;
+template <typename Reader>
+Token BasicTokenizer<Reader>::getNameToken(const Token& start) {
+    reader.skip(CharClass::NAME);
 
-    char nextChar = input->peekNextChar();
-    while (isalpha(nextChar)) {
-        nameStr += input->getNextChar();
+    const char* end = reader.getPosition();
 
-        if (input->hasNext()) nextChar = input->peekNextChar();
-        else break;
-    }
-
-    if (nameStr == "IF") {
-        return std::make_shared<Token>(TokenType::IF);
-    } else if (nameStr == "ELSE") {
-        return std::make_shared<Token>(TokenType::ELSE);
-    } else if (nameStr == "FOR") {
-        return std::make_shared<Token>(TokenType::FOR);
-    } else if (nameStr == "WHILE") {
-        return std::make_shared<Token>(TokenType::WHILE);
-    } else if (nameStr == "FUN") {
-        return std::make_shared<Token>(TokenType::FUN);
-    }
-
-    auto ret = std::make_shared<Token>(TokenType::NAME);
-    ret->payloadStr = nameStr;
-
-    return ret;
+    return finishToken(start, lookupKeyword(start.text,
+        static_cast<uint32_t>(end - start.text)));
 }
 
 
-std::shared_ptr<Token> Tokenizer::getNextToken() {
-    if (nextToken) {
-        auto ret = nextToken;
-        nextToken = nullptr;
-        return ret;
+template <typename Reader>
+Token BasicTokenizer<Reader>::getNextToken() {
+    if (peeked) {
+        peeked = false;
+        return nextToken;
     }
 
-    if (!input->hasNext()) {
-        return std::make_shared<Token>(TokenType::END_OF_FILE);
-    }
+    skipWhitespace();
 
-    char nextChar = input->peekNextChar();
-    while (isspace(nextChar)) {
-        input->getNextChar();
-        
-        if (input->hasNext()) {
-            nextChar = input->peekNextChar();
-        } else {
-            return std::make_shared<Token>(TokenType::END_OF_FILE);
-        }
+    if (!reader.hasNext()) {
+        return finishToken(startToken(), TokenType::END_OF_FILE);
     }
 
+    char nextChar = reader.peek();
+
+    auto start = startToken();
+
     switch (nextChar) {
         case '(':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::OPEN_PAR);
+            advance();
+            return finishToken(start, TokenType::OPEN_PAR);
         case ')':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::CLOSE_PAR);
+            advance();
+            return finishToken(start, TokenType::CLOSE_PAR);
         case ',':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::COMMA);
+            advance();
+            return finishToken(start, TokenType::COMMA);
         case ';':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::END_OF_LINE);
+            advance();
+            return finishToken(start, TokenType::END_OF_LINE);
         case '{':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::OPEN_BLOCK);
+            advance();
+            return finishToken(start, TokenType::OPEN_BLOCK);
         case '}':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::CLOSE_BLOCK);
+            advance();
+            return finishToken(start, TokenType::CLOSE_BLOCK);
         case '=':
-            input->getNextChar();
-            if (input->peekNextChar() == '=') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::EQUALS);
+            advance();
+            if (reader.peek() == '=') {
+                advance();
+                return finishToken(start, TokenType::EQUALS);
             } else {
-                return std::make_shared<Token>(TokenType::ASSIGN);
+                return finishToken(start, TokenType::ASSIGN);
             }
         case '>':
-            input->getNextChar();
-            if (input->peekNextChar() == '=') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::GREATER_OR_EQUALS);
+            advance();
+            if (reader.peek() == '=') {
+                advance();
+                return finishToken(start, TokenType::GREATER_OR_EQUALS);
             } else {
-                return std::make_shared<Token>(TokenType::GREATER);
+                return finishToken(start, TokenType::GREATER);
             }
         case '<':
-            input->getNextChar();
-            if (input->peekNextChar() == '=') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::LESS_OR_EQUALS);
+            advance();
+            if (reader.peek() == '=') {
+                advance();
+                return finishToken(start, TokenType::LESS_OR_EQUALS);
             } else {
-                return std::make_shared<Token>(TokenType::LESS);
+                return finishToken(start, TokenType::LESS);
             }
          case '!':
-            input->getNextChar();
-            if (input->peekNextChar() == '=') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::NOT_EQUALS);
+            advance();
+            if (reader.peek() == '=') {
+                advance();
+                return finishToken(start, TokenType::NOT_EQUALS);
             } else {
-                return std::make_shared<Token>(TokenType::NOT);
+                return finishToken(start, TokenType::NOT);
             }
         case '|':
-            input->getNextChar();
-            if (input->peekNextChar() == '|') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::OR);
+            advance();
+            if (reader.peek() == '|') {
+                advance();
+                return finishToken(start, TokenType::OR);
             } else {
                 throw std::exception("Bitwise or operator not yet supported");
             }
         case '&':
-            input->getNextChar();
-            if (input->peekNextChar() == '&') {
-                input->getNextChar();
-                return std::make_shared<Token>(TokenType::AND);
+            advance();
+            if (reader.peek() == '&') {
+                advance();
+                return finishToken(start, TokenType::AND);
             } else {
                 throw std::exception("Bitwise and operator not yet supported");
             }
         case '+':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::ADD);
+            advance();
+            return finishToken(start, TokenType::ADD);
         case '-':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::SUBTRACT);
+            advance();
+            return finishToken(start, TokenType::SUBTRACT);
         case '*':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::MULTIPLY);
+            advance();
+            return finishToken(start, TokenType::MULTIPLY);
         case '/':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::DIVIDE);
+            advance();
+            return finishToken(start, TokenType::DIVIDE);
         case '%':
-            input->getNextChar();
-            return std::make_shared<Token>(TokenType::MODULO);
+            advance();
+            return finishToken(start, TokenType::MODULO);
         case '"':
-            return getStringToken();
+            return getStringToken(start);
     }
 
     if (isdigit(nextChar)) {
-        return getNumericalToken();
+        return getNumericalToken(start);
     }
 
-    if (isalpha(nextChar)) {
-        return getNameToken();
+    if (isInClass(CharClass::NAME, nextChar)) {
+        return getNameToken(start);
     }
 
     throw std::exception("Malformed token");
 }
 
 
-std::shared_ptr<Token> Tokenizer::peekNextToken() {
-    if (!nextToken) {
+template <typename Reader>
+Token BasicTokenizer<Reader>::peekNextToken() {
+    if (!peeked) {
         nextToken = getNextToken();
+        peeked = true;
     }
 
     return nextToken;
 }
 
+
+template class BasicTokenizer<BufferReader>;
+template class BasicTokenizer<InputReader>;
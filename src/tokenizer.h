@@ -2,19 +2,23 @@
 #define TOKENIZER_H
 
 
+#include <cstdint>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <memory>
+#include <type_traits>
 
 #include "input.h"
+#include "scan.h"
+#include "symbols.h"
 
 
 /**
  * @brief The type of a token.
  * 
  */
-enum class TokenType {
+enum class TokenType : uint8_t {
     UNKNOWN,
     END_OF_FILE,
     END_OF_LINE,
@@ -52,6 +56,11 @@ enum class TokenType {
 
 /**
  * @brief A token that represents either literals or operation indicators.
+ *
+ * Tokens are small values which are cheap to copy. Instead of owning its
+ * text, a token points into the buffer of the Input it was read from, so
+ * it stays valid as long as the Tokenizer that returned it. The text of a
+ * NAME token is interned in the global SymbolTable when it is constructed.
  * 
  */
 class Token {
@@ -60,8 +69,10 @@ public:
      * @brief Construct a new Token object.
      * 
      * @param tokenType the type of the token.
+     * @param text the first character of the token in the source.
+     * @param length the number of characters of the token in the source.
      */
-    Token(TokenType tokenType);
+    Token(TokenType tokenType, const char* text = nullptr, uint32_t length = 0);
 
     /**
      * @brief Get the type of this token.
@@ -80,23 +91,63 @@ public:
     bool isType(TokenType tokenType) const;
 
     /**
-     * @brief The string this token holds if its type is any of
-     * NAME, STRING.
+     * @brief Copy the source text of this token, the name of a NAME token.
      * 
+     * @return std::string the characters the token spans.
      */
-    std::string payloadStr;
+    std::string getText() const;
 
     /**
-     * @brief The int this token holds if its type is INT.
+     * @brief Get the contents of a STRING token with its escape sequences
+     * replaced. The span of a STRING token does not include the quotes.
      * 
+     * @return std::string the string the token holds.
      */
-    int payloadInt;
+    std::string getString() const;
 
     /**
-     * @brief The int this token holds it its type is FLOAT.
+     * @brief The first character of this token in the source.
      * 
      */
-    float payloadFloat;
+    const char* text;
+
+    /**
+     * @brief The number of characters this token spans.
+     * 
+     */
+    uint32_t length;
+
+    /**
+     * @brief The line the token starts on, starting at 1.
+     * 
+     */
+    uint32_t line;
+
+    /**
+     * @brief The column the token starts at, starting at 1.
+     * 
+     */
+    uint32_t column;
+
+    union {
+        /**
+         * @brief The int this token holds if its type is INT.
+         * 
+         */
+        int payloadInt;
+
+        /**
+         * @brief The float this token holds it its type is FLOAT.
+         * 
+         */
+        float payloadFloat;
+
+        /**
+         * @brief The interned name if its type is NAME.
+         * 
+         */
+        SymbolId payloadSymbol;
+    };
 
 private:
     /**
@@ -106,65 +157,244 @@ private:
     TokenType tokenType;
 };
 
+static_assert(std::is_trivially_copyable<Token>::value,
+    "Tokens are passed by value");
+
+
+/**
+ * @brief Reads the characters for a tokenizer through the Input interface,
+ * one virtual call per character.
+ * 
+ */
+class InputReader {
+public:
+    /**
+     * @brief Construct a new InputReader object.
+     * 
+     * @param input the input to retrieve characters from.
+     */
+    InputReader(std::unique_ptr<Input>& input): input(std::move(input)) {}
+
+    bool hasNext() const {
+        return input->hasNext();
+    }
+
+    char peek() {
+        return input->peekNextChar();
+    }
+
+    char get() {
+        return input->getNextChar();
+    }
+
+    const char* getPosition() const {
+        return input->getCurrentPosition();
+    }
+
+    void skip(CharClass charClass) {
+        while (input->hasNext() && isInClass(charClass, input->peekNextChar())) {
+            input->getNextChar();
+        }
+    }
+
+private:
+    /**
+     * @brief the input to retrieve characters from.
+     * 
+     */
+    std::unique_ptr<Input> input;
+};
+
+
+/**
+ * @brief Reads the characters for a tokenizer directly from the contiguous
+ * buffer of an input. Every call is inlined into the tokenizer, runs of
+ * characters of the same class are skipped with the vectorized scan.
+ * 
+ */
+class BufferReader {
+public:
+    /**
+     * @brief Construct a new BufferReader object.
+     * 
+     * @param input the input owning the buffer, starting at its current
+     * position.
+     */
+    BufferReader(std::unique_ptr<Input>& input):
+        input(std::move(input)),
+        position(this->input->getCurrentPosition()),
+        end(this->input->getEnd()) {}
+
+    bool hasNext() const {
+        return position < end;
+    }
+
+    char peek() const {
+        return position < end ? *position : '\0';
+    }
+
+    char get() {
+        return position < end ? *position++ : '\0';
+    }
+
+    const char* getPosition() const {
+        return position;
+    }
+
+    void skip(CharClass charClass) {
+        position = scan(charClass, position, end);
+    }
+
+private:
+    /**
+     * @brief the input owning the buffer.
+     * 
+     */
+    std::unique_ptr<Input> input;
+
+    /**
+     * @brief The next character.
+     * 
+     */
+    const char* position;
+
+    /**
+     * @brief The end of the buffer.
+     * 
+     */
+    const char* end;
+};
+
 
 /**
  * @brief Tokenizer to create a stream of tokens from an input.
  * 
+ * The tokenizer is specialized on the way it reads characters. Tokenizer
+ * scans the buffer of the input directly and is the one the parser uses,
+ * InputTokenizer goes through the virtual Input interface instead. Both
+ * are instantiated in tokenizer.cpp.
+ * 
+ * @tparam Reader InputReader or BufferReader.
  */
-class Tokenizer {
+template <typename Reader>
+class BasicTokenizer {
 public:
     /**
      * @brief Construct a new Tokenizer object.
      * 
      * @param input the input to retrieve characters from.
      */
-    Tokenizer(std::unique_ptr<Input>& input);
+    BasicTokenizer(std::unique_ptr<Input>& input);
 
     /**
      * @brief Peek at the next token without advancing to it.
      * 
-     * @return std::shared_ptr<Token> the token that is coming up next.
+     * @return Token the token that is coming up next.
      */
-    std::shared_ptr<Token> peekNextToken();
+    Token peekNextToken();
 
     /**
      * @brief Advance to the next token and return it.
      * 
-     * @return std::shared_ptr<Token> the token that is coming up next.
+     * @return Token the token that is coming up next.
      */
-    std::shared_ptr<Token> getNextToken();
+    Token getNextToken();
     
 private:
     /**
      * @brief Construct a string token from the upcoming characters.
      * 
-     * @return std::shared_ptr<Token> the contructed string token.
+     * @param start the start of the token, at the opening quote.
+     * @return Token the contructed string token.
      */
-    std::shared_ptr<Token> getStringToken();
+    Token getStringToken(const Token& start);
     /**
      * @brief Construct a numerical token from the upcoming characters.
      * 
-     * @return std::shared_ptr<Token> the contructed int or float token.
+     * @param start the start of the token, at the first digit.
+     * @return Token the contructed int or float token.
      */
-    std::shared_ptr<Token> getNumericalToken();
+    Token getNumericalToken(const Token& start);
     /**
      * @brief Construct a name token from the upcoming characters.
      * 
-     * @return std::shared_ptr<Token> the contructed name token.
+     * @param start the start of the token, at the first letter.
+     * @return Token the contructed name token.
      */
-    std::shared_ptr<Token> getNameToken();
+    Token getNameToken(const Token& start);
 
     /**
-     * @brief the input to retrieve characters from.
+     * @brief Retrieve the next character, keeping track of the current line.
      * 
+     * @return char the retrieved character.
      */
-    std::unique_ptr<Input> input;
+    char advance();
+
+    /**
+     * @brief Skip the whitespace up to the next token.
+     * 
+     */
+    void skipWhitespace();
+
+    /**
+     * @brief Mark the start of a token at the next character.
+     * 
+     * @return Token a token of type UNKNOWN spanning no characters.
+     */
+    Token startToken() const;
+
+    /**
+     * @brief Create a token spanning from <start> up to the next character.
+     * 
+     * @param start the token returned by startToken.
+     * @param tokenType the type of the token.
+     * @return Token the finished token.
+     */
+    Token finishToken(const Token& start, TokenType tokenType) const;
+
+    /**
+     * @brief the reader to retrieve characters from.
+     * 
+     */
+    Reader reader;
 
     /**
      * @brief the next token if it has already been peeked.
      * 
      */
-    std::shared_ptr<Token> nextToken;
+    Token nextToken;
+
+    /**
+     * @brief Whether nextToken holds the peeked token.
+     * 
+     */
+    bool peeked;
+
+    /**
+     * @brief The line of the next character, starting at 1.
+     * 
+     */
+    uint32_t line;
+
+    /**
+     * @brief The first character of the current line.
+     * 
+     */
+    const char* lineStart;
 };
 
+
+/**
+ * @brief The tokenizer scanning the buffer of its input directly.
+ * 
+ */
+typedef BasicTokenizer<BufferReader> Tokenizer;
+
+/**
+ * @brief The tokenizer reading its input character by character through
+ * the Input interface.
+ * 
+ */
+typedef BasicTokenizer<InputReader> InputTokenizer;
+
 #endif
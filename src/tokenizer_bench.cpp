@@ -0,0 +1,95 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "input.h"
+#include "tokenizer.h"
+
+
+/**
+ * @brief Generate a script of roughly <size> bytes using every kind of token.
+ * 
+ * @param size the minimum number of bytes to generate.
+ * @return std::string the generated script.
+ */
+std::string generateScript(size_t size) {
+    std::string script;
+    script.reserve(size + 256);
+
+    for (int i = 0; script.size() < size; i++) {
+        auto index = std::to_string(i);
+
+        script += "function" + index + " = FUN counter, limit {\n";
+        script += "    IF counter >= limit && limit != 0 {\n";
+        script += "        print(\"reached \\\"limit\\\"\\n\"); counter\n";
+        script += "    } ELSE {\n";
+        script += "        function" + index + "(counter + 1, limit * 2 % 7)\n";
+        script += "    }\n";
+        script += "}\n";
+        script += "result = function" + index + "(" + index + ", 3.25 / 1.5)\n\n";
+    }
+
+    return script;
+}
+
+
+/**
+ * @brief Tokenize <script> with <TokenizerType> and report the best time
+ * out of <runs> runs.
+ * 
+ * @tparam TokenizerType Tokenizer or InputTokenizer.
+ * @param name the name printed with the result.
+ * @param script the script to tokenize.
+ * @param runs the number of runs.
+ * @return double the best time in seconds.
+ */
+template <typename TokenizerType>
+double benchmark(const char* name, std::string& script, int runs) {
+    double best = 0;
+    size_t tokens = 0;
+
+    for (int run = 0; run < runs; run++) {
+        std::unique_ptr<Input> input = std::make_unique<StringInput>(script);
+        TokenizerType tokenizer(input);
+        tokens = 0;
+
+        auto start = std::chrono::steady_clock::now();
+
+        while (!tokenizer.getNextToken().isType(TokenType::END_OF_FILE)) {
+            tokens++;
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    std::cout << name << ": " << tokens << " tokens in "
+        << best * 1000 << " ms, "
+        << script.size() / best / (1024 * 1024) << " MiB/s" << std::endl;
+
+    return best;
+}
+
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::atoi(argv[1]) : 16;
+    int runs = argc > 2 ? std::atoi(argv[2]) : 5;
+
+    auto script = generateScript(megabytes * 1024 * 1024);
+
+    const char* levels[] = { "scalar", "SSE2", "AVX2" };
+
+    std::cout << "Tokenizing " << script.size() << " bytes, best of "
+        << runs << " runs, scanning with "
+        << levels[static_cast<int>(getScanLevel())] << std::endl;
+
+    double virtualTime = benchmark<InputTokenizer>("InputTokenizer", script, runs);
+    double bufferTime = benchmark<Tokenizer>("Tokenizer     ", script, runs);
+
+    std::cout << "Speedup: " << virtualTime / bufferTime << "x" << std::endl;
+}
@@ -1,4 +1,5 @@
 #include <gtest/gtest.h>
+#include <cstring>
 #include <memory>
 
 #include "input.h"
@@ -9,23 +10,39 @@ TEST(Tokenizer, Keywords) {
     std::unique_ptr<Input> input(new StringInput(std::string("IF FOR ELSE WHILE FUN")));
     Tokenizer tokenizer(std::move(input));
 
-    std::shared_ptr<Token> token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::IF);
+    auto token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::IF);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FOR);
+    ASSERT_EQ(token.getType(), TokenType::FOR);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::ELSE);
+    ASSERT_EQ(token.getType(), TokenType::ELSE);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::WHILE);
+    ASSERT_EQ(token.getType(), TokenType::WHILE);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FUN);
+    ASSERT_EQ(token.getType(), TokenType::FUN);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
+}
+
+
+TEST(Tokenizer, NamesCloseToKeywords) {
+    std::unique_ptr<Input> input(new StringInput(
+        std::string("I IFF ELS ELSEIF FUNFOR WHILEX If fun RETURN FN WHEE")));
+    Tokenizer tokenizer(input);
+
+    for (auto name : { "I", "IFF", "ELS", "ELSEIF", "FUNFOR", "WHILEX", "If",
+            "fun", "RETURN", "FN", "WHEE" }) {
+        auto token = tokenizer.getNextToken();
+        ASSERT_EQ(token.getType(), TokenType::NAME) << name;
+        ASSERT_STREQ(token.getText().c_str(), name);
+    }
+
+    ASSERT_EQ(tokenizer.getNextToken().getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -34,25 +51,25 @@ TEST(Tokenizer, Symbols) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::OPEN_PAR);
+    ASSERT_EQ(token.getType(), TokenType::OPEN_PAR);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::CLOSE_PAR);
+    ASSERT_EQ(token.getType(), TokenType::CLOSE_PAR);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::OPEN_BLOCK);
+    ASSERT_EQ(token.getType(), TokenType::OPEN_BLOCK);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::CLOSE_BLOCK);
+    ASSERT_EQ(token.getType(), TokenType::CLOSE_BLOCK);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_LINE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_LINE);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::COMMA);
+    ASSERT_EQ(token.getType(), TokenType::COMMA);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -61,9 +78,9 @@ void testStringTokenizer(char* testStr) {
     std::unique_ptr<Input> input(new StringInput(completeStr));
     Tokenizer tokenizer(std::move(input));
 
-    std::shared_ptr<Token> token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::STRING);
-    ASSERT_STREQ(token->payloadStr.c_str(), testStr);
+    auto token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::STRING);
+    ASSERT_STREQ(token.getString().c_str(), testStr);
 }
 
 TEST(Tokenizer, SimpleString) {
@@ -80,15 +97,15 @@ TEST(Tokenizer, Name) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::NAME);
-    ASSERT_STREQ(token->payloadStr.c_str(), "abc");
+    ASSERT_EQ(token.getType(), TokenType::NAME);
+    ASSERT_STREQ(token.getText().c_str(), "abc");
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::NAME);
-    ASSERT_STREQ(token->payloadStr.c_str(), "DEF");
+    ASSERT_EQ(token.getType(), TokenType::NAME);
+    ASSERT_STREQ(token.getText().c_str(), "DEF");
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -97,15 +114,15 @@ TEST(Tokenizer, Integer) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::INT);
-    ASSERT_EQ(token->payloadInt, 20234324);
+    ASSERT_EQ(token.getType(), TokenType::INT);
+    ASSERT_EQ(token.payloadInt, 20234324);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::INT);
-    ASSERT_EQ(token->payloadInt, 2109090);
+    ASSERT_EQ(token.getType(), TokenType::INT);
+    ASSERT_EQ(token.payloadInt, 2109090);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -114,15 +131,15 @@ TEST(Tokenizer, Float) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 2.542);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 2.542);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 100.323);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 100.323);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -131,35 +148,35 @@ TEST(Tokenizer, Jumble) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 2.542);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 2.542);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::STRING);
-    ASSERT_STREQ(token->payloadStr.c_str(), "Test");
+    ASSERT_EQ(token.getType(), TokenType::STRING);
+    ASSERT_STREQ(token.getString().c_str(), "Test");
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::ASSIGN);
+    ASSERT_EQ(token.getType(), TokenType::ASSIGN);
     
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::NAME);
-    ASSERT_STREQ(token->payloadStr.c_str(), "var");
+    ASSERT_EQ(token.getType(), TokenType::NAME);
+    ASSERT_STREQ(token.getText().c_str(), "var");
     
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FUN);
+    ASSERT_EQ(token.getType(), TokenType::FUN);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::OPEN_BLOCK);
+    ASSERT_EQ(token.getType(), TokenType::OPEN_BLOCK);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::INT);
-    ASSERT_EQ(token->payloadInt, 100);
+    ASSERT_EQ(token.getType(), TokenType::INT);
+    ASSERT_EQ(token.payloadInt, 100);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::CLOSE_BLOCK);
+    ASSERT_EQ(token.getType(), TokenType::CLOSE_BLOCK);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::END_OF_FILE);
+    ASSERT_EQ(token.getType(), TokenType::END_OF_FILE);
 }
 
 
@@ -168,18 +185,100 @@ TEST(Tokenizer, Peeking) {
     Tokenizer tokenizer(std::move(input));
 
     auto token = tokenizer.peekNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 2.542);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 2.542);
 
     token = tokenizer.peekNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 2.542);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 2.542);
 
     token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::FLOAT);
-    ASSERT_FLOAT_EQ(token->payloadFloat, 2.542);
+    ASSERT_EQ(token.getType(), TokenType::FLOAT);
+    ASSERT_FLOAT_EQ(token.payloadFloat, 2.542);
 
      token = tokenizer.getNextToken();
-    ASSERT_EQ(token->getType(), TokenType::STRING);
-    ASSERT_STREQ(token->payloadStr.c_str(), "Test");
+    ASSERT_EQ(token.getType(), TokenType::STRING);
+    ASSERT_STREQ(token.getString().c_str(), "Test");
+}
+
+
+TEST(Tokenizer, EscapeSequences) {
+    std::unique_ptr<Input> input(new StringInput("\"a\\\"b\\n\\\\\""));
+    Tokenizer tokenizer(input);
+
+    auto token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::STRING);
+    ASSERT_STREQ(token.getText().c_str(), "a\\\"b\\n\\\\");
+    ASSERT_STREQ(token.getString().c_str(), "a\"b\n\\");
+}
+
+
+TEST(Tokenizer, SourceSpans) {
+    std::unique_ptr<Input> input(new StringInput("x = 12\n  print(\"hi\")"));
+    Tokenizer tokenizer(input);
+
+    auto token = tokenizer.getNextToken();
+    ASSERT_EQ(token.line, 1);
+    ASSERT_EQ(token.column, 1);
+    ASSERT_EQ(token.length, 1);
+
+    token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::ASSIGN);
+    ASSERT_EQ(token.column, 3);
+
+    token = tokenizer.getNextToken();
+    ASSERT_STREQ(token.getText().c_str(), "12");
+    ASSERT_EQ(token.column, 5);
+
+    token = tokenizer.peekNextToken();
+    ASSERT_STREQ(token.getText().c_str(), "print");
+    ASSERT_EQ(token.line, 2);
+    ASSERT_EQ(token.column, 3);
+
+    tokenizer.getNextToken();
+    token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::OPEN_PAR);
+    ASSERT_EQ(token.column, 8);
+
+    token = tokenizer.getNextToken();
+    ASSERT_STREQ(token.getText().c_str(), "hi");
+    ASSERT_EQ(token.column, 9);
+
+    token = tokenizer.getNextToken();
+    ASSERT_EQ(token.getType(), TokenType::CLOSE_PAR);
+    ASSERT_EQ(token.line, 2);
+    ASSERT_EQ(token.column, 13);
+}
+
+
+TEST(Tokenizer, InputTokenizerMatches) {
+    const char* script =
+        "fib = FUN n {\n"
+        "    IF n <= 1 { n } ELSE { fib(n - 1) + fib(n - 2) }\n"
+        "}\n"
+        "x = 2.5 * 4 % 3; print(\"a\\tb\", x != 1 && x >= 0 || !x)\n"
+        "averyveryveryverylongnamethatspansmorethanthirtytwocharacters = "
+        "12345678901234567890.1234567890123456789 +                          "
+        "\"a long string that crosses vector boundaries \\\" with escapes\n"
+        "and a line break in the middle of it, followed by some more text\"";
+
+    std::unique_ptr<Input> bufferInput(new StringInput(script));
+    std::unique_ptr<Input> virtualInput(new StringInput(script));
+    Tokenizer tokenizer(bufferInput);
+    InputTokenizer inputTokenizer(virtualInput);
+
+    while (true) {
+        auto token = tokenizer.getNextToken();
+        auto expected = inputTokenizer.getNextToken();
+
+        ASSERT_EQ(token.getType(), expected.getType());
+        ASSERT_EQ(token.line, expected.line);
+        ASSERT_EQ(token.column, expected.column);
+        ASSERT_EQ(token.length, expected.length);
+        ASSERT_EQ(memcmp(token.text, expected.text, token.length), 0);
+
+        if (token.isType(TokenType::END_OF_FILE)) {
+            break;
+        }
+    }
 }
@@ -0,0 +1,72 @@
+#include "value.h"
+
+#include "environment.h"
+
+
+StringObject::StringObject(std::string value):
+    value(std::move(value)) {}
+
+size_t StringObject::getSize() const {
+    return sizeof(StringObject) + value.capacity();
+}
+
+HeapObject* StringObject::promote(Heap& heap) const {
+    return heap.allocate<StringObject>(value);
+}
+
+
+FunctionObject::FunctionObject(std::shared_ptr<Function> function,
+        Environment* environment, std::vector<ExpressionValue*> captures):
+    function(std::move(function)), environment(environment),
+    captures(std::move(captures)) {}
+
+void FunctionObject::trace(Heap& heap) {
+    heap.mark(environment);
+}
+
+size_t FunctionObject::getSize() const {
+    return sizeof(FunctionObject)
+        + captures.capacity() * sizeof(ExpressionValue*);
+}
+
+HeapObject* FunctionObject::promote(Heap& heap) const {
+    return heap.allocate<FunctionObject>(function, environment, captures);
+}
+
+
+ExpressionValue::ExpressionValue(std::string value):
+    type(ExpressionValueType::STRING),
+    payloadObject(Heap::global().allocate<StringObject>(std::move(value))) {}
+
+ExpressionValue::ExpressionValue(std::shared_ptr<Function> function):
+    type(ExpressionValueType::FUNCTION),
+    payloadObject(Heap::global().allocate<FunctionObject>(
+        std::move(function))) {}
+
+ExpressionValue ExpressionValue::youngString(std::string value) {
+    ExpressionValue result;
+    result.type = ExpressionValueType::STRING;
+    result.payloadObject = Heap::global().allocateYoung<StringObject>(
+        std::move(value));
+
+    return result;
+}
+
+ExpressionValue ExpressionValue::youngFunction(
+        std::shared_ptr<Function> function, Environment* environment,
+        std::vector<ExpressionValue*> captures) {
+    ExpressionValue result;
+    result.type = ExpressionValueType::FUNCTION;
+    result.payloadObject = Heap::global().allocateYoung<FunctionObject>(
+        std::move(function), environment, std::move(captures));
+
+    return result;
+}
+
+const std::string& ExpressionValue::getString() const {
+    return static_cast<StringObject*>(payloadObject)->value;
+}
+
+const std::shared_ptr<Function>& ExpressionValue::getFunction() const {
+    return static_cast<FunctionObject*>(payloadObject)->function;
+}
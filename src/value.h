@@ -0,0 +1,336 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "gc.h"
+
+
+class Environment;
+class ExpressionValue;
+class Function;
+
+
+/**
+ * @brief The type an expression evaluates to.
+ *
+ * This can be NONE, STRING, INT, FLOAT or FUNCTION. NONE is the value of
+ * expressions that do not produce anything, like a call to print.
+ * UNDEFINED marks environment slots that have not been assigned yet and is
+ * never the result of an evaluation.
+ *
+ */
+enum class ExpressionValueType : uint8_t {
+    UNDEFINED,
+    NONE,
+    STRING,
+    INT,
+    FLOAT,
+    FUNCTION
+};
+
+
+/**
+ * @brief A heap object holding the contents of a string value.
+ *
+ */
+class StringObject: public HeapObject {
+public:
+    /**
+     * @brief Construct a new String Object object.
+     *
+     * @param value the contents of the string.
+     */
+    StringObject(std::string value);
+
+    size_t getSize() const override;
+
+    HeapObject* promote(Heap& heap) const override;
+
+    /**
+     * @brief The contents of the string.
+     *
+     */
+    const std::string value;
+};
+
+
+/**
+ * @brief A heap object holding a function value: the function and the
+ * closure it was created with.
+ *
+ * The closure consists of the environment the function was defined in and
+ * its captured variables. Every variable is referenced by the address of its
+ * storage in an environment reachable from <environment>, so the function
+ * reads the current value of the variable in O(1).
+ *
+ */
+class FunctionObject: public HeapObject {
+public:
+    /**
+     * @brief Construct a new Function Object object.
+     *
+     * @param function the function this value refers to.
+     * @param environment the environment calls of the function are made in,
+     * nullptr to make them in the environment of the caller.
+     * @param captures the variables captured by the function.
+     */
+    FunctionObject(std::shared_ptr<Function> function,
+        Environment* environment = nullptr,
+        std::vector<ExpressionValue*> captures = {});
+
+    /**
+     * @brief Mark the environment of the closure.
+     *
+     * @param heap the heap running the collection.
+     */
+    void trace(Heap& heap) override;
+
+    size_t getSize() const override;
+
+    HeapObject* promote(Heap& heap) const override;
+
+    /**
+     * @brief The function this value refers to.
+     *
+     */
+    const std::shared_ptr<Function> function;
+
+    /**
+     * @brief The environment calls of the function are made in, nullptr for
+     * functions like print that need none.
+     *
+     */
+    Environment* const environment;
+
+    /**
+     * @brief The variables captured by the function, indexed like
+     * Function::getCaptures.
+     *
+     */
+    const std::vector<ExpressionValue*> captures;
+};
+
+
+/**
+ * @brief The value an expression evaluates to.
+ *
+ * Expression values are small (16 bytes) and passed around by value. INT and
+ * FLOAT values are stored inline, STRING and FUNCTION values point to a
+ * HeapObject that is shared between all copies. Copying a value is a plain
+ * copy of two words, the object is kept alive by the garbage collector as
+ * long as some root reaches a value pointing to it.
+ *
+ */
+class ExpressionValue {
+public:
+    /**
+     * @brief Construct a new Expression Value object of type NONE.
+     *
+     */
+    ExpressionValue();
+
+    /**
+     * @brief Construct a new Expression Value object of type INT.
+     *
+     * @param value the integer value.
+     */
+    explicit ExpressionValue(int value);
+
+    /**
+     * @brief Construct a new Expression Value object of type FLOAT.
+     *
+     * @param value the floating point value.
+     */
+    explicit ExpressionValue(float value);
+
+    /**
+     * @brief Construct a new Expression Value object of type STRING.
+     *
+     * @param value the contents of the string.
+     */
+    explicit ExpressionValue(std::string value);
+
+    /**
+     * @brief Construct a new Expression Value object of type FUNCTION.
+     *
+     * @param function the function this value refers to.
+     */
+    explicit ExpressionValue(std::shared_ptr<Function> function);
+
+    /**
+     * @brief Construct a new Expression Value object of type STRING whose
+     * heap object is allocated in the nursery.
+     *
+     * @param value the contents of the string.
+     * @return ExpressionValue the short lived value.
+     */
+    static ExpressionValue youngString(std::string value);
+
+    /**
+     * @brief Construct a new Expression Value object of type FUNCTION whose
+     * heap object is allocated in the nursery.
+     *
+     * @param function the function this value refers to.
+     * @param environment the environment calls of the function are made in.
+     * @param captures the variables captured by the function.
+     * @return ExpressionValue the short lived value.
+     */
+    static ExpressionValue youngFunction(std::shared_ptr<Function> function,
+        Environment* environment = nullptr,
+        std::vector<ExpressionValue*> captures = {});
+
+    /**
+     * @brief Create a value of type UNDEFINED.
+     *
+     * @return ExpressionValue the value for slots not assigned yet.
+     */
+    static ExpressionValue undefined() {
+        ExpressionValue value;
+        value.type = ExpressionValueType::UNDEFINED;
+
+        return value;
+    }
+
+    /**
+     * @brief Get the contents of a STRING value.
+     *
+     * @return const std::string& the contents of the string.
+     */
+    const std::string& getString() const;
+
+    /**
+     * @brief Get the function of a FUNCTION value.
+     *
+     * @return const std::shared_ptr<Function>& the function.
+     */
+    const std::shared_ptr<Function>& getFunction() const;
+
+    /**
+     * @brief Get the heap object of a FUNCTION value, holding its closure.
+     *
+     * @return FunctionObject* the object.
+     */
+    FunctionObject* getFunctionObject() const {
+        return static_cast<FunctionObject*>(payloadObject);
+    }
+
+    /**
+     * @brief Check whether this value keeps a HeapObject alive.
+     *
+     * @return true if <type> is STRING or FUNCTION.
+     * @return false otherwise.
+     */
+    bool isHeapValue() const {
+        return type == ExpressionValueType::STRING
+            || type == ExpressionValueType::FUNCTION;
+    }
+
+    /**
+     * @brief Get the heap object of this value, for example to Pin it.
+     *
+     * @return HeapObject* the object, nullptr if this is no heap value.
+     */
+    HeapObject* getHeapObject() const {
+        return isHeapValue() ? payloadObject : nullptr;
+    }
+
+    /**
+     * @brief Get this value in a form that may be stored in an environment,
+     * copying its heap object out of the nursery if needed.
+     *
+     * @return ExpressionValue the promoted value.
+     */
+    ExpressionValue promote() const {
+        ExpressionValue value = *this;
+
+        if (isHeapValue()) {
+            value.payloadObject = Heap::global().promote(payloadObject);
+        }
+
+        return value;
+    }
+
+    /**
+     * @brief Get this value in a form that survives releasing the nursery
+     * to <mark>, used for the result of a call.
+     *
+     * @param mark the mark the nursery is about to be released to.
+     * @return ExpressionValue the promoted value.
+     */
+    ExpressionValue escape(const NurseryMark& mark) const {
+        if (isHeapValue() && Heap::global().isYoungerThan(payloadObject, mark)) {
+            return promote();
+        }
+
+        return *this;
+    }
+
+    /**
+     * @brief Mark the heap object of this value during a collection.
+     *
+     * @param heap the heap running the collection.
+     */
+    void trace(Heap& heap) const {
+        if (isHeapValue()) {
+            heap.mark(payloadObject);
+        }
+    }
+
+    /**
+     * @brief The type of this Expression Value. Determines which member of
+     * the payload union is valid.
+     *
+     */
+    ExpressionValueType type;
+
+    union {
+        /**
+         * @brief Contains an integer value as an Expression Value,
+         * if <type> is ExpressionValueType::INT.
+         *
+         */
+        int payloadInt;
+
+        /**
+         * @brief Contains a float value as an Expression Value,
+         * if <type> is ExpressionValueType::FLOAT.
+         *
+         */
+        float payloadFloat;
+
+        /**
+         * @brief Points to the StringObject or FunctionObject, if <type> is
+         * ExpressionValueType::STRING or ExpressionValueType::FUNCTION.
+         *
+         */
+        HeapObject* payloadObject;
+    };
+};
+
+static_assert(sizeof(ExpressionValue) == 16,
+    "ExpressionValue should fit into two machine words");
+static_assert(std::is_trivially_copyable<ExpressionValue>::value,
+    "ExpressionValue should be copied without touching the heap");
+
+
+inline ExpressionValue::ExpressionValue():
+    type(ExpressionValueType::NONE), payloadObject(nullptr) {}
+
+inline ExpressionValue::ExpressionValue(int value):
+    type(ExpressionValueType::INT), payloadObject(nullptr) {
+    payloadInt = value;
+}
+
+inline ExpressionValue::ExpressionValue(float value):
+    type(ExpressionValueType::FLOAT), payloadObject(nullptr) {
+    payloadFloat = value;
+}
+
+
+#endif
@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+
+#include "expressions.h"
+
+
+TEST(ExpressionValue, DefaultIsNone) {
+    ExpressionValue value;
+
+    ASSERT_EQ(value.type, ExpressionValueType::NONE);
+    ASSERT_FALSE(value.isHeapValue());
+}
+
+
+TEST(ExpressionValue, CopiesShareString) {
+    ExpressionValue value(std::string("shared"));
+    ExpressionValue copy = value;
+
+    ASSERT_EQ(copy.payloadObject, value.payloadObject);
+    ASSERT_EQ(copy.getHeapObject(), value.getHeapObject());
+    ASSERT_STREQ(value.getString().c_str(), "shared");
+}
+
+
+TEST(ExpressionValue, InlineValuesHaveNoHeapObject) {
+    ExpressionValue value(42);
+
+    ASSERT_EQ(value.getHeapObject(), nullptr);
+}
+
+
+TEST(ExpressionValue, IntegerArithmeticIsInline) {
+    ExpressionValue left(40);
+    ExpressionValue right(2);
+
+    auto sum = Addition::apply(left, right);
+    ASSERT_EQ(sum.type, ExpressionValueType::INT);
+    ASSERT_EQ(sum.payloadInt, 42);
+    ASSERT_FALSE(sum.isHeapValue());
+
+    auto comparison = LessThanComparison::apply(left, right);
+    ASSERT_EQ(comparison.type, ExpressionValueType::INT);
+    ASSERT_EQ(comparison.payloadInt, 0);
+}
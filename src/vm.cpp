@@ -0,0 +1,885 @@
+#include "vm.h"
+
+#include "jit.h"
+
+
+// GCC and Clang can take the address of a label, so every instruction jumps
+// to the next one directly instead of going back to a single switch
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_THREADED_DISPATCH
+#endif
+
+
+namespace {
+
+template <typename Number>
+bool compareNumbers(OpCode comparison, Number left, Number right) {
+    switch (comparison) {
+        case OpCode::EQUALS:
+            return left == right;
+        case OpCode::NOT_EQUALS:
+            return left != right;
+        case OpCode::GREATER:
+            return left > right;
+        case OpCode::GREATER_OR_EQUALS:
+            return left >= right;
+        case OpCode::LESS:
+            return left < right;
+        case OpCode::LESS_OR_EQUALS:
+            return left <= right;
+        default:
+            throw std::exception("Unknown instruction");
+    }
+}
+
+}
+
+
+VirtualMachine::VirtualMachine() {
+    Heap::global().addRootSet(this);
+}
+
+VirtualMachine::~VirtualMachine() {
+    Heap::global().removeRootSet(this);
+}
+
+void VirtualMachine::traceRoots(Heap& heap) {
+    for (auto it = stack.begin(); it != stack.end(); it++) {
+        it->trace(heap);
+    }
+
+    for (auto it = frames.begin(); it != frames.end(); it++) {
+        heap.mark(it->env);
+    }
+}
+
+ExpressionValue VirtualMachine::pop() {
+    auto value = stack.back();
+    stack.pop_back();
+
+    return value;
+}
+
+void VirtualMachine::binaryOperation(ExpressionValue (*operation)(
+        const ExpressionValue&, const ExpressionValue&)) {
+    auto rightValue = pop();
+    auto& leftValue = stack.back();
+
+    leftValue = operation(leftValue, rightValue);
+}
+
+bool VirtualMachine::compare(OpCode comparison) {
+    auto rightValue = pop();
+    auto leftValue = pop();
+
+    if (leftValue.type == ExpressionValueType::INT
+            && rightValue.type == ExpressionValueType::INT) {
+        return compareNumbers(comparison, leftValue.payloadInt,
+            rightValue.payloadInt);
+    }
+
+    if (leftValue.type == ExpressionValueType::FLOAT
+            && rightValue.type == ExpressionValueType::FLOAT) {
+        return compareNumbers(comparison, leftValue.payloadFloat,
+            rightValue.payloadFloat);
+    }
+
+    // Reports the same errors as the comparison on its own
+    ExpressionValue result;
+    switch (comparison) {
+        case OpCode::EQUALS:
+            result = EqualComparison::apply(leftValue, rightValue);
+            break;
+        case OpCode::NOT_EQUALS:
+            result = NotEqualComparison::apply(leftValue, rightValue);
+            break;
+        case OpCode::GREATER:
+            result = GreaterThanComparison::apply(leftValue, rightValue);
+            break;
+        case OpCode::GREATER_OR_EQUALS:
+            result = GreaterThanOrEqualComparison::apply(leftValue,
+                rightValue);
+            break;
+        case OpCode::LESS:
+            result = LessThanComparison::apply(leftValue, rightValue);
+            break;
+        case OpCode::LESS_OR_EQUALS:
+            result = LessThanOrEqualComparison::apply(leftValue, rightValue);
+            break;
+        default:
+            throw std::exception("Unknown instruction");
+    }
+
+    return result.type == ExpressionValueType::INT && result.payloadInt != 0;
+}
+
+void VirtualMachine::quicken(const Chunk& chunk, size_t offset,
+        OpCode intOp, OpCode floatOp) {
+    auto& leftValue = stack[stack.size() - 2];
+    auto& rightValue = stack.back();
+
+    if (leftValue.type != rightValue.type) {
+        return;
+    }
+
+    if (leftValue.type == ExpressionValueType::INT) {
+        chunk.rewrite(offset, intOp);
+    } else if (leftValue.type == ExpressionValueType::FLOAT) {
+        chunk.rewrite(offset, floatOp);
+    }
+}
+
+void VirtualMachine::call(uint32_t argCount) {
+    // Every live value is on the stack or in a frame here
+    Heap::global().safepoint();
+
+    if (frames.size() >= maxDepth) {
+        throw std::exception("Stack overflow");
+    }
+
+    size_t functionIndex = stack.size() - argCount - 1;
+    if (stack[functionIndex].type != ExpressionValueType::FUNCTION) {
+        throw std::exception("Only invoke functions");
+    }
+
+    HeapObject* functionObject = stack[functionIndex].payloadObject;
+    auto& function = stack[functionIndex].getFunction();
+    auto& parameterScope = function->getParameterScope();
+
+    if (parameterScope.size() != argCount) {
+        throw std::exception("Function arguments do not map to parameters");
+    }
+
+    auto compiled = dynamic_cast<const CompiledFunction*>(function.get());
+    if (compiled) {
+        callCompiled(*compiled, functionIndex);
+        return;
+    }
+
+    auto mark = Heap::global().getNurseryMark();
+    auto functionEnv = Function::createEnvironment(stack[functionIndex],
+        frames.back().env);
+
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        functionEnv->bindSlot(slot, stack[functionIndex + 1 + slot]);
+    }
+
+    Pin pinFunction(functionObject);
+    Pin pinEnv(functionEnv);
+
+    auto result = function->evaluate(functionEnv).escape(mark);
+    Heap::global().releaseNursery(mark);
+    stack.resize(functionIndex);
+    stack.push_back(result);
+}
+
+void VirtualMachine::callSelf(const Chunk& chunk, size_t offset,
+        uint32_t argCount) {
+    size_t functionIndex = stack.size() - argCount - 1;
+    auto& callee = stack[functionIndex];
+    const CompiledFunction* function = frames.back().function;
+
+    if (callee.type != ExpressionValueType::FUNCTION
+            || callee.getFunction().get() != function) {
+        chunk.rewrite(offset, OpCode::CALL);
+        call(argCount);
+        return;
+    }
+
+    // Every live value is on the stack or in a frame here
+    Heap::global().safepoint();
+
+    if (frames.size() >= maxDepth) {
+        throw std::exception("Stack overflow");
+    }
+
+    if (function->getParameterScope().size() != argCount) {
+        throw std::exception("Function arguments do not map to parameters");
+    }
+
+    callCompiled(*function, functionIndex);
+}
+
+void VirtualMachine::callCompiled(const CompiledFunction& function,
+        size_t functionIndex) {
+    auto& parameterScope = function.getParameterScope();
+    uint32_t argCount = parameterScope.size();
+
+    MemoKey key;
+    bool memoized = function.isMemoized() && MemoTable::makeKey(
+        stack.data() + functionIndex + 1, argCount, key);
+
+    ExpressionValue result;
+    if (memoized && function.getMemoTable().lookup(key, result)) {
+        stack.resize(functionIndex);
+        stack.push_back(result);
+        return;
+    }
+
+    // The callees of the machine code are looked up where the function was
+    // defined, the frames left are the depth it may recurse to
+    auto closure = stack[functionIndex].getFunctionObject();
+    if (function.jit && function.jit->run(&function,
+            stack.data() + functionIndex + 1,
+            closure->environment ? closure->environment : frames.back().env,
+            maxDepth - frames.size(), result)) {
+        if (memoized) {
+            function.getMemoTable().store(key, result);
+        }
+
+        stack.resize(functionIndex);
+        stack.push_back(result);
+        return;
+    }
+
+    auto mark = Heap::global().getNurseryMark();
+    auto functionEnv = Function::createEnvironment(stack[functionIndex],
+        frames.back().env);
+
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        functionEnv->bindSlot(slot, stack[functionIndex + 1 + slot]);
+    }
+
+    stack.resize(functionIndex);
+
+    frames.push_back(CallFrame{ &function, 0, functionEnv, mark,
+        frames.back().env,
+        memoized ? &function.getMemoTable() : nullptr,
+        std::move(key) });
+}
+
+void VirtualMachine::quickenCall(const Chunk& chunk, size_t offset,
+        uint32_t argCount) {
+    auto& callee = stack[stack.size() - argCount - 1];
+
+    if (callee.type == ExpressionValueType::FUNCTION
+            && callee.getFunction().get() == frames.back().function) {
+        chunk.rewrite(offset, OpCode::CALL_SELF);
+    }
+}
+
+void VirtualMachine::tailCall(uint32_t argCount) {
+    size_t functionIndex = stack.size() - argCount - 1;
+    const CompiledFunction* compiled = nullptr;
+
+    if (stack[functionIndex].type == ExpressionValueType::FUNCTION) {
+        compiled = dynamic_cast<const CompiledFunction*>(
+            stack[functionIndex].getFunction().get());
+    }
+
+    if (!compiled) {
+        call(argCount);
+        return;
+    }
+
+    // Every live value is on the stack or in a frame here
+    Heap::global().safepoint();
+
+    auto& parameterScope = compiled->getParameterScope();
+    if (parameterScope.size() != argCount) {
+        throw std::exception("Function arguments do not map to parameters");
+    }
+
+    // The function and its arguments outlive the frame they replace
+    CallFrame& frame = frames.back();
+    for (size_t index = functionIndex; index < stack.size(); index++) {
+        stack[index] = stack[index].escape(frame.mark);
+    }
+    Heap::global().releaseNursery(frame.mark);
+
+    auto functionEnv = Function::createEnvironment(stack[functionIndex],
+        frame.caller);
+
+    for (uint32_t slot = 0; slot < argCount; slot++) {
+        functionEnv->bindSlot(slot, stack[functionIndex + 1 + slot]);
+    }
+
+    stack.resize(functionIndex);
+
+    frame.function = compiled;
+    frame.ip = 0;
+    frame.env = functionEnv;
+}
+
+ExpressionValue VirtualMachine::run(
+        const CompiledFunction& function, Environment* env) {
+    NurseryRegion region(Heap::global());
+
+    stack.clear();
+    frames.clear();
+    frames.push_back(CallFrame{ &function, 0, env, region.getMark(),
+        env->getParent(), nullptr, {} });
+
+    try {
+        return execute();
+    } catch (...) {
+        // The frames refer to environments released with the nursery
+        stack.clear();
+        frames.clear();
+        throw;
+    }
+}
+
+void VirtualMachine::setMaxDepth(size_t maxDepth) {
+    this->maxDepth = maxDepth;
+}
+
+// Moves past the instruction at <offset> and its <operands>
+#define ADVANCE(operands) \
+    frame->ip = offset + 1 + (operands) * sizeof(uint32_t)
+
+#define OPERAND(index) chunk->readOperand(offset, index)
+
+// Calls and returns change the current frame
+#define ENTER_FRAME() \
+    frame = &frames.back(); \
+    chunk = &frame->function->chunk
+
+#ifdef VM_THREADED_DISPATCH
+#define INSTRUCTION(op) execute_##op:
+#define NEXT() \
+    offset = frame->ip; \
+    goto *instructions[chunk->code[offset]]
+#else
+#define INSTRUCTION(op) case OpCode::op:
+#define NEXT() continue
+#endif
+
+ExpressionValue VirtualMachine::execute() {
+    CallFrame* frame;
+    const Chunk* chunk;
+    size_t offset;
+
+    ENTER_FRAME();
+
+#ifdef VM_THREADED_DISPATCH
+    static void* const instructions[] = {
+        &&execute_CONSTANT,
+        &&execute_CLOSURE,
+        &&execute_NONE,
+        &&execute_POP,
+        &&execute_LOAD_NAME,
+        &&execute_STORE_NAME,
+        &&execute_LOAD_LOCAL,
+        &&execute_STORE_LOCAL,
+        &&execute_LOAD_GLOBAL,
+        &&execute_LOAD_CAPTURED,
+        &&execute_STORE_CAPTURED,
+        &&execute_LOAD_CALLEE,
+        &&execute_ADD,
+        &&execute_SUBTRACT,
+        &&execute_MULTIPLY,
+        &&execute_DIVIDE,
+        &&execute_EQUALS,
+        &&execute_NOT_EQUALS,
+        &&execute_GREATER,
+        &&execute_GREATER_OR_EQUALS,
+        &&execute_LESS,
+        &&execute_LESS_OR_EQUALS,
+        &&execute_ADD_INT,
+        &&execute_SUBTRACT_INT,
+        &&execute_MULTIPLY_INT,
+        &&execute_DIVIDE_INT,
+        &&execute_EQUALS_INT,
+        &&execute_NOT_EQUALS_INT,
+        &&execute_GREATER_INT,
+        &&execute_GREATER_OR_EQUALS_INT,
+        &&execute_LESS_INT,
+        &&execute_LESS_OR_EQUALS_INT,
+        &&execute_ADD_FLOAT,
+        &&execute_SUBTRACT_FLOAT,
+        &&execute_MULTIPLY_FLOAT,
+        &&execute_DIVIDE_FLOAT,
+        &&execute_EQUALS_FLOAT,
+        &&execute_NOT_EQUALS_FLOAT,
+        &&execute_GREATER_FLOAT,
+        &&execute_GREATER_OR_EQUALS_FLOAT,
+        &&execute_LESS_FLOAT,
+        &&execute_LESS_OR_EQUALS_FLOAT,
+        &&execute_ADD_LOCAL_CONSTANT,
+        &&execute_SUBTRACT_LOCAL_CONSTANT,
+        &&execute_JUMP,
+        &&execute_LOOP,
+        &&execute_JUMP_IF_FALSE,
+        &&execute_COMPARE_JUMP_IF_FALSE,
+        &&execute_JUMP_IF_FALSE_OR_POP,
+        &&execute_JUMP_IF_TRUE_OR_POP,
+        &&execute_PUSH_SCOPE,
+        &&execute_POP_SCOPE,
+        &&execute_CALL,
+        &&execute_CALL_SELF,
+        &&execute_TAIL_CALL,
+        &&execute_RETURN,
+    };
+    static_assert(sizeof(instructions) / sizeof(instructions[0])
+        == static_cast<size_t>(OpCode::RETURN) + 1,
+        "Every instruction needs a label");
+
+    NEXT();
+#else
+    while (true) {
+        offset = frame->ip;
+
+        switch (static_cast<OpCode>(chunk->code[offset])) {
+#endif
+            INSTRUCTION(CONSTANT) {
+                stack.push_back(chunk->constants[OPERAND(0)]);
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(CLOSURE) {
+                stack.push_back(Function::createClosure(
+                    chunk->constants[OPERAND(0)].getFunction(), frame->env));
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(NONE) {
+                stack.emplace_back();
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(POP) {
+                stack.pop_back();
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LOAD_NAME) {
+                stack.push_back(frame->env->getVariable(OPERAND(0)));
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(STORE_NAME) {
+                frame->env->setVariable(OPERAND(0), stack.back());
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(LOAD_LOCAL) {
+                stack.push_back(
+                    frame->env->getLocalVariable(OPERAND(0), OPERAND(1)));
+                ADVANCE(2);
+                NEXT();
+            }
+            INSTRUCTION(STORE_LOCAL) {
+                frame->env->setLocalVariable(OPERAND(0), OPERAND(1),
+                    stack.back());
+                ADVANCE(2);
+                NEXT();
+            }
+            INSTRUCTION(LOAD_GLOBAL) {
+                stack.push_back(frame->env->getGlobalVariable(OPERAND(0)));
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(LOAD_CAPTURED) {
+                stack.push_back(frame->env->getCapturedVariable(OPERAND(0),
+                    OPERAND(1), OPERAND(2)));
+                ADVANCE(3);
+                NEXT();
+            }
+            INSTRUCTION(STORE_CAPTURED) {
+                frame->env->setCapturedVariable(OPERAND(0), OPERAND(1),
+                    OPERAND(2), stack.back());
+                ADVANCE(3);
+                NEXT();
+            }
+            INSTRUCTION(LOAD_CALLEE) {
+                stack.push_back(frame->env->getVariable(OPERAND(0),
+                    chunk->caches[OPERAND(1)]));
+                ADVANCE(2);
+                NEXT();
+            }
+            INSTRUCTION(ADD) {
+                quicken(*chunk, offset, OpCode::ADD_INT,
+                    OpCode::ADD_FLOAT);
+                binaryOperation(Addition::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(SUBTRACT) {
+                quicken(*chunk, offset, OpCode::SUBTRACT_INT,
+                    OpCode::SUBTRACT_FLOAT);
+                binaryOperation(Subtraction::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(MULTIPLY) {
+                quicken(*chunk, offset, OpCode::MULTIPLY_INT,
+                    OpCode::MULTIPLY_FLOAT);
+                binaryOperation(Multiplication::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(DIVIDE) {
+                quicken(*chunk, offset, OpCode::DIVIDE_INT,
+                    OpCode::DIVIDE_FLOAT);
+                binaryOperation(Division::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(EQUALS) {
+                quicken(*chunk, offset, OpCode::EQUALS_INT,
+                    OpCode::EQUALS_FLOAT);
+                binaryOperation(EqualComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(NOT_EQUALS) {
+                quicken(*chunk, offset, OpCode::NOT_EQUALS_INT,
+                    OpCode::NOT_EQUALS_FLOAT);
+                binaryOperation(NotEqualComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER) {
+                quicken(*chunk, offset, OpCode::GREATER_INT,
+                    OpCode::GREATER_FLOAT);
+                binaryOperation(GreaterThanComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER_OR_EQUALS) {
+                quicken(*chunk, offset, OpCode::GREATER_OR_EQUALS_INT,
+                    OpCode::GREATER_OR_EQUALS_FLOAT);
+                binaryOperation(GreaterThanOrEqualComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS) {
+                quicken(*chunk, offset, OpCode::LESS_INT,
+                    OpCode::LESS_FLOAT);
+                binaryOperation(LessThanComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS_OR_EQUALS) {
+                quicken(*chunk, offset, OpCode::LESS_OR_EQUALS_INT,
+                    OpCode::LESS_OR_EQUALS_FLOAT);
+                binaryOperation(LessThanOrEqualComparison::apply);
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(ADD_INT) {
+                intOperation(*chunk, offset, OpCode::ADD,
+                    Addition::apply,
+                    [](int left, int right) {
+                        return left + right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(SUBTRACT_INT) {
+                intOperation(*chunk, offset, OpCode::SUBTRACT,
+                    Subtraction::apply,
+                    [](int left, int right) {
+                        return left - right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(MULTIPLY_INT) {
+                intOperation(*chunk, offset, OpCode::MULTIPLY,
+                    Multiplication::apply,
+                    [](int left, int right) {
+                        return left * right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(DIVIDE_INT) {
+                if (stack.back().type == ExpressionValueType::INT
+                        && stack.back().payloadInt == 0) {
+                    // Left to the generic operation to report
+                    binaryOperation(Division::apply);
+                    ADVANCE(0);
+                    NEXT();
+                }
+
+                intOperation(*chunk, offset, OpCode::DIVIDE,
+                    Division::apply,
+                    [](int left, int right) {
+                        return left / right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(EQUALS_INT) {
+                intOperation(*chunk, offset, OpCode::EQUALS,
+                    EqualComparison::apply,
+                    [](int left, int right) {
+                        return left == right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(NOT_EQUALS_INT) {
+                intOperation(*chunk, offset, OpCode::NOT_EQUALS,
+                    NotEqualComparison::apply,
+                    [](int left, int right) {
+                        return left != right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER_INT) {
+                intOperation(*chunk, offset, OpCode::GREATER,
+                    GreaterThanComparison::apply,
+                    [](int left, int right) {
+                        return left > right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER_OR_EQUALS_INT) {
+                intOperation(*chunk, offset, OpCode::GREATER_OR_EQUALS,
+                    GreaterThanOrEqualComparison::apply,
+                    [](int left, int right) {
+                        return left >= right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS_INT) {
+                intOperation(*chunk, offset, OpCode::LESS,
+                    LessThanComparison::apply,
+                    [](int left, int right) {
+                        return left < right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS_OR_EQUALS_INT) {
+                intOperation(*chunk, offset, OpCode::LESS_OR_EQUALS,
+                    LessThanOrEqualComparison::apply,
+                    [](int left, int right) {
+                        return left <= right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(ADD_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::ADD,
+                    Addition::apply,
+                    [](float left, float right) {
+                        return left + right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(SUBTRACT_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::SUBTRACT,
+                    Subtraction::apply,
+                    [](float left, float right) {
+                        return left - right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(MULTIPLY_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::MULTIPLY,
+                    Multiplication::apply,
+                    [](float left, float right) {
+                        return left * right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(DIVIDE_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::DIVIDE,
+                    Division::apply,
+                    [](float left, float right) {
+                        return left / right;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(EQUALS_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::EQUALS,
+                    EqualComparison::apply,
+                    [](float left, float right) {
+                        return left == right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(NOT_EQUALS_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::NOT_EQUALS,
+                    NotEqualComparison::apply,
+                    [](float left, float right) {
+                        return left != right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::GREATER,
+                    GreaterThanComparison::apply,
+                    [](float left, float right) {
+                        return left > right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(GREATER_OR_EQUALS_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::GREATER_OR_EQUALS,
+                    GreaterThanOrEqualComparison::apply,
+                    [](float left, float right) {
+                        return left >= right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::LESS,
+                    LessThanComparison::apply,
+                    [](float left, float right) {
+                        return left < right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(LESS_OR_EQUALS_FLOAT) {
+                floatOperation(*chunk, offset, OpCode::LESS_OR_EQUALS,
+                    LessThanOrEqualComparison::apply,
+                    [](float left, float right) {
+                        return left <= right ? 1 : 0;
+                    });
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(ADD_LOCAL_CONSTANT) {
+                localConstantOperation(*chunk, offset, Addition::apply,
+                    [](int left, int right) {
+                        return left + right;
+                    });
+                ADVANCE(3);
+                NEXT();
+            }
+            INSTRUCTION(SUBTRACT_LOCAL_CONSTANT) {
+                localConstantOperation(*chunk, offset, Subtraction::apply,
+                    [](int left, int right) {
+                        return left - right;
+                    });
+                ADVANCE(3);
+                NEXT();
+            }
+            INSTRUCTION(JUMP) {
+                frame->ip = OPERAND(0);
+                NEXT();
+            }
+            INSTRUCTION(LOOP) {
+                // Every live value is on the stack or in a frame here
+                Heap::global().safepoint();
+                frame->ip = OPERAND(0);
+                NEXT();
+            }
+            INSTRUCTION(JUMP_IF_FALSE) {
+                auto condition = pop();
+                if (condition.type != ExpressionValueType::INT
+                        || condition.payloadInt == 0) {
+                    frame->ip = OPERAND(0);
+                } else {
+                    ADVANCE(1);
+                }
+                NEXT();
+            }
+            INSTRUCTION(COMPARE_JUMP_IF_FALSE) {
+                if (!compare(static_cast<OpCode>(OPERAND(1)))) {
+                    frame->ip = OPERAND(0);
+                } else {
+                    ADVANCE(2);
+                }
+                NEXT();
+            }
+            INSTRUCTION(JUMP_IF_FALSE_OR_POP) {
+                auto& leftValue = stack.back();
+                if (leftValue.type != ExpressionValueType::INT) {
+                    throw std::exception("And: Wrong types");
+                }
+
+                if (leftValue.payloadInt == 0) {
+                    frame->ip = OPERAND(0);
+                } else {
+                    stack.pop_back();
+                    ADVANCE(1);
+                }
+                NEXT();
+            }
+            INSTRUCTION(JUMP_IF_TRUE_OR_POP) {
+                auto& leftValue = stack.back();
+                if (leftValue.type != ExpressionValueType::INT) {
+                    throw std::exception("Or: Wrong types");
+                }
+
+                if (leftValue.payloadInt == 1) {
+                    frame->ip = OPERAND(0);
+                } else {
+                    stack.pop_back();
+                    ADVANCE(1);
+                }
+                NEXT();
+            }
+            INSTRUCTION(PUSH_SCOPE) {
+                frame->env = Environment::create(frame->env,
+                    chunk->scopes[OPERAND(0)]);
+                ADVANCE(1);
+                NEXT();
+            }
+            INSTRUCTION(POP_SCOPE) {
+                frame->env = frame->env->getParent();
+                ADVANCE(0);
+                NEXT();
+            }
+            INSTRUCTION(CALL) {
+                uint32_t argCount = OPERAND(0);
+                ADVANCE(1);
+
+                quickenCall(*chunk, offset, argCount);
+                call(argCount);
+                ENTER_FRAME();
+                NEXT();
+            }
+            INSTRUCTION(CALL_SELF) {
+                uint32_t argCount = OPERAND(0);
+                ADVANCE(1);
+
+                callSelf(*chunk, offset, argCount);
+                ENTER_FRAME();
+                NEXT();
+            }
+            INSTRUCTION(TAIL_CALL) {
+                uint32_t argCount = OPERAND(0);
+                ADVANCE(1);
+
+                tailCall(argCount);
+                ENTER_FRAME();
+                NEXT();
+            }
+            INSTRUCTION(RETURN) {
+                if (frame->memoTable) {
+                    frame->memoTable->store(frame->memoKey, stack.back());
+                }
+
+                stack.back() = stack.back().escape(frame->mark);
+                Heap::global().releaseNursery(frame->mark);
+                frames.pop_back();
+
+                if (frames.empty()) {
+                    return pop();
+                }
+
+                ENTER_FRAME();
+                NEXT();
+            }
+#ifndef VM_THREADED_DISPATCH
+            default:
+                throw std::exception("Unknown instruction");
+        }
+    }
+#endif
+}
+
+#undef ADVANCE
+#undef OPERAND
+#undef ENTER_FRAME
+#undef INSTRUCTION
+#undef NEXT
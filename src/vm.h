@@ -0,0 +1,359 @@
+#ifndef VM_H
+#define VM_H
+
+
+#include <memory>
+#include <vector>
+
+#include "bytecode.h"
+#include "gc.h"
+
+
+/**
+ * @brief A stack based virtual machine executing CompiledFunctions.
+ *
+ * Operands and intermediate results live on a value stack and calls between
+ * compiled functions push call frames instead of recursing on the C++ stack.
+ * Variables are still kept in Environments, so the VirtualMachine produces
+ * the same results as evaluating the expression tree directly.
+ *
+ * The value stack and the environments of all call frames are roots of the
+ * global heap while the VirtualMachine exists. Collections happen at calls.
+ * Environments and temporaries of a call are allocated in the nursery and
+ * released when the call returns. Tail calls reuse the call frame, so tail
+ * recursion runs in constant space. Calls of pure functions are looked up in
+ * their memo table first, their frame stores the result when it returns.
+ *
+ * Arithmetic and comparison instructions quicken themselves: after seeing
+ * two INT or two FLOAT operands they are rewritten to a form that only
+ * handles that type, and back to the generic form when the types change.
+ * Calls of the executing function are quickened the same way.
+ *
+ * Built with GCC or Clang, every instruction jumps to the next one through a
+ * table of label addresses (threaded dispatch). Other compilers dispatch
+ * through a switch in a loop.
+ *
+ * As calls do not use the C++ stack, the depth of recursion is only limited
+ * by the maximum number of call frames. Exceeding it throws a stack overflow
+ * error, which makes the VirtualMachine suitable for running untrusted
+ * scripts on threads with small stacks.
+ *
+ */
+class VirtualMachine: public RootSet {
+public:
+    /**
+     * @brief The default maximum number of call frames.
+     *
+     */
+    static const size_t DEFAULT_MAX_DEPTH = 100000;
+
+    /**
+     * @brief Construct a new Virtual Machine object and register it as root
+     * set of the global heap.
+     *
+     */
+    VirtualMachine();
+
+    VirtualMachine(const VirtualMachine&) = delete;
+    VirtualMachine& operator=(const VirtualMachine&) = delete;
+
+    /**
+     * @brief Destroy the Virtual Machine object and remove it from the root
+     * sets of the global heap.
+     *
+     */
+    ~VirtualMachine();
+
+    /**
+     * @brief Run a compiled function until it returns.
+     *
+     * @param function the function to run, usually the result of
+     * Compiler::compileProgram.
+     * @param env the environment to run <function> in. Parameters must
+     * already be assigned.
+     * @return ExpressionValue the value returned by
+     * <function>.
+     */
+    ExpressionValue run(const CompiledFunction& function,
+        Environment* env);
+
+    /**
+     * @brief Set the maximum number of call frames. Calls beyond it throw.
+     *
+     * @param maxDepth the number of nested calls allowed, including the
+     * function passed to run.
+     */
+    void setMaxDepth(size_t maxDepth);
+
+    /**
+     * @brief Mark all values on the stack and the environments of all call
+     * frames.
+     *
+     * @param heap the heap running the collection.
+     */
+    void traceRoots(Heap& heap) override;
+
+private:
+    /**
+     * @brief The state of a compiled function that is currently executing.
+     *
+     */
+    struct CallFrame {
+        /**
+         * @brief The function being executed. Kept alive by the constant
+         * holding it in the chunk of the enclosing function.
+         *
+         */
+        const CompiledFunction* function;
+
+        /**
+         * @brief The offset of the next instruction to execute.
+         *
+         */
+        size_t ip;
+
+        /**
+         * @brief The innermost scope of the function.
+         *
+         */
+        Environment* env;
+
+        /**
+         * @brief The nursery position when the function was called. The
+         * nursery is released to it when the function returns.
+         *
+         */
+        NurseryMark mark;
+
+        /**
+         * @brief The environment the function was called in. Tail calls keep
+         * it as the parent for functions without closure.
+         *
+         */
+        Environment* caller;
+
+        /**
+         * @brief The memo table the result is stored in when the function
+         * returns, nullptr if the call is not memoized.
+         *
+         */
+        MemoTable* memoTable;
+
+        /**
+         * @brief The arguments of the original call, the key of the result.
+         * Tail calls keep it.
+         *
+         */
+        MemoKey memoKey;
+    };
+
+    /**
+     * @brief Execute instructions until the first call frame returns.
+     *
+     * @return ExpressionValue the value returned by the first call frame.
+     */
+    ExpressionValue execute();
+
+    /**
+     * @brief Pop the two topmost values, combine them with <operation> and
+     * push the result.
+     *
+     * @param operation the operation to apply, e.g. Addition::apply.
+     */
+    void binaryOperation(ExpressionValue (*operation)(
+        const ExpressionValue&, const ExpressionValue&));
+
+    /**
+     * @brief Quicken the generic operation at <offset> if its two operands
+     * on top of the stack are both INT or both FLOAT values.
+     *
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param intOp the form of the instruction for two INT operands.
+     * @param floatOp the form of the instruction for two FLOAT operands.
+     */
+    void quicken(const Chunk& chunk, size_t offset, OpCode intOp,
+        OpCode floatOp);
+
+    /**
+     * @brief Pop two operands and compare them.
+     *
+     * @param comparison the comparison instruction, like LESS.
+     * @return true if the comparison holds.
+     * @return false otherwise.
+     */
+    bool compare(OpCode comparison);
+
+    /**
+     * @brief Push the local variable of an ADD_LOCAL_CONSTANT or
+     * SUBTRACT_LOCAL_CONSTANT instruction combined with its constant.
+     *
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param apply the generic operation, used unless both are INT values.
+     * @param operation the operation on two INT values.
+     */
+    template <typename Operation>
+    void localConstantOperation(const Chunk& chunk, size_t offset,
+            ExpressionValue (*apply)(
+                const ExpressionValue&, const ExpressionValue&),
+            Operation operation) {
+        auto leftValue = frames.back().env->getLocalVariable(
+            chunk.readOperand(offset), chunk.readOperand(offset, 1));
+        auto& rightValue = chunk.constants[chunk.readOperand(offset, 2)];
+
+        if (leftValue.type == ExpressionValueType::INT
+                && rightValue.type == ExpressionValueType::INT) {
+            stack.push_back(ExpressionValue(
+                operation(leftValue.payloadInt, rightValue.payloadInt)));
+        } else {
+            stack.push_back(apply(leftValue, rightValue));
+        }
+    }
+
+    /**
+     * @brief Execute an operation quickened for two INT operands. Falls back
+     * to <generic> if the operands are of another type, rewriting the
+     * instruction at <offset> back to it.
+     *
+     * @tparam Operation a callable taking two ints.
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param generic the generic form of the instruction.
+     * @param apply the operation to apply to other operands.
+     * @param operation the operation on the two ints.
+     */
+    template <typename Operation>
+    void intOperation(const Chunk& chunk, size_t offset, OpCode generic,
+            ExpressionValue (*apply)(
+                const ExpressionValue&, const ExpressionValue&),
+            Operation operation) {
+        auto& leftValue = stack[stack.size() - 2];
+        auto& rightValue = stack.back();
+
+        if (leftValue.type == ExpressionValueType::INT
+                && rightValue.type == ExpressionValueType::INT) {
+            leftValue = ExpressionValue(
+                operation(leftValue.payloadInt, rightValue.payloadInt));
+            stack.pop_back();
+        } else {
+            chunk.rewrite(offset, generic);
+            binaryOperation(apply);
+        }
+    }
+
+    /**
+     * @brief Execute an operation quickened for two FLOAT operands. Falls
+     * back to <generic> if the operands are of another type, rewriting the
+     * instruction at <offset> back to it.
+     *
+     * @tparam Operation a callable taking two floats.
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param generic the generic form of the instruction.
+     * @param apply the operation to apply to other operands.
+     * @param operation the operation on the two floats.
+     */
+    template <typename Operation>
+    void floatOperation(const Chunk& chunk, size_t offset, OpCode generic,
+            ExpressionValue (*apply)(
+                const ExpressionValue&, const ExpressionValue&),
+            Operation operation) {
+        auto& leftValue = stack[stack.size() - 2];
+        auto& rightValue = stack.back();
+
+        if (leftValue.type == ExpressionValueType::FLOAT
+                && rightValue.type == ExpressionValueType::FLOAT) {
+            leftValue = ExpressionValue(
+                operation(leftValue.payloadFloat, rightValue.payloadFloat));
+            stack.pop_back();
+        } else {
+            chunk.rewrite(offset, generic);
+            binaryOperation(apply);
+        }
+    }
+
+    /**
+     * @brief Call the function below the topmost <argCount> values.
+     *
+     * Compiled functions get a new call frame, all other functions are
+     * evaluated directly.
+     *
+     * @param argCount the number of arguments on the stack.
+     */
+    void call(uint32_t argCount);
+
+    /**
+     * @brief Call the function below the topmost <argCount> values for a
+     * CALL_SELF instruction, expecting it to be the executing function.
+     *
+     * Other functions are called like with call, after rewriting the
+     * instruction back to CALL.
+     *
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param argCount the number of arguments on the stack.
+     */
+    void callSelf(const Chunk& chunk, size_t offset, uint32_t argCount);
+
+    /**
+     * @brief Push the call frame for a compiled function, or its memoized
+     * result.
+     *
+     * @param function the function to call, checked to take the arguments.
+     * @param functionIndex the index of the function on the stack, followed
+     * by its arguments.
+     */
+    void callCompiled(const CompiledFunction& function,
+        size_t functionIndex);
+
+    /**
+     * @brief Quicken the CALL instruction at <offset> to CALL_SELF if it
+     * calls the executing function.
+     *
+     * @param chunk the chunk holding the instruction.
+     * @param offset the offset of the instruction.
+     * @param argCount the number of arguments on the stack.
+     */
+    void quickenCall(const Chunk& chunk, size_t offset, uint32_t argCount);
+
+    /**
+     * @brief Call the function below the topmost <argCount> values in place
+     * of the current call frame.
+     *
+     * The environments and the nursery of the current frame are released
+     * and the new frame returns to its caller directly. Functions that are
+     * not compiled are called like with call.
+     *
+     * @param argCount the number of arguments on the stack.
+     */
+    void tailCall(uint32_t argCount);
+
+    /**
+     * @brief Remove the topmost value from the stack.
+     *
+     * @return ExpressionValue the value removed.
+     */
+    ExpressionValue pop();
+
+    /**
+     * @brief The operands and intermediate results.
+     *
+     */
+    std::vector<ExpressionValue> stack;
+
+    /**
+     * @brief The call frames of all active compiled functions.
+     *
+     */
+    std::vector<CallFrame> frames;
+
+    /**
+     * @brief The maximum number of call frames.
+     *
+     */
+    size_t maxDepth = DEFAULT_MAX_DEPTH;
+};
+
+
+#endif
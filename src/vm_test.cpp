@@ -0,0 +1,475 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "parser.h"
+#include "compiler.h"
+#include "jit.h"
+#include "vm.h"
+
+
+std::unique_ptr<Program> parseProgram(const char* program) {
+    std::unique_ptr<Input> input = std::make_unique<StringInput>(program);
+    auto tokenizer = std::make_unique<Tokenizer>(input);
+    auto parser = std::make_unique<Parser>(tokenizer);
+
+    return parser->parseAll();
+}
+
+ExpressionValue runOnVirtualMachine(const char* program) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    auto parsed = parseProgram(program);
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*parsed);
+
+    VirtualMachine vm;
+    return vm.run(*compiled, env);
+}
+
+ExpressionValue runOnTree(const char* program) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    auto parsed = parseProgram(program);
+
+    return parsed->evaluate(env);
+}
+
+void expectSameResult(const char* program) {
+    auto expected = runOnTree(program);
+    Pin pinExpected(expected.getHeapObject());
+    auto actual = runOnVirtualMachine(program);
+
+    ASSERT_EQ(actual.type, expected.type);
+    switch (expected.type) {
+        case ExpressionValueType::INT:
+            ASSERT_EQ(actual.payloadInt, expected.payloadInt);
+            break;
+        case ExpressionValueType::FLOAT:
+            ASSERT_FLOAT_EQ(actual.payloadFloat, expected.payloadFloat);
+            break;
+        case ExpressionValueType::STRING:
+            ASSERT_EQ(actual.getString(), expected.getString());
+            break;
+        default:
+            break;
+    }
+}
+
+
+TEST(VirtualMachine, Arithmetic) {
+    auto result = runOnVirtualMachine("(10 + 5) * 3 - 20 / 4");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 40);
+}
+
+
+TEST(VirtualMachine, StringConcatenation) {
+    auto result = runOnVirtualMachine("x = \"Hello, \"  x + \"world!\"");
+
+    ASSERT_EQ(result.type, ExpressionValueType::STRING);
+    ASSERT_STREQ(result.getString().c_str(), "Hello, world!");
+}
+
+
+TEST(VirtualMachine, Connectives) {
+    expectSameResult("10 == 11 || 10 == 11 || 5 == 5");
+    expectSameResult("1 && 0");
+    expectSameResult("0 && 1");
+    expectSameResult("1.5 < 2.5 && 3 >= 3");
+}
+
+
+TEST(VirtualMachine, IfStatementComplex) {
+    expectSameResult(
+        "   var = 10 == 10         "
+        "   test = 5               "
+        "   IF var {               "
+        "       test = test * 5    "
+        "   } ELSE {               "
+        "       test = 10          "
+        "   }                      "
+        "   test                   ");
+}
+
+
+TEST(VirtualMachine, Invocation) {
+    auto result = runOnVirtualMachine("print(\"TEST\")");
+
+    ASSERT_EQ(result.type, ExpressionValueType::NONE);
+}
+
+
+TEST(VirtualMachine, FunctionDeclarationAndInvocation) {
+    expectSameResult(
+        "   func = FUN test {                              "
+        "       IF test > 5 test - 10 ELSE 1000            "
+        "   }                                              "
+        "                                                  "
+        "   result = func(func(10))                        ");
+}
+
+
+TEST(VirtualMachine, RecursiveFibonacci) {
+    const char* program =
+        "   fib = FUN x {                         "
+        "      IF x <= 2 {                        "
+        "          1                              "
+        "      } ELSE {                           "
+        "          fib(x - 1) + fib(x - 2)        "
+        "      }                                  "
+        "   }                                     "
+        "                                         "
+        "   fib(15)                               ";
+
+    auto result = runOnVirtualMachine(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 610);
+
+    expectSameResult(program);
+}
+
+
+TEST(VirtualMachine, LexicalScoping) {
+    expectSameResult(
+        "   outer = 1                             "
+        "   get = FUN { outer }                   "
+        "   call = FUN outer { get() }            "
+        "   call(42)                              ");
+}
+
+TEST(VirtualMachine, AssignmentsUpdateOuterVariables) {
+    expectSameResult(
+        "   count = 0                             "
+        "   inc = FUN { count = count + 1 }       "
+        "   inc() inc()                           "
+        "   count                                 ");
+}
+
+TEST(VirtualMachine, ClosuresOutliveTheirDefinition) {
+    const char* program =
+        "   makeAdder = FUN n { FUN x { x + n } } "
+        "   addTwo = makeAdder(2)                 "
+        "   addFive = makeAdder(5)                "
+        "   addTwo(1) * 10 + addFive(1)           ";
+
+    ASSERT_EQ(runOnVirtualMachine(program).payloadInt, 36);
+    expectSameResult(program);
+}
+
+TEST(VirtualMachine, ClosuresSurviveCollections) {
+    const char* program =
+        "   makeAdder = FUN n { FUN x { x + n } } "
+        "   sum = FUN k, acc {                    "
+        "      IF k == 0 { acc } ELSE { add = makeAdder(k); sum(k - 1, acc + add(1)) }"
+        "   }                                     "
+        "   sum(20000, 0)                         ";
+
+    ASSERT_EQ(runOnVirtualMachine(program).payloadInt, 200030000);
+    expectSameResult(program);
+}
+
+TEST(VirtualMachine, ClosuresAssignOuterVariables) {
+    const char* program =
+        "   count = 0                             "
+        "   inc = FUN { count = count + 1 }       "
+        "   makeCounter = FUN {                   "
+        "      n = 0; FUN { n = n + 1; count = count + n }"
+        "   }                                     "
+        "   counter = makeCounter()               "
+        "   inc() inc() counter() counter()       "
+        "   count                                 ";
+
+    ASSERT_EQ(runOnVirtualMachine(program).payloadInt, 5);
+    expectSameResult(program);
+}
+
+TEST(VirtualMachine, ResolvedLocals) {
+    expectSameResult(
+        "   x = 1                                 "
+        "   f = FUN n { a = n * 2; { a = a + x; a } }"
+        "   f(20)                                 ");
+}
+
+TEST(VirtualMachine, TailCallsRunInConstantSpace) {
+    const char* program =
+        "   count = FUN n, acc {                  "
+        "      IF n == 0 { acc } ELSE { count(n - 1, acc + 1) }"
+        "   }                                     "
+        "   count(200000, 0)                      ";
+
+    auto young = Heap::global().getNurseryMark();
+    auto result = runOnVirtualMachine(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 200000);
+    ASSERT_EQ(Heap::global().getNurseryMark().objects, young.objects);
+
+    expectSameResult(program);
+}
+
+TEST(VirtualMachine, MutualTailCalls) {
+    expectSameResult(
+        "   even = FUN n { IF n == 0 { 1 } ELSE { odd(n - 1) } }"
+        "   odd = FUN n { IF n == 0 { 0 } ELSE { even(n - 1) } }"
+        "   even(100001)                          ");
+}
+
+TEST(VirtualMachine, DeepRecursionDoesNotUseTheNativeStack) {
+    auto result = runOnVirtualMachine(
+        "   depth = FUN n { IF n == 0 { 0 } ELSE { 1 + depth(n - 1) } }"
+        "   depth(20000)                          ");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 20000);
+}
+
+TEST(VirtualMachine, StackOverflow) {
+    GlobalEnvironment globalEnv;
+    auto parsed = parseProgram(
+        "   depth = FUN n { IF n == 0 { 0 } ELSE { 1 + depth(n - 1) } }"
+        "   depth(1000)                           ");
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*parsed);
+
+    VirtualMachine vm;
+    vm.setMaxDepth(100);
+    ASSERT_THROW(vm.run(*compiled, &globalEnv), std::exception);
+
+    // The frames of the failed run are gone, the next one starts fresh
+    vm.setMaxDepth(2000);
+    auto result = vm.run(*compiled, &globalEnv);
+    ASSERT_EQ(result.payloadInt, 1000);
+}
+
+TEST(VirtualMachine, PureFunctionsAreMemoized) {
+    const char* program =
+        "   fib = FUN x {                         "
+        "      IF x <= 2 {                        "
+        "          1                              "
+        "      } ELSE {                           "
+        "          fib(x - 1) + fib(x - 2)        "
+        "      }                                  "
+        "   }                                     "
+        "   fib(40)                               ";
+
+    MemoTable::resetStatistics();
+    auto result = runOnVirtualMachine(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 102334155);
+    ASSERT_EQ(MemoTable::getStatistics().misses, 40);
+
+    result = runOnTree(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 102334155);
+    ASSERT_EQ(MemoTable::getStatistics().misses, 80);
+}
+
+TEST(VirtualMachine, CapturedFunctionsAreCalledWithoutLookup) {
+    const char* program =
+        "   fib = FUN x {                         "
+        "      IF x <= 2 {                        "
+        "          1                              "
+        "      } ELSE {                           "
+        "          fib(x - 1) + fib(x - 2)        "
+        "      }                                  "
+        "   }                                     "
+        "   fib(20)                               ";
+
+    // Every call is interpreted, reading fib from the closure
+    MemoTable::setCapacity(0);
+    JitFunction::setThreshold(0);
+    Environment::resetCacheStatistics();
+    auto result = runOnVirtualMachine(program);
+
+    ASSERT_EQ(result.payloadInt, 6765);
+    // No call searches the chain
+    ASSERT_EQ(Environment::getCacheStatistics().misses, 0);
+    ASSERT_EQ(Environment::getCacheStatistics().hits, 0);
+
+    Environment::resetCacheStatistics();
+    result = runOnTree(program);
+    MemoTable::setCapacity(MemoTable::DEFAULT_CAPACITY);
+    JitFunction::setThreshold(JitFunction::DEFAULT_THRESHOLD);
+
+    ASSERT_EQ(result.payloadInt, 6765);
+    ASSERT_EQ(Environment::getCacheStatistics().misses, 0);
+    ASSERT_EQ(Environment::getCacheStatistics().hits, 0);
+}
+
+TEST(VirtualMachine, CallsSeeReassignedButNotShadowedFunctions) {
+    const char* program =
+        "   g = FUN x { 1 }                       "
+        "   callG = FUN x { g(x) }                "
+        "   shadow = FUN g { callG(0) }           "
+        "   a = callG(0)                          "
+        "   b = shadow(FUN x { 2 })               "
+        "   c = callG(0)                          "
+        "   g = FUN x { 3 }                       "
+        "   a + b * 10 + c * 100 + callG(0) * 1000";
+
+    // The parameter g of shadow is not visible where callG is defined
+    auto result = runOnVirtualMachine(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 3111);
+
+    result = runOnTree(program);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 3111);
+}
+
+std::vector<OpCode> decodeInstructions(const Chunk& chunk) {
+    std::vector<OpCode> instructions;
+
+    for (size_t offset = 0; offset < chunk.code.size();) {
+        auto op = static_cast<OpCode>(chunk.code[offset]);
+        instructions.push_back(op);
+        offset += 1 + operandCount(op) * sizeof(uint32_t);
+    }
+
+    return instructions;
+}
+
+TEST(VirtualMachine, QuickensOperationsOnNumbers) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    auto parsed = parseProgram("x = 3 y = 1.5 (x * 2 > 5) + (y / 0.5 < 4.0)");
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*parsed);
+
+    for (int run = 0; run < 2; run++) {
+        VirtualMachine vm;
+        auto result = vm.run(*compiled, env);
+
+        ASSERT_EQ(result.type, ExpressionValueType::INT);
+        ASSERT_EQ(result.payloadInt, 2);
+    }
+
+    auto instructions = decodeInstructions(compiled->chunk);
+    for (auto op: { OpCode::MULTIPLY_INT, OpCode::GREATER_INT,
+            OpCode::DIVIDE_FLOAT, OpCode::LESS_FLOAT, OpCode::ADD_INT }) {
+        ASSERT_NE(std::find(instructions.begin(), instructions.end(), op),
+            instructions.end());
+    }
+}
+
+TEST(VirtualMachine, QuickenedOperationsFallBack) {
+    expectSameResult("f = FUN a, b { a + b } f(1, 2) f(1.5, 2.5)");
+    expectSameResult("f = FUN a, b { a + b } f(1, 2) f(\"a\", \"b\")");
+    expectSameResult("f = FUN a, b { a < b } f(1.5, 2.5) f(3, 2)");
+
+    ASSERT_THROW(runOnVirtualMachine(
+        "f = FUN a, b { a < b } f(1, 2) f(1, 2.0)"), std::exception);
+    ASSERT_THROW(runOnVirtualMachine(
+        "f = FUN a, b { a / b } f(4, 2) f(4, 0)"), std::exception);
+}
+
+TEST(VirtualMachine, EmitsSuperinstructions) {
+    GlobalEnvironment globalEnv;
+    Environment* env = &globalEnv;
+
+    auto parsed = parseProgram(
+        "f = FUN x { IF x < 3 { x + 1 } ELSE { 1 + f(x - 1) } } f(5)");
+
+    Compiler compiler;
+    auto compiled = compiler.compileProgram(*parsed);
+
+    VirtualMachine vm;
+    auto result = vm.run(*compiled, env);
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 6);
+
+    auto function = std::dynamic_pointer_cast<CompiledFunction>(
+        compiled->chunk.constants[0].getFunction());
+    ASSERT_TRUE(function);
+
+    auto instructions = decodeInstructions(function->chunk);
+    for (auto op: { OpCode::COMPARE_JUMP_IF_FALSE, OpCode::ADD_LOCAL_CONSTANT,
+            OpCode::SUBTRACT_LOCAL_CONSTANT, OpCode::CALL_SELF }) {
+        ASSERT_NE(std::find(instructions.begin(), instructions.end(), op),
+            instructions.end());
+    }
+}
+
+TEST(VirtualMachine, SuperinstructionsFallBack) {
+    expectSameResult("f = FUN a { a + \"!\" } f(\"a\")");
+    expectSameResult("f = FUN a, b { IF a < b { 1 } ELSE { 2 } } "
+        "f(1, 2) f(2.5, 1.5)");
+    expectSameResult("x = 2 IF x > 1 && x < 3 { 1 } ELSE { 0 }");
+    expectSameResult("x = 5 IF x > 1 && x < 3 { 1 } ELSE { 0 }");
+    expectSameResult(
+        "   f = FUN x, h {                        "
+        "      IF x > 0 {                         "
+        "          1 + h(x - 1, h)                "
+        "      } ELSE {                           "
+        "          0                              "
+        "      }                                  "
+        "   }                                     "
+        "   g = FUN x, h { 100 }                  "
+        "   f(3, f) + f(1, g)                     ");
+
+    ASSERT_THROW(runOnVirtualMachine(
+        "f = FUN a { a - 1 } f(1) f(\"a\")"), std::exception);
+    ASSERT_THROW(runOnVirtualMachine(
+        "f = FUN a, b { IF a == b { 1 } ELSE { 2 } } "
+        "f(1, 2) f(\"a\", \"a\")"), std::exception);
+}
+
+TEST(VirtualMachine, Loops) {
+    auto result = runOnVirtualMachine(
+        "sum = 0 FOR i = 0, i < 100, i = i + 1 { sum = sum + i } sum");
+
+    ASSERT_EQ(result.type, ExpressionValueType::INT);
+    ASSERT_EQ(result.payloadInt, 4950);
+
+    expectSameResult(
+        "sum = 0 FOR i = 0, i < 100, i = i + 1 { sum = sum + i } sum");
+    expectSameResult("n = 10 f = 1 WHILE n > 1 { f = f * n; n = n - 1 } f");
+    expectSameResult("n = 0 WHILE 0 { n = 1 } n");
+    expectSameResult("FOR i = 0, i < 3, i = i + 1 { 0 }");
+    expectSameResult(
+        "s = \"a\" FOR i = 0, i < 5, i = i + 1 { s = s + \"b\" } s");
+    expectSameResult(
+        "   total = 0                             "
+        "   f = FUN n {                           "
+        "      FOR i = 0, i < n, i = i + 1 {      "
+        "          FOR j = 0, j < i, j = j + 1 {  "
+        "              total = total + j          "
+        "          }                              "
+        "      };                                 "
+        "      total                              "
+        "   }                                     "
+        "   f(10)                                 ");
+}
+
+TEST(VirtualMachine, LoopsReuseTheirEnvironment) {
+    expectSameResult("last = 0 "
+        "FOR i = 0, i < 10, i = i + 1 { square = i * i; last = square } last");
+    expectSameResult("FOR i = 0, i < 3, i = i + 1 { 0 } i");
+
+    // One environment holding square for all iterations
+    auto& statistics = Heap::global().getStatistics();
+    auto before = statistics.youngObjectsAllocated;
+    runOnTree("FOR i = 0, i < 1, i = i + 1 { square = i * i; square }");
+    auto once = statistics.youngObjectsAllocated - before;
+
+    before = statistics.youngObjectsAllocated;
+    runOnTree("FOR i = 0, i < 100, i = i + 1 { square = i * i; square }");
+    ASSERT_EQ(statistics.youngObjectsAllocated - before, once);
+
+    ASSERT_THROW(runOnVirtualMachine("WHILE 1 2"), std::exception);
+    ASSERT_THROW(runOnVirtualMachine("FOR i = 0 i < 1 { 0 }"), std::exception);
+}
@@ -0,0 +1,21 @@
+#!/bin/bash
+# Runs a compiled script and the interpreter on the same script and fails
+# unless both print the same output and exit code.
+#
+# Usage: compare_output.sh <binary> <main> <script>
+
+binary="$1"
+main="$2"
+script="$3"
+
+compiled=$("$binary" 2>&1)
+compiled_status=$?
+interpreted=$("$main" "$script" 2>&1)
+interpreted_status=$?
+
+if [ "$compiled" != "$interpreted" ] || [ $compiled_status != $interpreted_status ]; then
+    echo "$script: output differs"
+    echo "compiled ($compiled_status): $compiled"
+    echo "interpreted ($interpreted_status): $interpreted"
+    exit 1
+fi